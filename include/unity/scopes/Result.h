@@ -169,6 +169,7 @@ public:
 
     This method can be used for read-only access to both standard ("uri", "title", "art", "dnd_uri")
     and custom metadata attributes. Referencing a non-existing attribute throws unity::InvalidArgumentException.
+    The returned reference remains valid until this Result is modified or destroyed.
     \param key The name of the attribute.
     \return A const reference to the attribute.
     \throws unity::Invalidargument if no attribute with the given name exists.
@@ -222,6 +223,9 @@ public:
     therefore the code should always check the type of returned Variant and depending on that use Variant::get_int() or
     Variant::get_int_64_t() when dealing with 64-bit integers. This is not needed when using 32 bit integers only.
 
+    The returned reference remains valid until this Result is modified or destroyed
+    (modifying a copy of this Result does not invalidate it).
+
     \param key The attribute name.
     \return The attribute value.
     \throws unity::InvalidArgumentException if given attribute hasn't been set.
@@ -47,6 +47,7 @@ namespace internal
 
 struct VariantImpl;
 struct NullVariant;
+class VariantAccess;
 
 } // namespace internal
 
@@ -200,7 +201,7 @@ private:
     Variant(internal::NullVariant const&);
 
     std::unique_ptr<internal::VariantImpl> p;
-    friend class VariantImpl;
+    friend class internal::VariantAccess;
 };
 
 /**
@@ -0,0 +1,515 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+// Bounded thread-safe queue of items, with the same interface and destroy semantics as ThreadSafeQueue.
+//
+// Items are kept in a fixed-size ring buffer (the capacity is rounded up to a power of two).
+// Producers and consumers claim slots with a compare-and-swap on separate positions, so
+// push() and try_pop() do not take a lock unless the queue is full (for Block) or empty
+// (for wait_and_pop()). The mutex and condition variables are used only to put threads to
+// sleep and to wake them up again.
+//
+// What happens when an item is pushed onto a full queue depends on the overflow policy:
+// - Block: push() waits until a consumer has made space (or the queue is destroyed).
+// - Reject: push() returns false and the item is not added.
+// - DropOldest: the oldest item in the queue is discarded to make room.
+//
+// T must have a move constructor that does not throw.
+// If the queue is destroyed while threads are blocked in wait_and_pop() or push(), these throw std::runtime_error.
+
+template<typename T>
+class BoundedQueue final
+{
+public:
+    NONCOPYABLE(BoundedQueue);
+    UNITY_DEFINES_PTRS(BoundedQueue);
+
+    typedef T value_type;
+
+    enum class OverflowPolicy { Block, Reject, DropOldest };
+
+    BoundedQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::Block);
+    ~BoundedQueue();
+
+    void destroy() noexcept;
+    void wait_for_destroy() noexcept;
+    bool push(T const& item);
+    bool push(T&& item);
+    T wait_and_pop();
+    bool try_pop(T& item);
+    bool empty() const noexcept;
+    void wait_until_empty() const noexcept;
+    size_t size() const noexcept;
+    size_t capacity() const noexcept;
+    OverflowPolicy overflow_policy() const noexcept;
+
+private:
+    // Each cell carries a sequence number that tells producers and consumers whose turn it is:
+    // seq == pos means the cell is free for the producer that claims position pos, and
+    // seq == pos + 1 means the cell holds the item for the consumer that claims position pos.
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+    };
+
+    static constexpr size_t cache_line_size = 64;
+    static constexpr int max_spins = 16;  // Times to yield before wait_and_pop() or push() go to sleep
+
+    size_t const capacity_;
+    size_t const mask_;
+    OverflowPolicy const policy_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // Keep the positions on separate cache lines, so producers and consumers don't contend.
+    char pad0_[cache_line_size];
+    std::atomic<size_t> enqueue_pos_;
+    char pad1_[cache_line_size - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos_;
+    char pad2_[cache_line_size - sizeof(std::atomic<size_t>)];
+
+    std::atomic<bool> destroyed_;
+    mutable std::atomic<int> item_waiters_;   // Threads sleeping until an item is pushed
+    mutable std::atomic<int> space_waiters_;  // Threads sleeping until an item is popped
+    mutable std::mutex mutex_;
+    mutable std::condition_variable pushed_;
+    mutable std::condition_variable popped_;
+    int num_waiters_;                         // Threads blocked in wait_and_pop() or push(), protected by mutex_
+
+    static size_t round_up(size_t capacity);
+    static T* item_ptr(Cell* cell) noexcept;
+
+    bool claim_push(Cell*& cell, size_t& pos) noexcept;
+    bool claim_pop(Cell*& cell, size_t& pos) noexcept;
+    void release_pop(Cell* cell, size_t pos) noexcept;
+    bool full() const noexcept;
+    bool ready() const noexcept;
+    void notify_pushed() noexcept;
+    void notify_popped() noexcept;
+    bool push_(T& item);
+};
+
+template<typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity, OverflowPolicy policy) :
+    capacity_(round_up(capacity)),
+    mask_(capacity_ - 1),
+    policy_(policy),
+    cells_(new Cell[capacity_]),
+    enqueue_pos_(0),
+    dequeue_pos_(0),
+    destroyed_(false),
+    item_waiters_(0),
+    space_waiters_(0),
+    num_waiters_(0)
+{
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+BoundedQueue<T>::~BoundedQueue()
+{
+    destroy();
+    wait_for_destroy();
+
+    Cell* cell;
+    size_t pos;
+    while (claim_pop(cell, pos))
+    {
+        item_ptr(cell)->~T();
+    }
+}
+
+template<typename T>
+void BoundedQueue<T>::destroy() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (destroyed_)
+    {
+        return;
+    }
+    destroyed_ = true;
+    pushed_.notify_all();  // Wake up anyone asleep in wait_and_pop()
+    popped_.notify_all();  // Wake up anyone asleep in push() or wait_for_destroy()
+}
+
+template<typename T>
+void BoundedQueue<T>::wait_for_destroy() noexcept
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    popped_.wait(lock, [this] { return destroyed_ && num_waiters_ == 0; });
+}
+
+template<typename T>
+bool BoundedQueue<T>::push(T const& item)
+{
+    T tmp(item);  // Copy before claiming a slot, in case the copy throws.
+    return push_(tmp);
+}
+
+template<typename T>
+bool BoundedQueue<T>::push(T&& item)
+{
+    return push_(item);
+}
+
+template<typename T>
+T BoundedQueue<T>::wait_and_pop()
+{
+    int spins = 0;
+    for (;;)
+    {
+        if (destroyed_)
+        {
+            throw std::runtime_error("BoundedQueue: queue destroyed while thread was blocked in wait_and_pop()");
+        }
+
+        Cell* cell;
+        size_t pos;
+        if (claim_pop(cell, pos))
+        {
+            T* p = item_ptr(cell);
+            T item(std::move(*p));
+            p->~T();
+            release_pop(cell, pos);
+            notify_popped();
+            return item;
+        }
+        if (++spins < max_spins)
+        {
+            std::this_thread::yield();  // An item is usually not far off, and sleeping is expensive.
+            continue;
+        }
+        spins = 0;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++num_waiters_;
+        ++item_waiters_;
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // Pairs with the fence in notify_pushed()
+        if (!destroyed_ && !ready())
+        {
+            pushed_.wait(lock);
+        }
+        --item_waiters_;
+        if (destroyed_)
+        {
+            if (--num_waiters_ == 0)
+            {
+                popped_.notify_all();
+            }
+            throw std::runtime_error("BoundedQueue: queue destroyed while thread was blocked in wait_and_pop()");
+        }
+        --num_waiters_;
+    }
+}
+
+template<typename T>
+bool BoundedQueue<T>::try_pop(T& item)
+{
+    Cell* cell;
+    size_t pos;
+    if (!claim_pop(cell, pos))
+    {
+        return false;
+    }
+    T* p = item_ptr(cell);
+    item = std::move(*p);
+    p->~T();
+    release_pop(cell, pos);
+    notify_popped();
+    return true;
+}
+
+template<typename T>
+bool BoundedQueue<T>::empty() const noexcept
+{
+    return size() == 0;
+}
+
+template<typename T>
+void BoundedQueue<T>::wait_until_empty() const noexcept
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++space_waiters_;
+    std::atomic_thread_fence(std::memory_order_seq_cst);  // Pairs with the fence in notify_popped()
+    popped_.wait(lock, [this] { return size() == 0; });
+    --space_waiters_;
+}
+
+// The result is approximate while other threads are pushing or popping.
+
+template<typename T>
+size_t BoundedQueue<T>::size() const noexcept
+{
+    size_t deq = dequeue_pos_.load(std::memory_order_acquire);
+    size_t enq = enqueue_pos_.load(std::memory_order_acquire);
+    if (static_cast<std::ptrdiff_t>(enq - deq) <= 0)
+    {
+        return 0;
+    }
+    return std::min(enq - deq, capacity_);
+}
+
+template<typename T>
+size_t BoundedQueue<T>::capacity() const noexcept
+{
+    return capacity_;
+}
+
+template<typename T>
+typename BoundedQueue<T>::OverflowPolicy BoundedQueue<T>::overflow_policy() const noexcept
+{
+    return policy_;
+}
+
+template<typename T>
+size_t BoundedQueue<T>::round_up(size_t capacity)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("BoundedQueue: capacity must be > 0");
+    }
+    size_t n = 2;
+    while (n < capacity)
+    {
+        n <<= 1;
+    }
+    return n;
+}
+
+template<typename T>
+T* BoundedQueue<T>::item_ptr(Cell* cell) noexcept
+{
+    return reinterpret_cast<T*>(&cell->storage);
+}
+
+// Claims the cell at the tail of the queue for a producer. Returns false if the queue is full.
+
+template<typename T>
+bool BoundedQueue<T>::claim_push(Cell*& cell, size_t& pos) noexcept
+{
+    pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        cell = &cells_[pos & mask_];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        auto dif = static_cast<std::ptrdiff_t>(seq - pos);
+        if (dif == 0)
+        {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        else if (dif < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);  // Another producer got there first
+        }
+    }
+}
+
+// Claims the cell at the head of the queue for a consumer. Returns false if there is no item.
+
+template<typename T>
+bool BoundedQueue<T>::claim_pop(Cell*& cell, size_t& pos) noexcept
+{
+    pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        cell = &cells_[pos & mask_];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        auto dif = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+        if (dif == 0)
+        {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        else if (dif < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);  // Another consumer got there first
+        }
+    }
+}
+
+// Hands the cell back to the producer that will claim it on the next lap around the ring.
+
+template<typename T>
+void BoundedQueue<T>::release_pop(Cell* cell, size_t pos) noexcept
+{
+    cell->seq.store(pos + capacity_, std::memory_order_release);
+}
+
+// full() and ready() decide whether a caller goes to sleep. If they race with another thread,
+// they return the answer that makes the caller try again rather than sleep.
+
+template<typename T>
+bool BoundedQueue<T>::full() const noexcept
+{
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t seq = cells_[pos & mask_].seq.load(std::memory_order_acquire);
+    return static_cast<std::ptrdiff_t>(seq - pos) < 0;
+}
+
+template<typename T>
+bool BoundedQueue<T>::ready() const noexcept
+{
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    size_t seq = cells_[pos & mask_].seq.load(std::memory_order_acquire);
+    return static_cast<std::ptrdiff_t>(seq - (pos + 1)) >= 0;
+}
+
+// The waiters increment their counter and issue a fence before checking whether they need to sleep,
+// while holding mutex_. We issue a fence after updating the queue and before looking at the counter,
+// so either the waiter sees our update, or we see the waiter and wake it after it has gone to sleep.
+
+template<typename T>
+void BoundedQueue<T>::notify_pushed() noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (item_waiters_.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pushed_.notify_one();
+    }
+}
+
+template<typename T>
+void BoundedQueue<T>::notify_popped() noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (space_waiters_.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        popped_.notify_all();
+    }
+}
+
+template<typename T>
+bool BoundedQueue<T>::push_(T& item)
+{
+    int spins = 0;
+    for (;;)
+    {
+        if (destroyed_)
+        {
+            throw std::runtime_error("BoundedQueue: cannot push onto destroyed queue");
+        }
+
+        Cell* cell;
+        size_t pos;
+        if (claim_push(cell, pos))
+        {
+            new (&cell->storage) T(std::move(item));
+            cell->seq.store(pos + 1, std::memory_order_release);
+            notify_pushed();
+            return true;
+        }
+
+        switch (policy_)
+        {
+            case OverflowPolicy::Reject:
+            {
+                return false;
+            }
+            case OverflowPolicy::DropOldest:
+            {
+                if (claim_pop(cell, pos))
+                {
+                    item_ptr(cell)->~T();
+                    release_pop(cell, pos);
+                }
+                break;
+            }
+            case OverflowPolicy::Block:
+            {
+                if (++spins < max_spins)
+                {
+                    std::this_thread::yield();
+                    break;
+                }
+                spins = 0;
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                ++num_waiters_;
+                ++space_waiters_;
+                std::atomic_thread_fence(std::memory_order_seq_cst);  // Pairs with the fence in notify_popped()
+                if (!destroyed_ && full())
+                {
+                    popped_.wait(lock);
+                }
+                --space_waiters_;
+                if (destroyed_)
+                {
+                    if (--num_waiters_ == 0)
+                    {
+                        popped_.notify_all();
+                    }
+                    throw std::runtime_error("BoundedQueue: queue destroyed while thread was blocked in push()");
+                }
+                --num_waiters_;
+                break;
+            }
+            default:
+            {
+                assert(false);  // LCOV_EXCL_LINE
+                return false;   // LCOV_EXCL_LINE
+            }
+        }
+    }
+}
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+// Counts the work that was done for queries after they were cancelled.
+
+class CancellationStats final
+{
+public:
+    NONCOPYABLE(CancellationStats);
+    UNITY_DEFINES_PTRS(CancellationStats);
+
+    CancellationStats();
+
+    int64_t cancelled_queries() const noexcept;
+    int64_t dropped_results() const noexcept;           // Results pushed by the scope after cancellation
+    int64_t dropped_after_marshaling() const noexcept;  // Of those, results that were marshaled already
+
+private:
+    std::atomic<int64_t> cancelled_queries_;
+    std::atomic<int64_t> dropped_results_;
+    std::atomic<int64_t> dropped_after_marshaling_;
+
+    friend class CancellationToken;
+};
+
+// A CancellationToken is shared by everything that does work for a single query.
+// Once the query is cancelled, that work can be abandoned.
+
+class CancellationToken final
+{
+public:
+    NONCOPYABLE(CancellationToken);
+    UNITY_DEFINES_PTRS(CancellationToken);
+
+    CancellationToken(CancellationStats::SPtr const& stats = nullptr);
+
+    void cancel() noexcept;
+    bool cancelled() const noexcept;
+
+    // Record that a result was dropped because of cancellation.
+    void dropped_result(bool marshaled) noexcept;
+
+private:
+    std::atomic_bool cancelled_;
+    CancellationStats::SPtr const stats_;
+};
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
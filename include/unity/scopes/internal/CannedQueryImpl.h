@@ -20,6 +20,8 @@
 
 #include <unity/scopes/Variant.h>
 #include <unity/scopes/FilterState.h>
+
+#include <memory>
 #include <string>
 
 namespace unity
@@ -63,12 +65,19 @@ public:
     static const std::string scopes_schema;
 
 private:
-    static std::string decode_or_throw(std::string const& value, std::string const& key_name, std::string const& uri);
+    static std::string decode_or_throw(char const* begin, char const* end, std::string const& key_name, std::string const& uri);
+    std::string encode_uri() const;
+    void invalidate_uri() noexcept;
+
     std::string scope_id_;
     std::string query_string_;
     std::string department_id_;
     FilterState filter_state_;
     std::unique_ptr<Variant> user_data_;
+
+    // Result of to_uri(), computed on first use and reset by the setters. Accessed
+    // with the atomic shared_ptr functions, so concurrent readers of a const query are safe.
+    mutable std::shared_ptr<std::string const> uri_;
 };
 
 } // namespace internal
@@ -23,6 +23,7 @@
 #include <string>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 namespace unity
 {
@@ -77,6 +78,11 @@ public:
     */
     VariantArray serialize() const;
 
+    /**
+    \brief Returns all categories in the order in which they were registered.
+    */
+    std::vector<Category::SCPtr> categories() const;
+
 private:
     mutable std::mutex mutex_;
     typedef std::pair<std::string, Category::SCPtr> CatPair;
@@ -19,6 +19,9 @@
 #pragma once
 
 #include <unity/scopes/CategoryRenderer.h>
+
+#include <map>
+#include <memory>
 #include <string>
 
 namespace unity
@@ -30,6 +33,17 @@ namespace scopes
 namespace internal
 {
 
+// Renderer templates rarely change, so we intern them in a process-wide cache that is
+// keyed by a hash of the template. Constructing a renderer for a template that is in the
+// cache does not parse the JSON again, and all renderers for the same template share
+// the same string.
+//
+// The hash also allows us to avoid sending the same template over and over. The client
+// remembers which templates it has received from a scope, and sends their hashes
+// with each search. The scope then sends the hash instead of the template for those.
+// The client holds on to the templates it advertised until the reply is complete, so
+// it can resolve their hashes even if the cache evicts the templates in the mean time.
+
 class CategoryRendererImpl
 {
 public:
@@ -38,8 +52,19 @@ public:
 
     std::string data() const;
 
+    static std::string hash(CategoryRenderer const& renderer);
+    static CategoryRenderer from_hash(std::string const& hash);  // Throws NotFoundException if hash is unknown.
+
+    static void note_received(std::string const& origin, CategoryRenderer const& renderer);
+
+    // Returns the templates that origin sent us, keyed by hash. The cache evicts templates
+    // that are not used, so the caller keeps the returned templates for as long as a reply
+    // may refer to one of the hashes.
+    static std::map<std::string, std::shared_ptr<std::string const>> received_templates(std::string const& origin);
+
 private:
-    std::string data_;
+    std::string hash_;
+    std::shared_ptr<std::string const> data_;
 };
 
 } // namespace internal
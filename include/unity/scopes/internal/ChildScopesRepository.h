@@ -22,9 +22,12 @@
 #include <unity/scopes/internal/Logger.h>
 #include <unity/util/NonCopyable.h>
 
+#include <condition_variable>
 #include <list>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace unity
 {
@@ -44,13 +47,17 @@ public:
 
     ChildScopesRepository(std::string const& repo_file_path,
                           unity::scopes::internal::Logger& logger);
+    ~ChildScopesRepository();
 
     ChildScopeList child_scopes(ChildScopeList const& child_scopes_defaulted);
     bool set_child_scopes(ChildScopeList const& child_scopes);
 
 private:
-    bool write_repo(ChildScopeList const& child_scopes_list);
-    ChildScopeEnabledMap read_repo();
+    bool write_repo(std::string const& child_scopes_json);
+    void schedule_write(std::string const& child_scopes_json);
+    void writer_thread();
+    ChildScopeEnabledMap const& read_repo();
+    void update_cache(ChildScopeList const& child_scopes_list);
 
     std::string list_to_json(ChildScopeList const& child_scopes_list);
     ChildScopeEnabledMap json_to_list(std::string const& child_scopes_json);
@@ -61,6 +68,17 @@ private:
     std::mutex mutex_;
     ChildScopeEnabledMap cached_repo_;
     bool have_latest_cache_;
+    std::string repo_json_;         // What the repo file contains (or will contain once the pending write is done).
+    std::vector<std::string> last_ids_;  // Ids passed to the last child_scopes() call that checked repo_json_.
+    bool have_last_ids_;                 // Cleared whenever the cache changes other than by child_scopes().
+
+    // Writes from child_scopes() are done by a background thread. If several writes
+    // are requested before the thread gets to them, only the most recent one is written.
+    std::condition_variable write_cond_;
+    std::string pending_json_;
+    bool write_pending_;
+    bool done_;
+    std::thread writer_;
 };
 
 } // namespace internal
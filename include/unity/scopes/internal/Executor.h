@@ -20,8 +20,11 @@
 
 #include <core/posix/exec.h>
 #include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
 
+#include <map>
 #include <string>
+#include <vector>
 
 namespace unity
 {
@@ -37,6 +40,43 @@ class Executor
 public:
     UNITY_DEFINES_PTRS (Executor);
 
+    // A command line, environment, and confinement profile in the form that execve() needs.
+    // The registry keeps a Command for each scope, so launching a scope does not rebuild them.
+    class Command
+    {
+    public:
+        UNITY_DEFINES_PTRS(Command);
+        NONCOPYABLE(Command);
+
+        Command(const std::string& program,
+                const std::vector<std::string>& args,
+                const std::map<std::string, std::string>& env,
+                const std::string& confinement_profile);
+
+        const std::string& program() const;
+        const std::vector<std::string>& args() const;  // Without the program name
+        const std::map<std::string, std::string>& env() const;
+        const std::string& confinement_profile() const;
+
+    private:
+        friend class Executor;
+
+        const std::string program_;
+        const std::vector<std::string> args_;
+        const std::map<std::string, std::string> env_;
+        const std::string confinement_profile_;
+
+        // Null-terminated arrays for execve(), pointing into argv_strings_ and env_strings_.
+        std::vector<std::string> argv_strings_;
+        std::vector<std::string> env_strings_;
+        std::vector<char*> argv_;
+        std::vector<char*> envp_;
+
+        // Where and what to write to change the AppArmor profile on exec.
+        std::string profile_attr_path_;
+        std::string profile_attr_cmd_;
+    };
+
     Executor();
 
     virtual ~Executor() = default;
@@ -47,6 +87,11 @@ public:
             const core::posix::StandardStream& flags,
             const std::string& confinement_profile);
 
+    // Starts a process for the command. Unlike fork(), this does not copy the page tables
+    // of the (possibly large) calling process, and the child does not allocate memory or
+    // acquire locks before it calls execve().
+    virtual core::posix::ChildProcess spawn(const Command& command,
+                                            const core::posix::StandardStream& flags);
 };
 
 } // namespace internal
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/ScopeObject.h>
+
+#include <functional>
+#include <mutex>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+// A HostedScopeObject stands in for a scope that shares its process with other scopes.
+// The scope is loaded when the first request for it arrives, and unloaded again by
+// unload(), which is called once the scope has been idle for a while.
+
+class HostedScopeObject final : public ScopeObjectBase
+{
+public:
+    UNITY_DEFINES_PTRS(HostedScopeObject);
+
+    // A loaded scope. Calling stop() stops the scope and releases it.
+    struct Instance
+    {
+        ScopeObject::SPtr scope_object;
+        std::function<void()> stop;
+    };
+    typedef std::function<Instance()> LoadFunction;
+
+    HostedScopeObject(std::string const& scope_id, bool debug_mode, LoadFunction const& load);
+    virtual ~HostedScopeObject();
+
+    // Remote operation implementations
+    virtual MWQueryCtrlProxy search(CannedQuery const& q,
+                                    SearchMetadata const& hints,
+                                    VariantMap const& context,
+                                    MWReplyProxy const& reply,
+                                    InvokeInfo const& info) override;
+
+    virtual MWQueryCtrlProxy activate(Result const& result,
+                                      ActionMetadata const& hints,
+                                      MWReplyProxy const &reply,
+                                      InvokeInfo const& info) override;
+
+    virtual MWQueryCtrlProxy perform_action(Result const& result,
+                                            ActionMetadata const& hints,
+                                            std::string const& widget_id,
+                                            std::string const& action_id,
+                                            MWReplyProxy const &reply,
+                                            InvokeInfo const& info) override;
+
+    virtual MWQueryCtrlProxy preview(Result const& result,
+                                     ActionMetadata const& hints,
+                                     MWReplyProxy const& reply,
+                                     InvokeInfo const& info) override;
+
+    virtual ChildScopeList child_scopes() const override;
+    virtual bool set_child_scopes(ChildScopeList const& child_scopes) override;
+
+    virtual bool debug_mode() const override;
+
+    virtual MWQueryCtrlProxy activate_result_action(Result const& result,
+                                                    ActionMetadata const& hints,
+                                                    std::string const& action_id,
+                                                    MWReplyProxy const &reply,
+                                                    InvokeInfo const& info) override;
+
+    // Local methods
+    std::string scope_id() const;
+    bool loaded() const;
+
+    // Stops the scope, unless it is still busy with a request or query. If force is set,
+    // the scope is stopped regardless. Returns true if the scope is not loaded anymore.
+    bool unload(bool force = false);
+
+private:
+    ScopeObject::SPtr acquire() const;
+    void release() const noexcept;
+
+    std::string const scope_id_;
+    bool const debug_mode_;
+    LoadFunction const load_;
+
+    mutable std::mutex mutex_;  // Held while the scope is loaded or unloaded
+    mutable Instance instance_;
+    mutable int calls_in_progress_;
+};
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/Variant.h>
+
+#include <string>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+// Befriended by Variant. Lets the JSON parser move containers into a Variant instead of copying them.
+
+class VariantAccess
+{
+public:
+    static Variant from_dict(VariantMap&& dict);
+    static Variant from_array(VariantArray&& array);
+};
+
+// Conversion between JSON text and Variant without building an intermediate DOM.
+// The output and the accepted input match what JsonCppNode does with json-glib:
+// compact output, sorted object members, and integers that fit into 32 bits
+// are returned as Int, otherwise as Int64.
+
+// Appends the JSON encoding of v to out.
+void write_json(Variant const& v, std::string& out);
+
+// Callbacks for parse_json(), invoked in document order.
+// String arguments point into a buffer that is valid only for the duration of the call.
+
+class JsonSaxHandler
+{
+public:
+    virtual ~JsonSaxHandler() = default;
+
+    virtual void null_value() = 0;
+    virtual void bool_value(bool b) = 0;
+    virtual void int_value(int64_t i) = 0;
+    virtual void double_value(double d) = 0;
+    virtual void string_value(char const* s, size_t len) = 0;
+    virtual void start_object() = 0;
+    virtual void key(char const* s, size_t len) = 0;
+    virtual void end_object() = 0;
+    virtual void start_array() = 0;
+    virtual void end_array() = 0;
+};
+
+// Throws unity::ResourceException if json is not valid JSON.
+void parse_json(std::string const& json, JsonSaxHandler& handler);
+
+std::string variant_to_json(Variant const& v);      // Adds a trailing newline, like JsonCppNode::to_json_string().
+Variant json_to_variant(std::string const& json);   // Throws unity::ResourceException if json is not valid JSON.
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
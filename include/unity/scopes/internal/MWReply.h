@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <unity/scopes/internal/CancellationToken.h>
 #include <unity/scopes/internal/MWObjectProxy.h>
 #include <unity/scopes/internal/MWReplyProxyFwd.h>
 #include <unity/scopes/ListenerBase.h>
@@ -34,17 +35,30 @@ namespace scopes
 namespace internal
 {
 
+class ResultImpl;
+
 class MWReply : public virtual MWObjectProxy
 {
 public:
     virtual ~MWReply();
 
     virtual void push(VariantMap const& result) = 0;
+    // Pushes {"result": result.serialize()}. Middlewares that can write the result
+    // to the wire directly override this.
+    virtual void push_result(ResultImpl const& result);
     virtual void finished(CompletionDetails const& details) = 0;
     virtual void info(OperationInfo const& op_info) = 0;
 
+    // Once the token is cancelled, push() discards results instead of sending them.
+    // Must be called before the first push().
+    void set_cancellation_token(CancellationToken::SPtr const& token) noexcept;
+    CancellationToken::SPtr cancellation_token() const noexcept;
+
 protected:
     MWReply(MiddlewareBase* mw_base);
+
+private:
+    CancellationToken::SPtr cancellation_token_;
 };
 
 } // namespace internal
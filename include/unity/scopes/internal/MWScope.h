@@ -26,6 +26,9 @@
 #include <unity/scopes/QueryCtrlProxyFwd.h>
 #include <unity/scopes/Variant.h>
 
+#include <exception>
+#include <functional>
+
 namespace unity
 {
 
@@ -69,6 +72,43 @@ public:
                                                   std::string const& action_id,
                                                   MWReplyProxy const& reply) = 0;
 
+    // Completion callback for the asynchronous versions of the operations that create a query.
+    // Exactly one of ctrl and error is set.
+    typedef std::function<void(QueryCtrlProxy const& ctrl, std::exception_ptr const& error)> QueryCtrlCallback;
+
+    // Asynchronous versions of search(), activate(), and so on. They return once the request is on its way
+    // and pass the result to on_done when the scope has replied. on_done may run on a middleware thread,
+    // so it must not block. The caller must keep this proxy alive until on_done has run.
+    // The default implementations make the synchronous call and then call on_done.
+    virtual void search_async(CannedQuery const& query,
+                              VariantMap const& hints,
+                              VariantMap const& details,
+                              MWReplyProxy const& reply,
+                              QueryCtrlCallback on_done);
+
+    virtual void activate_async(VariantMap const& result,
+                                VariantMap const& hints,
+                                MWReplyProxy const& reply,
+                                QueryCtrlCallback on_done);
+
+    virtual void perform_action_async(VariantMap const& result,
+                                      VariantMap const& hints,
+                                      std::string const& widget_id,
+                                      std::string const& action_id,
+                                      MWReplyProxy const& reply,
+                                      QueryCtrlCallback on_done);
+
+    virtual void preview_async(VariantMap const& result,
+                               VariantMap const& hints,
+                               MWReplyProxy const& reply,
+                               QueryCtrlCallback on_done);
+
+    virtual void activate_result_action_async(VariantMap const& result,
+                                              VariantMap const& hints,
+                                              std::string const& action_id,
+                                              MWReplyProxy const& reply,
+                                              QueryCtrlCallback on_done);
+
 protected:
     MWScope(MiddlewareBase* mw_base);
 };
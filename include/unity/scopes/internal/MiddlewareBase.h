@@ -33,6 +33,8 @@
 #include <unity/scopes/internal/ScopeObjectBase.h>
 #include <unity/scopes/internal/StateReceiverObject.h>
 
+#include <functional>
+
 namespace unity
 {
 
@@ -82,7 +84,11 @@ public:
     virtual void add_dflt_query_object(QueryObjectBase::SPtr const& query) = 0;
     virtual MWRegistryProxy add_registry_object(std::string const& identity, RegistryObjectBase::SPtr const& registry) = 0;
     virtual MWReplyProxy add_reply_object(ReplyObjectBase::SPtr const& reply) = 0;
-    virtual MWScopeProxy add_scope_object(std::string const& identity, ScopeObjectBase::SPtr const& scope, int64_t idle_timeout = -1) = 0;
+    // If idle_callback is set, it is called (repeatedly) instead of stopping
+    // the middleware when the scope has not received a request for idle_timeout ms.
+    virtual MWScopeProxy add_scope_object(std::string const& identity, ScopeObjectBase::SPtr const& scope,
+                                          int64_t idle_timeout = -1,
+                                          std::function<void()> const& idle_callback = nullptr) = 0;
     virtual void add_dflt_scope_object(ScopeObjectBase::SPtr const& scope) = 0;
     virtual MWStateReceiverProxy add_state_receiver_object(std::string const& identity, StateReceiverObject::SPtr const& state_receiver) = 0;
 
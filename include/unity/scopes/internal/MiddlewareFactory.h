@@ -61,7 +61,7 @@ public:
 private:
     MiddlewareBase::SPtr find_unlocked(std::string const& server_name, std::string const& kind) const;
 
-    enum Kind { Kind_Zmq, Kind_REST };
+    enum Kind { Kind_Zmq, Kind_REST, Kind_Inproc };
     static Kind to_kind(::std::string const& kind);
 
     struct MiddlewareData
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/ActionMetadata.h>
+#include <unity/scopes/Result.h>
+#include <unity/scopes/Variant.h>
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+// In-memory cache for prefetched previews, used if Preview.Prefetch is set in the run time config.
+// An entry holds the replies that a scope pushed for a preview, so they can be replayed to
+// a PreviewListenerBase without contacting the scope. The entries for a scope are discarded
+// when the next search is sent to that scope. The cache is capped by the (approximate) size
+// of the replies; the least-recently used entries are evicted first.
+
+class PreviewCache final
+{
+public:
+    NONCOPYABLE(PreviewCache);
+    UNITY_DEFINES_PTRS(PreviewCache);
+
+    struct Entry
+    {
+        UNITY_DEFINES_PTRS(Entry);
+
+        std::vector<VariantMap> replies;
+        std::chrono::steady_clock::duration latency;  // Time it took the scope to produce the replies
+        size_t size;
+    };
+
+    PreviewCache(size_t max_bytes);
+
+    // The key includes the complete hints, so a preview is served from the cache only
+    // if it is requested with the same locale, form factor, connectivity, and so on.
+    static std::string key(Result const& result, ActionMetadata const& hints);
+
+    // Entries are stored only if the generation of their scope has not changed since
+    // the prefetch started. invalidate() discards the scope's entries and starts a new generation.
+    int64_t generation(std::string const& scope);
+    void invalidate(std::string const& scope);
+
+    // Returns nullptr on a miss.
+    Entry::SCPtr lookup(std::string const& scope, std::string const& key);
+    bool contains(std::string const& scope, std::string const& key);  // Does not count as hit or miss
+    void store(std::string const& scope,
+               int64_t generation,
+               std::string const& key,
+               std::vector<VariantMap> replies,
+               std::chrono::steady_clock::duration latency);
+
+    int64_t hits() const;
+    int64_t misses() const;
+    int64_t prefetched() const;
+    std::chrono::milliseconds saved_latency() const;  // Total latency of the scope for all hits
+
+private:
+    typedef std::list<std::string> LruList;
+
+    struct Item
+    {
+        std::string scope;
+        Entry::SCPtr entry;
+        LruList::iterator lru_pos;
+    };
+
+    void erase(std::map<std::string, Item>::iterator it);
+
+    size_t const max_bytes_;
+
+    std::mutex mutex_;
+    std::map<std::string, Item> items_;            // Indexed by scope and key
+    LruList lru_;                                  // Most-recently used key at the front
+    std::map<std::string, int64_t> generations_;  // Indexed by scope
+    size_t size_;
+
+    std::atomic<int64_t> hits_;
+    std::atomic<int64_t> misses_;
+    std::atomic<int64_t> prefetched_;
+    std::atomic<int64_t> saved_us_;
+};
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/ActionMetadata.h>
+#include <unity/scopes/internal/PreviewCache.h>
+#include <unity/scopes/Result.h>
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+class ScopeImpl;
+
+// Collects the first few results of a search and, once the search has completed successfully,
+// previews them in the background and stores the replies in the preview cache.
+// Previews are prefetched one at a time, so a prefetch never delays a real request
+// by more than a single invocation in the async pool.
+
+class PreviewPrefetcher final : public std::enable_shared_from_this<PreviewPrefetcher>
+{
+public:
+    NONCOPYABLE(PreviewPrefetcher);
+    UNITY_DEFINES_PTRS(PreviewPrefetcher);
+
+    PreviewPrefetcher(std::shared_ptr<ScopeImpl> const& scope,
+                      PreviewCache::SPtr const& cache,
+                      int max_results,
+                      ActionMetadata const& hints);
+
+    void add(Result const& result);  // Ignores results beyond max_results.
+    void start();                    // Only the first call has an effect.
+
+    // Called by the reply object of a prefetched preview.
+    void preview_finished(std::string const& key,
+                          bool ok,
+                          std::vector<VariantMap> replies,
+                          std::chrono::steady_clock::duration latency);
+
+private:
+    void prefetch_next();
+
+    std::shared_ptr<ScopeImpl> const scope_;
+    PreviewCache::SPtr const cache_;
+    size_t const max_results_;
+    ActionMetadata const hints_;
+    std::string const scope_proxy_;
+    int64_t const generation_;
+
+    std::mutex mutex_;
+    std::deque<Result> results_;
+    size_t num_added_;
+    bool started_;
+};
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
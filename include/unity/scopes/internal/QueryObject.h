@@ -18,9 +18,11 @@
 
 #pragma once
 
+#include <unity/scopes/internal/CancellationToken.h>
 #include <unity/scopes/internal/MWReplyProxyFwd.h>
 #include <unity/scopes/internal/MWQueryCtrlProxyFwd.h>
 #include <unity/scopes/internal/QueryObjectBase.h>
+#include <unity/scopes/internal/SurfacingCache.h>
 #include <unity/scopes/ReplyProxyFwd.h>
 
 namespace unity
@@ -65,6 +67,15 @@ public:
     // and we can pass the shared_ptr to the ReplyImpl.
     void set_self(QueryObjectBase::SPtr const& self) noexcept override;
 
+    // Called by search() for surfacing queries of scopes that set a results TTL.
+    void set_surfacing_cache(SurfacingCache::SPtr const& cache, std::string const& key);
+
+    // Called by search() for scopes that share a process, whose cache directory differs from the run time's.
+    void set_cache_directory(std::string const& dir);
+
+    // Called by query(), before run(), so cancellations of this query are counted in the scope's stats.
+    void set_cancellation_stats(CancellationStats::SPtr const& stats);
+
 protected:
     std::shared_ptr<QueryBase> query_base_;
     MWReplyProxy const reply_;
@@ -73,6 +84,10 @@ protected:
     bool pushable_;
     QueryObjectBase::SPtr self_;
     int cardinality_;
+    SurfacingCache::SPtr surfacing_cache_;
+    std::string surfacing_cache_key_;
+    std::string cache_directory_;
+    CancellationToken::SPtr cancellation_token_;  // Shared with the MWReply, so it can drop results after cancel()
     mutable std::mutex mutex_;
 };
 
@@ -20,6 +20,8 @@
 
 #include <unity/scopes/internal/ConfigBase.h>
 
+#include <vector>
+
 namespace unity
 {
 
@@ -43,6 +45,7 @@ public:
     std::string click_installdir() const;       // Directory for Click scope config files
     std::string scoperunner_path() const;       // Path to scoperunner binary
     int process_timeout() const;                // Milliseconds to wait before scope is considereed non-responsive.
+    std::vector<std::string> shared_host_scopes() const;  // IDs of scopes that share a single scoperunner process
 
 private:
     std::string identity_;
@@ -53,6 +56,7 @@ private:
     std::string click_installdir_;
     std::string scoperunner_path_;
     int process_timeout_;                       // Milliseconds
+    std::vector<std::string> shared_host_scopes_;
 };
 
 } // namespace internal
@@ -54,6 +54,15 @@ public:
         std::string confinement_profile;
         int timeout_ms;
         bool debug_mode;
+        std::string host_id;        // Scopes with the same non-empty host_id share a scoperunner process.
+    };
+
+    // A local scope to be added by apply_changes().
+    struct LocalScope
+    {
+        std::string scope_id;
+        ScopeMetadata metadata;
+        ScopeExecData exec_data;
     };
 
 public:
@@ -74,6 +83,11 @@ public:
     bool add_local_scope(std::string const& scope_id, ScopeMetadata const& scope,
                          ScopeExecData const& scope_exec_data);
     bool remove_local_scope(std::string const& scope_id);
+
+    // Adds and removes several local scopes at once. The changes are applied under a single
+    // lock acquisition, and subscribers receive a single list update for the whole batch.
+    // If a scope appears in both lists, it is added (replacing any existing scope with that id).
+    void apply_changes(std::vector<LocalScope> const& added, std::vector<std::string> const& removed);
     void set_remote_registry(MWRegistryProxy const& remote_registry);
 
     StateReceiverObject::SPtr state_receiver();
@@ -112,17 +126,29 @@ private:
                   Executor::SPtr executor);
         void kill();
 
+        // Builds the command line and environment for the process ahead of time,
+        // so exec() need not do it when the scope is first located.
+        void prepare();
+
         bool on_process_death(pid_t pid);
 
+        // For a process that hosts several scopes, these add a scope to or remove a scope
+        // from the process. remove_hosted_scope() returns the number of scopes that remain.
+        bool is_host() const noexcept;
+        void add_hosted_scope(std::string const& scope_id, std::string const& scope_config);
+        size_t remove_hosted_scope(std::string const& scope_id);
+
     private:
         // the following methods must be called with process_mutex_ locked
         void clear_handle_unlocked();
         void update_state_unlocked(ProcessState state);
+        std::vector<std::string> scope_ids_unlocked() const;
 
         bool wait_for_state(std::unique_lock<std::mutex>& lock, ProcessState state) const;
         void kill(std::unique_lock<std::mutex>& lock);
 
         std::vector<std::string> expand_custom_exec();
+        Executor::Command::SPtr make_command_unlocked();
         void publish_state_change(ProcessState scope_state);
 
         const ScopeExecData exec_data_;
@@ -132,10 +158,17 @@ private:
         core::posix::ChildProcess process_ = core::posix::ChildProcess::invalid();
         std::weak_ptr<MWPublisher> reg_publisher_; // weak_ptr, so processes don't hold publisher alive
         bool manually_started_;
+        std::map<std::string, std::string> hosted_scopes_;  // Scope ID -> scope config, empty unless is_host()
+        Executor::Command::SPtr command_;                    // Null until prepared, reset if hosted_scopes_ changes
         unity::scopes::internal::Logger& logger_;
     };
 
 private:
+    // The following methods must be called with mutex_ locked
+    bool add_local_scope_unlocked(std::string const& scope_id, ScopeMetadata const& metadata,
+                                  ScopeExecData const& exec_data, std::shared_ptr<ScopeProcess>& stale_host);
+    std::shared_ptr<ScopeProcess> detach_process_unlocked(std::string const& scope_id);
+
     std::unique_ptr<unity::scopes::internal::Logger> test_logger_;
     unity::scopes::internal::Logger& logger_;
 
@@ -150,6 +183,7 @@ private:
     MetadataMap scopes_;
     typedef std::map<std::string, std::shared_ptr<ScopeProcess>> ProcessMap;
     ProcessMap scope_processes_;
+    ProcessMap host_processes_;                 // Host ID -> process shared by several scopes
     MWRegistryProxy remote_registry_;
     mutable std::mutex mutex_;
 
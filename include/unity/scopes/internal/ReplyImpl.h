@@ -37,6 +37,7 @@ namespace internal
 {
 
 class QueryObjectBase;
+class ResultImpl;
 
 class ReplyImpl : public virtual unity::scopes::Reply, public virtual ObjectImpl
 {
@@ -52,10 +53,14 @@ public:
 
 protected:
     bool push(VariantMap const& variant_map);
+    bool push_result(ResultImpl const& result);  // Same as pushing {"result": result.serialize()}
+    bool pushable();    // False once the reply has finished or the query was cancelled or failed.
 
     MWReplyProxy fwd();
 
 private:
+    bool push_(std::function<void()> const& send);
+
     std::shared_ptr<QueryObjectBase> qo_;
     std::atomic_bool finished_;
 };
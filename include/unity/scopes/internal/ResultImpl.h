@@ -18,9 +18,11 @@
 
 #pragma once
 
+#include <deque>
 #include <string>
 #include <memory>
 #include <functional>
+#include <vector>
 #include <unity/scopes/Variant.h>
 #include <unity/scopes/ScopeProxyFwd.h>
 #include <unity/scopes/internal/RuntimeImpl.h>
@@ -81,12 +83,21 @@ public:
 
     VariantMap serialize() const;
 
+    // For serializers that write a result straight to the wire, without building the VariantMap
+    // that serialize() returns: check_serializable() throws if serialize() would throw,
+    // visit_attributes() calls func for each attribute in key order, and internal_values()
+    // returns what serialize() returns as the "internal" dictionary.
+    void check_serializable() const;
+    void visit_attributes(std::function<void(std::string const& key, Variant const& value)> const& func) const;
+    VariantMap internal_values() const;
+
     bool compare(ResultImpl *other) const;
 
     // a public static method, so there's access to the private constructor
     // without the need to define too many classes as friends
     static Result create_result(VariantMap const&);
     static Result create_result(ResultImpl *impl);
+    static ResultImpl const& get(Result const& result);
 
 protected:
     virtual void serialize_internal(VariantMap& var) const;
@@ -100,12 +111,38 @@ protected:
                             std::function<void(VariantMap const&)> const& not_found_func) const;
 
 private:
+    // Attributes are kept in a flat list with interned keys, so a result does not allocate a key
+    // string for each attribute, and a sorted index into the list for binary search. The list
+    // is shared by copies of a result until one of them is modified. Once operator[] has returned
+    // a non-const reference, the list is no longer shared, so a write via that reference cannot
+    // change a copy.
+    // A const reference returned by value() or operator[] remains valid until the result is
+    // modified or destroyed. (Modifying a result whose list is shared gives the result a list
+    // of its own, and the old list goes away with the last copy that shares it.)
+    struct Attribute
+    {
+        std::string const* key;                       // Interned, or points at own_key
+        std::shared_ptr<std::string const> own_key;   // Set only if the key could not be interned
+        Variant value;
+    };
+    struct Attributes
+    {
+        std::deque<Attribute> list;                   // Deque, so references returned by operator[] remain valid
+        std::vector<uint32_t> index;                  // Positions in list, in key order
+        bool shareable = true;
+    };
+
+    Attribute const* find_attr(std::string const& key) const;
+    Variant& attr_value(std::string const& key);      // Adds the attribute if it does not exist yet
+    Attributes& writable_attrs();
+    std::string string_attr(std::string const* interned_key) const noexcept;
+
     void deserialize(VariantMap const& var);
     void throw_on_non_string(std::string const& name, Variant::Type vtype) const;
     void throw_on_empty(std::string const& name) const;
 
-    VariantMap attrs_;
-    std::shared_ptr<VariantMap> stored_result_;
+    std::shared_ptr<Attributes> attrs_;
+    std::shared_ptr<VariantMap const> stored_result_;  // Never modified, so it is shared by copies
     std::string origin_;
     int flags_;
     RuntimeImpl const* runtime_;
@@ -20,8 +20,12 @@
 
 #include <unity/scopes/internal/ReplyObject.h>
 #include <unity/scopes/internal/CategoryRegistry.h>
+#include <unity/scopes/internal/PreviewPrefetcher.h>
 #include <unity/scopes/SearchListenerBase.h>
 
+#include <map>
+#include <mutex>
+
 namespace unity
 {
 
@@ -42,11 +46,26 @@ public:
 
     virtual bool process_data(VariantMap const& data) override;
 
+    // Remote operation implementation
+    void finished(CompletionDetails const& details) noexcept override;
+
+    // Must be called before the reply object is added to the middleware.
+    void set_prefetcher(PreviewPrefetcher::SPtr const& prefetcher);
+
+    // Called before the search is sent, with the renderer templates whose hashes the search
+    // tells the scope about. We keep them until we are destroyed, so a category that refers
+    // to one of them by hash can be resolved even if the template was evicted from the cache.
+    void set_known_renderers(std::map<std::string, std::shared_ptr<std::string const>> const& templates);
+
 private:
     SearchListenerBase::SPtr const receiver_;
     std::shared_ptr<CategoryRegistry> cat_registry_;
     std::atomic_int cardinality_;
     std::atomic_int num_pushes_;
+    PreviewPrefetcher::SPtr prefetcher_;
+    std::atomic_bool finished_called_;
+    std::map<std::string, std::shared_ptr<std::string const>> known_renderers_;
+    std::mutex known_renderers_mutex_;
 };
 
 } // namespace internal
@@ -44,6 +44,8 @@ public:
     std::string default_middleware_configfile() const;
     int reap_expiry() const;
     int reap_interval() const;
+    int preview_prefetch() const;
+    int preview_cache_size() const;
     std::string cache_directory() const;
     std::string app_directory() const;
     std::string config_directory() const;
@@ -62,6 +64,8 @@ private:
     std::string default_middleware_configfile_;
     int reap_expiry_;
     int reap_interval_;
+    int preview_prefetch_;
+    int preview_cache_size_;
     std::string cache_directory_;
     std::string app_directory_;
     std::string config_directory_;
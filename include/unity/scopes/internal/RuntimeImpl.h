@@ -21,7 +21,9 @@
 #include <unity/scopes/internal/Logger.h>
 #include <unity/scopes/internal/MiddlewareBase.h>
 #include <unity/scopes/internal/MiddlewareFactory.h>
+#include <unity/scopes/internal/PreviewCache.h>
 #include <unity/scopes/internal/Reaper.h>
+#include <unity/scopes/internal/ScopeLoader.h>
 #include <unity/scopes/internal/ThreadPool.h>
 #include <unity/scopes/Runtime.h>
 
@@ -34,6 +36,8 @@ namespace scopes
 namespace internal
 {
 
+class CancellationStats;
+
 class RuntimeImpl final
 {
 public:
@@ -53,11 +57,22 @@ public:
     Reaper::SPtr reply_reaper() const;
     ThreadPool::SPtr async_pool() const;
     ThreadSafeQueue<std::future<void>>::SPtr future_queue() const;
+    PreviewCache::SPtr preview_cache() const;  // nullptr unless Preview.Prefetch is set
+    int preview_prefetch() const;
     unity::scopes::internal::Logger& logger() const;
     void run_scope(ScopeBase* scope_base,
                    std::string const& scope_ini_file,
                    std::promise<void> ready_promise = std::promise<void>());
 
+    // Runs several scopes in this process. Each scope is loaded with load_scope when the first
+    // request for it arrives, and stopped again when it has been idle for its idle timeout.
+    // Returns once all scopes are idle, or the run time is destroyed.
+    typedef std::function<ScopeLoader::SPtr(std::string const& scope_id,
+                                            std::string const& scope_ini_file)> ScopeLoadFunction;
+    void run_hosted_scopes(std::vector<std::string> const& scope_ini_files,
+                           ScopeLoadFunction const& load_scope,
+                           std::promise<void> ready_promise = std::promise<void>());
+
     ObjectProxy string_to_proxy(std::string const& s) const;
     std::string proxy_to_string(ObjectProxy const& proxy) const;
 
@@ -73,15 +88,20 @@ private:
     std::string demangled_id(std::string const& scope_id) const;
     bool confined() const;
     std::string confinement_type() const;
-    std::string find_cache_dir() const;
-    std::string find_app_dir() const;
+    void configure_scope(ScopeBase* scope_base, std::string const& scope_id, std::string const& scope_ini_file);
+    void log_cancellation_stats(std::string const& scope_id, CancellationStats const& stats);
+    MiddlewareBase::SPtr scope_middleware();
+    std::string find_cache_dir(std::string const& id) const;
+    std::string find_app_dir(std::string const& id) const;
     std::string find_log_dir(std::string const& id) const;
-    std::string find_tmp_dir() const;
+    std::string find_tmp_dir(std::string const& id) const;
 
     bool destroyed_;
     std::string scope_id_;
     MiddlewareFactory::UPtr middleware_factory_;
     MiddlewareBase::SPtr middleware_;
+    std::string default_middleware_;
+    std::string default_middleware_configfile_;
     RegistryProxy registry_;
     std::string runtime_configfile_;
     std::string registry_configfile_;
@@ -99,6 +119,8 @@ private:
     mutable ThreadPool::SPtr async_pool_;  // Pool of invocation threads for async query creation
     mutable ThreadSafeQueue<std::future<void>>::SPtr future_queue_;
     mutable std::thread waiter_thread_;
+    int preview_prefetch_;
+    PreviewCache::SPtr preview_cache_;
     mutable std::mutex mutex_;  // For lazy initialization of reply_reaper_, async_pool_, and queue_
 };
 
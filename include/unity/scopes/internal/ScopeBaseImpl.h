@@ -22,6 +22,8 @@
 #include <unity/scopes/RegistryProxyFwd.h>
 #include <unity/scopes/Variant.h>
 
+#include <core/signal.h>
+
 #include <mutex>
 #include <string>
 
@@ -69,6 +71,8 @@ public:
     bool set_child_scopes(ChildScopeList const& child_scopes);
 
 private:
+    void invalidate_child_scopes_cache() const;
+
     std::string scope_directory_;
     bool scope_dir_initialized_;
 
@@ -91,6 +95,14 @@ private:
     bool child_scopes_repo_initialized_;
 
     mutable std::mutex mutex_;
+
+    // Cache for the default implementation of find_child_scopes(). The cache is
+    // invalidated when the registry publishes a list update.
+    mutable std::mutex child_scopes_mutex_;
+    mutable std::shared_ptr<ChildScopeList const> child_scopes_cache_;
+    mutable int child_scopes_generation_;
+    mutable bool list_update_subscribed_;
+    mutable std::unique_ptr<core::ScopedConnection> list_update_connection_;
 };
 
 } // namespace internal
@@ -21,6 +21,8 @@
 #include <unity/scopes/ActivationListenerBase.h>
 #include <unity/scopes/internal/MWScopeProxyFwd.h>
 #include <unity/scopes/internal/ObjectImpl.h>
+#include <unity/scopes/internal/PreviewCache.h>
+#include <unity/scopes/internal/ReplyObject.h>
 #include <unity/scopes/internal/SearchQueryBaseImpl.h>
 #include <unity/scopes/PreviewListenerBase.h>
 #include <unity/scopes/QueryCtrlProxyFwd.h>
@@ -79,12 +81,15 @@ public:
                           std::unique_ptr<Variant> user_data,
                           SearchMetadata const& metadata,
                           SearchQueryBaseImpl::History const& history,
-                          SearchListenerBase::SPtr const& reply);       // Not remote, hence not override
+                          SearchListenerBase::SPtr const& reply,
+                          std::string const& client_id = "");          // Not remote, hence not override
 
+    // client_id is the ID of the scope that sends the query. If empty, the scope ID of the run time is used.
     QueryCtrlProxy search(CannedQuery const& query,
                           SearchMetadata const& metadata,
                           SearchQueryBaseImpl::History const& history,
-                          SearchListenerBase::SPtr const& reply);       // Not remote, hence not override
+                          SearchListenerBase::SPtr const& reply,
+                          std::string const& client_id = "");          // Not remote, hence not override
 
     virtual QueryCtrlProxy activate(Result const& result,
                                     ActionMetadata const& metadata,
@@ -100,6 +105,10 @@ public:
                                    ActionMetadata const& hints,
                                    PreviewListenerBase::SPtr const& reply) override;
 
+    QueryCtrlProxy send_preview(Result const& result,
+                                ActionMetadata const& hints,
+                                ReplyObject::SPtr const& ro);             // Not remote, hence not override
+
     virtual QueryCtrlProxy activate_result_action(Result const& result,
                                                   ActionMetadata const& metadata,
                                                   std::string const& action_id,
@@ -112,6 +121,7 @@ public:
 
 private:
     MWScopeProxy fwd();
+    QueryCtrlProxy replay_preview(PreviewCache::Entry::SCPtr const& entry, ReplyObject::SPtr const& ro);
 
     RuntimeImpl* const runtime_;
     std::string scope_id_;
@@ -18,8 +18,10 @@
 
 #pragma once
 
+#include <unity/scopes/internal/CancellationToken.h>
 #include <unity/scopes/internal/ScopeObjectBase.h>
 #include <unity/scopes/internal/QueryObjectBase.h>
+#include <unity/scopes/internal/SurfacingCache.h>
 #include <unity/scopes/QueryBase.h>
 
 #include <functional>
@@ -50,7 +52,11 @@ class ScopeObject final : public ScopeObjectBase
 public:
     UNITY_DEFINES_PTRS(ScopeObject);
 
-    ScopeObject(ScopeBase* scope_base, bool debug_mode = false);
+    // scope_id is needed only if the scope shares its process (and run time) with other scopes.
+    ScopeObject(ScopeBase* scope_base,
+                bool debug_mode = false,
+                SurfacingCache::SPtr const& surfacing_cache = nullptr,
+                std::string const& scope_id = "");
     virtual ~ScopeObject();
 
     // Remote operation implementations
@@ -88,13 +94,24 @@ public:
                                                     MWReplyProxy const &reply,
                                                     InvokeInfo const& info) override;
 
+    // Returns the number of queries created by this scope that have not been destroyed yet.
+    long active_queries() const noexcept;
+
+    // Counts cancelled queries, and results that were discarded because their query was cancelled.
+    CancellationStats::SPtr cancellation_stats() const noexcept;
+
 private:
     MWQueryCtrlProxy query(MWReplyProxy const& reply, MiddlewareBase* mw_base,
         std::string const& method,
         std::function<QueryBase::SPtr(void)> const& query_factory_fun,
         std::function<QueryObjectBase::SPtr(QueryBase::SPtr, MWQueryCtrlProxy)> const& query_object_factory_fun);
+    std::string scope_id(MiddlewareBase* mw_base) const;
     ScopeBase* const scope_base_;
     bool const debug_mode_;
+    SurfacingCache::SPtr const surfacing_cache_;
+    std::shared_ptr<int> const query_token_;  // Each query holds a reference until it is destroyed.
+    CancellationStats::SPtr const cancellation_stats_;
+    std::string const scope_id_;
 };
 
 } // namespace internal
@@ -36,6 +36,8 @@ namespace scopes
 namespace internal
 {
 
+class RuntimeImpl;
+
 class SearchQueryBaseImpl : public QueryBaseImpl
 {
 public:
@@ -53,6 +55,9 @@ public:
 
     void set_history(History const& h);
 
+    void set_known_renderers(std::set<std::string> const& hashes);
+    std::set<std::string> known_renderers() const;
+
     QueryCtrlProxy subsearch(ScopeProxy const& scope,
                              std::set<std::string> const& keywords,
                              std::string const& query_string,
@@ -76,7 +81,9 @@ private:
     std::string department_id_;
     std::string client_id_;
     History history_;
+    std::set<std::string> known_renderers_;
     std::vector<QueryCtrlProxy> subqueries_;
+    RuntimeImpl* runtime_;  // Run time of the subsearch scopes, for cancelling them in parallel
 
     QueryCtrlProxy check_for_query_loop(ScopeProxy const& scope,
                                         SearchListenerBase::SPtr const& reply,
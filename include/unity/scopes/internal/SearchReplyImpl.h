@@ -26,8 +26,11 @@
 #include <unity/scopes/internal/MWReplyProxyFwd.h>
 #include <unity/scopes/internal/ObjectImpl.h>
 #include <unity/scopes/internal/ReplyImpl.h>
+#include <unity/scopes/internal/SurfacingCache.h>
 #include <unity/scopes/SearchReply.h>
 
+#include <set>
+
 namespace unity
 {
 
@@ -54,7 +57,8 @@ public:
                     std::shared_ptr<QueryObjectBase>const & qo,
                     int cardinality,
                     std::string const& query_string,
-                    std::string const& current_department_id);
+                    std::string const& current_department_id,
+                    std::set<std::string> const& known_renderers = std::set<std::string>());
     virtual ~SearchReplyImpl();
 
     virtual void register_departments(Department::SCPtr const& parent) override;
@@ -82,9 +86,22 @@ public:
 
     virtual bool push(unity::scopes::Filters const& filters) override;
 
+    // When the query finishes normally, its results are stored in the cache under the given key.
+    void set_surfacing_cache(SurfacingCache::SPtr const& cache, std::string const& key);
+
+    // Pushes the results of a cache entry and finishes the query.
+    void push_surfacing_results(SurfacingCache::Entry const& entry) noexcept;
+
+    // Sets the directory for the cached surfacing results, if it differs from the cache directory
+    // of the run time (which is the case for scopes that share a process). Must be called before
+    // the reply is passed to the scope.
+    void set_cache_directory(std::string const& dir);
+
 private:
     bool push(Category::SCPtr category);
     void write_cached_results() noexcept;
+    void store_surfacing_results() noexcept;
+    std::string cache_directory() const;
 
     std::shared_ptr<CategoryRegistry> cat_registry_;
 
@@ -93,10 +110,14 @@ private:
     std::atomic_bool finished_;
     std::string query_string_;
     std::string current_department_;
+    std::set<std::string> const known_renderers_;   // Hashes of renderer templates the client already has.
 
     Department::SCPtr cached_departments_;
     unity::scopes::Filters cached_filters_;
     std::vector<unity::scopes::CategorisedResult> cached_results_;
+    SurfacingCache::SPtr surfacing_cache_;
+    std::string surfacing_cache_key_;
+    std::string cache_directory_;
     std::mutex mutex_;
 };
 
@@ -24,6 +24,13 @@
 #include <unity/util/NonCopyable.h>
 #include <unity/util/ResourcePtr.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <sys/types.h>
 #include <time.h>
 
 namespace unity
@@ -50,19 +57,46 @@ public:
     static UPtr create_from_json_string(std::string const& db_path, std::string const& json_string);
     static UPtr create_from_schema(std::string const& db_path, unity::scopes::internal::SettingsSchema const& schema);
 
-    ~SettingsDB() = default;
+    ~SettingsDB();
 
-    SettingsDB(SettingsDB&&) = default;
-    SettingsDB& operator=(SettingsDB&&) = default;
+    // Returns the current settings. While the DB is watched with inotify, this
+    // is a snapshot that is updated in the background whenever the DB changes.
+    // Otherwise, the DB is checked on each call.
+    VariantMap settings();
 
-    VariantMap settings();  // Returns the current settings (checking the DB each time).
+    // Waits until the settings reflect the DB as it is on disk now. Returns false if
+    // that takes longer than timeout. For the tests; the run time never needs to wait.
+    bool wait_for_refresh(std::chrono::milliseconds timeout);
 
 private:
+    // Identifies a version of the DB file, so we can tell whether a snapshot is current.
+    struct FileState
+    {
+        bool exists;
+        ::timespec ctime;
+        ::ino_t inode;
+
+        bool operator==(FileState const& other) const;
+    };
+
+    // Values and error from the most recent read of the DB. Immutable once published.
+    struct Snapshot
+    {
+        VariantMap values;
+        std::exception_ptr error;
+        FileState file_state;                        // State of the DB before it was read
+    };
+
     SettingsDB(std::string const& db_path, unity::scopes::internal::SettingsSchema const& schema);
 
     void process_doc_(std::string const& id, unity::util::IniParser const& parer);
     void process_all_docs();
     void set_defaults();
+    void refresh();
+    FileState file_state() const;
+    void start_watch();
+    void stop_watch();
+    void watch_thread();
 
     std::string db_path_;
     decltype(::timespec::tv_nsec) last_write_time_nsec_;
@@ -71,6 +105,17 @@ private:
     VariantArray definitions_;                       // Returned by SettingsSchema
     std::map<std::string, Variant> def_map_;  // Allows fast access to the Variants in definitions_
     unity::scopes::VariantMap values_;
+
+    std::mutex mutex_;                               // Protects values_ and last_write_* during refresh()
+    std::shared_ptr<Snapshot const> snapshot_;       // Only accessed with std::atomic_load/atomic_store
+    std::mutex snapshot_mutex_;                      // For snapshot_cond_
+    std::condition_variable snapshot_cond_;          // Notified whenever snapshot_ changes
+
+    int inotify_fd_;
+    int watch_fd_;
+    std::atomic_bool watching_;
+    std::atomic_bool stopping_;
+    std::thread watcher_;
 };
 
 }  // namespace internal
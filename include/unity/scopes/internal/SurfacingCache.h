@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/Department.h>
+#include <unity/scopes/FilterBase.h>
+#include <unity/scopes/internal/CategoryRegistry.h>
+#include <unity/scopes/ScopeMetadata.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/SearchReply.h>
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+// In-memory cache for the results of surfacing queries, used by scopes that set ResultsTtlType.
+// Results that are younger than the TTL are replayed without running the query. Older results
+// are replayed as well, but the query is then run again to refresh the cache entry.
+
+class SurfacingCache final
+{
+public:
+    NONCOPYABLE(SurfacingCache);
+    UNITY_DEFINES_PTRS(SurfacingCache);
+
+    struct Entry
+    {
+        UNITY_DEFINES_PTRS(Entry);
+
+        Department::SCPtr departments;
+        std::vector<Category::SCPtr> categories;
+        Filters filters;
+        std::vector<CategorisedResult> results;
+        std::chrono::steady_clock::time_point created;
+    };
+
+    SurfacingCache(ScopeMetadata::ResultsTtlType ttl_type, int max_entries = 50);
+    SurfacingCache(std::chrono::steady_clock::duration ttl, int max_entries = 50);
+
+    static std::chrono::seconds ttl(ScopeMetadata::ResultsTtlType ttl_type);
+
+    // Returns the key for a query, or the empty string if the query cannot be cached.
+    static std::string key(CannedQuery const& query, SearchMetadata const& metadata);
+
+    // Returns nullptr on a miss. stale is set if the entry is older than the TTL.
+    Entry::SCPtr lookup(std::string const& key, bool& stale);
+    void store(std::string const& key, Entry::SPtr const& entry);
+
+    // Only one refresh runs at a time for each key. end_refresh() must be called
+    // once for every call to begin_refresh() that returned true.
+    bool begin_refresh(std::string const& key);
+    void end_refresh(std::string const& key);
+
+    int64_t hits() const;
+    int64_t stale_hits() const;
+    int64_t misses() const;
+
+private:
+    std::chrono::steady_clock::duration const ttl_;
+    size_t const max_entries_;
+
+    std::mutex mutex_;
+    std::map<std::string, Entry::SCPtr> entries_;
+    std::set<std::string> refreshing_;
+
+    std::atomic<int64_t> hits_;
+    std::atomic<int64_t> stale_hits_;
+    std::atomic<int64_t> misses_;
+};
+
+// Reply that runs a surfacing query only to refresh a stale cache entry.
+// Nothing is sent anywhere; when the query finishes, the results are stored in the cache.
+
+class SurfacingRefreshReply : public virtual unity::scopes::SearchReply
+{
+public:
+    SurfacingRefreshReply(SurfacingCache::SPtr const& cache, std::string const& key, int cardinality);
+    ~SurfacingRefreshReply();
+
+    void register_departments(Department::SCPtr const& parent) override;
+    Category::SCPtr register_category(std::string const& id,
+                                      std::string const& title,
+                                      std::string const &icon,
+                                      CategoryRenderer const& renderer_template) override;
+    Category::SCPtr register_category(std::string const& id,
+                                      std::string const& title,
+                                      std::string const &icon,
+                                      CannedQuery const &query,
+                                      CategoryRenderer const& renderer_template) override;
+    void register_category(Category::SCPtr category) override;
+    Category::SCPtr lookup_category(std::string const& id) override;
+
+    bool push(unity::scopes::experimental::Annotation const& annotation) override;
+    bool push(unity::scopes::CategorisedResult const& result) override;
+    bool push(unity::scopes::Filters const& filters, unity::scopes::FilterState const& filter_state) override;
+    bool push(unity::scopes::Filters const& filters) override;
+    void push_surfacing_results_from_cache() noexcept override;
+
+    // Reply interface
+    void finished() override;
+    void error(std::exception_ptr ex) override;
+    void info(OperationInfo const& op_info) override;
+
+    // Object interface
+    std::string endpoint() override;
+    std::string identity() override;
+    std::string target_category() override;
+    int64_t timeout() override;
+    std::string to_string() override;
+
+private:
+    void complete(bool ok);
+
+    SurfacingCache::SPtr const cache_;
+    std::string const key_;
+    int const cardinality_;
+
+    std::mutex mutex_;
+    bool finished_;
+    CategoryRegistry cat_registry_;
+    SurfacingCache::Entry::SPtr entry_;
+};
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -20,10 +20,9 @@
 
 #include <unity/util/NonCopyable.h>
 
-#include <iomanip>
-#include <mutex>
+#include <atomic>
+#include <cstdint>
 #include <random>
-#include <sstream>
 #include <string>
 
 namespace unity
@@ -36,8 +35,13 @@ namespace internal
 {
 
 // Poor man's thread-safe unique ID generator.
-// Generates a random number concatenated with a counter.
+// Generates a pseudo-random number concatenated with a counter.
 // Return value is a string of 16 hex digits.
+//
+// gen() does not lock. Each thread takes a block of counter values from the generator
+// and hands them out without touching shared state until the block is used up.
+// The random part is derived from the seed and the counter value, so generators with
+// the same seed produce the same sequence of ids (as long as they are used by a single thread).
 
 class UniqueID
 {
@@ -49,11 +53,11 @@ public:
     std::string gen();                                  // Returns a unique id
 
 private:
-    std::mt19937 engine;
-    std::uniform_int_distribution<uint32_t> uniform_dist;
-    int counter;
-    std::ostringstream s;
-    std::mutex m;
+    static constexpr uint32_t block_size = 64;
+
+    uint64_t const salt_;
+    uint64_t const instance_;                           // Distinguishes generators in the thread-local cache
+    std::atomic<uint32_t> next_block_;
 };
 
 } // namespace internal
@@ -36,6 +36,10 @@ namespace internal
 VariantMap::const_iterator find_or_throw(std::string const& context, VariantMap const& var, std::string const& key);
 std::string to_percent_encoding(std::string const& str);
 std::string from_percent_encoding(std::string const& str);
+
+// Same as above, but append to out, so callers can build a string without temporaries.
+void append_percent_encoding(char const* str, size_t len, std::string& out);
+void append_percent_decoding(char const* begin, char const* end, std::string& out);
 std::string uncamelcase(std::string const& str);
 
 template<typename T>
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/inproc_middleware/ObjectAdapter.h>
+#include <unity/scopes/internal/MiddlewareBase.h>
+#include <unity/scopes/internal/UniqueID.h>
+
+#include <condition_variable>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+// A middleware for scopes and clients that live in the same process. Proxies invoke
+// operations on their servants directly, via the thread of the servant's adapter,
+// so nothing is marshaled.
+//
+// There is no registry, and no publisher/subscriber support. Idle timeouts are ignored,
+// so a scope runs until its run time is destroyed.
+
+class InprocMiddleware final : public MiddlewareBase
+{
+public:
+    InprocMiddleware(std::string const& server_name, RuntimeImpl* runtime);
+    virtual ~InprocMiddleware();
+
+    virtual void start() override;
+    virtual void stop() override;
+    virtual void wait_for_shutdown() override;
+
+    virtual ObjectProxy string_to_proxy(std::string const& s) override;
+    virtual std::string proxy_to_string(MWProxy const& proxy) override;
+
+    virtual MWRegistryProxy registry_proxy() override;
+    virtual MWRegistryProxy ss_registry_proxy() override;
+
+    virtual MWScopeProxy create_scope_proxy(std::string const& identity) override;
+    virtual MWScopeProxy create_scope_proxy(std::string const& identity, std::string const& endpoint) override;
+    virtual MWQueryProxy create_query_proxy(std::string const& identity, std::string const& endpoint) override;
+    virtual MWQueryCtrlProxy create_query_ctrl_proxy(std::string const& identity, std::string const& endpoint) override;
+    virtual MWStateReceiverProxy create_state_receiver_proxy(std::string const& identity) override;
+    virtual MWStateReceiverProxy create_registry_state_receiver_proxy(std::string const& identity) override;
+
+    virtual MWQueryCtrlProxy add_query_ctrl_object(QueryCtrlObjectBase::SPtr const& ctrl) override;
+    virtual void add_dflt_query_ctrl_object(QueryCtrlObjectBase::SPtr const& ctrl) override;
+    virtual MWQueryProxy add_query_object(QueryObjectBase::SPtr const& query) override;
+    virtual void add_dflt_query_object(QueryObjectBase::SPtr const& query) override;
+    virtual MWRegistryProxy add_registry_object(std::string const& identity, RegistryObjectBase::SPtr const& registry) override;
+    virtual MWReplyProxy add_reply_object(ReplyObjectBase::SPtr const& reply) override;
+    virtual MWScopeProxy add_scope_object(std::string const& identity, ScopeObjectBase::SPtr const& scope,
+                                          int64_t idle_timeout, std::function<void()> const& idle_callback) override;
+    virtual void add_dflt_scope_object(ScopeObjectBase::SPtr const& scope) override;
+    virtual MWStateReceiverProxy add_state_receiver_object(std::string const& identity, StateReceiverObject::SPtr const& state_receiver) override;
+
+    virtual MWPublisher::UPtr create_publisher(std::string const& publisher_id) override;
+    virtual MWSubscriber::UPtr create_subscriber(std::string const& publisher_id, std::string const& topic) override;
+
+    virtual std::string get_scope_endpoint() override;
+    virtual std::string get_query_endpoint() override;
+    virtual std::string get_query_ctrl_endpoint() override;
+
+private:
+    ObjectAdapter::SPtr find_adapter(std::string const& name);
+
+    std::string safe_add(std::function<void()>& disconnect_func,
+                         ObjectAdapter::SPtr const& adapter,
+                         std::string const& identity,
+                         AbstractObject::SPtr const& servant);
+
+    std::function<void()> safe_dflt_add(ObjectAdapter::SPtr const& adapter,
+                                        std::string const& category,
+                                        AbstractObject::SPtr const& servant);
+
+    std::string const server_name_;
+    std::string registry_identity_;
+
+    typedef std::map<std::string, ObjectAdapter::SPtr> AdapterMap;
+    AdapterMap am_;
+    mutable std::mutex data_mutex_;             // Protects am_
+
+    UniqueID unique_id_;
+
+    enum State { Created, Started, Stopping, Stopped };
+    State state_;
+    std::condition_variable state_changed_;
+    mutable std::mutex state_mutex_;            // Protects state_
+    bool shutdown_flag_;
+
+    int64_t const twoway_timeout_;              // Timeout for twoway invocations
+};
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/inproc_middleware/InprocMiddleware.h>
+#include <unity/scopes/internal/inproc_middleware/ObjectAdapter.h>
+#include <unity/scopes/internal/InvokeInfo.h>
+#include <unity/scopes/internal/MWObjectProxy.h>
+
+#include <chrono>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+// An in-process proxy that points at some servant, but without a specific type.
+// Invocations look up the target adapter and servant by endpoint and identity and run
+// the operation on the adapter's thread. Arguments are passed to the servant as
+// they are, without marshaling.
+
+class InprocObjectProxy : public virtual MWObjectProxy
+{
+public:
+    InprocObjectProxy(InprocMiddleware* mw_base,
+                      std::string const& endpoint,
+                      std::string const& identity,
+                      std::string const& category,
+                      int64_t timeout = -1);
+    virtual ~InprocObjectProxy();
+
+    virtual InprocMiddleware* mw_base() const noexcept override;
+
+    virtual std::string endpoint() const override;
+    virtual std::string identity() const override;
+    virtual std::string target_category() const override;
+    virtual int64_t timeout() const noexcept override;
+
+    virtual std::string to_string() const override;
+
+    // Remote operation
+    virtual void ping() override;
+
+protected:
+    // Runs f(servant, info) on the target adapter's thread and returns its result.
+    // Throws ObjectNotExistException if there is no such servant, TimeoutException if f does not complete
+    // within timeout() milliseconds, and MiddlewareException if f throws.
+    // f may still run after this function has timed out, so it must not refer to the caller's stack.
+    // f is moved (not copied) into the adapter's queue, so arguments that are bound into f by value
+    // reach the servant without further copies.
+    template<typename T, typename F>
+    typename std::result_of<F(std::shared_ptr<T> const&, InvokeInfo const&)>::type
+    invoke_twoway_(std::string const& op_name, F f);
+
+    // Queues f(servant, info) on the target adapter's thread and returns immediately.
+    // If there is no such servant, the request is discarded, as for any oneway request
+    // that does not reach its target.
+    template<typename T, typename F>
+    void invoke_oneway_(F f);
+
+private:
+    template<typename T>
+    std::shared_ptr<T> find_servant_(ObjectAdapter::SPtr& adapter) const;
+
+    // The task that runs on the adapter's thread. (We use a struct instead of a lambda
+    // so we can move f into the task.)
+    template<typename T, typename F>
+    struct Invocation
+    {
+        InprocMiddleware* mw;
+        std::shared_ptr<T> servant;
+        std::string id;
+        F f;
+
+        typename std::result_of<F(std::shared_ptr<T> const&, InvokeInfo const&)>::type operator()()
+        {
+            InvokeInfo info{ id, mw };
+            return f(servant, info);
+        }
+    };
+
+    std::string const endpoint_;
+    std::string const identity_;
+    std::string const category_;
+    int64_t const timeout_;
+};
+
+template<typename T>
+std::shared_ptr<T> InprocObjectProxy::find_servant_(ObjectAdapter::SPtr& adapter) const
+{
+    adapter = ObjectAdapter::find(endpoint_);
+    return adapter ? std::dynamic_pointer_cast<T>(adapter->find_servant(identity_, category_)) : nullptr;
+}
+
+template<typename T, typename F>
+typename std::result_of<F(std::shared_ptr<T> const&, InvokeInfo const&)>::type
+InprocObjectProxy::invoke_twoway_(std::string const& op_name, F f)
+{
+    ObjectAdapter::SPtr adapter;
+    auto servant = find_servant_<T>(adapter);
+    if (!servant)
+    {
+        throw ObjectNotExistException("Object does not exist (endpoint = " + endpoint_ + ", op = " + op_name + ")",
+                                      identity_);
+    }
+
+    auto future = adapter->submit(Invocation<T, F>{ adapter->mw(), servant, identity_, std::move(f) });
+
+    if (timeout_ != -1 && future.wait_for(std::chrono::milliseconds(timeout_)) != std::future_status::ready)
+    {
+        throw TimeoutException("Request timed out after " + std::to_string(timeout_) + " milliseconds (endpoint = "
+                               + endpoint_ + ", op = " + op_name + ")");
+    }
+    try
+    {
+        return future.get();
+    }
+    catch (std::exception const& e)
+    {
+        throw MiddlewareException(e.what());
+    }
+    catch (...)
+    {
+        throw MiddlewareException("unknown exception");
+    }
+}
+
+template<typename T, typename F>
+void InprocObjectProxy::invoke_oneway_(F f)
+{
+    ObjectAdapter::SPtr adapter;
+    auto servant = find_servant_<T>(adapter);
+    if (!servant)
+    {
+        return;
+    }
+
+    try
+    {
+        adapter->submit(Invocation<T, F>{ adapter->mw(), servant, identity_, std::move(f) });
+    }
+    catch (MiddlewareException const&)
+    {
+        // The adapter was shut down after we found it.
+    }
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/inproc_middleware/InprocObjectProxy.h>
+#include <unity/scopes/internal/MWReply.h>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+class InprocReply : public virtual InprocObjectProxy, public virtual MWReply
+{
+public:
+    UNITY_DEFINES_PTRS(InprocReply);
+
+    InprocReply(InprocMiddleware* mw_base,
+                std::string const& endpoint,
+                std::string const& identity,
+                std::string const& category);
+    virtual ~InprocReply();
+
+    virtual void push(VariantMap const& result) override;
+    virtual void finished(CompletionDetails const& details) override;
+    virtual void info(OperationInfo const& op_info) override;
+
+    // Returns a proxy for the same reply object that is bound to mw. A servant that receives
+    // a reply proxy from another middleware must rebind it before using it, so the servant's
+    // replies are accounted to its own run time. Returns nullptr if reply is nullptr.
+    static MWReplyProxy rebind(MWReplyProxy const& reply, MiddlewareBase* mw);
+};
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/inproc_middleware/InprocObjectProxy.h>
+#include <unity/scopes/internal/MWScope.h>
+
+#include <mutex>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+// The arguments of each operation are converted to the types that the servant expects
+// on the caller's thread, and then moved to the scope's thread.
+
+class InprocScope : public virtual InprocObjectProxy, public virtual MWScope
+{
+public:
+    UNITY_DEFINES_PTRS(InprocScope);
+
+    InprocScope(InprocMiddleware* mw_base,
+                std::string const& endpoint,
+                std::string const& identity,
+                std::string const& category,
+                int64_t timeout);
+    virtual ~InprocScope();
+
+    virtual QueryCtrlProxy search(CannedQuery const& query,
+                                  VariantMap const& hints,
+                                  VariantMap const& context,
+                                  MWReplyProxy const& reply) override;
+
+    virtual QueryCtrlProxy activate(VariantMap const& result,
+                                    VariantMap const& hints,
+                                    MWReplyProxy const& reply) override;
+
+    virtual QueryCtrlProxy perform_action(VariantMap const& result,
+                                          VariantMap const& hints,
+                                          std::string const& widget_id,
+                                          std::string const& action_id,
+                                          MWReplyProxy const& reply) override;
+
+    virtual QueryCtrlProxy preview(VariantMap const& result,
+                                   VariantMap const& hints,
+                                   MWReplyProxy const& reply) override;
+
+    virtual ChildScopeList child_scopes() override;
+    virtual bool set_child_scopes(ChildScopeList const& child_scopes) override;
+
+    virtual bool debug_mode() override;
+
+    virtual QueryCtrlProxy activate_result_action(VariantMap const& result,
+                                                  VariantMap const& hints,
+                                                  std::string const& action_id,
+                                                  MWReplyProxy const& reply) override;
+
+private:
+    QueryCtrlProxy make_query_ctrl_(MWQueryCtrlProxy const& ctrl, MWReplyProxy const& reply);
+
+    std::mutex debug_mode_mutex_;
+    std::unique_ptr<bool> debug_mode_;
+};
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
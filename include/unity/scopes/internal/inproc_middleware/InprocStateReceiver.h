@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/inproc_middleware/InprocObjectProxy.h>
+#include <unity/scopes/internal/MWStateReceiver.h>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+class InprocStateReceiver : public virtual InprocObjectProxy, public virtual MWStateReceiver
+{
+public:
+    UNITY_DEFINES_PTRS(InprocStateReceiver);
+
+    InprocStateReceiver(InprocMiddleware* mw_base,
+                        std::string const& endpoint,
+                        std::string const& identity,
+                        std::string const& category);
+    virtual ~InprocStateReceiver();
+
+    virtual void push_state(std::string const& sender_id, StateReceiverObject::State const& state) override;
+};
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
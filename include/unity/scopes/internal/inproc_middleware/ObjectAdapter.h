@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/AbstractObject.h>
+#include <unity/scopes/internal/ThreadPool.h>
+#include <unity/scopes/ScopeExceptions.h>
+
+#include <map>
+#include <mutex>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+class InprocMiddleware;
+
+// An adapter holds a number of servants and a single thread on which all requests for these
+// servants run, in the order in which they were submitted. Requests are plain function calls
+// on the servant, so nothing is marshaled.
+// Once activated, an adapter can be found via its endpoint from anywhere in the process,
+// so proxies created by one middleware can reach servants of another middleware.
+
+class ObjectAdapter final : public std::enable_shared_from_this<ObjectAdapter>
+{
+public:
+    NONCOPYABLE(ObjectAdapter);
+    UNITY_DEFINES_PTRS(ObjectAdapter);
+
+    static char const* const scheme;  // Prefix of all endpoints
+
+    ObjectAdapter(InprocMiddleware& mw, std::string const& name);
+    ~ObjectAdapter();
+
+    InprocMiddleware* mw() const noexcept;
+    std::string name() const;
+    std::string endpoint() const;
+
+    void activate();
+    void shutdown() noexcept;           // Stops accepting requests and makes the endpoint unreachable.
+    void wait_for_shutdown() noexcept;  // Waits until the requests submitted before shutdown() have completed.
+
+    void add(std::string const& id, AbstractObject::SPtr const& obj);
+    void remove(std::string const& id);
+    void add_dflt_servant(std::string const& category, AbstractObject::SPtr const& obj);
+    void remove_dflt_servant(std::string const& category);
+
+    // Returns the servant with the given identity or, if there is none, the default servant
+    // for the category. Returns nullptr if neither exists.
+    AbstractObject::SPtr find_servant(std::string const& id, std::string const& category) const;
+
+    // Queues f for the adapter's thread. Throws MiddlewareException if the adapter is not active.
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submit(F f);
+
+    // Returns the active adapter with the given endpoint, or nullptr if there is none.
+    static SPtr find(std::string const& endpoint);
+
+private:
+    InprocMiddleware& mw_;
+    std::string const name_;
+    std::string const endpoint_;
+    ThreadPool pool_;
+
+    enum AdapterState { Inactive, Active, Destroyed };
+    AdapterState state_;
+    std::map<std::string, AbstractObject::SPtr> servants_;
+    std::map<std::string, AbstractObject::SPtr> dflt_servants_;
+    mutable std::mutex mutex_;
+};
+
+template<typename F>
+std::future<typename std::result_of<F()>::type> ObjectAdapter::submit(F f)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ != Active)
+    {
+        throw MiddlewareException("Object adapter " + name_ + " is not active");
+    }
+    return pool_.submit(std::move(f));
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -26,6 +26,9 @@
 
 #include <zmqpp/socket.hpp>
 
+#include <array>
+#include <atomic>
+#include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -60,7 +63,8 @@ public:
                   std::string const& endpoint,
                   RequestMode m,
                   int pool_size,
-                  int64_t idle_timeout = -1);
+                  int64_t idle_timeout = -1,
+                  std::function<void()> const& idle_callback = nullptr);
     ~ObjectAdapter();
 
     ZmqMiddleware* mw() const;
@@ -79,6 +83,10 @@ public:
     void shutdown();
     void wait_for_shutdown();
 
+    // Dispatches a oneway request that did not arrive via the adapter's endpoint
+    // (see ShmListener). The request is dropped unless the adapter is active.
+    void dispatch_oneway(capnp::MessageReader& message);
+
 private:
     // An adapter transitions through these states in order:
     //
@@ -93,6 +101,7 @@ private:
     // a fatal error condition.
     enum AdapterState { Inactive, Activating, Active, Deactivating, Destroyed, Failed };
     void throw_bad_state(std::string const& label, AdapterState state) const;
+    void throw_if_destroyed(char const* label) const;
 
     void run_workers();
 
@@ -120,21 +129,32 @@ private:
     RequestMode mode_;
     int pool_size_;
     int64_t idle_timeout_;
+    std::function<void()> idle_callback_;       // Called on idle timeout; if not set, the middleware is stopped
     std::unique_ptr<StopPublisher> stopper_;    // Used to signal threads when it's time to terminate
     std::thread pump_;                          // Load-balancing pump: router-router or pull-router
     std::vector<std::thread> workers_;          // Threads for incoming invocations
     std::exception_ptr exception_;              // Failed threads deposit their exception here
     std::once_flag once_;
 
-    AdapterState state_;
+    std::atomic<AdapterState> state_;          // Changed only while holding state_mutex_, but can be read without it
     std::condition_variable state_changed_;
     mutable std::mutex state_mutex_;
 
-    // Map of object identity and servant pairs
+    // Maps of object identity and servant pairs. Every query adds and removes several servants,
+    // so the servants are spread over a number of maps with separate locks to keep worker
+    // threads from contending with each other.
     typedef std::unordered_map<std::string, std::shared_ptr<ServantBase>> ServantMap;
-    ServantMap servants_;
+    struct ServantShard
+    {
+        std::mutex mutex;
+        ServantMap servants;
+    };
+    static constexpr size_t num_shards = 16;
+    ServantShard& shard(std::string const& id) const;
+    mutable std::array<ServantShard, num_shards> shards_;
+
     ServantMap dflt_servants_;
-    mutable std::mutex map_mutex_;
+    mutable std::mutex dflt_mutex_;
 
     // Dummy logger for testing
     std::unique_ptr<unity::scopes::internal::Logger> test_logger_;
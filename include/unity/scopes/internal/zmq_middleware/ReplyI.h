@@ -20,8 +20,11 @@
 
 #include <unity/scopes/internal/MWReply.h>
 #include <unity/scopes/internal/ReplyObjectBase.h>
+#include <unity/scopes/internal/zmq_middleware/ResultCodec.h>
 #include <unity/scopes/internal/zmq_middleware/ServantBase.h>
 
+#include <mutex>
+
 namespace unity
 {
 
@@ -50,6 +53,9 @@ private:
     virtual void info_(Current const& current,
                        capnp::AnyPointer::Reader& in_params,
                        capnproto::Response::Builder& r);
+
+    std::mutex decoder_mutex_;
+    ResultDecoder decoder_;
 };
 
 } // namespace zmq_middleware
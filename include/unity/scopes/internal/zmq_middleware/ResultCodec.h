@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/Variant.h>
+#include <unity/util/NonCopyable.h>
+#include <scopes/internal/zmq_middleware/capnproto/Reply.capnp.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+class ResultImpl;
+
+namespace zmq_middleware
+{
+
+// Compact encoding of pushed search results (see Result in Reply.capnp).
+// Each query has one encoder on the sending side and one decoder on the receiving side.
+// The two share a key dictionary, so messages must be decoded in the order in which they
+// were encoded. Neither class is thread-safe.
+
+class ResultEncoder final
+{
+public:
+    NONCOPYABLE(ResultEncoder);
+
+    ResultEncoder();
+
+    // Returns true if push holds a single search result, that is, if encode() can deal with it.
+    static bool encodable(VariantMap const& push) noexcept;
+
+    // Encodes the result in push, adding the names of any new custom attributes to the dictionary.
+    void encode(VariantMap const& push, capnproto::Reply::Result::Builder& b);
+
+    // Same as encoding {"result": result.serialize()}, but without building that map first.
+    void encode(ResultImpl const& result, capnproto::Reply::Result::Builder& b);
+
+    // Starts a new dictionary. Must be called if an encoded message may not have been delivered.
+    void reset() noexcept;
+
+private:
+    typedef std::pair<std::string const*, Variant const*> Attr;
+
+    void encode_(std::vector<Attr> const& attrs, VariantMap const& internal, capnproto::Reply::Result::Builder& b);
+
+    std::unordered_map<std::string, uint32_t> key_ids_;
+};
+
+class ResultDecoder final
+{
+public:
+    NONCOPYABLE(ResultDecoder);
+
+    ResultDecoder();
+
+    // Returns the push that was passed to ResultEncoder::encode(). Throws MiddlewareException
+    // if r refers to dictionary entries from a message that was never received.
+    VariantMap decode(capnproto::Reply::Result::Reader const& r);
+
+private:
+    std::vector<std::string> keys_;
+};
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
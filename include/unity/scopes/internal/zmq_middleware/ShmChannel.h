@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/internal/zmq_middleware/ShmRing.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace zmq_middleware
+{
+
+// Shared-memory channels carry oneway requests between processes on the same host.
+//
+// The receiving process runs a ShmListener on a unix domain socket. For each connection, the
+// listener creates a ShmRing and passes the ring's descriptors to the peer. From then on,
+// the listener thread reads requests from the ring and hands them to the dispatch function,
+// one at a time and in the order in which they were written. The connection stays open while
+// the channel is in use, so each side notices when the other one goes away.
+//
+// The sending process uses a ShmSender, which keeps one channel per listener.
+
+// Returns the path of the listener socket that belongs to an ipc:// endpoint,
+// or the empty string if the endpoint is not an ipc:// endpoint.
+std::string shm_channel_path(std::string const& endpoint);
+
+class ShmListener final
+{
+public:
+    NONCOPYABLE(ShmListener);
+    UNITY_DEFINES_PTRS(ShmListener);
+
+    typedef std::function<void(capnp::MessageReader&)> DispatchFunction;
+
+    // Starts listening on path, replacing any stale socket. Each channel gets a ring of ring_size bytes.
+    ShmListener(std::string const& path, size_t ring_size, DispatchFunction const& dispatch);
+    ~ShmListener();
+
+    std::string path() const;
+
+    // Stops the listener thread and closes all channels. Requests that have not been dispatched are lost.
+    void stop() noexcept;
+
+private:
+    struct Channel;
+
+    void run() noexcept;
+    void accept_channels();
+    void read_channel(Channel& c);
+    void remove_channel(std::shared_ptr<Channel> const& c);
+    void close_fds() noexcept;
+
+    std::string const path_;
+    size_t const ring_size_;
+    DispatchFunction const dispatch_;
+
+    int listen_fd_;
+    int epoll_fd_;
+    int stop_fd_;
+    std::unordered_map<int, std::shared_ptr<Channel>> channels_;  // Keyed by connection and data descriptor
+    std::thread thread_;
+    std::once_flag stop_once_;
+};
+
+class ShmSender final
+{
+public:
+    NONCOPYABLE(ShmSender);
+    UNITY_DEFINES_PTRS(ShmSender);
+
+    // timeout is the number of milliseconds to wait for a receiver that does not keep up (-1 waits forever).
+    ShmSender(int64_t timeout);
+    ~ShmSender();
+
+    // Sends a request to the listener at path, connecting first if necessary.
+    // Returns false if the request must be sent some other way, which happens only once
+    // the receiver has dispatched all earlier requests. From then on, send() returns false
+    // for that path, so the requests to a particular receiver arrive in order. (The exception
+    // is a receiver that goes away, in which case earlier requests may not have been dispatched.)
+    // Throws TimeoutException if the receiver stops reading requests while the channel is full;
+    // the request is not sent, and send() returns false for that path from then on.
+    bool send(std::string const& path, kj::ArrayPtr<kj::ArrayPtr<capnp::word const> const> segments);
+
+private:
+    struct Channel;
+
+    std::unique_ptr<Channel> connect(std::string const& path) noexcept;
+
+    int64_t const timeout_;
+    std::map<std::string, std::unique_ptr<Channel>> channels_;  // nullptr if the channel is unusable
+    std::mutex mutex_;
+};
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <capnp/message.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace zmq_middleware
+{
+
+// A single-producer, single-consumer queue of capnp messages in a memfd shared memory segment.
+// The consumer creates the ring and passes its file descriptors to the producer, which maps
+// the same segment. Messages are copied into the ring in flat array format, so the consumer
+// can read them in place.
+//
+// Each side sleeps on an eventfd: the consumer waits for messages, the producer for space.
+// An eventfd is signalled only if the other side has said that it is about to sleep, so
+// a ring that is kept busy costs no system calls.
+//
+// The two processes do not trust each other: everything read from the segment is checked,
+// and a ring with inconsistent contents is closed.
+
+class ShmRing final
+{
+public:
+    NONCOPYABLE(ShmRing);
+    UNITY_DEFINES_PTRS(ShmRing);
+
+    // Creates a ring that holds capacity bytes (rounded up to a whole number of pages).
+    static UPtr create(size_t capacity);
+
+    // Maps a ring that was created by another process. The ring takes ownership of the descriptors.
+    static UPtr attach(int mem_fd, int data_fd, int space_fd);
+
+    ~ShmRing();
+
+    int mem_fd() const noexcept;
+    int data_fd() const noexcept;   // Readable when the consumer has messages to read
+    int space_fd() const noexcept;  // Readable when the producer may have room to write
+
+    size_t capacity() const noexcept;
+
+    // Number of bytes a message occupies in the ring. Messages larger than
+    // max_message_size() cannot be written.
+    static size_t message_size(kj::ArrayPtr<kj::ArrayPtr<capnp::word const> const> segments) noexcept;
+    size_t max_message_size() const noexcept;
+
+    // Producer side. Copies the message into the ring, waiting up to timeout milliseconds
+    // for the consumer to make room if necessary (-1 waits forever). While waiting, a hangup on peer_fd
+    // (if not -1) is treated like a closed ring. Returns false if the message was not written.
+    bool write(kj::ArrayPtr<kj::ArrayPtr<capnp::word const> const> segments, int timeout, int peer_fd = -1);
+
+    // Waits until the consumer has read everything in the ring. Returns false on timeout,
+    // or if the ring is closed before it drains.
+    bool wait_until_empty(int timeout, int peer_fd = -1);
+
+    // Consumer side. Calls f (which must not throw) for each message in the ring.
+    // The space taken by a message is released once f returns, so f can read the message
+    // in place. Returns the number of messages read. Before read() returns, it tells
+    // the producer to signal data_fd() when the next message arrives.
+    size_t read(std::function<void(kj::ArrayPtr<capnp::word const>)> const& f);
+
+    // Either side can close the ring; the other side is woken up and sees closed() == true.
+    void close() noexcept;
+    bool closed() const noexcept;
+
+private:
+    struct Header;
+
+    ShmRing(int mem_fd, int data_fd, int space_fd);
+
+    bool wait_for_space(size_t needed, int timeout, int peer_fd);
+    void wake_producer() noexcept;
+
+    int mem_fd_;
+    int data_fd_;
+    int space_fd_;
+    void* map_;
+    size_t map_size_;
+    Header* header_;
+    char* data_;
+    size_t capacity_;
+};
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
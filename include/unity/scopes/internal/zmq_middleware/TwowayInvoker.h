@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <capnp/message.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace zmqpp
+{
+class context;
+class poller;
+class socket;
+}
+
+namespace capnp
+{
+class SegmentArrayMessageReader;
+}
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace zmq_middleware
+{
+
+class ZmqReceiver;
+
+// Holds both the receiver for the unmarshaling buffer (which allocates memory)
+// and the reader that decodes the memory from the unmarshaling buffer.
+// We use unique_ptr because capnp Builder and Reader types are not movable.
+struct TwowayOutParams
+{
+    NONCOPYABLE(TwowayOutParams);
+
+    TwowayOutParams() = default;
+    TwowayOutParams(TwowayOutParams&&) = default;
+    TwowayOutParams& operator=(TwowayOutParams&&) = default;
+
+    std::unique_ptr<ZmqReceiver> receiver;
+    std::unique_ptr<capnp::SegmentArrayMessageReader> reader;
+};
+
+// A TwowayInvoker sends twoway requests and waits for their replies on a single thread,
+// so no thread other than the caller's is tied up while a reply is outstanding.
+// That way, an aggregator can have many subsearches in flight at once, and nested
+// aggregators cannot run out of invoker threads.
+//
+// At most max_requests requests are on the wire at any one time, and at most max_per_endpoint
+// of these go to the same endpoint. Requests beyond these limits wait, in the order in which
+// they were submitted, until an earlier request completes. The time spent waiting counts
+// towards the request's timeout.
+
+class TwowayInvoker final
+{
+public:
+    NONCOPYABLE(TwowayInvoker);
+    UNITY_DEFINES_PTRS(TwowayInvoker);
+
+    TwowayInvoker(zmqpp::context& context, int max_requests, int max_per_endpoint);
+    ~TwowayInvoker();
+
+    // Sends request to endpoint and returns a future for the reply. If the reply does not arrive within
+    // timeout milliseconds (-1 waits forever), the future holds a TimeoutException instead.
+    // The caller must keep request alive until the future is ready.
+    // Throws MiddlewareException if the invoker has been stopped.
+    std::future<TwowayOutParams> invoke(std::string const& endpoint, capnp::MessageBuilder& request, int64_t timeout);
+
+    typedef std::function<void(std::future<TwowayOutParams>)> ReplyCallback;
+
+    // Like invoke(), but instead of returning the future, passes it to on_reply once it is ready.
+    // on_reply runs on the invoker thread, so it must not block (in particular, it must not
+    // wait for another twoway request). The invoker keeps request alive until on_reply was called.
+    // Throws MiddlewareException if the invoker has been stopped.
+    void invoke_async(std::string const& endpoint,
+                      std::shared_ptr<capnp::MessageBuilder> const& request,
+                      int64_t timeout,
+                      ReplyCallback on_reply);
+
+    // Stops the invoker thread. Requests that have not completed yet fail with a MiddlewareException.
+    void stop() noexcept;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request
+    {
+        std::string endpoint;
+        capnp::MessageBuilder* message;
+        int64_t timeout;
+        Clock::time_point deadline;
+        std::promise<TwowayOutParams> promise;
+        std::shared_ptr<capnp::MessageBuilder> owned_message;  // Set only by invoke_async()
+        ReplyCallback on_reply;                                // Set only by invoke_async()
+    };
+
+    struct InFlight
+    {
+        Request request;
+        std::unique_ptr<zmqpp::socket> socket;
+    };
+
+    void run() noexcept;
+    void expire_requests(zmqpp::poller& poller, Clock::time_point now);
+    void send_requests(zmqpp::poller& poller);
+    void send_request(zmqpp::poller& poller, Request& r);
+    void receive_replies(zmqpp::poller& poller);
+    long poll_timeout(Clock::time_point now) const;
+    std::list<InFlight>::iterator retire(zmqpp::poller& poller, std::list<InFlight>::iterator it);
+    void time_out(Request& r);
+    void abandon(Request& r);
+    void complete(Request& r) noexcept;
+    void submit(Request r);
+
+    zmqpp::context& context_;
+    int const max_requests_;
+    int const max_per_endpoint_;
+
+    int wake_fd_;                              // Interrupts the poll when a request is submitted or on stop()
+    std::deque<Request> submitted_;            // Requests not yet seen by the invoker thread
+    bool stopped_;
+    std::mutex mutex_;                         // Protects submitted_ and stopped_
+
+    // Used only by the invoker thread
+    std::list<Request> waiting_;               // Requests held back by the limits, in submission order
+    std::list<InFlight> in_flight_;
+    std::map<std::string, int> per_endpoint_;  // Number of requests in flight for each endpoint
+
+    std::thread thread_;
+    std::once_flag stop_once_;
+};
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -40,6 +40,9 @@ public:
     int locate_timeout() const;
     int registry_timeout() const;
     int child_scopes_timeout() const;
+    int shm_ring_size() const;
+    int twoway_max_requests() const;
+    int twoway_max_requests_per_endpoint() const;
     std::string registry_endpoint_dir() const;
     std::string ss_registry_endpoint_dir() const;
 
@@ -49,6 +52,9 @@ private:
     int locate_timeout_;
     int registry_timeout_;
     int child_scopes_timeout_;
+    int shm_ring_size_;
+    int twoway_max_requests_;
+    int twoway_max_requests_per_endpoint_;
     std::string registry_endpoint_dir_;
     std::string ss_registry_endpoint_dir_;
 };
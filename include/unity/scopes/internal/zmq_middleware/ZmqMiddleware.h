@@ -48,6 +48,9 @@ namespace zmq_middleware
 
 class ObjectAdapter;
 class ServantBase;
+class ShmListener;
+class ShmSender;
+class TwowayInvoker;
 
 class ZmqMiddleware final : public MiddlewareBase
 {
@@ -78,7 +81,8 @@ public:
     virtual void add_dflt_query_object(QueryObjectBase::SPtr const& query) override;
     virtual MWRegistryProxy add_registry_object(std::string const& identity, RegistryObjectBase::SPtr const& registry) override;
     virtual MWReplyProxy add_reply_object(ReplyObjectBase::SPtr const& reply) override;
-    virtual MWScopeProxy add_scope_object(std::string const& identity, ScopeObjectBase::SPtr const& scope, int64_t idle_timeout) override;
+    virtual MWScopeProxy add_scope_object(std::string const& identity, ScopeObjectBase::SPtr const& scope,
+                                          int64_t idle_timeout, std::function<void()> const& idle_callback) override;
     virtual void add_dflt_scope_object(ScopeObjectBase::SPtr const& scope) override;
     virtual MWStateReceiverProxy add_state_receiver_object(std::string const& identity, StateReceiverObject::SPtr const& state_receiver) override;
 
@@ -91,7 +95,8 @@ public:
 
     zmqpp::context* context() const noexcept;
     ThreadPool* oneway_pool();
-    ThreadPool* twoway_pool();
+    TwowayInvoker* twoway_invoker();
+    ShmSender* shm_sender() const noexcept;
     int64_t locate_timeout() const noexcept;
     int64_t registry_timeout() const noexcept;
     int64_t child_scopes_timeout() const noexcept;
@@ -104,7 +109,8 @@ private:
                            int64_t timeout);
 
     std::shared_ptr<ObjectAdapter> find_adapter(std::string const& name, std::string const& endpoint_dir,
-                                                std::string const& category, int64_t idle_timeout = -1);
+                                                std::string const& category, int64_t idle_timeout = -1,
+                                                std::function<void()> const& idle_callback = nullptr);
 
     ZmqProxy safe_add(std::function<void()>& disconnect_func,
                       std::shared_ptr<ObjectAdapter> const& adapter,
@@ -115,6 +121,8 @@ private:
                                         std::string const& category,
                                         std::shared_ptr<ServantBase> const& servant);
 
+    bool start_shm_listener(std::shared_ptr<ObjectAdapter> const& reply_adapter);
+
     std::string server_name_;
     zmqpp::context context_;
     MWRegistryProxy registry_proxy_;
@@ -123,16 +131,21 @@ private:
     typedef std::map<std::string, std::shared_ptr<ObjectAdapter>> AdapterMap;
     AdapterMap am_;
     std::unique_ptr<ThreadPool> oneway_invoker_;
-    std::unique_ptr<ThreadPool> twoway_invokers_;
+    std::unique_ptr<TwowayInvoker> twoway_invoker_;
+
+    std::unique_ptr<ShmListener> shm_listener_; // Receives replies via shared memory, if enabled
+    bool shm_listener_failed_;
+    std::unique_ptr<ShmSender> shm_sender_;     // Sends replies via shared memory to receivers that accept them
 
-    mutable std::mutex data_mutex_;             // Protects am_ and the invokers
+    mutable std::mutex data_mutex_;             // Protects am_, the invokers, and shm_listener_
 
     UniqueID unique_id_;
 
     enum State { Created, Started, Stopping, Stopped };
     State state_;
     std::condition_variable state_changed_;
-    mutable std::mutex state_mutex_;            // Protects state_
+    mutable std::mutex state_mutex_;            // Protects state_ and stopping_invokers_
+    bool stopping_invokers_;                    // Set while stop() waits for the invokers without holding the lock
     std::atomic_bool shutdown_flag_;
     std::unique_ptr<unity::scopes::internal::Logger> test_logger_;
     unity::scopes::internal::Logger& logger_;
@@ -141,6 +154,9 @@ private:
     int64_t locate_timeout_;                    // Timeout for registry locate()
     int64_t registry_timeout_;                  // Timeout for registry operations other than locate()
     int64_t child_scopes_timeout_;              // Timeout for child_scopes() and set_child_scopes() methods
+    size_t shm_ring_size_;                      // Size of shared-memory reply rings in bytes, 0 if disabled
+    int twoway_max_requests_;                   // Maximum number of outstanding twoway requests
+    int twoway_max_requests_per_endpoint_;      // Same, but for each endpoint
 
     std::string public_endpoint_dir_;
     std::string private_endpoint_dir_;
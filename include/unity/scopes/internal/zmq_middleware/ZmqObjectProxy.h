@@ -22,6 +22,7 @@
 #include <scopes/internal/zmq_middleware/capnproto/Message.capnp.h>
 #include <unity/scopes/internal/zmq_middleware/ConnectionPool.h>
 #include <unity/scopes/internal/zmq_middleware/RequestMode.h>
+#include <unity/scopes/internal/zmq_middleware/TwowayInvoker.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqMiddleware.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqObjectProxyFwd.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqRegistryProxyFwd.h>
@@ -40,8 +41,6 @@ namespace internal
 namespace zmq_middleware
 {
 
-class ZmqReceiver;
-
 // A Zmq proxy that points at some Zmq object, but without a specific type.
 
 class ZmqObjectProxy : public virtual MWObjectProxy
@@ -74,20 +73,11 @@ protected:
 
     void invoke_oneway_(capnp::MessageBuilder& in_params);
 
-    // Holds both the receiver for the unmarshaling buffer (which allocates memory)
-    // and the reader that decodes the memory from the unmarshaling buffer.
-    // We use unique_ptr because capnp Builder and Reader types are not movable.
-    struct TwowayOutParams
-    {
-        NONCOPYABLE(TwowayOutParams);
-
-        TwowayOutParams() = default;
-        TwowayOutParams(TwowayOutParams&&) = default;
-        TwowayOutParams& operator=(TwowayOutParams&&) = default;
+    // Sends a oneway request from the calling thread, bypassing the oneway invoker pool.
+    // This still works after the middleware has been stopped.
+    void invoke_oneway_direct_(capnp::MessageBuilder& in_params);
 
-        std::unique_ptr<ZmqReceiver> receiver;
-        std::unique_ptr<capnp::SegmentArrayMessageReader> reader;
-    };
+    typedef zmq_middleware::TwowayOutParams TwowayOutParams;
 
     TwowayOutParams invoke_twoway_(capnp::MessageBuilder& request);
     TwowayOutParams invoke_twoway_(capnp::MessageBuilder& request,
@@ -96,8 +86,24 @@ protected:
                                    int64_t twoway_timeout,
                                    int64_t locate_timeout);
 
+    typedef TwowayInvoker::ReplyCallback TwowayCallback;
+
+    // Like invoke_twoway_(), but returns without waiting for the reply. on_reply receives the (ready) future
+    // for the reply, on the twoway invoker thread, so it must not block. The implicit locate() call to the
+    // registry is made asynchronously as well. The caller must keep this proxy alive until on_reply has run.
+    void invoke_twoway_async_(std::shared_ptr<capnp::MessageBuilder> const& request,
+                              int64_t twoway_timeout,
+                              int64_t locate_timeout,
+                              TwowayCallback on_reply);
+
+    // Passes a future holding e to on_reply.
+    static void fail_async_(TwowayCallback const& on_reply, std::exception_ptr const& e);
+
 private:
     TwowayOutParams invoke_twoway__(capnp::MessageBuilder& request, int64_t timeout);
+    void invoke_twoway_async__(std::shared_ptr<capnp::MessageBuilder> const& request,
+                               int64_t timeout,
+                               TwowayCallback on_reply);
 
     std::string decode_request_(capnp::MessageBuilder& request);
     void trace_request_(capnp::MessageBuilder& request);
@@ -53,6 +53,16 @@ public:
     virtual ObjectProxy locate(std::string const& identity, int64_t timeout) override;
     virtual ObjectProxy locate(std::string const& identity) override;
     virtual bool is_scope_running(std::string const& scope_id) override;
+
+    // Asynchronous version of locate(). Exactly one of proxy and error is set.
+    // on_located runs on the twoway invoker thread and must not block.
+    // The caller must keep this proxy alive until on_located has run.
+    typedef std::function<void(ObjectProxy const& proxy, std::exception_ptr const& error)> LocateCallback;
+    void locate_async(std::string const& identity, int64_t timeout, LocateCallback on_located);
+
+private:
+    void make_locate_request_(capnp::MessageBuilder& b, std::string const& identity) const;
+    ObjectProxy locate_result_(capnp::MessageReader& reply, std::string const& identity);
 };
 
 } // namespace zmq_middleware
@@ -18,10 +18,14 @@
 
 #pragma once
 
+#include <unity/scopes/internal/zmq_middleware/ResultCodec.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqObjectProxy.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqReplyProxyFwd.h>
 #include <unity/scopes/internal/MWReply.h>
 
+#include <functional>
+#include <mutex>
+
 namespace unity
 {
 
@@ -34,18 +38,38 @@ namespace internal
 namespace zmq_middleware
 {
 
+// The version is the wire version of the reply object that the proxy points at. It is passed
+// along with the proxy, so a scope knows whether the client can decode compact results, and
+// whether the client accepts replies via shared memory (see ShmChannel.h).
+
 class ZmqReply : public virtual ZmqObjectProxy, public virtual MWReply
 {
 public:
+    static int32_t const compact_results_version = 1;  // Version of reply objects created by this library
+    static int32_t const shm_channel_version = 2;      // Same, if the middleware listens for shared-memory channels
+
     ZmqReply(ZmqMiddleware* mw_base,
              std::string const& endpoint,
              std::string const& identity,
-             std::string const& category);
+             std::string const& category,
+             int32_t version = 0);
     virtual ~ZmqReply();
 
     virtual void push(VariantMap const& result) override;
+    virtual void push_result(ResultImpl const& result) override;
     virtual void finished(CompletionDetails const& details) override;
     virtual void info(OperationInfo const& op_info) override;
+
+    int32_t version() const noexcept;
+
+private:
+    void push_(bool compact, std::function<void(capnproto::Reply::PushRequest::Builder&)> const& set_result);
+    void send_(capnp::MessageBuilder& request);
+
+    int32_t const version_;
+    std::string const shm_path_;  // Empty unless the receiver accepts replies via shared memory
+    std::mutex encoder_mutex_;   // Held until an encoded result is queued for sending
+    ResultEncoder encoder_;
 };
 
 } // namespace zmq_middleware
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <unity/scopes/internal/zmq_middleware/ZmqObjectProxy.h>
+#include <unity/scopes/internal/zmq_middleware/ZmqReplyProxyFwd.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqScopeProxyFwd.h>
 #include <unity/scopes/internal/MWScope.h>
 
@@ -73,9 +74,69 @@ public:
                                                   std::string const& action_id,
                                                   MWReplyProxy const& reply) override;
 
+    virtual void search_async(CannedQuery const& query,
+                              VariantMap const& hints,
+                              VariantMap const& context,
+                              MWReplyProxy const& reply,
+                              QueryCtrlCallback on_done) override;
+
+    virtual void activate_async(VariantMap const& result,
+                                VariantMap const& hints,
+                                MWReplyProxy const& reply,
+                                QueryCtrlCallback on_done) override;
+
+    virtual void perform_action_async(VariantMap const& result,
+                                      VariantMap const& hints,
+                                      std::string const& widget_id,
+                                      std::string const& action_id,
+                                      MWReplyProxy const& reply,
+                                      QueryCtrlCallback on_done) override;
+
+    virtual void preview_async(VariantMap const& result,
+                               VariantMap const& hints,
+                               MWReplyProxy const& reply,
+                               QueryCtrlCallback on_done) override;
+
+    virtual void activate_result_action_async(VariantMap const& result,
+                                              VariantMap const& hints,
+                                              std::string const& action_id,
+                                              MWReplyProxy const& reply,
+                                              QueryCtrlCallback on_done) override;
+
 private:
+    void make_search_request_(capnp::MessageBuilder& b,
+                              CannedQuery const& query,
+                              VariantMap const& hints,
+                              VariantMap const& context,
+                              ZmqReply& reply_proxy) const;
+    void make_activate_request_(capnp::MessageBuilder& b,
+                                VariantMap const& result,
+                                VariantMap const& hints,
+                                ZmqReply& reply_proxy) const;
+    void make_perform_action_request_(capnp::MessageBuilder& b,
+                                      VariantMap const& result,
+                                      VariantMap const& hints,
+                                      std::string const& widget_id,
+                                      std::string const& action_id,
+                                      ZmqReply& reply_proxy) const;
+    void make_activate_result_action_request_(capnp::MessageBuilder& b,
+                                              VariantMap const& result,
+                                              VariantMap const& hints,
+                                              std::string const& action_id,
+                                              ZmqReply& reply_proxy) const;
+    void make_preview_request_(capnp::MessageBuilder& b,
+                               VariantMap const& result,
+                               VariantMap const& hints,
+                               ZmqReply& reply_proxy) const;
+    QueryCtrlProxy query_ctrl_(capnp::MessageReader& reply, ZmqReplyProxy const& reply_proxy);
+
     ZmqObjectProxy::TwowayOutParams invoke_scope_(capnp::MessageBuilder& in_params);
     ZmqObjectProxy::TwowayOutParams invoke_scope_(capnp::MessageBuilder& in_params, int64_t timeout);
+    void invoke_scope_async_(std::shared_ptr<capnp::MessageBuilder> const& in_params, TwowayCallback on_reply);
+    void invoke_query_async_(std::shared_ptr<capnp::MessageBuilder> const& in_params,
+                             ZmqReplyProxy const& reply_proxy,
+                             QueryCtrlCallback on_done);
+
     std::mutex debug_mode_mutex_;
     std::unique_ptr<bool> debug_mode_;
 };
@@ -77,6 +77,21 @@ public:
     template <typename PARSER>
     using ParserFuture = std::future<std::shared_ptr<PARSER>>;
 
+    using ChunkFunc = std::function<bool(std::string const& chunk, std::string& error)>;
+
+    using StreamFuture = std::future<void>;
+
+    /**
+     * \brief Counts of the requests that were handled by the response cache.
+     */
+    struct CacheStats
+    {
+        int64_t hits;         ///< Requests answered from the cache without contacting the server.
+        int64_t revalidated;  ///< Requests answered from the cache after the server confirmed the cached response.
+        int64_t misses;       ///< Requests for which the server returned a new response.
+        int64_t coalesced;    ///< Requests that shared the download of an identical request in progress.
+    };
+
     HttpAsyncReader();
 
     virtual ~HttpAsyncReader();
@@ -149,6 +164,61 @@ public:
     template <typename PARSER>
     ParserFuture<PARSER> async_get_parser(std::string const& uri, FactoryFunc<PARSER> const& create) const;
 
+    /**
+     * \brief Downloads a HTTP remote file asynchronously and hands the data to the given function as it arrives.
+     *
+     * This method downloads in a separated thread a http document identified by the given URI. Each chunk
+     * of the body is passed to on_chunk as soon as it has been received, so the caller can parse the document
+     * incrementally. Once the download is complete, on_chunk is called once more with an empty chunk.
+     *
+     * If on_chunk returns false, the download stops. If it also sets the error string, the returned future
+     * holds a unity::LogicException with that error; otherwise, the future simply becomes ready.
+     *
+     * Note that the body is passed to on_chunk before the HTTP status is known. If the status is not OK,
+     * the future holds a unity::LogicException once the download is complete.
+     *
+     * \param uri URI to download
+     * \param on_chunk Function that receives the body of the document, one chunk at a time
+     *
+     * \return Future that becomes ready once the download is complete
+     */
+    StreamFuture async_get_stream(std::string const& uri, ChunkFunc const& on_chunk) const;
+
+    /**
+     * \brief Cancels all downloads of this reader that are in progress.
+     *
+     * The futures of the cancelled downloads hold a unity::LogicException. Downloads that are
+     * started after this call are not affected.
+     */
+    void cancel();
+
+    /**
+     * \brief Enables a cache of HTTP responses in the given directory.
+     *
+     * Once the cache is enabled, responses are stored in the directory as permitted by their Cache-Control
+     * (or Expires) header. A request for a URI that has a fresh response in the cache is answered from
+     * the cache. If the cached response is stale but has an ETag or Last-Modified header, the reader sends
+     * a conditional request, so the server does not need to send the document again if it has not changed.
+     * If a request is made while an identical request is still in progress, both share the same download.
+     *
+     * If the responses in the cache exceed max_size bytes in total, the least-recently used ones are removed.
+     * A good place for the cache is a sub-directory of the scope's cache directory
+     * (see unity::scopes::ScopeBase::cache_directory()). Readers that use the same directory share the cache.
+     *
+     * \param directory The directory for the cache. It is created if it does not exist.
+     * \param max_size The maximum size of the cache in bytes.
+     * \throws unity::ResourceException The directory cannot be created.
+     */
+    void set_cache(std::string const& directory, int64_t max_size = 10 * 1024 * 1024);
+
+    /**
+     * \brief Returns the number of cache hits, revalidations, and misses.
+     *
+     * The counts include the requests of all readers that use the same cache directory.
+     * If no cache was set with set_cache(), all counts are zero.
+     */
+    CacheStats cache_stats() const;
+
     /**
      * \brief Gets the data of the given future in the gived timeout.
      * If the time given expires and the data in the future is not ready throws a unity::scopes::TimeoutException
@@ -173,6 +243,10 @@ protected:
     /// @cond
     core::net::http::Request::Progress::Next progress_report(core::net::http::Request::Progress const& progress) const;
 
+    // Returns a progress handler that aborts the download once cancel() is called.
+    std::function<core::net::http::Request::Progress::Next(core::net::http::Request::Progress const&)>
+    progress_handler() const;
+
     void async_execute(core::net::http::Request::Handler const& handler, std::string const& uri) const;
 
     class Priv;
@@ -192,7 +266,7 @@ HttpAsyncReader::ResultsFuture<BASE> HttpAsyncReader::async_get(std::string cons
     auto prom = std::make_shared<std::promise<std::deque<std::shared_ptr<BASE>>>>();
     core::net::http::Request::Handler handler;
 
-    handler.on_progress(bind(&HttpAsyncReader::progress_report, this, std::placeholders::_1));
+    handler.on_progress(progress_handler());
 
     handler.on_error([prom, uri](core::net::Error const& e)
                      {
@@ -255,7 +329,7 @@ HttpAsyncReader::ParserFuture<PARSER> HttpAsyncReader::async_get_parser(std::str
 {
     auto prom = std::make_shared<std::promise<std::shared_ptr<PARSER>>>();
     core::net::http::Request::Handler handler;
-    handler.on_progress(bind(&HttpAsyncReader::progress_report, this, std::placeholders::_1));
+    handler.on_progress(progress_handler());
 
     handler.on_error([prom, uri](core::net::Error const& e)
                      {
@@ -105,6 +105,17 @@ public:
      */
     typedef std::vector<std::pair<std::string, std::string>> JsonParameters;
 
+    /**
+     * \brief Function that receives each object of a streamed download
+     */
+    template <typename T>
+    using ObjectFunc = std::function<bool(std::shared_ptr<T> const&)>;
+
+    /**
+     * \brief Future of a streamed download
+     */
+    typedef HttpAsyncReader::StreamFuture StreamFuture;
+
     JsonAsyncReader();
     virtual ~JsonAsyncReader() = default;
     /// @encond
@@ -239,7 +250,80 @@ public:
      */
     JsonDocumentFuture async_get_parser(std::string const& host, JsonParameters const& params) const;
 
+    /**
+     * \brief Downloads a HTTP JSON remote file asynchronously and passes each object to a callback as soon as
+     * it has been parsed.
+     *
+     * Unlike async_get(), this method does not wait for the whole document. The data is parsed while it is
+     * downloaded, and on_object is called (on the download thread) for every object with the given name
+     * as soon as the object is complete. This allows a scope to push its first results before the
+     * download has finished.
+     *
+     * An object with the given name is the value of a member with that name or, if that value is an array,
+     * each object in the array. Objects with the given name that are nested inside another such object
+     * are not reported separately.
+     *
+     * If on_object returns false, the download stops and the returned future becomes ready. If the document
+     * is malformed, the future holds a unity::LogicException.
+     *
+     * The method has 2 template parameters: the type passed to on_object and the type of objects when
+     * instantiating, which defaults to the former.
+     *
+     * \param uri URI to download
+     * \param object_name name of the kind of object we are looking for in the http document
+     * \param on_object Function that receives each object
+     *
+     * \return Future that becomes ready once the whole document has been parsed
+     */
+    template <typename BASE, typename TYPE = BASE>
+    StreamFuture async_get_stream(std::string const& uri,
+                                  std::string const& object_name,
+                                  ObjectFunc<BASE> const& on_object) const;
+
+    /**
+     * \brief Downloads a HTTP JSON remote file asynchronously and passes each object to a callback as soon as
+     * it has been parsed.
+     *
+     * See async_get_stream() above.
+     *
+     * \param host the remote host name
+     * \param params The parameters that will build the final query, defined by a list of pairs of key and value
+     * \param object_name name of the kind of object we are looking for in the http document
+     * \param on_object Function that receives each object
+     *
+     * \return Future that becomes ready once the whole document has been parsed
+     */
+    template <typename BASE, typename TYPE = BASE>
+    StreamFuture async_get_stream(std::string const& host,
+                                  JsonParameters const& params,
+                                  std::string const& object_name,
+                                  ObjectFunc<BASE> const& on_object) const;
+
+    /**
+     * \brief Cancels all downloads of this reader that are in progress.
+     */
+    void cancel();
+
+    /**
+     * \brief Enables a cache of HTTP responses in the given directory.
+     *
+     * See HttpAsyncReader::set_cache() for details.
+     */
+    void set_cache(std::string const& directory, int64_t max_size = 10 * 1024 * 1024);
+
+    /**
+     * \brief Returns the number of cache hits, revalidations, and misses.
+     */
+    HttpAsyncReader::CacheStats cache_stats() const;
+
 protected:
+    /**
+     * \brief Creates a function that parses a JSON document incrementally, as it is downloaded, and passes
+     * each object with the given name to on_object.
+     */
+    static HttpAsyncReader::ChunkFunc create_stream_parser(std::string const& object_name,
+                                                           std::function<bool(QJsonObject&)> const& on_object);
+
     /**
      * \brief Creates a QJsonDocument filled with the given data.
      * \param data The data that contains the JSON document
@@ -292,6 +376,32 @@ JsonAsyncReader::ResultsFuture<T> JsonAsyncReader::async_get(std::string const&
     return p_->async_get<T, T, QJsonDocument>(uri, object_name, JsonAsyncReader::create_parser_with_data, parse);
 }
 
+template <typename BASE, typename TYPE>
+JsonAsyncReader::StreamFuture JsonAsyncReader::async_get_stream(std::string const& uri,
+                                                                std::string const& object_name,
+                                                                ObjectFunc<BASE> const& on_object) const
+{
+    static_assert(std::is_base_of<BASE, TYPE>::value,
+                  "Second template parameter type must be a valid base class of the first one.");
+
+    auto parser = create_stream_parser(object_name,
+                                       [on_object](QJsonObject& obj)
+                                       {
+                                           return on_object(std::make_shared<TYPE>(obj));
+                                       });
+    return p_->async_get_stream(uri, parser);
+}
+
+template <typename BASE, typename TYPE>
+JsonAsyncReader::StreamFuture JsonAsyncReader::async_get_stream(std::string const& host,
+                                                                JsonParameters const& params,
+                                                                std::string const& object_name,
+                                                                ObjectFunc<BASE> const& on_object) const
+{
+    std::string uri = p_->get_uri(host, params);
+    return async_get_stream<BASE, TYPE>(uri, object_name, on_object);
+}
+
 template <typename B, typename T>
 static bool get_results_json_object(QJsonObject& root,
                                     const std::string& object_name,
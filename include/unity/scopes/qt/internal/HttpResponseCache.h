@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <core/net/http/response.h>
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace qt
+{
+
+namespace internal
+{
+
+// Size-bounded on-disk cache of HTTP responses for HttpAsyncReader.
+//
+// Each response is stored in a file of its own in the cache directory. The cache honors the
+// no-store, no-cache, and max-age directives of Cache-Control (and the Expires header if there is
+// no max-age). A response that is no longer fresh is kept if it has an ETag or Last-Modified header,
+// so the reader can revalidate it with a conditional request instead of downloading it again.
+// If the total size of the cached responses exceeds the limit, the least-recently used ones are removed.
+//
+// All readers that use the same directory share a single instance. The cache is thread-safe.
+
+class HttpResponseCache final
+{
+public:
+    NONCOPYABLE(HttpResponseCache);
+    UNITY_DEFINES_PTRS(HttpResponseCache);
+
+    struct Entry
+    {
+        UNITY_DEFINES_PTRS(Entry);
+
+        std::string body;
+        std::string etag;
+        std::string last_modified;
+        int64_t expires;  // Seconds since the epoch; the entry is fresh until then.
+
+        bool is_fresh() const;
+    };
+
+    // Returns the cache for the given directory, creating the directory if necessary.
+    // If a cache for the directory exists already, it is returned (and max_size is ignored).
+    static SPtr open(std::string const& directory, int64_t max_size);
+
+    ~HttpResponseCache();
+
+    std::string directory() const;
+
+    // Returns the cached response for uri, or nullptr if there is none.
+    Entry::SPtr lookup(std::string const& uri);
+
+    // Adds the headers for a conditional request to revalidate the given entry.
+    static void add_validators(Entry const& entry, core::net::http::Header& header);
+
+    // Stores a response (with status OK) to a request for uri, unless its headers say otherwise.
+    void store(std::string const& uri, core::net::http::Response const& response);
+
+    // Updates the expiry time of the entry for uri after the server returned "304 Not Modified".
+    void refresh(std::string const& uri, Entry const& entry, core::net::http::Response const& response);
+
+    void count_hit();
+    void count_revalidated();
+    void count_miss();
+    void count_coalesced();
+
+    int64_t hits() const;
+    int64_t revalidated() const;
+    int64_t misses() const;
+    int64_t coalesced() const;
+
+private:
+    HttpResponseCache(std::string const& directory, int64_t max_size);
+
+    std::string path(std::string const& uri) const;
+    void write(std::string const& uri, Entry const& entry);
+    void touch(std::string const& uri);
+    void erase(std::string const& uri);
+    void evict();
+    void load_index();
+
+    std::string const directory_;
+    int64_t const max_size_;
+
+    // Index of the files in the directory in LRU order (least-recently used first).
+    struct IndexEntry
+    {
+        std::string file;
+        int64_t size;
+    };
+    typedef std::list<IndexEntry> LRUList;
+    LRUList lru_;
+    std::map<std::string, LRUList::iterator> index_;  // File name to position in lru_
+    int64_t size_;
+    std::mutex mutex_;
+
+    std::atomic<int64_t> hits_;
+    std::atomic<int64_t> revalidated_;
+    std::atomic<int64_t> misses_;
+    std::atomic<int64_t> coalesced_;
+};
+
+}  // namespace internal
+
+}  // namespace qt
+
+}  // namespace scopes
+
+}  // namespace unity
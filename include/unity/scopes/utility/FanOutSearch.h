@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/ChildScope.h>
+#include <unity/scopes/CompletionDetails.h>
+#include <unity/scopes/QueryCtrlProxyFwd.h>
+#include <unity/scopes/SearchListenerBase.h>
+#include <unity/scopes/SearchReplyProxyFwd.h>
+#include <unity/scopes/utility/ResultMerger.h>
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+class SearchQueryBase;
+
+namespace utility
+{
+
+namespace internal
+{
+    class FanOutSearchImpl;
+}
+
+class FanOutSearch final
+{
+public:
+    /// @cond
+    NONCOPYABLE(FanOutSearch);
+    UNITY_DEFINES_PTRS(FanOutSearch);
+
+    ~FanOutSearch();
+    /// @endcond
+
+    /**
+    \brief Per-child statistics collected by run().
+    */
+    struct ChildStats
+    {
+        std::string scope_id;       ///< The scope id of the child.
+        int64_t first_result_ms;    ///< Time from issuing the search to the first result, -1 if no result arrived.
+        int64_t latency_ms;         ///< Time from issuing the search until the child finished or was abandoned.
+        int results;                ///< Number of results of this child that were forwarded upstream.
+        bool timed_out;             ///< `true` if the child did not finish before its deadline.
+        CompletionDetails::CompletionStatus status;  ///< Completion status of the child.
+    };
+
+    /**
+    \brief Function that issues the search for a single child.
+
+    The function must send the search to the child and return immediately, delivering the results
+    to the passed listener. Typically, this calls one of the SearchQueryBase::subsearch() methods.
+    */
+    typedef std::function<QueryCtrlProxy(ChildScope const& child, SearchListenerBase::SPtr const& listener)> SearchFunc;
+
+    /**
+    \brief Create a fan-out search for the given children.
+
+    Results are pushed to `upstream` in the order of `children`. Children that are not enabled are ignored.
+
+    \param upstream The reply proxy of the aggregator's query.
+    \param children The child scopes to query, usually the return value of ScopeBase::child_scopes().
+    */
+    FanOutSearch(SearchReplyProxy const& upstream, ChildScopeList const& children);
+
+    /**
+    \brief Set the deadline for each child.
+
+    A child that has not finished by the time its deadline expires is cancelled. Any of its results that
+    were received before the deadline are forwarded, and children that follow it no longer wait for it.
+
+    \param timeout The deadline in milliseconds, measured from the time the child's search is issued.
+    -1 means no deadline (the default).
+    */
+    void set_child_timeout(int64_t timeout);
+
+    /**
+    \brief Set the maximum number of results forwarded upstream across all children.
+
+    Once the limit is reached, all remaining children are cancelled. If a ResultMerger is set,
+    duplicates that the merger drops do not count towards the limit.
+
+    \param cardinality The maximum number of results. 0 means no limit (the default).
+    */
+    void set_cardinality(int cardinality);
+
+    /**
+    \brief Pass results through a ResultMerger to remove duplicates.
+
+    If a merger is set, each child pushes its results via ResultMerger::child_reply() instead of
+    the upstream proxy, with the first enabled child having the highest priority. The merger must
+    have been created with the same upstream proxy as this FanOutSearch.
+
+    \param merger The merger, or `nullptr` to forward all results unchanged (the default).
+    */
+    void set_merger(ResultMerger::SPtr const& merger);
+
+    /**
+    \brief Search all children with the query string, department, filter state, and metadata of `query`.
+
+    This method blocks until all children have finished, were cancelled because of their deadline or
+    the cardinality limit, or until cancel() is called. Searches are sent to all children without
+    waiting for one another, so the children run in parallel.
+
+    \param query The aggregator's query, used to issue subsearches.
+    \return The statistics for each enabled child, in child order.
+    */
+    std::vector<ChildStats> run(SearchQueryBase& query);
+
+    /**
+    \brief Search all children using a custom search function.
+
+    This is useful if the aggregator needs to send a different query to each child.
+
+    \param search_func The function that issues the search for each child.
+    \return The statistics for each enabled child, in child order.
+    */
+    std::vector<ChildStats> run(SearchFunc const& search_func);
+
+    /**
+    \brief Cancel all outstanding children and make run() return.
+
+    Call this from your implementation of QueryBase::cancelled().
+    */
+    void cancel();
+
+private:
+    std::unique_ptr<internal::FanOutSearchImpl> p;
+};
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/SearchReplyProxyFwd.h>
+#include <unity/util/DefinesPtrs.h>
+#include <unity/util/NonCopyable.h>
+
+#include <memory>
+#include <string>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace utility
+{
+
+namespace internal
+{
+    class ResultMergerImpl;
+}
+
+class ResultMerger final
+{
+public:
+    /// @cond
+    NONCOPYABLE(ResultMerger);
+    UNITY_DEFINES_PTRS(ResultMerger);
+
+    ~ResultMerger();
+    /// @endcond
+
+    /**
+    \brief Determines which of several duplicate results is passed upstream.
+    */
+    enum class Policy
+    {
+        FirstWins,          ///< The first result to arrive is pushed, later duplicates are dropped.
+        PreferChildOrder,   ///< The result from the child with the lowest rank is pushed.
+        CombineAttributes   ///< Like PreferChildOrder, but attributes that are missing from the pushed
+                            ///< result are copied from its duplicates.
+    };
+
+    /**
+    \brief Create a merger that pushes results to `upstream`.
+
+    \param upstream The reply proxy of the aggregator's query.
+    \param key The name of the attribute that identifies duplicates, such as "uri" or "dnd_uri".
+    Results that do not have this attribute are never considered duplicates.
+    \param policy The merge policy.
+    \param max_keys The maximum number of distinct keys that are remembered for this query.
+    Once the limit is reached, results with new keys are passed upstream without de-duplication.
+    \throws unity::InvalidArgumentException if `upstream` is null, `key` is empty, or `max_keys` is zero.
+    */
+    ResultMerger(SearchReplyProxy const& upstream,
+                 std::string const& key = "uri",
+                 Policy policy = Policy::FirstWins,
+                 size_t max_keys = 10000);
+
+    /**
+    \brief Returns the reply proxy for the next child.
+
+    Each call returns a new proxy whose rank is one greater than that of the previous proxy, so the
+    first call returns the proxy for the child with the highest priority. Pushing a result on the
+    returned proxy passes it through the merger. Calling `finished()` on the returned proxy indicates
+    that the child will not push any more results; it does not complete the upstream query.
+
+    \return The reply proxy for the child.
+    */
+    SearchReplyProxy child_reply();
+
+    /**
+    \brief Pushes any results that are held back by the PreferChildOrder or CombineAttributes policies.
+    */
+    void flush();
+
+    /**
+    \brief Returns the number of duplicates that were dropped so far.
+    */
+    int duplicates() const;
+
+private:
+    std::shared_ptr<internal::ResultMergerImpl> p;
+};
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
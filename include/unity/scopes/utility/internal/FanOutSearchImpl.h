@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/utility/FanOutSearch.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace utility
+{
+
+namespace internal
+{
+
+class FanOutForwarder;
+
+// State shared between the FanOutSearchImpl and the forwarders of the children.
+// The forwarders keep this alive because they can still receive callbacks for
+// cancelled or timed-out children after run() has returned.
+
+struct FanOutState
+{
+    typedef std::chrono::steady_clock Clock;
+
+    FanOutState();
+
+    // Returns true if a result from child may be forwarded. If merging is false, the result
+    // counts towards the cardinality immediately. Otherwise, it counts only if it is still
+    // forwarded after de-duplication, which the merger reports via admit_merged().
+    bool admit(size_t child, bool merging);
+    bool admit_merged(size_t child);
+    void child_finished(size_t child, CompletionDetails const& details);
+    bool limit_reached() const;     // Must be called with mutex_ locked.
+    bool abandoned(size_t child) const;  // Same.
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    int cardinality_;
+    int num_forwarded_;
+    int outstanding_;
+    bool cancelled_;
+    std::vector<FanOutSearch::ChildStats> stats_;
+    std::vector<Clock::time_point> start_times_;
+    std::vector<bool> done_;
+
+private:
+    void count_forwarded(size_t child);
+};
+
+class FanOutSearchImpl
+{
+public:
+    FanOutSearchImpl(unity::scopes::SearchReplyProxy const& upstream, ChildScopeList const& children);
+    ~FanOutSearchImpl();
+
+    void set_child_timeout(int64_t timeout);
+    void set_cardinality(int cardinality);
+    void set_merger(ResultMerger::SPtr const& merger);
+    std::vector<FanOutSearch::ChildStats> run(FanOutSearch::SearchFunc const& search_func);
+    void cancel();
+
+private:
+    void abandon(std::vector<size_t> const& children, bool timed_out);
+    void abandon_outstanding();
+
+    unity::scopes::SearchReplyProxy const upstream_;
+    ChildScopeList children_;
+    int64_t child_timeout_;
+    bool started_;
+    ResultMerger::SPtr merger_;
+    std::shared_ptr<FanOutState> state_;
+    std::vector<std::shared_ptr<FanOutForwarder>> forwarders_;
+    std::vector<QueryCtrlProxy> ctrls_;
+};
+
+} // namespace internal
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/SearchReply.h>
+#include <unity/scopes/utility/ResultMerger.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace utility
+{
+
+namespace internal
+{
+
+class ResultMergerImpl : public std::enable_shared_from_this<ResultMergerImpl>
+{
+public:
+    // Called with the rank of the child that supplied a result, just before the result is passed
+    // upstream. Returning false drops the result. FanOutSearch uses this to apply the cardinality
+    // limit to de-duplicated results.
+    typedef std::function<bool(size_t rank)> OutputFilter;
+
+    ResultMergerImpl(unity::scopes::SearchReplyProxy const& upstream,
+                     std::string const& key,
+                     ResultMerger::Policy policy,
+                     size_t max_keys);
+
+    unity::scopes::SearchReplyProxy upstream() const;
+    unity::scopes::SearchReplyProxy child_reply();
+    bool push(size_t rank, CategorisedResult const& result);
+    void child_finished(size_t rank);
+    void flush();
+    int duplicates() const;
+    void set_output_filter(OutputFilter const& filter);
+
+private:
+    struct Entry
+    {
+        size_t rank;                // Rank of the child that supplied the result we keep for this key.
+        bool pending;               // True if the result has not been pushed yet.
+        std::unique_ptr<CategorisedResult> result;   // Set only while pending.
+    };
+
+    bool can_push(size_t rank) const;
+    std::vector<std::pair<size_t, CategorisedResult>> release_pending(bool all);
+    bool push_upstream(size_t rank, CategorisedResult const& result);
+    static void combine(CategorisedResult& target, CategorisedResult const& source);
+
+    unity::scopes::SearchReplyProxy const upstream_;
+    std::string const key_;
+    ResultMerger::Policy const policy_;
+    size_t const max_keys_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> seen_;
+    std::vector<std::string> pending_order_;   // Keys of pending results in order of arrival.
+    std::vector<bool> finished_;    // Index is child rank.
+    int duplicates_;
+    OutputFilter filter_;
+};
+
+// Reply proxy for a single child. Everything except results and the completion
+// of the child is passed straight through to the upstream proxy.
+
+class ChildMergeReply : public virtual unity::scopes::SearchReply
+{
+public:
+    ChildMergeReply(std::shared_ptr<ResultMergerImpl> const& merger, size_t rank);
+
+    std::shared_ptr<ResultMergerImpl> merger() const;
+    size_t rank() const;
+
+    void register_departments(Department::SCPtr const& parent) override;
+    Category::SCPtr register_category(std::string const& id,
+                                      std::string const& title,
+                                      std::string const &icon,
+                                      CategoryRenderer const& renderer_template) override;
+    Category::SCPtr register_category(std::string const& id,
+                                      std::string const& title,
+                                      std::string const &icon,
+                                      CannedQuery const &query,
+                                      CategoryRenderer const& renderer_template) override;
+    void register_category(Category::SCPtr category) override;
+    Category::SCPtr lookup_category(std::string const& id) override;
+
+    bool push(unity::scopes::experimental::Annotation const& annotation) override;
+    bool push(unity::scopes::CategorisedResult const& result) override;
+    bool push(unity::scopes::Filters const& filters, unity::scopes::FilterState const& filter_state) override;
+    bool push(unity::scopes::Filters const& filters) override;
+    void push_surfacing_results_from_cache() noexcept override;
+
+    // Reply interface
+    void finished() override;
+    void error(std::exception_ptr ex) override;
+    void info(OperationInfo const& op_info) override;
+
+    // Object interface
+    std::string endpoint() override;
+    std::string identity() override;
+    std::string target_category() override;
+    int64_t timeout() override;
+    std::string to_string() override;
+
+private:
+    std::shared_ptr<ResultMergerImpl> const merger_;
+    unity::scopes::SearchReplyProxy const upstream_;
+    size_t const rank_;
+};
+
+} // namespace internal
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
@@ -25,6 +25,8 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
+
 #include <sys/stat.h>
 
 using namespace unity::scopes::internal;
@@ -33,22 +35,80 @@ using namespace boost;
 namespace scoperegistry
 {
 
+namespace
+{
+
+bool file_is_empty(std::string const& path)
+{
+    struct stat buf;
+    if (stat(path.c_str(), &buf) == -1)
+    {
+        // We ignore errors because, by the time we get to look,
+        // the file may no longer be there.
+        return true;
+    }
+    return buf.st_size == 0;
+}
+
+std::string scope_id_of(std::string const& ini_path)
+{
+    return filesystem::path(ini_path).stem().native();
+}
+
+}
+
 ScopesWatcher::ScopesWatcher(RegistryObject::SPtr registry,
-                             std::function<void(std::pair<std::string, std::string> const&)> ini_added_callback,
-                             Logger& logger)
+                             ScopeFactory make_scope,
+                             Logger& logger,
+                             std::chrono::milliseconds settle_time)
     : DirWatcher(logger)
     , registry_(registry)
-    , ini_added_callback_(ini_added_callback)
+    , make_scope_(make_scope)
     , logger_(logger)
+    , settle_time_(settle_time)
+    , stopping_(false)
 {
+    flush_thread_ = std::thread(&ScopesWatcher::flush_thread, this);
 }
 
 ScopesWatcher::~ScopesWatcher()
 {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    pending_cond_.notify_all();
+    if (flush_thread_.joinable())
+    {
+        flush_thread_.join();
+    }
     cleanup();
 }
 
 void ScopesWatcher::add_install_dir(std::string const& dir)
+{
+    watch_install_dir(dir, true);
+}
+
+std::string ScopesWatcher::parent_dir(std::string const& child_dir)
+{
+    std::string parent;
+    if (child_dir.back() == '/')
+    {
+        parent = filesystem::path(child_dir.substr(0, child_dir.length() - 1)).parent_path().native();
+    }
+    else
+    {
+        parent = filesystem::path(child_dir).parent_path().native();
+    }
+    return parent;
+}
+
+// If initial is true, the scopes in dir have already been added to the registry,
+// so we only remember where they are. Otherwise, dir has appeared at run time
+// and each of its sub-directories is scheduled to be examined.
+
+void ScopesWatcher::watch_install_dir(std::string const& dir, bool initial)
 {
     try
     {
@@ -64,15 +124,10 @@ void ScopesWatcher::add_install_dir(std::string const& dir)
         }
 
         // Create a new entry for this install dir into idir_to_sdirs_map_
-        if (dir.back() == '/')
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            idir_to_sdirs_map_[dir.substr(0, dir.length() - 1)] = std::set<std::string>();
-        }
-        else
+        std::string const install_dir = dir.back() == '/' ? dir.substr(0, dir.length() - 1) : dir;
         {
             std::lock_guard<std::mutex> lock(mutex_);
-            idir_to_sdirs_map_[dir] = std::set<std::string>();
+            idir_to_sdirs_map_[install_dir] = std::set<std::string>();
         }
 
         // Add watch for root directory
@@ -80,13 +135,29 @@ void ScopesWatcher::add_install_dir(std::string const& dir)
         {
             add_watch(dir);
 
-            // Add watches for each sub directory in root
             auto subdirs = find_entries(dir, EntryType::Directory);
             for (auto const& subdir : subdirs)
             {
+                if (!initial)
+                {
+                    schedule(subdir);
+                    continue;
+                }
                 try
                 {
-                    add_scope_dir(subdir);
+                    try
+                    {
+                        add_watch(subdir);  // Avoid noise if someone drops a file in here
+                    }
+                    catch (unity::LogicException const&) {}
+
+                    auto configs = find_scope_dir_configs(subdir, ".ini");
+                    if (!configs.empty() && !file_is_empty(configs.cbegin()->second))
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        idir_to_sdirs_map_[install_dir].insert(subdir);
+                        sdir_to_ini_map_[subdir] = configs.cbegin()->second;
+                    }
                 }
                 catch (unity::FileException const&)
                 {
@@ -109,20 +180,6 @@ void ScopesWatcher::add_install_dir(std::string const& dir)
     }
 }
 
-std::string ScopesWatcher::parent_dir(std::string const& child_dir)
-{
-    std::string parent;
-    if (child_dir.back() == '/')
-    {
-        parent = filesystem::path(child_dir.substr(0, child_dir.length() - 1)).parent_path().native();
-    }
-    else
-    {
-        parent = filesystem::path(child_dir).parent_path().native();
-    }
-    return parent;
-}
-
 void ScopesWatcher::remove_install_dir(std::string const& dir)
 {
     std::set<std::string> scope_dirs;
@@ -136,103 +193,177 @@ void ScopesWatcher::remove_install_dir(std::string const& dir)
 
     for (auto const& scope_dir : scope_dirs)
     {
-        remove_scope_dir(scope_dir);
+        schedule(scope_dir);
     }
 
     remove_watch(dir);
 }
 
-namespace
+void ScopesWatcher::schedule(std::string const& scope_dir)
 {
+    auto const now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty())
+        {
+            batch_start_ = now;
+        }
+        pending_[scope_dir] = now;
+    }
+    pending_cond_.notify_all();
+}
 
-bool file_is_empty(std::string const& path)
+void ScopesWatcher::flush_thread()
 {
-    struct stat buf;
-    if (stat(path.c_str(), &buf) == -1)
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
     {
-        // We ignore errors because, by the time we get to look,
-        // the file may no longer be there.
-        return true;
+        if (pending_.empty())
+        {
+            pending_cond_.wait(lock);
+            continue;
+        }
+
+        // Installing or removing a scope touches the scope dir and its files several times in quick
+        // succession, and package updates often change many scopes at once. We wait until things
+        // have gone quiet, so the whole lot turns into a single registry update. The upper bound
+        // makes sure that a steady trickle of events cannot hold back the update indefinitely.
+        auto const now = std::chrono::steady_clock::now();
+        auto last_event = batch_start_;
+        for (auto const& p : pending_)
+        {
+            last_event = std::max(last_event, p.second);
+        }
+        auto const deadline = std::min(last_event + settle_time_, batch_start_ + settle_time_ * 10);
+        if (now < deadline)
+        {
+            pending_cond_.wait_until(lock, deadline);
+            continue;
+        }
+
+        std::set<std::string> scope_dirs;
+        for (auto const& p : pending_)
+        {
+            scope_dirs.insert(p.first);
+        }
+        pending_.clear();
+
+        lock.unlock();
+        flush(scope_dirs);
+        lock.lock();
     }
-    return buf.st_size == 0;
 }
 
-}
+// Compares each scope dir with what we knew about it before and collects the differences,
+// which are then passed to the registry in one go. We look at the file system rather than
+// the events we received, so it doesn't matter how many events there were, or in what order.
 
-void ScopesWatcher::add_scope_dir(std::string const& dir)
+void ScopesWatcher::flush(std::set<std::string> const& scope_dirs)
 {
-    try
+    std::vector<RegistryObject::LocalScope> added;
+    std::vector<std::string> removed;
+
+    for (auto const& dir : scope_dirs)
     {
-        // Add a watch for this directory (ignore exception if already exists)
         try
         {
-            if (filesystem::is_directory(dir))
+            bool const exists = filesystem::is_directory(dir);
+            if (exists)
             {
-                add_watch(dir);  // Avoid noise if someone drops a file in here
+                try
+                {
+                    add_watch(dir);  // Avoid noise if someone drops a file in here
+                }
+                catch (unity::LogicException const&) {}
             }
-        }
-        catch (unity::LogicException const&) {}
-
-        auto configs = find_scope_dir_configs(dir, ".ini");
-        if (!configs.empty())
-        {
-            auto config = *configs.cbegin();
-            if (file_is_empty(config.second))
+            else
             {
-                return;  // Wait for event indicating non-empty file, so we don't try parsing it too early.
+                remove_watch(dir);
             }
+
+            std::string old_ini;
             {
                 std::lock_guard<std::mutex> lock(mutex_);
+                auto it = sdir_to_ini_map_.find(dir);
+                if (it != sdir_to_ini_map_.end())
+                {
+                    old_ini = it->second;
+                }
+            }
 
-                // Associate this scope with its install directory
-                if (idir_to_sdirs_map_.find(parent_dir(dir)) != idir_to_sdirs_map_.end())
+            auto configs = find_scope_dir_configs(dir, ".ini");
+            if (!configs.empty())
+            {
+                auto config = *configs.cbegin();
+                if (file_is_empty(config.second))
+                {
+                    continue;  // Wait for event indicating non-empty file, so we don't try parsing it too early.
+                }
+                if (!old_ini.empty() && scope_id_of(old_ini) != config.first)
+                {
+                    removed.push_back(scope_id_of(old_ini));
+                }
+                try
+                {
+                    added.push_back(make_scope_(config));
+                }
+                catch (std::exception const& e)
                 {
-                    idir_to_sdirs_map_.at(parent_dir(dir)).insert(dir);
+                    logger_() << "ScopesWatcher: ignoring installed scope \"" << config.first << "\": " << e.what();
+                    continue;
                 }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+
+                    // Associate this scope with its install directory
+                    auto idir = idir_to_sdirs_map_.find(parent_dir(dir));
+                    if (idir != idir_to_sdirs_map_.end())
+                    {
+                        idir->second.insert(dir);
+                    }
 
-                // Associate this directory with the contained config file
-                sdir_to_ini_map_[dir] = config.second;
+                    // Associate this directory with the contained config file
+                    sdir_to_ini_map_[dir] = config.second;
+                }
+                logger_(LoggerSeverity::Info) << "ScopesWatcher: scope: \"" << config.first
+                                              << "\" installed to: \"" << dir << "\"";
             }
+            else if (!old_ini.empty())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
 
-            // New config found, execute callback
-            ini_added_callback_(config);
-            logger_(LoggerSeverity::Info) << "ScopesWatcher: scope: \"" << config.first
-                                          << "\" installed to: \"" << dir << "\"";
+                    // Unassociate this scope from its install directory and config file
+                    auto idir = idir_to_sdirs_map_.find(parent_dir(dir));
+                    if (idir != idir_to_sdirs_map_.end())
+                    {
+                        idir->second.erase(dir);
+                    }
+                    sdir_to_ini_map_.erase(dir);
+                }
+                removed.push_back(scope_id_of(old_ini));
+                logger_(LoggerSeverity::Info) << "ScopesWatcher: scope: \"" << removed.back()
+                                              << "\" uninstalled from: \"" << dir << "\"";
+            }
+        }
+        catch (std::exception const& e)
+        {
+            logger_() << "ScopesWatcher::flush(): " << dir << ": " << e.what();
         }
     }
-    catch (std::exception const& e)
+
+    if (added.empty() && removed.empty())
     {
-        logger_() << "scoperegistry: add_scope_dir(): " << e.what();
+        return;
     }
-}
-
-void ScopesWatcher::remove_scope_dir(std::string const& dir)
-{
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    // Check if this directory is associate with a config file
-    if (sdir_to_ini_map_.find(dir) != sdir_to_ini_map_.end())
+    try
     {
-        // Unassociate this scope with its install directory
-        if (idir_to_sdirs_map_.find(parent_dir(dir)) != idir_to_sdirs_map_.end())
-        {
-            idir_to_sdirs_map_.at(parent_dir(dir)).erase(dir);
-        }
-
-        // Unassociate this config file with its scope directory
-        std::string ini_path = sdir_to_ini_map_.at(dir);
-        sdir_to_ini_map_.erase(dir);
-
-        // Inform the registry that this scope has been removed
-        filesystem::path p(ini_path);
-        std::string scope_id = p.stem().native();
-        registry_->remove_local_scope(scope_id);
-        logger_(LoggerSeverity::Info) << "ScopesWatcher: scope: \"" << scope_id
-                                      << "\" uninstalled from: \"" << dir << "\"";
+        registry_->apply_changes(added, removed);
+    }
+    catch (std::exception const& e)
+    {
+        logger_() << "ScopesWatcher::flush(): cannot update registry: " << e.what();
     }
-
-    // Remove the watch for this directory
-    remove_watch(dir);
 }
 
 void ScopesWatcher::watch_event(DirWatcher::EventType event_type,
@@ -241,106 +372,52 @@ void ScopesWatcher::watch_event(DirWatcher::EventType event_type,
 {
     filesystem::path fs_path(path);
 
+    // A .ini has been added, modified, or removed. We look at the scope dir containing it later.
     if (file_type == DirWatcher::File
         && fs_path.extension() == ".ini"
         && !boost::algorithm::ends_with(path, "-settings.ini"))
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        std::string parent_path = fs_path.parent_path().native();
-        std::string scope_id = fs_path.stem().native();
-
-        // A .ini has been added / modified
-        if (event_type == DirWatcher::Added || event_type == DirWatcher::Modified)
+        std::string scope_dir = fs_path.parent_path().native();
+        bool is_scope_dir;
         {
-            // We notify only if the file is non-empty.
-            // This avoids notifying twice if things are slow,
-            // because we may get an event for the file creation,
-            // followed by an event for the file modification.
-            // This is not completely free of races because,
-            // by the time we get the create event, the file may
-            // have been *partially* written, in which case
-            // we'll still notify a second time when the file is closed.
-            // But because .ini files are small, we get away with it. (We
-            // rely on the file writer to not write, say, one byte
-            // at a time.)
-            bool non_empty = true;
-            if (event_type == DirWatcher::Added)
-            {
-                non_empty = !file_is_empty(path);
-            }
-            if (non_empty)
-            {
-                sdir_to_ini_map_[parent_path] = path;
-                ini_added_callback_(std::make_pair(scope_id, path));
-                logger_(LoggerSeverity::Info) << "scopeswatcher: scope: \"" << scope_id
-                                              << "\" .ini installed: \"" << path << "\"";
-            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_scope_dir = idir_to_sdirs_map_.find(parent_dir(scope_dir)) != idir_to_sdirs_map_.end();
         }
-        // a .ini has been removed
-        else if (event_type == DirWatcher::Removed)
+        if (is_scope_dir)
         {
-            sdir_to_ini_map_.erase(parent_path);
-            registry_->remove_local_scope(scope_id);
-            logger_(LoggerSeverity::Info) << "scopeswatcher: scope: \"" << scope_id
-                                          << "\" .ini uninstalled: \"" << path << "\"";
+            schedule(scope_dir);
         }
+        return;
     }
-    else
+
+    bool is_install_dir;
+    bool is_inside_install_dir;
     {
-        bool is_install_dir = false;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (idir_to_sdirs_map_.find(path) != idir_to_sdirs_map_.end())
-            {
-                is_install_dir = true;
-            }
-        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_install_dir = idir_to_sdirs_map_.find(path) != idir_to_sdirs_map_.end();
+        is_inside_install_dir = idir_to_sdirs_map_.find(parent_dir(path)) != idir_to_sdirs_map_.end();
+    }
 
-        // If this path is an install dir:
-        if (is_install_dir)
+    // If this path is an install dir:
+    if (is_install_dir)
+    {
+        // An install directory has been added
+        if (event_type == DirWatcher::Added)
         {
-            // An install directory has been added
-            if (event_type == DirWatcher::Added)
-            {
-                add_install_dir(path);
-            }
-            // An install directory has been removed
-            else if (event_type == DirWatcher::Removed)
-            {
-                remove_install_dir(path);
-            }
+            watch_install_dir(path, false);
         }
-        // Else if this path is within an install dir:
-        else
+        // An install directory has been removed
+        else if (event_type == DirWatcher::Removed)
         {
-            bool is_inside_install_dir;
-            {
-                std::lock_guard<std::mutex> lock(mutex_);
-                is_inside_install_dir = idir_to_sdirs_map_.find(parent_dir(path)) != idir_to_sdirs_map_.end();
-            }
-
-            if (is_inside_install_dir)
-            {
-                // A new sub-directory (or symlink to sub-directory) has been added
-                if (event_type == DirWatcher::Added)
-                {
-                    // try add this path as a scope folder (ignore failures to add this path as scope dir)
-                    // (we need to do this with both files and folders added, as the file added may be a symlink)
-                    try
-                    {
-                        add_scope_dir(path);
-                    }
-                    catch (unity::FileException const& e) {}
-                }
-                // A sub directory has been removed
-                else if (event_type == DirWatcher::Removed)
-                {
-                    remove_scope_dir(path);
-                }
-            }
+            remove_install_dir(path);
         }
     }
+    // Else if this path is within an install dir, a scope dir (or a symlink to one)
+    // has been added or removed.
+    else if (is_inside_install_dir && event_type != DirWatcher::Modified)
+    {
+        schedule(path);
+    }
 }
 
 } // namespace scoperegistry
@@ -22,38 +22,59 @@
 
 #include <unity/scopes/internal/RegistryObject.h>
 
+#include <chrono>
+#include <set>
+
 namespace scoperegistry
 {
 
 // ScopesWatcher watches the scope install directories specified by calls to add_install_dir() for
-// the installation / uninstallation of scopes. If a scope is removed, the registry is informed
-// accordingly. If a scope is added, a user callback (provided on construction) is executed.
+// the installation / uninstallation of scopes. Events are not acted on immediately. Instead, the
+// scope directory they refer to is marked as pending. Once no pending directory has seen an event
+// for settle_time (or, if events keep arriving, settle_time * 10 after the first one), each pending
+// directory is re-examined and all resulting additions and removals are passed to the registry with
+// a single call to apply_changes(), so the registry publishes one list update per batch.
+// To add a scope, the registry entry is created by a user callback (provided on construction),
+// which throws if the scope cannot be added.
 
 class ScopesWatcher : public DirWatcher
 {
 public:
+    typedef std::function<unity::scopes::internal::RegistryObject::LocalScope(
+                std::pair<std::string, std::string> const&)> ScopeFactory;
+
     ScopesWatcher(unity::scopes::internal::RegistryObject::SPtr registry,
-                  std::function<void(std::pair<std::string, std::string> const&)> ini_added_callback,
-                  unity::scopes::internal::Logger& logger);
+                  ScopeFactory make_scope,
+                  unity::scopes::internal::Logger& logger,
+                  std::chrono::milliseconds settle_time = std::chrono::milliseconds(500));
 
     ~ScopesWatcher();
 
+    // Starts watching dir. Scopes already in dir are assumed to be known to the registry.
     void add_install_dir(std::string const& dir);
 
 private:
     unity::scopes::internal::RegistryObject::SPtr const registry_;
-    std::function<void(std::pair<std::string, std::string> const&)> const ini_added_callback_;
+    ScopeFactory const make_scope_;
     unity::scopes::internal::Logger& logger_;
+    std::chrono::milliseconds const settle_time_;
     std::map<std::string, std::string> sdir_to_ini_map_;
     std::map<std::string, std::set<std::string>> idir_to_sdirs_map_;
+    std::map<std::string, std::chrono::steady_clock::time_point> pending_;  // Scope dir -> time of last event
+    std::chrono::steady_clock::time_point batch_start_;
+    bool stopping_;
     std::mutex mutex_;
+    std::condition_variable pending_cond_;
+    std::thread flush_thread_;
 
     static std::string parent_dir(std::string const& child_dir);
 
+    void watch_install_dir(std::string const& dir, bool initial);
     void remove_install_dir(std::string const& dir);
 
-    void add_scope_dir(std::string const& dir);
-    void remove_scope_dir(std::string const& dir);
+    void schedule(std::string const& scope_dir);
+    void flush_thread();
+    void flush(std::set<std::string> const& scope_dirs);
 
     void watch_event(DirWatcher::EventType event_type,
                      DirWatcher::FileType file_type,
@@ -33,6 +33,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
 #include <wordexp.h>
 
 using namespace scoperegistry;
@@ -259,17 +260,17 @@ void convert_relative_attribute(VariantMap& inner_map, const string& id, const f
     }
 }
 
-// For each scope, open the config file for the scope, create the metadata info from the config,
-// and add an entry to the RegistryObject.
+// For each scope, open the config file for the scope and create the metadata info and
+// execution data for the RegistryObject entry from the config.
 // If the scope uses settings, also parse the settings file and add the settings to the metadata.
 
-void add_local_scope(RegistryObject::SPtr const& registry,
-                     pair<string, string> const& scope,
-                     MiddlewareBase::SPtr const& mw,
-                     string const& scoperunner_path,
-                     string const& config_file,
-                     bool click,
-                     int timeout_ms)
+RegistryObject::LocalScope make_local_scope(pair<string, string> const& scope,
+                                            MiddlewareBase::SPtr const& mw,
+                                            string const& scoperunner_path,
+                                            string const& config_file,
+                                            bool click,
+                                            int timeout_ms,
+                                            vector<string> const& shared_host_scopes)
 {
     unique_ptr<ScopeMetadataImpl> mi(new ScopeMetadataImpl(mw.get()));
     string scope_config(scope.second);
@@ -419,7 +420,28 @@ void add_local_scope(RegistryObject::SPtr const& registry,
     exec_data.scope_config = scope.second;
     exec_data.debug_mode = sc.debug_mode();
 
-    registry->add_local_scope(scope.first, std::move(meta), exec_data);
+    // Scopes listed in SharedHost.Scopes run together in a single scoperunner process,
+    // unless they are confined, use their own scoperunner, or are being debugged.
+    if (!click && exec_data.custom_exec.empty() && !exec_data.debug_mode
+        && find(shared_host_scopes.begin(), shared_host_scopes.end(), scope.first) != shared_host_scopes.end())
+    {
+        exec_data.host_id = "shared-host";
+    }
+
+    return RegistryObject::LocalScope{ scope.first, std::move(meta), exec_data };
+}
+
+void add_local_scope(RegistryObject::SPtr const& registry,
+                     pair<string, string> const& scope,
+                     MiddlewareBase::SPtr const& mw,
+                     string const& scoperunner_path,
+                     string const& config_file,
+                     bool click,
+                     int timeout_ms,
+                     vector<string> const& shared_host_scopes)
+{
+    auto local_scope = make_local_scope(scope, mw, scoperunner_path, config_file, click, timeout_ms, shared_host_scopes);
+    registry->add_local_scope(local_scope.scope_id, local_scope.metadata, local_scope.exec_data);
 }
 
 void add_local_scopes(RegistryObject::SPtr const& registry,
@@ -428,13 +450,14 @@ void add_local_scopes(RegistryObject::SPtr const& registry,
                       string const& scoperunner_path,
                       string const& config_file,
                       bool click,
-                      int timeout_ms)
+                      int timeout_ms,
+                      vector<string> const& shared_host_scopes)
 {
     for (auto&& pair : all_scopes)
     {
         try
         {
-            add_local_scope(registry, pair, mw, scoperunner_path, config_file, click, timeout_ms);
+            add_local_scope(registry, pair, mw, scoperunner_path, config_file, click, timeout_ms, shared_host_scopes);
         }
         catch (unity::Exception const& e)
         {
@@ -511,6 +534,7 @@ int main(int argc, char* argv[])
         string click_installdir;
         string scoperunner_path;
         int process_timeout;
+        vector<string> shared_host_scopes;
         {
             RegistryConfig c(identity, runtime->registry_configfile());
             mw_kind = c.mw_kind();
@@ -519,6 +543,7 @@ int main(int argc, char* argv[])
             click_installdir = c.click_installdir();
             scoperunner_path = c.scoperunner_path();
             process_timeout = c.process_timeout();
+            shared_host_scopes = c.shared_host_scopes();
         } // Release memory for config parser
 
         // Inform the signal thread that it should shutdown the runtime
@@ -559,8 +584,10 @@ int main(int argc, char* argv[])
             local_scopes[scope_id] = argv[i];                   // operator[] overwrites pre-existing entries
         }
 
-        add_local_scopes(registry, local_scopes, middleware, scoperunner_path, config_file, false, process_timeout);
-        add_local_scopes(registry, click_scopes, middleware, scoperunner_path, config_file, true, process_timeout);
+        add_local_scopes(registry, local_scopes, middleware, scoperunner_path, config_file, false, process_timeout,
+                         shared_host_scopes);
+        add_local_scopes(registry, click_scopes, middleware, scoperunner_path, config_file, true, process_timeout,
+                         shared_host_scopes);
         if (ss_reg_id.empty())
         {
             error("no remote registry configured, only local scopes will be available");
@@ -571,33 +598,21 @@ int main(int argc, char* argv[])
         }
 
         // Configure watches for scope install directories
-        auto local_watch_lambda = [registry, &middleware, &scoperunner_path, &config_file, process_timeout]
+        auto local_watch_lambda = [&middleware, &scoperunner_path, &config_file, process_timeout, &shared_host_scopes]
                                   (pair<string, string> const& scope)
         {
-            try
-            {
-                add_local_scope(registry, scope, middleware, scoperunner_path, config_file, false, process_timeout);
-            }
-            catch (unity::Exception const& e)
-            {
-                error("ignoring installed scope \"" + scope.first + "\": cannot create metadata: " + e.what());
-            }
+            return make_local_scope(scope, middleware, scoperunner_path, config_file, false, process_timeout,
+                                    shared_host_scopes);
         };
         ScopesWatcher local_scopes_watcher(registry, local_watch_lambda, runtime->logger());
         local_scopes_watcher.add_install_dir(scope_installdir);
         local_scopes_watcher.add_install_dir(oem_installdir);
 
-        auto click_watch_lambda = [registry, &middleware, &scoperunner_path, &config_file, process_timeout]
+        auto click_watch_lambda = [&middleware, &scoperunner_path, &config_file, process_timeout, &shared_host_scopes]
                                   (pair<string, string> const& scope)
         {
-            try
-            {
-                add_local_scope(registry, scope, middleware, scoperunner_path, config_file, true, process_timeout);
-            }
-            catch (unity::Exception const& e)
-            {
-                error("ignoring installed scope \"" + scope.first + "\": cannot create metadata: " + e.what());
-            }
+            return make_local_scope(scope, middleware, scoperunner_path, config_file, true, process_timeout,
+                                    shared_host_scopes);
         };
         ScopesWatcher click_scopes_watcher(registry, click_watch_lambda, runtime->logger());
         click_scopes_watcher.add_install_dir(click_installdir);
@@ -69,10 +69,88 @@ private:
     std::function<void()> f_;
 };
 
-// Run the scope specified by the config_file in a separate thread and wait for the thread to finish.
+// Make sure LD_LIBRARY_PATH includes <lib_dir> and <lib_dir>/lib for each of the lib_dirs
+// before loading any scope .so.
+
+void set_ld_library_path(vector<string> const& lib_dirs)
+{
+    string ld_lib_path = core::posix::this_process::env::get("LD_LIBRARY_PATH", "");
+    string scope_ld_lib_path;
+    for (auto const& lib_dir : lib_dirs)
+    {
+        if (boost::starts_with(ld_lib_path, lib_dir) || scope_ld_lib_path.find(lib_dir + ":") != string::npos)
+        {
+            continue;
+        }
+        scope_ld_lib_path += lib_dir + ":" + lib_dir + "/lib:";
+    }
+    if (scope_ld_lib_path.empty())
+    {
+        return;
+    }
+    scope_ld_lib_path = ld_lib_path.empty() ? scope_ld_lib_path.substr(0, scope_ld_lib_path.size() - 1)
+                                            : scope_ld_lib_path + ld_lib_path;
+    try
+    {
+        // No overwrite option for this_process::env::set(), need to unset first
+        core::posix::this_process::env::unset_or_throw("LD_LIBRARY_PATH");
+        core::posix::this_process::env::set_or_throw("LD_LIBRARY_PATH", scope_ld_lib_path);
+    }
+    catch (std::exception const&)
+    {
+        throw unity::ResourceException("cannot set LD_LIBRARY_PATH for scope library in " + lib_dirs[0]);
+    }
+}
+
+// Load the .so for the scope with the given config file.
+
+ScopeLoader::SPtr load_scope(string const& scope_id, string const& scope_config)
+{
+    string lib_dir = boost::filesystem::canonical(scope_config).parent_path().native();
+
+    // For a scope_id "Fred", we look for the library as "libFred.so", "Fred.so", and "scope.so".
+    vector<string> libs;
+    libs.push_back(lib_dir + "/" + DEB_HOST_MULTIARCH + "/lib" + scope_id + ".so");
+    libs.push_back(lib_dir + "/" + DEB_HOST_MULTIARCH + "/" + scope_id + ".so");
+    libs.push_back(lib_dir + "/" + DEB_HOST_MULTIARCH + "/scope.so");
+    libs.push_back(lib_dir + "/lib" + scope_id + ".so");
+    libs.push_back(lib_dir + "/" + scope_id + ".so");
+    libs.push_back(lib_dir + "/scope.so");
+    string failed_libs;
+    ScopeLoader::SPtr loader;
+    exception_ptr ep;
+    for (auto const& lib : libs)
+    {
+        try
+        {
+            loader = ScopeLoader::load(scope_id, lib);
+        }
+        catch (unity::ResourceException& e)
+        {
+            failed_libs += "\n    " + lib;
+            ep = e.remember(ep);
+        }
+        if (loader)
+        {
+            break;
+        }
+    }
+    if (!loader)
+    {
+        unity::ResourceException e("Cannot load scope " + scope_id + "; tried in the following locations:"
+                                   + failed_libs);
+        e.remember(ep);
+        throw e;
+    }
+    return loader;
+}
+
+// Run the scopes specified by the config files in a separate thread and wait for the thread to finish.
+// With a single config file, the scope is loaded immediately. With several config files, the scopes
+// share this process and are loaded on demand.
 // Return exit status for main to use.
 
-int run_scope(std::string const& runtime_config, std::string const& scope_config)
+int run_scopes(std::string const& runtime_config, vector<string> const& scope_configs)
 {
     auto trap = core::posix::trap_signals_for_all_subsequent_threads(
     {
@@ -83,68 +161,26 @@ int run_scope(std::string const& runtime_config, std::string const& scope_config
     std::thread trap_worker([trap]{ trap->run(); });
     ThreadWrapper trap_wrapper(std::move(trap_worker), [trap]{ trap->stop(); });
 
-    // Figure out what the scope ID is from the name of the scope config file.
-    auto scope_config_path = boost::filesystem::canonical(scope_config);
-    string lib_dir = scope_config_path.parent_path().native();
-    string scope_id = scope_config_path.stem().native();
-
+    // Figure out what the scope IDs are from the names of the scope config files.
+    vector<string> scope_ids;
+    vector<string> lib_dirs;
+    for (auto const& scope_config : scope_configs)
     {
-        // Make sure we set LD_LIBRARY_PATH to include <lib_dir> and <lib_dir>/lib
-        // before loading the scope's .so.
-        string scope_ld_lib_path = lib_dir + ":" + lib_dir + "/lib";
-        string ld_lib_path = core::posix::this_process::env::get("LD_LIBRARY_PATH", "");
-        if (!boost::starts_with(ld_lib_path, lib_dir))
-        {
-            scope_ld_lib_path = scope_ld_lib_path + (ld_lib_path.empty() ? "" : (":" + ld_lib_path));
-            try
-            {
-                // No overwrite option for this_process::env::set(), need to unset first
-                core::posix::this_process::env::unset_or_throw("LD_LIBRARY_PATH");
-                core::posix::this_process::env::set_or_throw("LD_LIBRARY_PATH", scope_ld_lib_path);
-            }
-            catch (std::exception const&)
-            {
-                throw unity::ResourceException("cannot set LD_LIBRARY_PATH for scope " + scope_id);
-            }
-        }
+        auto scope_config_path = boost::filesystem::canonical(scope_config);
+        lib_dirs.push_back(scope_config_path.parent_path().native());
+        scope_ids.push_back(scope_config_path.stem().native());
     }
 
+    set_ld_library_path(lib_dirs);
+
     int exit_status = 1;
     try
     {
-        // For a scope_id "Fred", we look for the library as "libFred.so", "Fred.so", and "scope.so".
-        vector<string> libs;
-        libs.push_back(lib_dir + "/" + DEB_HOST_MULTIARCH + "/lib" + scope_id + ".so");
-        libs.push_back(lib_dir + "/" + DEB_HOST_MULTIARCH + "/" + scope_id + ".so");
-        libs.push_back(lib_dir + "/" + DEB_HOST_MULTIARCH + "/scope.so");
-        libs.push_back(lib_dir + "/lib" + scope_id + ".so");
-        libs.push_back(lib_dir + "/" + scope_id + ".so");
-        libs.push_back(lib_dir + "/scope.so");
-        string failed_libs;
+        bool const hosting = scope_configs.size() > 1;
         ScopeLoader::SPtr loader;
-        exception_ptr ep;
-        for (auto const& lib : libs)
+        if (!hosting)
         {
-            try
-            {
-                loader = ScopeLoader::load(scope_id, lib);
-            }
-            catch (unity::ResourceException& e)
-            {
-                failed_libs += "\n    " + lib;
-                ep = e.remember(ep);
-            }
-            if (loader)
-            {
-                break;
-            }
-        }
-        if (!loader)
-        {
-            unity::ResourceException e("Cannot load scope " + scope_id + "; tried in the following locations:"
-                                       + failed_libs);
-            e.remember(ep);
-            throw e;
+            loader = load_scope(scope_ids[0], scope_configs[0]);
         }
 
         static mutex rt_mutex;
@@ -160,13 +196,20 @@ int run_scope(std::string const& runtime_config, std::string const& scope_config
             }
         });
 
-        // Instantiate the run time and run the scope.
+        // Instantiate the run time and run the scope(s).
         {
             lock_guard<mutex> lock(rt_mutex);
-            rt = RuntimeImpl::create(scope_id, runtime_config);
+            rt = RuntimeImpl::create(hosting ? "host-" + scope_ids[0] : scope_ids[0], runtime_config);
         }
 
-        rt->run_scope(loader->scope_base(), scope_config);
+        if (hosting)
+        {
+            rt->run_hosted_scopes(scope_configs, load_scope);
+        }
+        else
+        {
+            rt->run_scope(loader->scope_base(), scope_configs[0]);
+        }
 
         exit_status = 0;
     }
@@ -188,18 +231,18 @@ int
 main(int argc, char* argv[])
 {
     prog_name = basename(argv[0]);
-    if (argc != 3)
+    if (argc < 3)
     {
-        cerr << "usage: " << prog_name << " runtime.ini configfile.ini" << endl;
+        cerr << "usage: " << prog_name << " runtime.ini configfile.ini [configfile.ini...]" << endl;
         return 2;
     }
     char const* const runtime_config = argv[1];
-    char const* const scope_config = argv[2];
+    vector<string> const scope_configs(argv + 2, argv + argc);
 
     int exit_status = 1;
     try
     {
-        exit_status = run_scope(runtime_config, scope_config);
+        exit_status = run_scopes(runtime_config, scope_configs);
     }
     catch (std::exception const& e)
     {
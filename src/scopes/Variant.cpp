@@ -17,7 +17,7 @@
  */
 
 #include <unity/scopes/Variant.h>
-#include <unity/scopes/internal/JsonCppNode.h>
+#include <unity/scopes/internal/JsonCodec.h>
 
 #include <unity/UnityExceptions.h>
 
@@ -294,14 +294,26 @@ void swap(Variant& lhs, Variant& rhs) noexcept
 
 std::string Variant::serialize_json() const
 {
-    internal::JsonCppNode node(*this);
-    return node.to_json_string();
+    return internal::variant_to_json(*this);
 }
 
 Variant Variant::deserialize_json(std::string const& json_string)
 {
-    internal::JsonCppNode node(json_string);
-    return node.to_variant();
+    return internal::json_to_variant(json_string);
+}
+
+Variant internal::VariantAccess::from_dict(VariantMap&& dict)
+{
+    Variant v;
+    v.p->v = move(dict);
+    return v;
+}
+
+Variant internal::VariantAccess::from_array(VariantArray&& array)
+{
+    Variant v;
+    v.p->v = move(array);
+    return v;
 }
 
 } // namespace scopes
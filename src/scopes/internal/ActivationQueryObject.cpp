@@ -55,6 +55,8 @@ void ActivationQueryObject::run(MWReplyProxy const& reply, InvokeInfo const& inf
 {
     assert(self_);
 
+    reply->set_cancellation_token(cancellation_token_);
+
     // Disconnect from middleware. While this request is in progress,
     // this instance will not be deallocated.
     self_ = nullptr;
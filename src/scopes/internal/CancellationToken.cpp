@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/CancellationToken.h>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+CancellationStats::CancellationStats()
+    : cancelled_queries_(0)
+    , dropped_results_(0)
+    , dropped_after_marshaling_(0)
+{
+}
+
+int64_t CancellationStats::cancelled_queries() const noexcept
+{
+    return cancelled_queries_;
+}
+
+int64_t CancellationStats::dropped_results() const noexcept
+{
+    return dropped_results_;
+}
+
+int64_t CancellationStats::dropped_after_marshaling() const noexcept
+{
+    return dropped_after_marshaling_;
+}
+
+CancellationToken::CancellationToken(CancellationStats::SPtr const& stats)
+    : cancelled_(false)
+    , stats_(stats)
+{
+}
+
+void CancellationToken::cancel() noexcept
+{
+    if (!cancelled_.exchange(true) && stats_)
+    {
+        ++stats_->cancelled_queries_;
+    }
+}
+
+bool CancellationToken::cancelled() const noexcept
+{
+    return cancelled_.load(memory_order_relaxed);
+}
+
+void CancellationToken::dropped_result(bool marshaled) noexcept
+{
+    if (stats_)
+    {
+        ++stats_->dropped_results_;
+        if (marshaled)
+        {
+            ++stats_->dropped_after_marshaling_;
+        }
+    }
+}
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
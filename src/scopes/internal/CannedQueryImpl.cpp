@@ -18,11 +18,11 @@
 
 #include <unity/scopes/internal/CannedQueryImpl.h>
 #include <unity/scopes/internal/FilterStateImpl.h>
-#include <unity/scopes/internal/JsonCppNode.h>
+#include <unity/scopes/internal/JsonCodec.h>
 #include <unity/scopes/CannedQuery.h>
 #include <unity/UnityExceptions.h>
 #include <unity/scopes/internal/Utils.h>
-#include <sstream>
+#include <cstring>
 #include <set>
 
 namespace unity
@@ -36,6 +36,17 @@ namespace internal
 
 const std::string CannedQueryImpl::scopes_schema {"scope://"};
 
+namespace
+{
+
+template<size_t N>
+inline bool key_equals(char const* key, size_t key_len, char const (&name)[N])
+{
+    return key_len == N - 1 && memcmp(key, name, key_len) == 0;
+}
+
+} // namespace
+
 CannedQueryImpl::CannedQueryImpl(std::string const& scope_id)
     : scope_id_(scope_id)
 {
@@ -66,6 +77,7 @@ CannedQueryImpl::CannedQueryImpl(CannedQueryImpl const &other)
     {
         user_data_.reset(new Variant(*other.user_data_));
     }
+    uri_ = std::atomic_load(&other.uri_);
 }
 
 CannedQueryImpl::CannedQueryImpl(VariantMap const& variant)
@@ -123,6 +135,7 @@ CannedQueryImpl& CannedQueryImpl::operator=(CannedQueryImpl const &other)
         {
             user_data_.reset(nullptr);
         }
+        std::atomic_store(&uri_, std::atomic_load(&other.uri_));
     }
     return *this;
 }
@@ -130,16 +143,19 @@ CannedQueryImpl& CannedQueryImpl::operator=(CannedQueryImpl const &other)
 void CannedQueryImpl::set_department_id(std::string const& dep_id)
 {
     department_id_ = dep_id;
+    invalidate_uri();
 }
 
 void CannedQueryImpl::set_query_string(std::string const& query_str)
 {
     query_string_ = query_str;
+    invalidate_uri();
 }
 
 void CannedQueryImpl::set_filter_state(FilterState const& filter_state)
 {
     filter_state_ = filter_state;
+    invalidate_uri();
 }
 
 std::string CannedQueryImpl::scope_id() const
@@ -165,6 +181,7 @@ FilterState CannedQueryImpl::filter_state() const
 void CannedQueryImpl::set_user_data(Variant const& value)
 {
     user_data_.reset(new Variant(value));
+    invalidate_uri();
 }
 
 bool CannedQueryImpl::has_user_data() const
@@ -197,28 +214,56 @@ VariantMap CannedQueryImpl::serialize() const
 
 std::string CannedQueryImpl::to_uri() const
 {
-    std::ostringstream s;
-    s << scopes_schema << scope_id_;
-    s << "?q=" << to_percent_encoding(query_string_);
+    // Departments and canned queries are sent with every result, so the same
+    // query is often turned into a URI many times over.
+    auto uri = std::atomic_load(&uri_);
+    if (!uri)
+    {
+        uri = std::make_shared<std::string const>(encode_uri());
+        std::atomic_store(&uri_, uri);
+    }
+    return *uri;
+}
+
+std::string CannedQueryImpl::encode_uri() const
+{
+    std::string s;
+    s.reserve(scopes_schema.size() + scope_id_.size() + 3 * (query_string_.size() + department_id_.size()) + 16);
+    s += scopes_schema;
+    s += scope_id_;
+    s += "?q=";
+    append_percent_encoding(query_string_.data(), query_string_.size(), s);
 
     if (!department_id_.empty())
     {
-        s << "&dep=" << to_percent_encoding(department_id_);
+        s += "&dep=";
+        append_percent_encoding(department_id_.data(), department_id_.size(), s);
     }
 
+    // The JSON has a trailing newline, for compatibility with URIs created by earlier versions.
+    std::string json;
     auto filters_var = filter_state_.serialize();
     if (filters_var.size())
     {
-        Variant const var(filters_var);
-        internal::JsonCppNode const jstr(var);
-        s << "&filters=" << to_percent_encoding(jstr.to_json_string());
+        write_json(VariantAccess::from_dict(std::move(filters_var)), json);
+        json += '\n';
+        s += "&filters=";
+        append_percent_encoding(json.data(), json.size(), s);
     }
     if (user_data_)
     {
-        internal::JsonCppNode const jstr(*(user_data_));
-        s << "&data=" << to_percent_encoding(jstr.to_json_string());
+        json.clear();
+        write_json(*user_data_, json);
+        json += '\n';
+        s += "&data=";
+        append_percent_encoding(json.data(), json.size(), s);
     }
-    return s.str();
+    return s;
+}
+
+void CannedQueryImpl::invalidate_uri() noexcept
+{
+    std::atomic_store(&uri_, std::shared_ptr<std::string const>());
 }
 
 CannedQuery CannedQueryImpl::create(VariantMap const& var)
@@ -226,17 +271,18 @@ CannedQuery CannedQueryImpl::create(VariantMap const& var)
     return CannedQuery(new CannedQueryImpl(var));
 }
 
-std::string CannedQueryImpl::decode_or_throw(std::string const& value, std::string const& key_name, std::string const& uri)
+std::string CannedQueryImpl::decode_or_throw(char const* begin, char const* end, std::string const& key_name, std::string const& uri)
 {
     try
     {
-        return from_percent_encoding(value);
+        std::string value;
+        value.reserve(end - begin);
+        append_percent_decoding(begin, end, value);
+        return value;
     }
     catch (InvalidArgumentException const&)
     {
-        std::stringstream err;
-        err << "Failed to decode key '" << key_name << "' of uri '" << uri << "'";
-        throw InvalidArgumentException(err.str());
+        throw InvalidArgumentException("Failed to decode key '" + key_name + "' of uri '" + uri + "'");
     }
 }
 
@@ -245,71 +291,64 @@ CannedQuery CannedQueryImpl::from_uri(std::string const& uri)
     size_t pos = scopes_schema.length();
     if (uri.compare(0, pos, scopes_schema) != 0)
     {
-        std::stringstream s;
-        s << "CannedQuery::from_uri(): unsupported schema '" + uri + "'";
-        throw InvalidArgumentException(s.str());
+        throw InvalidArgumentException("CannedQuery::from_uri(): unsupported schema '" + uri + "'");
     }
 
-    size_t next = uri.find("?", pos);
-
-    auto scope_id = uri.substr(pos, next - pos);
-    if (scope_id.empty())
+    size_t next = uri.find('?', pos);
+    size_t const id_end = next == std::string::npos ? uri.size() : next;
+    if (id_end == pos)
     {
-        std::stringstream s;
-        s << "CannedQuery()::from_uri(): scope id is empty in '" << uri << "'";
-        throw InvalidArgumentException(s.str());
+        throw InvalidArgumentException("CannedQuery()::from_uri(): scope id is empty in '" + uri + "'");
     }
 
-    CannedQuery q(from_percent_encoding(scope_id));
+    // We slice the URI in place and decode each value straight into its member,
+    // instead of copying each key/value pair out first.
+    std::string scope_id;
+    append_percent_decoding(uri.data() + pos, uri.data() + id_end, scope_id);
+    std::unique_ptr<CannedQueryImpl> q(new CannedQueryImpl(scope_id));
 
-    if (next != std::string::npos) {
-        ++next;
-        std::string kv;
-        std::istringstream istr(uri.substr(next));
-        while (std::getline(istr, kv, '&'))
+    if (next != std::string::npos)
+    {
+        char const* p = uri.data() + next + 1;
+        char const* const end = uri.data() + uri.size();
+        while (p < end)
         {
-            auto eqpos = kv.find("=");
-            if (eqpos != std::string::npos)
+            auto amp = static_cast<char const*>(memchr(p, '&', end - p));
+            char const* const kv_end = amp ? amp : end;
+            auto eq = static_cast<char const*>(memchr(p, '=', kv_end - p));
+            if (eq)
             {
-                std::string const key = kv.substr(0, eqpos);
-                std::string const val = kv.substr(eqpos + 1);
+                size_t const key_len = eq - p;
+                char const* const val = eq + 1;
 
-                if (key == "q")
+                if (key_equals(p, key_len, "q"))
                 {
-                    q.set_query_string(decode_or_throw(val, key, uri));
+                    q->query_string_ = decode_or_throw(val, kv_end, "q", uri);
                 }
-                else if (key == "dep")
+                else if (key_equals(p, key_len, "dep"))
                 {
-                    q.set_department_id(decode_or_throw(val, key, uri));
+                    q->department_id_ = decode_or_throw(val, kv_end, "dep", uri);
                 }
-                else if (key == "filters")
+                else if (key_equals(p, key_len, "filters"))
                 {
-                    auto const fstate_json = decode_or_throw(val, key, uri);
-                    internal::JsonCppNode const node(fstate_json);
-                    auto const var = node.to_variant();
-                    if (var.which() == Variant::Type::Dict)
-                    {
-                        q.set_filter_state(internal::FilterStateImpl::deserialize(var.get_dict()));
-                    }
-                    else
+                    auto const var = json_to_variant(decode_or_throw(val, kv_end, "filters", uri));
+                    if (var.which() != Variant::Type::Dict)
                     {
-                        std::stringstream s;
-                        s << "CannedQuery::from_uri(): invalid filters data for uri: '" << uri << "'";
-                        throw InvalidArgumentException(s.str());
+                        throw InvalidArgumentException("CannedQuery::from_uri(): invalid filters data for uri: '" + uri + "'");
                     }
+                    q->filter_state_ = internal::FilterStateImpl::deserialize(var.get_dict());
                 }
-                else if (key == "data")
+                else if (key_equals(p, key_len, "data"))
                 {
-                    auto const data_json = decode_or_throw(val, key, uri);
-                    internal::JsonCppNode const node(data_json);
-                    q.set_user_data(node.to_variant());
+                    q->set_user_data(json_to_variant(decode_or_throw(val, kv_end, "data", uri)));
                 }
                 // else - unknown keys are ignored
             } // else - the string with no '=' is ignored
+            p = kv_end + 1;
         }
     }
 
-    return q;
+    return CannedQuery(q.release());
 }
 
 } // namespace internal
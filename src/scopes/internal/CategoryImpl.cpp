@@ -17,6 +17,7 @@
  */
 
 #include <unity/scopes/internal/CategoryImpl.h>
+#include <unity/scopes/internal/CategoryRendererImpl.h>
 #include <unity/UnityExceptions.h>
 
 namespace unity
@@ -118,6 +119,15 @@ void CategoryImpl::deserialize(VariantMap const& variant_map)
     {
         renderer_template_ = CategoryRenderer(it->second.get_string()); // can throw if json is invalid
     }
+    else
+    {
+        // The sender omits a template we have received before and sends only its hash.
+        it = variant_map.find("renderer_hash");
+        if (it != variant_map.end())
+        {
+            renderer_template_ = CategoryRendererImpl::from_hash(it->second.get_string()); // can throw if hash is unknown
+        }
+    }
 }
 
 } // namespace internal
@@ -79,6 +79,17 @@ VariantArray CategoryRegistry::serialize() const
     return va;
 }
 
+std::vector<Category::SCPtr> CategoryRegistry::categories() const
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    std::vector<Category::SCPtr> cats;
+    for (auto&& p : categories_)
+    {
+        cats.push_back(p.second);
+    }
+    return cats;
+}
+
 } // namespace internal
 
 } // namespace scopes
@@ -19,9 +19,17 @@
 #include <unity/scopes/internal/CategoryRendererImpl.h>
 #include <unity/scopes/CategoryRenderer.h>
 #include <unity/scopes/internal/JsonCppNode.h>
+#include <unity/scopes/ScopeExceptions.h>
 #include <unity/util/FileIO.h>
 #include <unity/UnityExceptions.h>
 
+#include <cinttypes>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
 namespace unity
 {
 
@@ -34,9 +42,194 @@ namespace internal
 
 //! @cond
 
+namespace
+{
+
+// The cache evicts the least recently used template once it holds max_templates templates.
+// An evicted hash is also forgotten for every origin, so a client does not ask a scope
+// to send just the hash of a template the client can no longer look up.
+size_t const max_templates = 1000;
+size_t const max_origins = 1000;
+size_t const max_hashes_per_origin = 100;
+
+class RendererCache
+{
+public:
+    static RendererCache& instance()
+    {
+        static RendererCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<std::string const> find(std::string const& hash, std::string const& json_text)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = templates_.find(hash);
+        // We compare the template too, so a hash collision can't return the wrong template.
+        if (it == templates_.end() || *it->second.data != json_text)
+        {
+            return nullptr;
+        }
+        touch(it->second);
+        return it->second.data;
+    }
+
+    std::shared_ptr<std::string const> find(std::string const& hash)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = templates_.find(hash);
+        if (it == templates_.end())
+        {
+            return nullptr;
+        }
+        touch(it->second);
+        return it->second.data;
+    }
+
+    std::shared_ptr<std::string const> add(std::string const& hash, std::string const& json_text)
+    {
+        auto data = std::make_shared<std::string const>(json_text);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = templates_.find(hash);
+        if (it != templates_.end())
+        {
+            // A different template with the same hash is cached. We keep the cached one.
+            touch(it->second);
+            return data;
+        }
+        if (templates_.size() >= max_templates)
+        {
+            evict(lru_.back());
+        }
+        lru_.push_front(hash);
+        templates_.emplace(hash, Template{ data, lru_.begin() });
+        return data;
+    }
+
+    // Records that origin sent us the template for hash. We only record the hash if data is
+    // the cached template for hash, so we can look the template up later. The check and the
+    // insertion are done under the same lock, so a concurrent eviction can't leave a hash
+    // in received_ that is no longer in templates_.
+    void note_received(std::string const& origin, std::string const& hash, std::shared_ptr<std::string const> const& data)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto t = templates_.find(hash);
+        if (t == templates_.end() || t->second.data != data)
+        {
+            return;
+        }
+
+        auto it = received_.find(origin);
+        if (it == received_.end())
+        {
+            if (received_.size() >= max_origins)
+            {
+                received_.erase(origin_lru_.back());
+                origin_lru_.pop_back();
+            }
+            origin_lru_.push_front(origin);
+            it = received_.emplace(origin, Origin{ std::list<std::string>(), origin_lru_.begin() }).first;
+        }
+        else
+        {
+            origin_lru_.splice(origin_lru_.begin(), origin_lru_, it->second.pos);
+        }
+
+        // Most recently received hashes are at the front.
+        auto& hashes = it->second.hashes;
+        hashes.remove(hash);
+        hashes.push_front(hash);
+        if (hashes.size() > max_hashes_per_origin)
+        {
+            hashes.pop_back();
+        }
+    }
+
+    std::map<std::string, std::shared_ptr<std::string const>> received_templates(std::string const& origin)
+    {
+        std::map<std::string, std::shared_ptr<std::string const>> templates;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = received_.find(origin);
+        if (it == received_.end())
+        {
+            return templates;
+        }
+        for (auto const& hash : it->second.hashes)
+        {
+            auto t = templates_.find(hash);
+            if (t != templates_.end())
+            {
+                touch(t->second);  // The client is about to advertise the hash.
+                templates.emplace(hash, t->second.data);
+            }
+        }
+        return templates;
+    }
+
+private:
+    struct Template
+    {
+        std::shared_ptr<std::string const> data;
+        std::list<std::string>::iterator pos;     // Position in lru_.
+    };
+
+    struct Origin
+    {
+        std::list<std::string> hashes;
+        std::list<std::string>::iterator pos;     // Position in origin_lru_.
+    };
+
+    // Call with mutex_ locked.
+    void touch(Template& t)
+    {
+        lru_.splice(lru_.begin(), lru_, t.pos);
+    }
+
+    // Call with mutex_ locked.
+    void evict(std::string hash)  // By value because hash may refer to the lru_ entry we erase.
+    {
+        auto it = templates_.find(hash);
+        lru_.erase(it->second.pos);
+        templates_.erase(it);
+        for (auto& r : received_)
+        {
+            r.second.hashes.remove(hash);
+        }
+    }
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Template> templates_;
+    std::list<std::string> lru_;                        // Template hashes, most recently used first.
+    std::unordered_map<std::string, Origin> received_;  // Origin proxy string -> hashes received from it.
+    std::list<std::string> origin_lru_;                 // Origins, most recently used first.
+};
+
+// 64-bit FNV-1a. The hash must be the same in every process, so we can't use std::hash.
+
+std::string compute_hash(std::string const& json_text)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : json_text)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016" PRIx64, h);
+    return buf;
+}
+
+} // namespace
+
 CategoryRendererImpl::CategoryRendererImpl(std::string const& json_text)
-    : data_(json_text)
+    : hash_(compute_hash(json_text))
 {
+    data_ = RendererCache::instance().find(hash_, json_text);
+    if (data_)
+    {
+        return;  // Template was validated already.
+    }
+
     try
     {
         const internal::JsonCppNode node(json_text);
@@ -49,6 +242,7 @@ CategoryRendererImpl::CategoryRendererImpl(std::string const& json_text)
     {
         throw unity::InvalidArgumentException("CategoryRenderer(): invalid JSON definition");
     }
+    data_ = RendererCache::instance().add(hash_, json_text);
 }
 
 CategoryRenderer CategoryRendererImpl::from_file(std::string const& path)
@@ -66,7 +260,32 @@ CategoryRenderer CategoryRendererImpl::from_file(std::string const& path)
 
 std::string CategoryRendererImpl::data() const
 {
-    return data_;
+    return *data_;
+}
+
+std::string CategoryRendererImpl::hash(CategoryRenderer const& renderer)
+{
+    return renderer.p->hash_;
+}
+
+CategoryRenderer CategoryRendererImpl::from_hash(std::string const& hash)
+{
+    auto data = RendererCache::instance().find(hash);
+    if (!data)
+    {
+        throw NotFoundException("CategoryRenderer::from_hash(): unknown renderer template", hash);
+    }
+    return CategoryRenderer(*data);  // Found in the cache, so this does not parse the template.
+}
+
+void CategoryRendererImpl::note_received(std::string const& origin, CategoryRenderer const& renderer)
+{
+    RendererCache::instance().note_received(origin, renderer.p->hash_, renderer.p->data_);
+}
+
+std::map<std::string, std::shared_ptr<std::string const>> CategoryRendererImpl::received_templates(std::string const& origin)
+{
+    return RendererCache::instance().received_templates(origin);
 }
 
 //! @endcond
@@ -31,36 +31,76 @@ ChildScopesRepository::ChildScopesRepository(std::string const& repo_file_path,
     : repo_file_path_(repo_file_path)
     , logger_(logger)
     , have_latest_cache_(false)
+    , have_last_ids_(false)
+    , write_pending_(false)
+    , done_(false)
 {
 }
 
+ChildScopesRepository::~ChildScopesRepository()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    write_cond_.notify_all();
+    if (writer_.joinable())
+    {
+        writer_.join();  // Writes any pending update before the thread exits.
+    }
+}
+
+// child_scopes() is called for every query of an aggregator, so we avoid file I/O here.
+// The repo is read only once, and we write to it only if the list has actually changed.
+// That write is done asynchronously, so the query does not wait for it.
+
 ChildScopeList ChildScopesRepository::child_scopes(ChildScopeList const& child_scopes_defaulted)
 {
     ChildScopeList child_scopes;
+    child_scopes.reserve(child_scopes_defaulted.size());
 
     std::lock_guard<std::mutex> lock(mutex_);
 
     // Read child scope enabled states from our repo
-    auto child_enabled_map = read_repo();
+    auto const& child_enabled_map = read_repo();
 
-    // If we find a child scope in the repo, replace its enabled state with the one found in the repo
-    for (auto const& child_scope : child_scopes_defaulted)
+    // If we find a child scope in the repo, replace its enabled state with the one found in the repo.
+    // If we don't find a child scope in the repo, simply add it in default state.
+    bool same_ids = have_last_ids_ && last_ids_.size() == child_scopes_defaulted.size();
+    for (size_t i = 0; i < child_scopes_defaulted.size(); ++i)
     {
-        if (child_enabled_map.find(child_scope.id) != child_enabled_map.end())
-        {
-            ChildScope updated_child_scope = child_scope;
-            updated_child_scope.enabled = child_enabled_map.at(child_scope.id);
-            child_scopes.push_back(updated_child_scope);
-        }
-        else
+        auto const& child_scope = child_scopes_defaulted[i];
+        same_ids = same_ids && last_ids_[i] == child_scope.id;
+        child_scopes.push_back(child_scope);
+        auto it = child_enabled_map.find(child_scope.id);
+        if (it != child_enabled_map.end())
         {
-            // If we don't find a child scope in the repo, simply add it in default state
-            child_scopes.push_back(child_scope);
+            child_scopes.back().enabled = it->second;
         }
     }
 
-    // write the new ordered list to file
-    write_repo(child_scopes);
+    // Once the repo matches a list, every child in that list is in the repo, so its enabled
+    // state comes from the repo. The same ids in the same order therefore produce the same
+    // repo contents, and we don't need to check for a change.
+    if (same_ids)
+    {
+        return child_scopes;
+    }
+
+    // write the new ordered list to file if it differs from what is there already
+    auto const child_scopes_json = list_to_json(child_scopes);
+    if (child_scopes_json != repo_json_)
+    {
+        update_cache(child_scopes);
+        repo_json_ = child_scopes_json;
+        schedule_write(child_scopes_json);
+    }
+    last_ids_.clear();
+    for (auto const& child_scope : child_scopes)
+    {
+        last_ids_.push_back(child_scope.id);
+    }
+    have_last_ids_ = true;
     return child_scopes;
 }
 
@@ -68,10 +108,29 @@ bool ChildScopesRepository::set_child_scopes(ChildScopeList const& child_scopes)
 {
     // simply write child_scopes_ordered to file
     std::lock_guard<std::mutex> lock(mutex_);
-    return write_repo(child_scopes);
+
+    auto const child_scopes_json = list_to_json(child_scopes);
+    if (child_scopes_json == repo_json_ && !write_pending_)
+    {
+        return true;
+    }
+
+    // This write supersedes any pending one, and is done synchronously so we can report failure.
+    have_last_ids_ = false;
+    write_pending_ = false;
+    pending_json_.clear();
+    if (!write_repo(child_scopes_json))
+    {
+        have_latest_cache_ = false;
+        repo_json_.clear();
+        return false;
+    }
+    update_cache(child_scopes);
+    repo_json_ = child_scopes_json;
+    return true;
 }
 
-bool ChildScopesRepository::write_repo(ChildScopeList const& child_scopes_list)
+bool ChildScopesRepository::write_repo(std::string const& child_scopes_json)
 {
     assert(!mutex_.try_lock());
 
@@ -83,14 +142,46 @@ bool ChildScopesRepository::write_repo(ChildScopeList const& child_scopes_list)
         return false;
     }
 
-    repo_file << list_to_json(child_scopes_list);
+    repo_file << child_scopes_json;
     repo_file.close();
-
-    have_latest_cache_ = false;
     return true;
 }
 
-ChildScopeEnabledMap ChildScopesRepository::read_repo()
+void ChildScopesRepository::schedule_write(std::string const& child_scopes_json)
+{
+    assert(!mutex_.try_lock());
+
+    pending_json_ = child_scopes_json;
+    write_pending_ = true;
+    if (!writer_.joinable())
+    {
+        writer_ = std::thread(&ChildScopesRepository::writer_thread, this);
+    }
+    write_cond_.notify_all();
+}
+
+void ChildScopesRepository::writer_thread()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        write_cond_.wait(lock, [this]{ return write_pending_ || done_; });
+        if (write_pending_)
+        {
+            // Only the most recent list is written; earlier ones that we did not get to are dropped.
+            std::string json;
+            json.swap(pending_json_);
+            write_pending_ = false;
+            write_repo(json);
+        }
+        else
+        {
+            return;  // done_ is set and there is nothing left to write.
+        }
+    }
+}
+
+ChildScopeEnabledMap const& ChildScopesRepository::read_repo()
 {
     // if we already have the latest cache of the repo, simply return it
     if (have_latest_cache_)
@@ -104,17 +195,33 @@ ChildScopeEnabledMap ChildScopesRepository::read_repo()
     {
         logger_(LoggerSeverity::Info) << "ChildScopesRepository::read_repo(): "
                                       << "Failed to open file: \"" << repo_file_path_ << "\"";
-        return ChildScopeEnabledMap();
+        cached_repo_.clear();
+        return cached_repo_;
     }
 
-    cached_repo_ = json_to_list(std::string((std::istreambuf_iterator<char>(repo_file)),
-                                            std::istreambuf_iterator<char>()));
+    repo_json_ = std::string((std::istreambuf_iterator<char>(repo_file)), std::istreambuf_iterator<char>());
+    cached_repo_ = json_to_list(repo_json_);
     repo_file.close();
 
     have_latest_cache_ = true;
     return cached_repo_;
 }
 
+// Updates the cache to match what read_repo() would return after writing child_scopes_list.
+
+void ChildScopesRepository::update_cache(ChildScopeList const& child_scopes_list)
+{
+    assert(!mutex_.try_lock());
+
+    cached_repo_.clear();
+    for (auto const& child_scope : child_scopes_list)
+    {
+        // As for json_to_list(), the first appearance of a child determines its enabled state.
+        cached_repo_.insert(make_pair(child_scope.id, child_scope.enabled));
+    }
+    have_latest_cache_ = true;
+}
+
 std::string ChildScopesRepository::list_to_json(ChildScopeList const& child_scopes_list)
 {
     std::ostringstream child_scopes_json;
@@ -161,10 +161,10 @@ string ConfigBase::get_middleware(string const& group, string const& key) const
     {
         return DFLT_MIDDLEWARE;
     }
-    if (val != "Zmq" && val != "REST")
+    if (val != "Zmq" && val != "REST" && val != "Inproc")
     {
         throw_ex("Illegal value for " + key + ": \"" + val +
-                 "\": legal values are \"Zmq\" and \"REST\"");
+                 "\": legal values are \"Zmq\", \"REST\", and \"Inproc\"");
     }
     return val;
 }
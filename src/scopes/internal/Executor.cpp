@@ -18,11 +18,87 @@
 
 #include <unity/scopes/internal/Executor.h>
 
+#include <core/posix/fork.h>
+
 #include <cerrno>
-#include <sys/apparmor.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace unity::scopes::internal;
 
+namespace
+{
+
+// Writes a message to stderr. (The child of vfork() cannot use iostreams or throw.)
+
+void child_error(char const* msg)
+{
+    ssize_t rc = ::write(STDERR_FILENO, msg, strlen(msg));
+    static_cast<void>(rc);
+}
+
+} // namespace
+
+Executor::Command::Command(const std::string& program,
+                           const std::vector<std::string>& args,
+                           const std::map<std::string, std::string>& env,
+                           const std::string& confinement_profile)
+    : program_(program)
+    , args_(args)
+    , env_(env)
+    , confinement_profile_(confinement_profile)
+{
+    argv_strings_.push_back(program_);
+    argv_strings_.insert(argv_strings_.end(), args_.begin(), args_.end());
+    for (auto const& var : env_)
+    {
+        env_strings_.push_back(var.first + "=" + var.second);
+    }
+
+    // Take the addresses only once the vectors no longer change.
+    for (auto& arg : argv_strings_)
+    {
+        argv_.push_back(&arg[0]);
+    }
+    argv_.push_back(nullptr);
+    for (auto& var : env_strings_)
+    {
+        envp_.push_back(&var[0]);
+    }
+    envp_.push_back(nullptr);
+
+    if (!confinement_profile_.empty())
+    {
+        // This is what aa_change_profile() does, except that we work out the file name and
+        // the command here, instead of in the child.
+        profile_attr_path_ = ::access("/proc/self/attr/apparmor/current", F_OK) == 0
+                                 ? "/proc/self/attr/apparmor/current"
+                                 : "/proc/self/attr/current";
+        profile_attr_cmd_ = "changeprofile " + confinement_profile_;
+    }
+}
+
+const std::string& Executor::Command::program() const
+{
+    return program_;
+}
+
+const std::vector<std::string>& Executor::Command::args() const
+{
+    return args_;
+}
+
+const std::map<std::string, std::string>& Executor::Command::env() const
+{
+    return env_;
+}
+
+const std::string& Executor::Command::confinement_profile() const
+{
+    return confinement_profile_;
+}
+
 Executor::Executor()
 {
 }
@@ -33,29 +109,54 @@ core::posix::ChildProcess Executor::exec(const std::string& fn,
         const core::posix::StandardStream& flags,
         const std::string& confinement_profile)
 {
-    std::function<void()> child_setup = [confinement_profile]()
+    Command command(fn, argv, env, confinement_profile);
+    return spawn(command, flags);
+}
+
+core::posix::ChildProcess Executor::spawn(const Command& command, const core::posix::StandardStream& flags)
+{
+    // The child shares our memory until it calls execve() (as for posix_spawn()), so everything
+    // it does below must be async-signal-safe. In particular, it must not allocate or throw.
+    // (We use vfork() rather than posix_spawn() because the death observer needs a ChildProcess.)
+    const Command* cmd = &command;
+    std::function<core::posix::exit::Status()> child_main = [cmd]()
     {
         // Clear any signal masks inherited from the parent process
         ::sigset_t empty_mask;
         ::sigemptyset(&empty_mask);
         ::pthread_sigmask(SIG_SETMASK, &empty_mask, nullptr);
 
-        if (!confinement_profile.empty())
+        if (!cmd->profile_attr_cmd_.empty())
         {
-            if (aa_change_profile(confinement_profile.c_str()) < 0)
+            int fd = ::open(cmd->profile_attr_path_.c_str(), O_WRONLY | O_CLOEXEC);
+            ssize_t len = fd == -1 ? -1 : ::write(fd, cmd->profile_attr_cmd_.data(), cmd->profile_attr_cmd_.size());
+            int err = errno;
+            if (fd != -1)
+            {
+                ::close(fd);
+            }
+            if (len == -1)
             {
-                switch (errno)
+                switch (err)
                 {
                     case ENOENT:
                     case EACCES:
-                        throw std::runtime_error("AppArmor profile does not exist");
+                        child_error("Executor: AppArmor profile does not exist\n");
+                        break;
                     case EINVAL:
-                        throw std::runtime_error("AppArmor interface not available");
+                        child_error("Executor: AppArmor interface not available\n");
+                        break;
                     default:
-                        throw std::runtime_error("Unknown AppArmor error");
+                        child_error("Executor: Unknown AppArmor error\n");
                 }
+                ::_exit(EXIT_FAILURE);
             }
         }
+
+        ::execve(cmd->argv_[0], cmd->argv_.data(), cmd->envp_.data());
+        child_error("Executor: execve() failed\n");
+        ::_exit(127);
+        return core::posix::exit::Status::failure;  // Not reached
     };
-    return core::posix::exec(fn, argv, env, flags, child_setup);
+    return core::posix::vfork(child_main, flags);
 }
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/HostedScopeObject.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace
+{
+
+// Keeps the scope loaded for the duration of a forwarded call.
+
+class CallGuard
+{
+public:
+    CallGuard(function<void()> const& release)
+        : release_(release)
+    {
+    }
+
+    ~CallGuard()
+    {
+        release_();
+    }
+
+private:
+    function<void()> release_;
+};
+
+} // namespace
+
+HostedScopeObject::HostedScopeObject(string const& scope_id, bool debug_mode, LoadFunction const& load)
+    : scope_id_(scope_id)
+    , debug_mode_(debug_mode)
+    , load_(load)
+    , calls_in_progress_(0)
+{
+    assert(!scope_id.empty());
+    assert(load);
+}
+
+HostedScopeObject::~HostedScopeObject()
+{
+    unload(true);
+}
+
+ScopeObject::SPtr HostedScopeObject::acquire() const
+{
+    lock_guard<mutex> lock(mutex_);
+    if (!instance_.scope_object)
+    {
+        instance_ = load_();
+        assert(instance_.scope_object);
+    }
+    ++calls_in_progress_;
+    return instance_.scope_object;
+}
+
+void HostedScopeObject::release() const noexcept
+{
+    lock_guard<mutex> lock(mutex_);
+    --calls_in_progress_;
+}
+
+MWQueryCtrlProxy HostedScopeObject::search(CannedQuery const& q,
+                                           SearchMetadata const& hints,
+                                           VariantMap const& context,
+                                           MWReplyProxy const& reply,
+                                           InvokeInfo const& info)
+{
+    auto so = acquire();
+    CallGuard guard([this] { release(); });
+    return so->search(q, hints, context, reply, info);
+}
+
+MWQueryCtrlProxy HostedScopeObject::activate(Result const& result,
+                                             ActionMetadata const& hints,
+                                             MWReplyProxy const& reply,
+                                             InvokeInfo const& info)
+{
+    auto so = acquire();
+    CallGuard guard([this] { release(); });
+    return so->activate(result, hints, reply, info);
+}
+
+MWQueryCtrlProxy HostedScopeObject::perform_action(Result const& result,
+                                                   ActionMetadata const& hints,
+                                                   string const& widget_id,
+                                                   string const& action_id,
+                                                   MWReplyProxy const& reply,
+                                                   InvokeInfo const& info)
+{
+    auto so = acquire();
+    CallGuard guard([this] { release(); });
+    return so->perform_action(result, hints, widget_id, action_id, reply, info);
+}
+
+MWQueryCtrlProxy HostedScopeObject::preview(Result const& result,
+                                            ActionMetadata const& hints,
+                                            MWReplyProxy const& reply,
+                                            InvokeInfo const& info)
+{
+    auto so = acquire();
+    CallGuard guard([this] { release(); });
+    return so->preview(result, hints, reply, info);
+}
+
+ChildScopeList HostedScopeObject::child_scopes() const
+{
+    auto so = acquire();
+    CallGuard guard([this] { release(); });
+    return so->child_scopes();
+}
+
+bool HostedScopeObject::set_child_scopes(ChildScopeList const& child_scopes)
+{
+    auto so = acquire();
+    CallGuard guard([this] { release(); });
+    return so->set_child_scopes(child_scopes);
+}
+
+bool HostedScopeObject::debug_mode() const
+{
+    return debug_mode_;
+}
+
+MWQueryCtrlProxy HostedScopeObject::activate_result_action(Result const& result,
+                                                           ActionMetadata const& hints,
+                                                           string const& action_id,
+                                                           MWReplyProxy const& reply,
+                                                           InvokeInfo const& info)
+{
+    auto so = acquire();
+    CallGuard guard([this] { release(); });
+    return so->activate_result_action(result, hints, action_id, reply, info);
+}
+
+string HostedScopeObject::scope_id() const
+{
+    return scope_id_;
+}
+
+bool HostedScopeObject::loaded() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return instance_.scope_object != nullptr;
+}
+
+bool HostedScopeObject::unload(bool force)
+{
+    // We hold the lock while the scope stops, so a request that arrives in the mean time
+    // waits and then loads a fresh instance, instead of running alongside the old one.
+    lock_guard<mutex> lock(mutex_);
+    if (!instance_.scope_object)
+    {
+        return true;
+    }
+    if (!force && (calls_in_progress_ > 0 || instance_.scope_object->active_queries() > 0))
+    {
+        return false;
+    }
+    Instance instance = move(instance_);
+    instance_ = Instance();
+    instance.scope_object.reset();
+    if (instance.stop)
+    {
+        instance.stop();
+    }
+    return true;
+}
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
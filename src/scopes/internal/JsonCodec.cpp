@@ -0,0 +1,801 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/JsonCodec.h>
+
+#include <unity/UnityExceptions.h>
+
+#include <cctype>
+#include <cerrno>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace
+{
+
+char const hex_digits[] = "0123456789abcdef";
+
+void write_string(string const& s, string& out)
+{
+    out += '"';
+    char const* p = s.data();
+    char const* end = p + s.size();
+    char const* run = p;  // Start of the characters that can be copied verbatim.
+    for (; p != end; ++p)
+    {
+        unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+        out.append(run, p - run);
+        run = p + 1;
+        out += '\\';
+        switch (c)
+        {
+            case '"':
+                out += '"';
+                break;
+            case '\\':
+                out += '\\';
+                break;
+            case '\b':
+                out += 'b';
+                break;
+            case '\f':
+                out += 'f';
+                break;
+            case '\n':
+                out += 'n';
+                break;
+            case '\r':
+                out += 'r';
+                break;
+            case '\t':
+                out += 't';
+                break;
+            default:
+                out += "u00";
+                out += hex_digits[c >> 4];
+                out += hex_digits[c & 0xf];
+                break;
+        }
+    }
+    out.append(run, p - run);
+    out += '"';
+}
+
+// snprintf() and strtod() use the decimal point of the current locale, JSON always uses '.'.
+
+char locale_decimal_point()
+{
+    char const* dp = localeconv()->decimal_point;
+    return dp && *dp ? *dp : '.';
+}
+
+void write_double(double d, string& out)
+{
+    if (!isfinite(d))
+    {
+        // JSON has no representation for these; json-glib writes something unparseable too.
+        out += "null";
+        return;
+    }
+
+    // Same precision as json-glib (g_ascii_dtostr()), so URIs and other persisted JSON
+    // that contain doubles do not change compared to earlier releases.
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%.17g", d);
+    char const dp = locale_decimal_point();
+    bool has_fraction = false;
+    for (int i = 0; i < len; ++i)
+    {
+        if (buf[i] == dp)
+        {
+            buf[i] = '.';
+            has_fraction = true;
+        }
+        else if (buf[i] == 'e' || buf[i] == 'n' || buf[i] == 'i')
+        {
+            has_fraction = true;
+        }
+    }
+    out.append(buf, len);
+    if (!has_fraction)
+    {
+        out += ".0";  // Make sure the value is read back as a double.
+    }
+}
+
+void write_value(Variant const& v, string& out)
+{
+    switch (v.which())
+    {
+        case Variant::Type::Null:
+            out += "null";
+            break;
+        case Variant::Type::Bool:
+            out += v.get_bool() ? "true" : "false";
+            break;
+        case Variant::Type::Int:
+            out += std::to_string(v.get_int());
+            break;
+        case Variant::Type::Int64:
+            out += std::to_string(v.get_int64_t());
+            break;
+        case Variant::Type::Double:
+            write_double(v.get_double(), out);
+            break;
+        case Variant::Type::String:
+            write_string(v.get_string(), out);
+            break;
+        case Variant::Type::Array:
+        {
+            out += '[';
+            bool first = true;
+            for (auto const& elmt : v.get_array())
+            {
+                if (!first)
+                {
+                    out += ',';
+                }
+                first = false;
+                write_value(elmt, out);
+            }
+            out += ']';
+            break;
+        }
+        case Variant::Type::Dict:
+        {
+            out += '{';
+            bool first = true;
+            for (auto const& member : v.get_dict())
+            {
+                if (!first)
+                {
+                    out += ',';
+                }
+                first = false;
+                write_string(member.first, out);
+                out += ':';
+                write_value(member.second, out);
+            }
+            out += '}';
+            break;
+        }
+        default:
+            abort();  // LCOV_EXCL_LINE  // Impossible
+    }
+}
+
+// Recursive descent parser. Strings without escapes are passed to the handler
+// straight out of the input; strings with escapes are decoded into a scratch buffer
+// that is reused for the whole document.
+
+class Parser
+{
+public:
+    Parser(string const& json, JsonSaxHandler& handler)
+        : begin_(json.data())
+        , p_(json.data())
+        , end_(json.data() + json.size())
+        , handler_(handler)
+        , depth_(0)
+    {
+    }
+
+    void parse()
+    {
+        skip_space();
+        if (p_ == end_)
+        {
+            throw unity::ResourceException("JsonCodec: empty string is not a valid JSON");
+        }
+        parse_value();
+        skip_space();
+        if (p_ != end_)
+        {
+            error("unexpected character after value");
+        }
+    }
+
+private:
+    static constexpr int max_depth = 512;
+
+    [[noreturn]] void error(char const* what) const
+    {
+        throw unity::ResourceException(string("JsonCodec: parse error at offset ")
+                                       + std::to_string(p_ - begin_) + ": " + what);
+    }
+
+    // json-glib accepts C and C++ style comments, so we do too.
+    void skip_space()
+    {
+        while (p_ != end_)
+        {
+            char c = *p_;
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            {
+                ++p_;
+            }
+            else if (c == '/' && p_ + 1 != end_ && p_[1] == '/')
+            {
+                p_ += 2;
+                while (p_ != end_ && *p_ != '\n')
+                {
+                    ++p_;
+                }
+            }
+            else if (c == '/' && p_ + 1 != end_ && p_[1] == '*')
+            {
+                p_ += 2;
+                while (p_ != end_ && !(*p_ == '*' && p_ + 1 != end_ && p_[1] == '/'))
+                {
+                    ++p_;
+                }
+                if (p_ == end_)
+                {
+                    error("unterminated comment");
+                }
+                p_ += 2;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    void expect_literal(char const* lit, size_t len)
+    {
+        if (size_t(end_ - p_) < len || memcmp(p_, lit, len) != 0)
+        {
+            error("invalid literal");
+        }
+        p_ += len;
+    }
+
+    void parse_value()
+    {
+        if (p_ == end_)
+        {
+            error("unexpected end of input");
+        }
+        switch (*p_)
+        {
+            case '{':
+                parse_object();
+                break;
+            case '[':
+                parse_array();
+                break;
+            case '"':
+            {
+                size_t len;
+                char const* s = parse_string(len);
+                handler_.string_value(s, len);
+                break;
+            }
+            case 't':
+                expect_literal("true", 4);
+                handler_.bool_value(true);
+                break;
+            case 'f':
+                expect_literal("false", 5);
+                handler_.bool_value(false);
+                break;
+            case 'n':
+                expect_literal("null", 4);
+                handler_.null_value();
+                break;
+            default:
+                parse_number();
+                break;
+        }
+    }
+
+    void enter()
+    {
+        if (++depth_ > max_depth)
+        {
+            error("nesting too deep");
+        }
+    }
+
+    void parse_object()
+    {
+        enter();
+        ++p_;  // '{'
+        handler_.start_object();
+        skip_space();
+        if (p_ != end_ && *p_ == '}')
+        {
+            ++p_;
+        }
+        else
+        {
+            for (;;)
+            {
+                skip_space();
+                if (p_ == end_ || *p_ != '"')
+                {
+                    error("expected member name");
+                }
+                size_t len;
+                char const* s = parse_string(len);
+                handler_.key(s, len);
+                skip_space();
+                if (p_ == end_ || *p_ != ':')
+                {
+                    error("expected ':'");
+                }
+                ++p_;
+                skip_space();
+                parse_value();
+                skip_space();
+                if (p_ != end_ && *p_ == ',')
+                {
+                    ++p_;
+                    continue;
+                }
+                if (p_ != end_ && *p_ == '}')
+                {
+                    ++p_;
+                    break;
+                }
+                error("expected ',' or '}'");
+            }
+        }
+        handler_.end_object();
+        --depth_;
+    }
+
+    void parse_array()
+    {
+        enter();
+        ++p_;  // '['
+        handler_.start_array();
+        skip_space();
+        if (p_ != end_ && *p_ == ']')
+        {
+            ++p_;
+        }
+        else
+        {
+            for (;;)
+            {
+                skip_space();
+                parse_value();
+                skip_space();
+                if (p_ != end_ && *p_ == ',')
+                {
+                    ++p_;
+                    continue;
+                }
+                if (p_ != end_ && *p_ == ']')
+                {
+                    ++p_;
+                    break;
+                }
+                error("expected ',' or ']'");
+            }
+        }
+        handler_.end_array();
+        --depth_;
+    }
+
+    unsigned parse_hex4()
+    {
+        if (end_ - p_ < 4)
+        {
+            error("invalid \\u escape");
+        }
+        unsigned cp = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            char c = *p_++;
+            cp <<= 4;
+            if (c >= '0' && c <= '9')
+            {
+                cp |= c - '0';
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                cp |= c - 'a' + 10;
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                cp |= c - 'A' + 10;
+            }
+            else
+            {
+                error("invalid \\u escape");
+            }
+        }
+        return cp;
+    }
+
+    void append_utf8(unsigned cp)
+    {
+        if (cp < 0x80)
+        {
+            scratch_ += char(cp);
+        }
+        else if (cp < 0x800)
+        {
+            scratch_ += char(0xc0 | (cp >> 6));
+            scratch_ += char(0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000)
+        {
+            scratch_ += char(0xe0 | (cp >> 12));
+            scratch_ += char(0x80 | ((cp >> 6) & 0x3f));
+            scratch_ += char(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            scratch_ += char(0xf0 | (cp >> 18));
+            scratch_ += char(0x80 | ((cp >> 12) & 0x3f));
+            scratch_ += char(0x80 | ((cp >> 6) & 0x3f));
+            scratch_ += char(0x80 | (cp & 0x3f));
+        }
+    }
+
+    // Returns a pointer to the decoded string, which is valid until the next call.
+    char const* parse_string(size_t& len)
+    {
+        ++p_;  // Opening quote
+        char const* start = p_;
+        while (p_ != end_ && *p_ != '"' && *p_ != '\\')
+        {
+            if (static_cast<unsigned char>(*p_) < 0x20)
+            {
+                error("control character in string");
+            }
+            ++p_;
+        }
+        if (p_ == end_)
+        {
+            error("unterminated string");
+        }
+        if (*p_ == '"')
+        {
+            len = p_ - start;
+            ++p_;
+            return start;
+        }
+
+        // Slow path for strings with escapes.
+        scratch_.assign(start, p_ - start);
+        while (p_ != end_ && *p_ != '"')
+        {
+            char c = *p_++;
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                error("control character in string");
+            }
+            if (c != '\\')
+            {
+                scratch_ += c;
+                continue;
+            }
+            if (p_ == end_)
+            {
+                break;
+            }
+            switch (*p_++)
+            {
+                case '"':
+                    scratch_ += '"';
+                    break;
+                case '\\':
+                    scratch_ += '\\';
+                    break;
+                case '/':
+                    scratch_ += '/';
+                    break;
+                case 'b':
+                    scratch_ += '\b';
+                    break;
+                case 'f':
+                    scratch_ += '\f';
+                    break;
+                case 'n':
+                    scratch_ += '\n';
+                    break;
+                case 'r':
+                    scratch_ += '\r';
+                    break;
+                case 't':
+                    scratch_ += '\t';
+                    break;
+                case 'u':
+                {
+                    unsigned cp = parse_hex4();
+                    if (cp >= 0xd800 && cp < 0xdc00)
+                    {
+                        // High surrogate, must be followed by a low surrogate.
+                        if (end_ - p_ < 6 || p_[0] != '\\' || p_[1] != 'u')
+                        {
+                            error("invalid surrogate pair");
+                        }
+                        p_ += 2;
+                        unsigned low = parse_hex4();
+                        if (low < 0xdc00 || low >= 0xe000)
+                        {
+                            error("invalid surrogate pair");
+                        }
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    else if (cp >= 0xdc00 && cp < 0xe000)
+                    {
+                        error("invalid surrogate pair");
+                    }
+                    append_utf8(cp);
+                    break;
+                }
+                default:
+                    error("invalid escape sequence");
+            }
+        }
+        if (p_ == end_)
+        {
+            error("unterminated string");
+        }
+        ++p_;  // Closing quote
+        len = scratch_.size();
+        return scratch_.data();
+    }
+
+    void parse_number()
+    {
+        char const* start = p_;
+        bool is_double = false;
+        if (p_ != end_ && *p_ == '-')
+        {
+            ++p_;
+        }
+        if (p_ == end_ || !isdigit(static_cast<unsigned char>(*p_)))
+        {
+            error("unexpected character");
+        }
+        while (p_ != end_ && isdigit(static_cast<unsigned char>(*p_)))
+        {
+            ++p_;
+        }
+        if (p_ != end_ && *p_ == '.')
+        {
+            is_double = true;
+            ++p_;
+            if (p_ == end_ || !isdigit(static_cast<unsigned char>(*p_)))
+            {
+                error("invalid number");
+            }
+            while (p_ != end_ && isdigit(static_cast<unsigned char>(*p_)))
+            {
+                ++p_;
+            }
+        }
+        if (p_ != end_ && (*p_ == 'e' || *p_ == 'E'))
+        {
+            is_double = true;
+            ++p_;
+            if (p_ != end_ && (*p_ == '+' || *p_ == '-'))
+            {
+                ++p_;
+            }
+            if (p_ == end_ || !isdigit(static_cast<unsigned char>(*p_)))
+            {
+                error("invalid number");
+            }
+            while (p_ != end_ && isdigit(static_cast<unsigned char>(*p_)))
+            {
+                ++p_;
+            }
+        }
+
+        // The input need not be NUL-terminated after the number, so we copy it.
+        size_t const len = p_ - start;
+        char buf[64];
+        if (len >= sizeof(buf))
+        {
+            error("number too long");
+        }
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+
+        if (!is_double)
+        {
+            errno = 0;
+            long long ll = strtoll(buf, nullptr, 10);
+            if (errno == 0)
+            {
+                handler_.int_value(ll);
+                return;
+            }
+            // Out of range for int64, json-glib returns it as a double.
+        }
+        char const dp = locale_decimal_point();
+        if (dp != '.')
+        {
+            if (char* dot = strchr(buf, '.'))
+            {
+                *dot = dp;
+            }
+        }
+        handler_.double_value(strtod(buf, nullptr));
+    }
+
+    char const* const begin_;
+    char const* p_;
+    char const* const end_;
+    JsonSaxHandler& handler_;
+    int depth_;
+    string scratch_;
+};
+
+// Builds a Variant from the parser callbacks. Containers under construction are kept
+// on a stack; completed values are moved into their parent.
+
+class VariantBuilder : public JsonSaxHandler
+{
+public:
+    void null_value() override
+    {
+        add(Variant());
+    }
+
+    void bool_value(bool b) override
+    {
+        add(Variant(b));
+    }
+
+    void int_value(int64_t i) override
+    {
+        // If the value fits into a 32-bit int, return an Int variant, the same as JsonCppNode.
+        if (i < INT32_MIN || i > INT32_MAX)
+        {
+            add(Variant(i));
+        }
+        else
+        {
+            add(Variant(int32_t(i)));
+        }
+    }
+
+    void double_value(double d) override
+    {
+        add(Variant(d));
+    }
+
+    void string_value(char const* s, size_t len) override
+    {
+        add(Variant(string(s, len)));
+    }
+
+    void start_object() override
+    {
+        stack_.emplace_back(Frame{true, VariantMap(), VariantArray(), string()});
+    }
+
+    void key(char const* s, size_t len) override
+    {
+        stack_.back().key.assign(s, len);
+    }
+
+    void end_object() override
+    {
+        Variant v = VariantAccess::from_dict(move(stack_.back().dict));
+        stack_.pop_back();
+        add(move(v));
+    }
+
+    void start_array() override
+    {
+        stack_.emplace_back(Frame{false, VariantMap(), VariantArray(), string()});
+    }
+
+    void end_array() override
+    {
+        Variant v = VariantAccess::from_array(move(stack_.back().array));
+        stack_.pop_back();
+        add(move(v));
+    }
+
+    Variant result()
+    {
+        return move(result_);
+    }
+
+private:
+    struct Frame
+    {
+        bool is_object;
+        VariantMap dict;
+        VariantArray array;
+        string key;
+    };
+
+    void add(Variant&& v)
+    {
+        if (stack_.empty())
+        {
+            result_ = move(v);
+            return;
+        }
+        auto& top = stack_.back();
+        if (top.is_object)
+        {
+            top.dict[top.key] = move(v);  // With duplicate keys, the last one wins.
+        }
+        else
+        {
+            top.array.push_back(move(v));
+        }
+    }
+
+    vector<Frame> stack_;
+    Variant result_;
+};
+
+} // namespace
+
+void write_json(Variant const& v, string& out)
+{
+    write_value(v, out);
+}
+
+void parse_json(string const& json, JsonSaxHandler& handler)
+{
+    Parser(json, handler).parse();
+}
+
+string variant_to_json(Variant const& v)
+{
+    string out;
+    out.reserve(256);
+    write_value(v, out);
+    out += '\n';
+    return out;
+}
+
+Variant json_to_variant(string const& json)
+{
+    VariantBuilder builder;
+    parse_json(json, builder);
+    return builder.result();
+}
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -17,6 +17,7 @@
  */
 
 #include <unity/scopes/internal/MWReply.h>
+#include <unity/scopes/internal/ResultImpl.h>
 
 using namespace std;
 
@@ -38,6 +39,23 @@ MWReply::~MWReply()
 {
 }
 
+void MWReply::push_result(ResultImpl const& result)
+{
+    VariantMap var;
+    var["result"] = result.serialize();
+    push(var);
+}
+
+void MWReply::set_cancellation_token(CancellationToken::SPtr const& token) noexcept
+{
+    cancellation_token_ = token;
+}
+
+CancellationToken::SPtr MWReply::cancellation_token() const noexcept
+{
+    return cancellation_token_;
+}
+
 } // namespace internal
 
 } // namespace scopes
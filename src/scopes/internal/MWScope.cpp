@@ -38,6 +38,71 @@ MWScope::~MWScope()
 {
 }
 
+namespace
+{
+
+template<typename F>
+void call_sync(MWScope::QueryCtrlCallback const& on_done, F f)
+{
+    QueryCtrlProxy ctrl;
+    try
+    {
+        ctrl = f();
+    }
+    catch (...)
+    {
+        on_done(nullptr, current_exception());
+        return;
+    }
+    on_done(ctrl, nullptr);
+}
+
+} // namespace
+
+void MWScope::search_async(CannedQuery const& query,
+                           VariantMap const& hints,
+                           VariantMap const& details,
+                           MWReplyProxy const& reply,
+                           QueryCtrlCallback on_done)
+{
+    call_sync(on_done, [&]{ return search(query, hints, details, reply); });
+}
+
+void MWScope::activate_async(VariantMap const& result,
+                             VariantMap const& hints,
+                             MWReplyProxy const& reply,
+                             QueryCtrlCallback on_done)
+{
+    call_sync(on_done, [&]{ return activate(result, hints, reply); });
+}
+
+void MWScope::perform_action_async(VariantMap const& result,
+                                   VariantMap const& hints,
+                                   string const& widget_id,
+                                   string const& action_id,
+                                   MWReplyProxy const& reply,
+                                   QueryCtrlCallback on_done)
+{
+    call_sync(on_done, [&]{ return perform_action(result, hints, widget_id, action_id, reply); });
+}
+
+void MWScope::preview_async(VariantMap const& result,
+                            VariantMap const& hints,
+                            MWReplyProxy const& reply,
+                            QueryCtrlCallback on_done)
+{
+    call_sync(on_done, [&]{ return preview(result, hints, reply); });
+}
+
+void MWScope::activate_result_action_async(VariantMap const& result,
+                                           VariantMap const& hints,
+                                           string const& action_id,
+                                           MWReplyProxy const& reply,
+                                           QueryCtrlCallback on_done)
+{
+    call_sync(on_done, [&]{ return activate_result_action(result, hints, action_id, reply); });
+}
+
 } // namespace internal
 
 } // namespace scopes
@@ -18,6 +18,7 @@
 
 #include <unity/scopes/internal/MiddlewareFactory.h>
 
+#include <unity/scopes/internal/inproc_middleware/InprocMiddleware.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqMiddleware.h>
 #include <unity/scopes/ScopeExceptions.h>
 
@@ -71,6 +72,11 @@ MiddlewareBase::SPtr MiddlewareFactory::create(string const& server_name,
             abort();
             break;
         }
+        case Kind_Inproc:
+        {
+            mw = make_shared<inproc_middleware::InprocMiddleware>(server_name, runtime_);
+            break;
+        }
         default:
         {
             assert(false);  // LCOV_EXCL_LINE
@@ -93,6 +99,7 @@ MiddlewareBase::SPtr MiddlewareFactory::find(string const& proxy_string) const
 {
     static const string zmq_scheme = "ipc:";
     static const string rest_scheme = "rest:";
+    static const string inproc_scheme = "inproc:";
     string kind;
     if (proxy_string.substr(0, zmq_scheme.size()) == zmq_scheme)
     {
@@ -102,6 +109,10 @@ MiddlewareBase::SPtr MiddlewareFactory::find(string const& proxy_string) const
     {
         kind = "REST";
     }
+    else if (proxy_string.substr(0, inproc_scheme.size()) == inproc_scheme)
+    {
+        kind = "Inproc";
+    }
     else
     {
         throw MiddlewareException("Unknown scheme name for proxy: " + proxy_string);
@@ -136,6 +147,10 @@ MiddlewareFactory::Kind MiddlewareFactory::to_kind(string const& kind)
     {
         k = Kind_REST;
     }
+    else if (kind == "Inproc")
+    {
+        k = Kind_Inproc;
+    }
     else
     {
         throw ConfigException("Invalid middleware kind: " + kind);
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/PreviewCache.h>
+
+#include <unity/UnityExceptions.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+PreviewCache::PreviewCache(size_t max_bytes)
+    : max_bytes_(max_bytes)
+    , size_(0)
+    , hits_(0)
+    , misses_(0)
+    , prefetched_(0)
+    , saved_us_(0)
+{
+    if (max_bytes == 0)
+    {
+        throw InvalidArgumentException("PreviewCache(): max_bytes must be greater than zero");
+    }
+}
+
+string PreviewCache::key(Result const& result, ActionMetadata const& hints)
+{
+    return Variant(result.serialize()).serialize_json() + "\n" + Variant(hints.serialize()).serialize_json();
+}
+
+int64_t PreviewCache::generation(string const& scope)
+{
+    lock_guard<mutex> lock(mutex_);
+    return generations_[scope];
+}
+
+void PreviewCache::invalidate(string const& scope)
+{
+    lock_guard<mutex> lock(mutex_);
+    ++generations_[scope];
+    for (auto it = items_.begin(); it != items_.end(); )
+    {
+        auto next = std::next(it);
+        if (it->second.scope == scope)
+        {
+            erase(it);
+        }
+        it = next;
+    }
+}
+
+PreviewCache::Entry::SCPtr PreviewCache::lookup(string const& scope, string const& key)
+{
+    lock_guard<mutex> lock(mutex_);
+    auto it = items_.find(scope + "\n" + key);
+    if (it == items_.end())
+    {
+        ++misses_;
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+    ++hits_;
+    saved_us_ += chrono::duration_cast<chrono::microseconds>(it->second.entry->latency).count();
+    return it->second.entry;
+}
+
+bool PreviewCache::contains(string const& scope, string const& key)
+{
+    lock_guard<mutex> lock(mutex_);
+    return items_.find(scope + "\n" + key) != items_.end();
+}
+
+void PreviewCache::store(string const& scope,
+                         int64_t generation,
+                         string const& key,
+                         vector<VariantMap> replies,
+                         chrono::steady_clock::duration latency)
+{
+    auto entry = make_shared<Entry>();
+    entry->size = key.size();
+    for (auto const& r : replies)
+    {
+        entry->size += Variant(r).serialize_json().size();
+    }
+    entry->replies = move(replies);
+    entry->latency = latency;
+
+    if (entry->size > max_bytes_)
+    {
+        return;  // Would evict everything else and still not fit.
+    }
+
+    string const full_key = scope + "\n" + key;
+
+    lock_guard<mutex> lock(mutex_);
+    if (generations_[scope] != generation)
+    {
+        return;  // A new search was sent to the scope since the prefetch started.
+    }
+    auto it = items_.find(full_key);
+    if (it != items_.end())
+    {
+        erase(it);
+    }
+    while (size_ + entry->size > max_bytes_)
+    {
+        assert(!lru_.empty());
+        erase(items_.find(lru_.back()));
+    }
+    lru_.push_front(full_key);
+    items_[full_key] = Item{ scope, entry, lru_.begin() };
+    size_ += entry->size;
+    ++prefetched_;
+}
+
+int64_t PreviewCache::hits() const
+{
+    return hits_;
+}
+
+int64_t PreviewCache::misses() const
+{
+    return misses_;
+}
+
+int64_t PreviewCache::prefetched() const
+{
+    return prefetched_;
+}
+
+chrono::milliseconds PreviewCache::saved_latency() const
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::microseconds(saved_us_));
+}
+
+void PreviewCache::erase(map<string, Item>::iterator it)
+{
+    assert(it != items_.end());
+    size_ -= it->second.entry->size;
+    lru_.erase(it->second.lru_pos);
+    items_.erase(it);
+}
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
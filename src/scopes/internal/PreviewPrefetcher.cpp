@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/PreviewPrefetcher.h>
+
+#include <unity/scopes/internal/MiddlewareBase.h>
+#include <unity/scopes/internal/MWScope.h>
+#include <unity/scopes/internal/ReplyObject.h>
+#include <unity/scopes/internal/RuntimeImpl.h>
+#include <unity/scopes/internal/ScopeImpl.h>
+#include <unity/scopes/PreviewListenerBase.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace
+{
+
+// Receives the finished() call for a prefetched preview. The replies themselves
+// are recorded by the PrefetchReplyObject, so the push() methods are never called.
+
+class PrefetchListener : public PreviewListenerBase
+{
+public:
+    PrefetchListener(PreviewPrefetcher::SPtr const& prefetcher, string const& key)
+        : prefetcher_(prefetcher)
+        , key_(key)
+        , start_time_(chrono::steady_clock::now())
+    {
+    }
+
+    void push(ColumnLayoutList const&) override
+    {
+    }
+
+    void push(PreviewWidgetList const&) override
+    {
+    }
+
+    void push(string const&, Variant const&) override
+    {
+    }
+
+    void record(VariantMap const& data)
+    {
+        lock_guard<mutex> lock(mutex_);
+        replies_.push_back(data);
+    }
+
+    void finished(CompletionDetails const& details) override
+    {
+        vector<VariantMap> replies;
+        {
+            lock_guard<mutex> lock(mutex_);
+            replies.swap(replies_);
+        }
+        prefetcher_->preview_finished(key_,
+                                      details.status() == CompletionDetails::OK,
+                                      move(replies),
+                                      chrono::steady_clock::now() - start_time_);
+    }
+
+private:
+    PreviewPrefetcher::SPtr const prefetcher_;
+    string const key_;
+    chrono::steady_clock::time_point const start_time_;
+    mutex mutex_;
+    vector<VariantMap> replies_;
+};
+
+// Records the replies as they arrive, without unmarshaling them. They are unmarshaled
+// by the PreviewReplyObject of the real request when they are replayed from the cache.
+
+class PrefetchReplyObject : public ReplyObject
+{
+public:
+    PrefetchReplyObject(shared_ptr<PrefetchListener> const& listener,
+                        RuntimeImpl const* runtime,
+                        string const& scope_proxy,
+                        bool dont_reap)
+        : ReplyObject(static_pointer_cast<ListenerBase>(listener), runtime, scope_proxy, dont_reap)
+        , listener_(listener)
+    {
+    }
+
+    bool process_data(VariantMap const& data) override
+    {
+        listener_->record(data);
+        return false;
+    }
+
+private:
+    shared_ptr<PrefetchListener> const listener_;
+};
+
+} // namespace
+
+PreviewPrefetcher::PreviewPrefetcher(shared_ptr<ScopeImpl> const& scope,
+                                     PreviewCache::SPtr const& cache,
+                                     int max_results,
+                                     ActionMetadata const& hints)
+    : scope_(scope)
+    , cache_(cache)
+    , max_results_(max_results)
+    , hints_(hints)
+    , scope_proxy_(scope->to_string())
+    , generation_(cache->generation(scope_proxy_))
+    , num_added_(0)
+    , started_(false)
+{
+    assert(max_results > 0);
+}
+
+void PreviewPrefetcher::add(Result const& result)
+{
+    lock_guard<mutex> lock(mutex_);
+    if (started_ || num_added_ >= max_results_)
+    {
+        return;
+    }
+    ++num_added_;
+    results_.push_back(result);
+}
+
+void PreviewPrefetcher::start()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (started_)
+        {
+            return;
+        }
+        started_ = true;
+    }
+    prefetch_next();
+}
+
+void PreviewPrefetcher::preview_finished(string const& key,
+                                         bool ok,
+                                         vector<VariantMap> replies,
+                                         chrono::steady_clock::duration latency)
+{
+    if (!ok)
+    {
+        return;  // If the scope cannot produce one preview, it is unlikely to produce the others.
+    }
+    cache_->store(scope_proxy_, generation_, key, move(replies), latency);
+    prefetch_next();
+}
+
+void PreviewPrefetcher::prefetch_next()
+{
+    try
+    {
+        for (;;)
+        {
+            unique_ptr<Result> result;
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (results_.empty())
+                {
+                    return;
+                }
+                result.reset(new Result(results_.front()));
+                results_.pop_front();
+            }
+            if (cache_->generation(scope_proxy_) != generation_)
+            {
+                return;  // A new search was sent, so these results are no longer of interest.
+            }
+            string const key = PreviewCache::key(*result, hints_);
+            if (cache_->contains(scope_proxy_, key))
+            {
+                continue;
+            }
+            auto listener = make_shared<PrefetchListener>(shared_from_this(), key);
+            auto runtime = scope_->runtime();
+            ReplyObject::SPtr ro = make_shared<PrefetchReplyObject>(listener,
+                                                                   runtime,
+                                                                   scope_proxy_,
+                                                                   false);
+            scope_->send_preview(*result, hints_, ro);
+            return;
+        }
+    }
+    catch (std::exception const& e)
+    {
+        // Most likely, the run time is shutting down.
+        scope_->runtime()->logger()(LoggerSeverity::Info) << "PreviewPrefetcher: " << e.what();
+    }
+}
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
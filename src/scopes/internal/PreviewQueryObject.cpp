@@ -69,6 +69,7 @@ void PreviewQueryObject::run(MWReplyProxy const& reply, InvokeInfo const& info)
 
     assert(self_);
 
+    reply->set_cancellation_token(cancellation_token_);
     auto reply_proxy = make_shared<PreviewReplyImpl>(reply, self_);
     assert(reply_proxy);
     reply_proxy_ = reply_proxy;
@@ -25,6 +25,7 @@
 #include <unity/scopes/internal/QueryBaseImpl.h>
 #include <unity/scopes/internal/QueryCtrlObject.h>
 #include <unity/scopes/internal/RuntimeImpl.h>
+#include <unity/scopes/internal/SearchQueryBaseImpl.h>
 #include <unity/scopes/internal/SearchReplyImpl.h>
 #include <unity/scopes/PreviewQueryBase.h>
 #include <unity/scopes/QueryBase.h>
@@ -60,6 +61,7 @@ QueryObject::QueryObject(std::shared_ptr<QueryBase> const& query_base,
     , ctrl_(ctrl)
     , pushable_(true)
     , cardinality_(cardinality)
+    , cancellation_token_(make_shared<CancellationToken>())
 {
 }
 
@@ -98,6 +100,8 @@ void QueryObject::run(MWReplyProxy const& reply, InvokeInfo const& info) noexcep
     auto search_query = dynamic_pointer_cast<SearchQueryBase>(query_base_);
     assert(search_query);
 
+    reply->set_cancellation_token(cancellation_token_);
+
     // Create the reply proxy to pass to query_base_ and keep a weak_ptr, which we will need
     // if cancel() is called later.
     assert(self_);
@@ -105,8 +109,13 @@ void QueryObject::run(MWReplyProxy const& reply, InvokeInfo const& info) noexcep
                                                     self_,
                                                     cardinality_,
                                                     search_query->query().query_string(),
-                                                    search_query->department_id());
+                                                    search_query->department_id(),
+                                                    search_query->fwd()->known_renderers());
     assert(reply_proxy);
+    if (!cache_directory_.empty())
+    {
+        reply_proxy->set_cache_directory(cache_directory_);
+    }
     reply_proxy_ = reply_proxy;
 
     // The reply proxy now holds our reference count high, so
@@ -114,16 +123,46 @@ void QueryObject::run(MWReplyProxy const& reply, InvokeInfo const& info) noexcep
     self_ = nullptr;
     disconnect();
 
+    SearchReplyProxy refresh_reply;
     try
     {
         lock.unlock();
 
+        // For scopes with a results TTL, we answer surfacing queries from the cache if we can.
+        // If the cached results are stale, we still send them, and then run the query
+        // to refresh the cache, without sending anything more to the client.
+        if (surfacing_cache_)
+        {
+            bool stale = false;
+            auto entry = surfacing_cache_->lookup(surfacing_cache_key_, stale);
+            if (!entry)
+            {
+                reply_proxy->set_surfacing_cache(surfacing_cache_, surfacing_cache_key_);
+            }
+            else
+            {
+                reply_proxy->push_surfacing_results(*entry);
+                if (!stale || !surfacing_cache_->begin_refresh(surfacing_cache_key_))
+                {
+                    return;  // Fresh, or someone else is refreshing already.
+                }
+                refresh_reply = make_shared<SurfacingRefreshReply>(surfacing_cache_, surfacing_cache_key_, cardinality_);
+            }
+        }
+
         // Synchronous call into scope implementation.
         // On return, replies for the query may still be outstanding.
-        search_query->run(reply_proxy);
+        search_query->run(refresh_reply ? refresh_reply : reply_proxy);
     }
     catch (std::exception const& e)
     {
+        if (refresh_reply)
+        {
+            // The client is done already, so we don't report the error.
+            info.mw->runtime()->logger()() << "QueryBase::run() (cache refresh): " << e.what();
+            refresh_reply->error(current_exception());
+            return;
+        }
         {
             lock_guard<mutex> lock(mutex_);
             pushable_ = false;
@@ -133,6 +172,12 @@ void QueryObject::run(MWReplyProxy const& reply, InvokeInfo const& info) noexcep
     }
     catch (...)
     {
+        if (refresh_reply)
+        {
+            info.mw->runtime()->logger()() << "QueryBase::run() (cache refresh): unknown exception";
+            refresh_reply->error(current_exception());
+            return;
+        }
         {
             lock_guard<mutex> lock(mutex_);
             pushable_ = false;
@@ -142,6 +187,25 @@ void QueryObject::run(MWReplyProxy const& reply, InvokeInfo const& info) noexcep
     }
 }
 
+void QueryObject::set_surfacing_cache(SurfacingCache::SPtr const& cache, string const& key)
+{
+    lock_guard<mutex> lock(mutex_);
+    surfacing_cache_ = cache;
+    surfacing_cache_key_ = key;
+}
+
+void QueryObject::set_cache_directory(string const& dir)
+{
+    lock_guard<mutex> lock(mutex_);
+    cache_directory_ = dir;
+}
+
+void QueryObject::set_cancellation_stats(CancellationStats::SPtr const& stats)
+{
+    lock_guard<mutex> lock(mutex_);
+    cancellation_token_ = make_shared<CancellationToken>(stats);
+}
+
 void QueryObject::cancel(InvokeInfo const& info)
 {
     {
@@ -152,6 +216,9 @@ void QueryObject::cancel(InvokeInfo const& info)
             return;
         }
         pushable_ = false;
+
+        // Results that are still waiting to be sent are dropped from here on.
+        cancellation_token_->cancel();
     }  // Release lock
 
     try
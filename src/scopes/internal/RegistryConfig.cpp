@@ -22,6 +22,9 @@
 #include <unity/scopes/ScopeExceptions.h>
 #include <unity/UnityExceptions.h>
 
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
 #include <stdlib.h>
 
 using namespace std;
@@ -45,6 +48,7 @@ namespace
     const string click_installdir_key = "Click.InstallDir";
     const string scoperunner_path_key = "Scoperunner.Path";
     const string process_timeout_key = "Process.Timeout";
+    const string shared_host_scopes_key = "SharedHost.Scopes";
 }
 
 RegistryConfig::RegistryConfig(string const& identity, string const& configfile) :
@@ -75,6 +79,10 @@ RegistryConfig::RegistryConfig(string const& identity, string const& configfile)
     {
         throw_ex("Illegal value (" + to_string(process_timeout_) + ") for " + process_timeout_key + ": value must be 10-60000 ms");
     }
+    string shared_host_scopes = get_optional_string(registry_config_group, shared_host_scopes_key);
+    boost::split(shared_host_scopes_, shared_host_scopes, boost::is_any_of(";, \t"), boost::token_compress_on);
+    shared_host_scopes_.erase(remove(shared_host_scopes_.begin(), shared_host_scopes_.end(), string()),
+                              shared_host_scopes_.end());
 
     KnownEntries const known_entries = {
                                           {  registry_config_group,
@@ -85,7 +93,8 @@ RegistryConfig::RegistryConfig(string const& identity, string const& configfile)
                                                 oem_installdir_key,
                                                 click_installdir_key,
                                                 scoperunner_path_key,
-                                                process_timeout_key
+                                                process_timeout_key,
+                                                shared_host_scopes_key
                                              }
                                           }
                                        };
@@ -136,6 +145,11 @@ int RegistryConfig::process_timeout() const
     return process_timeout_;
 }
 
+vector<string> RegistryConfig::shared_host_scopes() const
+{
+    return shared_host_scopes_;
+}
+
 } // namespace internal
 
 } // namespace scopes
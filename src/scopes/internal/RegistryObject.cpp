@@ -31,6 +31,7 @@
 #include <core/posix/exec.h>
 
 #include <fstream>
+#include <set>
 #include <wordexp.h>
 
 using namespace std;
@@ -249,27 +250,89 @@ bool RegistryObject::add_local_scope(std::string const& scope_id, ScopeMetadata
         throw unity::InvalidArgumentException("RegistryObject::add_local_scope(): Cannot create a scope with '/' in its id");
     }
 
-    lock_guard<decltype(mutex_)> lock(mutex_);
+    bool return_value;
+    shared_ptr<ScopeProcess> stale_host;
+    {
+        lock_guard<decltype(mutex_)> lock(mutex_);
+
+        return_value = add_local_scope_unlocked(scope_id, metadata, exec_data, stale_host);
+
+        if (publisher_)
+        {
+            // Send a blank message to subscribers to inform them that the registry has been updated
+            publisher_->send_message("");
+        }
+    }
 
+    // Kill process after unlocking, so we can handle on_process_death
+    if (stale_host)
+    {
+        try
+        {
+            stale_host->kill();
+        }
+        catch (std::exception const& e)
+        {
+            logger_() << "RegistryObject::add_local_scope(): " << e.what();
+        }
+    }
+    return return_value;
+}
+
+bool RegistryObject::add_local_scope_unlocked(std::string const& scope_id, ScopeMetadata const& metadata,
+                                              ScopeExecData const& exec_data, shared_ptr<ScopeProcess>& stale_host)
+{
     bool return_value = true;
+
     if (scopes_.find(scope_id) != scopes_.end())
     {
         // If scope is known already, remove it's details and kill it if it is running.
+        auto proc_it = scope_processes_.find(scope_id);
+        if (proc_it != scope_processes_.end() && proc_it->second->is_host())
+        {
+            // The scope shares its process with other scopes, so we cannot simply drop the process.
+            proc_it->second->remove_hosted_scope(scope_id);
+            stale_host = proc_it->second;
+        }
         scopes_.erase(scope_id);
         scope_processes_.erase(scope_id);
         remove_desktop_file(scope_id);
         return_value = false;
     }
     scopes_.insert(make_pair(scope_id, metadata));
-    scope_processes_.insert(make_pair(scope_id, make_shared<ScopeProcess>(exec_data, publisher_, logger_)));
 
-    if (publisher_)
+    shared_ptr<ScopeProcess> proc;
+    if (!exec_data.host_id.empty())
     {
-        // Send a blank message to subscribers to inform them that the registry has been updated
-        publisher_->send_message("");
+        auto host_it = host_processes_.find(exec_data.host_id);
+        if (host_it != host_processes_.end())
+        {
+            proc = host_it->second;
+            if (proc->state() != ScopeProcess::Stopped)
+            {
+                // The running host doesn't know about this scope yet; it is restarted
+                // with the complete list of scopes the next time one of them is located.
+                stale_host = proc;
+            }
+        }
+        else
+        {
+            ScopeExecData host_exec_data = exec_data;
+            host_exec_data.scope_id = exec_data.host_id;
+            proc = make_shared<ScopeProcess>(host_exec_data, publisher_, logger_);
+            host_processes_.insert(make_pair(exec_data.host_id, proc));
+        }
+        proc->add_hosted_scope(scope_id, exec_data.scope_config);
+    }
+    else
+    {
+        proc = make_shared<ScopeProcess>(exec_data, publisher_, logger_);
     }
+    scope_processes_.insert(make_pair(scope_id, proc));
+    proc->prepare();
 
     create_desktop_file(metadata);
+
     return return_value;
 }
 
@@ -285,12 +348,7 @@ bool RegistryObject::remove_local_scope(std::string const& scope_id)
     shared_ptr<ScopeProcess> proc;
     {
         unique_lock<decltype(mutex_)> lock(mutex_);
-
-        auto proc_it = scope_processes_.find(scope_id);
-        if (proc_it != scope_processes_.end())
-        {
-            proc = proc_it->second;
-        }
+        proc = detach_process_unlocked(scope_id);
     }
 
     // Kill process after unlocking, so we can handle on_process_death
@@ -333,6 +391,117 @@ bool RegistryObject::remove_local_scope(std::string const& scope_id)
     return erased;
 }
 
+// Returns the process of the scope (or nullptr if there is none), after removing the scope from its
+// host process. The process stays in scope_processes_, so on_process_death() can find it while it is killed.
+
+shared_ptr<RegistryObject::ScopeProcess> RegistryObject::detach_process_unlocked(std::string const& scope_id)
+{
+    auto proc_it = scope_processes_.find(scope_id);
+    if (proc_it == scope_processes_.end())
+    {
+        return nullptr;
+    }
+    auto proc = proc_it->second;
+    if (proc->is_host() && proc->remove_hosted_scope(scope_id) == 0)
+    {
+        for (auto it = host_processes_.begin(); it != host_processes_.end(); ++it)
+        {
+            if (it->second == proc)
+            {
+                host_processes_.erase(it);
+                break;
+            }
+        }
+    }
+    return proc;
+}
+
+void RegistryObject::apply_changes(std::vector<LocalScope> const& added, std::vector<std::string> const& removed)
+{
+    set<string> added_ids;
+    for (auto const& scope : added)
+    {
+        if (scope.scope_id.empty() || scope.scope_id.find('/') != std::string::npos)
+        {
+            throw unity::InvalidArgumentException("RegistryObject::apply_changes(): invalid scope id: \""
+                                                  + scope.scope_id + "\"");
+        }
+        added_ids.insert(scope.scope_id);
+    }
+
+    vector<pair<string, shared_ptr<ScopeProcess>>> removed_procs;
+    vector<shared_ptr<ScopeProcess>> stale_hosts;
+    {
+        lock_guard<decltype(mutex_)> lock(mutex_);
+
+        bool changed = false;
+        for (auto const& scope_id : removed)
+        {
+            if (scope_id.empty() || added_ids.find(scope_id) != added_ids.end())
+            {
+                continue;
+            }
+            auto proc = detach_process_unlocked(scope_id);
+            if (proc)
+            {
+                removed_procs.push_back(make_pair(scope_id, proc));
+            }
+            if (scopes_.erase(scope_id) == 1)
+            {
+                remove_desktop_file(scope_id);
+                changed = true;
+            }
+        }
+        for (auto const& scope : added)
+        {
+            shared_ptr<ScopeProcess> stale_host;
+            add_local_scope_unlocked(scope.scope_id, scope.metadata, scope.exec_data, stale_host);
+            if (stale_host)
+            {
+                stale_hosts.push_back(stale_host);
+            }
+            changed = true;
+        }
+
+        if (publisher_ && changed)
+        {
+            // Send a single blank message for the whole batch to inform subscribers
+            // that the registry has been updated
+            publisher_->send_message("");
+        }
+    }
+
+    // Kill processes after unlocking, so we can handle on_process_death
+    for (auto const& p : removed_procs)
+    {
+        stale_hosts.push_back(p.second);
+    }
+    for (auto const& proc : stale_hosts)
+    {
+        try
+        {
+            proc->kill();
+        }
+        catch (std::exception const& e)
+        {
+            logger_() << "RegistryObject::apply_changes(): " << e.what();
+        }
+    }
+
+    if (!removed_procs.empty())
+    {
+        lock_guard<decltype(mutex_)> lock(mutex_);
+        for (auto const& p : removed_procs)
+        {
+            auto it = scope_processes_.find(p.first);
+            if (it != scope_processes_.end() && it->second == p.second)
+            {
+                scope_processes_.erase(it);
+            }
+        }
+    }
+}
+
 void RegistryObject::set_remote_registry(MWRegistryProxy const& remote_registry)
 {
     lock_guard<decltype(mutex_)> lock(mutex_);
@@ -533,58 +702,26 @@ void RegistryObject::ScopeProcess::exec(
     // 2. exec the scope.
     update_state_unlocked(Starting);
 
-    std::string program;
-    std::vector<std::string> argv;
-
-    // Check if this scope has specified a custom executable
-    auto custom_exec_args = expand_custom_exec();
-    if (!custom_exec_args.empty())
-    {
-        program = custom_exec_args[0];
-        for (size_t i = 1; i < custom_exec_args.size(); ++i)
-        {
-            argv.push_back(custom_exec_args[i]);
-        }
-    }
-    else
+    if (!command_)
     {
-        // No custom_exec was provided, use the default scoperunner
-        program = exec_data_.scoperunner_path;
-        argv.insert(argv.end(), {exec_data_.runtime_config, exec_data_.scope_config});
-    }
-
-    {
-        // Copy current env vars into env.
-        std::map<std::string, std::string> env;
-        core::posix::this_process::env::for_each([&env](const std::string& key, const std::string& value)
-        {
-            env.insert(std::make_pair(key, value));
-        });
-
-        // Make sure we set LD_LIBRARY_PATH to include <lib_dir> and <lib_dir>/lib
-        // before exec'ing the scope.
-        auto scope_config_path = boost::filesystem::canonical(exec_data_.scope_config);
-        string lib_dir = scope_config_path.parent_path().native();
-        string scope_ld_lib_path = lib_dir + ":" + lib_dir + "/lib";
-        scope_ld_lib_path.append(":" + lib_dir + "/" + DEB_HOST_MULTIARCH + "/lib");
-        string ld_lib_path = core::posix::this_process::env::get("LD_LIBRARY_PATH", "");
-        if (!boost::algorithm::starts_with(ld_lib_path, lib_dir))
+        try
         {
-            scope_ld_lib_path = scope_ld_lib_path + (ld_lib_path.empty() ? "" : (":" + ld_lib_path));
+            command_ = make_command_unlocked();
         }
-        env["LD_LIBRARY_PATH"] = scope_ld_lib_path;  // Overwrite any LD_LIBRARY_PATH entry that may already be there.
-
-        process_ = executor->exec(program, argv, env,
-                                  core::posix::StandardStream::stdin,
-                                  exec_data_.confinement_profile);
-        if (process_.pid() <= 0)
+        catch (std::exception const&)
         {
             clear_handle_unlocked();
-            throw unity::ResourceException("RegistryObject::ScopeProcess::exec(): Failed to exec scope via command: \""
-                                           + exec_data_.scoperunner_path + " " + exec_data_.runtime_config + " "
-                                           + exec_data_.scope_config + "\"");
+            throw;
         }
     }
+    process_ = executor->spawn(*command_, core::posix::StandardStream::stdin);
+    if (process_.pid() <= 0)
+    {
+        clear_handle_unlocked();
+        throw unity::ResourceException("RegistryObject::ScopeProcess::exec(): Failed to exec scope via command: \""
+                                       + command_->program() + " "
+                                       + boost::algorithm::join(command_->args(), " ") + "\"");
+    }
 
     // 3. wait for scope to be "running".
     //  3.1. when ready, return.
@@ -633,6 +770,41 @@ bool RegistryObject::ScopeProcess::on_process_death(pid_t pid)
     return false;
 }
 
+bool RegistryObject::ScopeProcess::is_host() const noexcept
+{
+    return !exec_data_.host_id.empty();
+}
+
+void RegistryObject::ScopeProcess::add_hosted_scope(std::string const& scope_id, std::string const& scope_config)
+{
+    assert(is_host());
+    std::lock_guard<std::mutex> lock(process_mutex_);
+    hosted_scopes_[scope_id] = scope_config;
+    command_.reset();
+}
+
+size_t RegistryObject::ScopeProcess::remove_hosted_scope(std::string const& scope_id)
+{
+    std::lock_guard<std::mutex> lock(process_mutex_);
+    hosted_scopes_.erase(scope_id);
+    command_.reset();
+    return hosted_scopes_.size();
+}
+
+std::vector<std::string> RegistryObject::ScopeProcess::scope_ids_unlocked() const
+{
+    if (!is_host())
+    {
+        return { exec_data_.scope_id };
+    }
+    std::vector<std::string> ids;
+    for (auto const& scope : hosted_scopes_)
+    {
+        ids.push_back(scope.first);
+    }
+    return ids;
+}
+
 void RegistryObject::ScopeProcess::clear_handle_unlocked()
 {
     process_ = core::posix::ChildProcess::invalid();
@@ -651,7 +823,10 @@ void RegistryObject::ScopeProcess::update_state_unlocked(ProcessState new_state)
         if (reg_publisher)
         {
             // Send a "started" message to subscribers to inform them that this scope (topic) has started
-            reg_publisher->send_message("started", exec_data_.scope_id);
+            for (auto const& id : scope_ids_unlocked())
+            {
+                reg_publisher->send_message("started", id);
+            }
         }
 
         if (state_ != Starting)
@@ -667,7 +842,10 @@ void RegistryObject::ScopeProcess::update_state_unlocked(ProcessState new_state)
         if (reg_publisher)
         {
             // Send a "stopped" message to subscribers to inform them that this scope (topic) has stopped
-            reg_publisher->send_message("stopped", exec_data_.scope_id);
+            for (auto const& id : scope_ids_unlocked())
+            {
+                reg_publisher->send_message("stopped", id);
+            }
         }
 
         if (state_ != Stopping)
@@ -681,7 +859,10 @@ void RegistryObject::ScopeProcess::update_state_unlocked(ProcessState new_state)
         if (reg_publisher)
         {
             // Send a "stopped" message to subscribers to inform them that this scope (topic) has stopped
-            reg_publisher->send_message("stopped", exec_data_.scope_id);
+            for (auto const& id : scope_ids_unlocked())
+            {
+                reg_publisher->send_message("stopped", id);
+            }
         }
 
         logger_() << "RegistryObject::ScopeProcess: Manually started process for scope: \""
@@ -747,6 +928,95 @@ void RegistryObject::ScopeProcess::kill(std::unique_lock<std::mutex>& lock)
     }
 }
 
+void RegistryObject::ScopeProcess::prepare()
+{
+    std::lock_guard<std::mutex> lock(process_mutex_);
+    if (command_)
+    {
+        return;
+    }
+    try
+    {
+        command_ = make_command_unlocked();
+    }
+    catch (std::exception const&)
+    {
+        // Not an error yet: exec() tries again and reports the problem if the scope is located.
+    }
+}
+
+Executor::Command::SPtr RegistryObject::ScopeProcess::make_command_unlocked()
+{
+    std::string program;
+    std::vector<std::string> argv;
+
+    std::vector<std::string> scope_configs;
+    if (is_host())
+    {
+        for (auto const& scope : hosted_scopes_)
+        {
+            scope_configs.push_back(scope.second);
+        }
+    }
+    else
+    {
+        scope_configs.push_back(exec_data_.scope_config);
+    }
+
+    // Check if this scope has specified a custom executable
+    auto custom_exec_args = expand_custom_exec();
+    if (!custom_exec_args.empty())
+    {
+        program = custom_exec_args[0];
+        for (size_t i = 1; i < custom_exec_args.size(); ++i)
+        {
+            argv.push_back(custom_exec_args[i]);
+        }
+    }
+    else
+    {
+        // No custom_exec was provided, use the default scoperunner
+        program = exec_data_.scoperunner_path;
+        argv.push_back(exec_data_.runtime_config);
+        argv.insert(argv.end(), scope_configs.begin(), scope_configs.end());
+    }
+
+    // Copy current env vars into env.
+    std::map<std::string, std::string> env;
+    core::posix::this_process::env::for_each([&env](const std::string& key, const std::string& value)
+    {
+        env.insert(std::make_pair(key, value));
+    });
+
+    // Make sure we set LD_LIBRARY_PATH to include <lib_dir> and <lib_dir>/lib
+    // for each scope before exec'ing the scope(s).
+    string first_lib_dir;
+    string scope_ld_lib_path;
+    for (auto const& scope_config : scope_configs)
+    {
+        auto scope_config_path = boost::filesystem::canonical(scope_config);
+        string lib_dir = scope_config_path.parent_path().native();
+        if (first_lib_dir.empty())
+        {
+            first_lib_dir = lib_dir;
+        }
+        else
+        {
+            scope_ld_lib_path.append(":");
+        }
+        scope_ld_lib_path.append(lib_dir + ":" + lib_dir + "/lib");
+        scope_ld_lib_path.append(":" + lib_dir + "/" + DEB_HOST_MULTIARCH + "/lib");
+    }
+    string ld_lib_path = core::posix::this_process::env::get("LD_LIBRARY_PATH", "");
+    if (!boost::algorithm::starts_with(ld_lib_path, first_lib_dir))
+    {
+        scope_ld_lib_path = scope_ld_lib_path + (ld_lib_path.empty() ? "" : (":" + ld_lib_path));
+    }
+    env["LD_LIBRARY_PATH"] = scope_ld_lib_path;  // Overwrite any LD_LIBRARY_PATH entry that may already be there.
+
+    return make_shared<Executor::Command>(program, argv, env, exec_data_.confinement_profile);
+}
+
 std::vector<std::string> RegistryObject::ScopeProcess::expand_custom_exec()
 {
     // Check first that custom_exec has been set
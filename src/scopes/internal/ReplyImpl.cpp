@@ -21,6 +21,7 @@
 #include <unity/scopes/internal/MiddlewareBase.h>
 #include <unity/scopes/internal/MWReply.h>
 #include <unity/scopes/internal/QueryObjectBase.h>
+#include <unity/scopes/internal/ResultImpl.h>
 #include <unity/scopes/internal/RuntimeImpl.h>
 #include <unity/scopes/Reply.h>
 #include <unity/UnityExceptions.h>
@@ -57,12 +58,39 @@ ReplyImpl::~ReplyImpl()
     }
 }
 
+bool ReplyImpl::pushable()
+{
+    if (finished_)
+    {
+        return false;
+    }
+    auto qo = dynamic_pointer_cast<QueryObjectBase>(qo_);
+    assert(qo);
+    return qo->pushable(InvokeInfo{ fwd()->identity(), fwd()->mw_base() });
+}
+
 bool ReplyImpl::push(VariantMap const& variant_map)
+{
+    return push_([this, &variant_map] { fwd()->push(variant_map); });
+}
+
+bool ReplyImpl::push_result(ResultImpl const& result)
+{
+    result.check_serializable();  // An invalid result is the caller's error, not a failed push.
+    return push_([this, &result] { fwd()->push_result(result); });
+}
+
+bool ReplyImpl::push_(function<void()> const& send)
 {
     auto qo = dynamic_pointer_cast<QueryObjectBase>(qo_);
     assert(qo);
     if (!qo->pushable(InvokeInfo{ fwd()->identity(), fwd()->mw_base() }))
     {
+        auto token = fwd()->cancellation_token();
+        if (token && token->cancelled())
+        {
+            token->dropped_result(false);
+        }
         return false; // Query was cancelled or had an error.
     }
 
@@ -73,7 +101,7 @@ bool ReplyImpl::push(VariantMap const& variant_map)
 
     try
     {
-        fwd()->push(variant_map);
+        send();
     }
     catch (std::exception const&)
     {
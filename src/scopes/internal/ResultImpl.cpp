@@ -18,8 +18,14 @@
 
 #include <unity/scopes/internal/ResultImpl.h>
 #include <unity/UnityExceptions.h>
+#include <unity/scopes/internal/JsonCodec.h>
 #include <unity/scopes/Result.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <cassert>
 
 namespace unity
@@ -31,14 +37,99 @@ namespace scopes
 namespace internal
 {
 
+namespace
+{
+
+// Attribute names are interned in a process-wide table, so each name is stored once
+// and attributes can be compared by address. Scopes can make up attribute names on the fly,
+// so we stop interning once the table is full and store further names with each result.
+// The table is never destroyed, so results can be destroyed during static destruction.
+
+size_t const max_interned_keys = 4096;
+
+struct KeyTable
+{
+    std::mutex m;
+    std::unordered_set<std::string> keys;  // Node-based, so the addresses of the keys are stable
+};
+
+KeyTable& key_table()
+{
+    static KeyTable* t = new KeyTable;
+    return *t;
+}
+
+// Returns the interned key, or nullptr if key is not interned. If add is true and
+// the table is not full, key is added to the table.
+// Every thread caches the keys it has looked up, so it rarely needs the lock.
+
+std::string const* intern(std::string const& key, bool add)
+{
+    thread_local std::unordered_map<std::string, std::string const*> cache;
+
+    auto cache_it = cache.find(key);
+    if (cache_it != cache.end())
+    {
+        return cache_it->second;
+    }
+
+    std::string const* k = nullptr;
+    {
+        auto& t = key_table();
+        std::lock_guard<std::mutex> lock(t.m);
+        auto it = t.keys.find(key);
+        if (it != t.keys.end())
+        {
+            k = &*it;
+        }
+        else if (add && t.keys.size() < max_interned_keys)
+        {
+            k = &*t.keys.insert(key).first;
+        }
+    }
+    if (k)
+    {
+        cache.emplace(key, k);
+    }
+    return k;
+}
+
+std::string const* uri_key()
+{
+    static std::string const* const k = intern("uri", true);
+    return k;
+}
+
+std::string const* title_key()
+{
+    static std::string const* const k = intern("title", true);
+    return k;
+}
+
+std::string const* art_key()
+{
+    static std::string const* const k = intern("art", true);
+    return k;
+}
+
+std::string const* dnd_uri_key()
+{
+    static std::string const* const k = intern("dnd_uri", true);
+    return k;
+}
+
+} // namespace
+
 ResultImpl::ResultImpl()
-    : flags_(Flags::ActivationNotHandled),
+    : attrs_(std::make_shared<Attributes>()),
+      flags_(Flags::ActivationNotHandled),
       runtime_(nullptr)
 {
 }
 
 ResultImpl::ResultImpl(VariantMap const& variant_map)
-    : flags_(Flags::ActivationNotHandled),
+    : attrs_(std::make_shared<Attributes>()),
+      flags_(Flags::ActivationNotHandled),
       runtime_(nullptr)
 {
     deserialize(variant_map);
@@ -46,13 +137,15 @@ ResultImpl::ResultImpl(VariantMap const& variant_map)
 
 ResultImpl::ResultImpl(ResultImpl const& other)
     : attrs_(other.attrs_),
+      stored_result_(other.stored_result_),
       origin_(other.origin_),
       flags_(other.flags_),
       runtime_(other.runtime_)
 {
-    if (other.stored_result_)
+    if (!attrs_->shareable)
     {
-        stored_result_ = std::make_shared<VariantMap>(*other.stored_result_);
+        attrs_ = std::make_shared<Attributes>(*other.attrs_);
+        attrs_->shareable = true;
     }
 }
 
@@ -60,14 +153,19 @@ ResultImpl& ResultImpl::operator=(ResultImpl const& other)
 {
     if (this != &other)
     {
-        attrs_ = other.attrs_;
+        if (other.attrs_->shareable)
+        {
+            attrs_ = other.attrs_;
+        }
+        else
+        {
+            attrs_ = std::make_shared<Attributes>(*other.attrs_);
+            attrs_->shareable = true;
+        }
         flags_ = other.flags_;
         origin_ = other.origin_;
         runtime_ = other.runtime_;
-        if (other.stored_result_)
-        {
-            stored_result_ = std::make_shared<VariantMap>(*other.stored_result_);
-        }
+        stored_result_ = other.stored_result_;
     }
     return *this;
 }
@@ -82,7 +180,7 @@ void ResultImpl::store(Result const& other, bool intercept_activation)
     {
         set_intercept_activation();
     }
-    stored_result_.reset(new VariantMap(other.serialize()));
+    stored_result_ = std::make_shared<VariantMap const>(other.serialize());
 }
 
 bool ResultImpl::has_stored_result() const
@@ -120,22 +218,22 @@ void ResultImpl::set_uri(std::string const& uri)
     {
         throw InvalidArgumentException("Result::set_uri(): Invalid empty uri string");
     }
-    attrs_["uri"] = uri;
+    attr_value(*uri_key()) = uri;
 }
 
 void ResultImpl::set_title(std::string const& title)
 {
-    attrs_["title"] = title;
+    attr_value(*title_key()) = title;
 }
 
 void ResultImpl::set_art(std::string const& art)
 {
-    attrs_["art"] = art;
+    attr_value(*art_key()) = art;
 }
 
 void ResultImpl::set_dnd_uri(std::string const& dnd_uri)
 {
-    attrs_["dnd_uri"] = dnd_uri;
+    attr_value(*dnd_uri_key()) = dnd_uri;
 }
 
 void ResultImpl::set_intercept_activation()
@@ -286,11 +384,9 @@ int ResultImpl::flags() const
 
 Variant& ResultImpl::operator[](std::string const& key)
 {
-    if (key.empty())
-    {
-        throw InvalidArgumentException("Result::operator[]: Invalid empty key string");
-    }
-    return attrs_[key];
+    Variant& v = attr_value(key);
+    attrs_->shareable = false;  // The caller can write via the reference at any time.
+    return v;
 }
 
 Variant const& ResultImpl::operator[](std::string const& key) const
@@ -307,42 +403,22 @@ Variant const& ResultImpl::operator[](std::string const& key) const
 
 std::string ResultImpl::uri() const noexcept
 {
-    auto const it = attrs_.find("uri");
-    if (it != attrs_.end() && it->second.which() == Variant::Type::String)
-    {
-        return it->second.get_string();
-    }
-    return "";
+    return string_attr(uri_key());
 }
 
 std::string ResultImpl::title() const noexcept
 {
-    auto const it = attrs_.find("title");
-    if (it != attrs_.end() && it->second.which() == Variant::Type::String)
-    {
-        return it->second.get_string();
-    }
-    return "";
+    return string_attr(title_key());
 }
 
 std::string ResultImpl::art() const noexcept
 {
-    auto const it = attrs_.find("art");
-    if (it != attrs_.end() && it->second.which() == Variant::Type::String)
-    {
-        return it->second.get_string();
-    }
-    return "";
+    return string_attr(art_key());
 }
 
 std::string ResultImpl::dnd_uri() const noexcept
 {
-    auto const it = attrs_.find("dnd_uri");
-    if (it != attrs_.end() && it->second.which() == Variant::Type::String)
-    {
-        return it->second.get_string();
-    }
-    return "";
+    return string_attr(dnd_uri_key());
 }
 
 std::string ResultImpl::origin() const noexcept
@@ -356,7 +432,7 @@ bool ResultImpl::contains(std::string const& key) const
     {
         throw InvalidArgumentException("Result::contains(): Invalid empty key string");
     }
-    return attrs_.find(key) != attrs_.end();
+    return find_attr(key) != nullptr;
 }
 
 Variant const& ResultImpl::value(std::string const& key) const
@@ -365,10 +441,10 @@ Variant const& ResultImpl::value(std::string const& key) const
     {
         throw InvalidArgumentException("Result::value(): invalid empty key string");
     }
-    auto const& it = attrs_.find(key);
-    if (it != attrs_.end())
+    auto const a = find_attr(key);
+    if (a)
     {
-        return it->second;
+        return a->value;
     }
     std::ostringstream s;
     s << "Result::value(): requested key " << key << " doesn't exist";
@@ -385,12 +461,12 @@ void ResultImpl::throw_on_non_string(std::string const& name, Variant::Type vtyp
 
 void ResultImpl::throw_on_empty(std::string const& name) const
 {
-    auto const it = attrs_.find(name);
-    if (it == attrs_.end())
+    auto const a = find_attr(name);
+    if (!a)
     {
         throw InvalidArgumentException("ResultItem: missing required attribute: " + name);
     }
-    throw_on_non_string(name, it->second.which());
+    throw_on_non_string(name, a->value.which());
 }
 
 void ResultImpl::serialize_internal(VariantMap& var) const
@@ -411,21 +487,48 @@ void ResultImpl::serialize_internal(VariantMap& var) const
 
 VariantMap ResultImpl::serialize() const
 {
-    throw_on_empty("uri");
-    auto it = attrs_.find("dnd_uri");
-    if (it != attrs_.end())
+    check_serializable();
+
+    // The index is in key order, so each attribute is appended at the end of the map.
+    // We move the dictionaries into place instead of copying them.
+    VariantMap attrs;
+    for (auto i : attrs_->index)
     {
-        throw_on_non_string("dnd_uri", it->second.which());
+        auto const& attr = attrs_->list[i];
+        attrs.emplace_hint(attrs.end(), *attr.key, attr.value);
     }
 
     VariantMap outer;
-    outer["attrs"] = Variant(attrs_);
+    outer["attrs"] = VariantAccess::from_dict(std::move(attrs));
+    outer["internal"] = VariantAccess::from_dict(internal_values());
 
+    return outer;
+}
+
+void ResultImpl::check_serializable() const
+{
+    throw_on_empty("uri");
+    auto a = find_attr(*dnd_uri_key());
+    if (a)
+    {
+        throw_on_non_string("dnd_uri", a->value.which());
+    }
+}
+
+void ResultImpl::visit_attributes(std::function<void(std::string const& key, Variant const& value)> const& func) const
+{
+    for (auto i : attrs_->index)
+    {
+        auto const& attr = attrs_->list[i];
+        func(*attr.key, attr.value);
+    }
+}
+
+VariantMap ResultImpl::internal_values() const
+{
     VariantMap intvar;
     serialize_internal(intvar);
-    outer["internal"] = std::move(intvar);
-
-    return outer;
+    return intvar;
 }
 
 void ResultImpl::deserialize(VariantMap const& var)
@@ -452,7 +555,7 @@ void ResultImpl::deserialize(VariantMap const& var)
         it = resvar.find("result");
         if (it != resvar.end())
         {
-            stored_result_.reset(new VariantMap(it->second.get_dict()));
+            stored_result_ = std::make_shared<VariantMap const>(it->second.get_dict());
         }
     }
 
@@ -470,7 +573,7 @@ void ResultImpl::deserialize(VariantMap const& var)
 
     for (auto const& kv: attrs)
     {
-        this->operator[](kv.first) = kv.second;
+        attr_value(kv.first) = kv.second;
     }
 }
 
@@ -491,7 +594,95 @@ bool ResultImpl::compare(ResultImpl *other) const
     {
         return false;
     }
-    return attrs_ == other->attrs_;
+    if (attrs_ == other->attrs_)
+    {
+        return true;
+    }
+
+    // Both indexes are in key order, so we can compare the attributes pairwise.
+    auto const& mine = *attrs_;
+    auto const& theirs = *other->attrs_;
+    if (mine.index.size() != theirs.index.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < mine.index.size(); ++i)
+    {
+        auto const& a = mine.list[mine.index[i]];
+        auto const& b = theirs.list[theirs.index[i]];
+        if ((a.key != b.key && *a.key != *b.key) || !(a.value == b.value))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+ResultImpl::Attribute const* ResultImpl::find_attr(std::string const& key) const
+{
+    auto const& attrs = *attrs_;
+    auto it = std::lower_bound(attrs.index.begin(), attrs.index.end(), key,
+                               [&attrs](uint32_t i, std::string const& k) { return *attrs.list[i].key < k; });
+    if (it != attrs.index.end() && *attrs.list[*it].key == key)
+    {
+        return &attrs.list[*it];
+    }
+    return nullptr;
+}
+
+Variant& ResultImpl::attr_value(std::string const& key)
+{
+    if (key.empty())
+    {
+        throw InvalidArgumentException("Result::operator[]: Invalid empty key string");
+    }
+    auto& attrs = writable_attrs();
+    auto it = std::lower_bound(attrs.index.begin(), attrs.index.end(), key,
+                               [&attrs](uint32_t i, std::string const& k) { return *attrs.list[i].key < k; });
+    if (it != attrs.index.end() && *attrs.list[*it].key == key)
+    {
+        return attrs.list[*it].value;
+    }
+
+    auto const k = intern(key, true);
+    if (k)
+    {
+        attrs.list.push_back(Attribute{ k, nullptr, Variant() });
+    }
+    else
+    {
+        // Not interned, so the key can only be stored with the attribute.
+        auto own_key = std::make_shared<std::string const>(key);
+        attrs.list.push_back(Attribute{ own_key.get(), own_key, Variant() });
+    }
+    attrs.index.insert(it, attrs.list.size() - 1);
+    return attrs.list.back().value;
+}
+
+// Gives up our reference to the attributes if they are shared, so they can be modified.
+
+ResultImpl::Attributes& ResultImpl::writable_attrs()
+{
+    if (attrs_.use_count() > 1)
+    {
+        attrs_ = std::make_shared<Attributes>(*attrs_);
+    }
+    else
+    {
+        // Make sure we see all reads of other results that just released the attributes.
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *attrs_;
+}
+
+std::string ResultImpl::string_attr(std::string const* interned_key) const noexcept
+{
+    auto const a = find_attr(*interned_key);
+    if (a && a->value.which() == Variant::Type::String)
+    {
+        return a->value.get_string();
+    }
+    return "";
 }
 
 Result ResultImpl::create_result(VariantMap const& variant_map)
@@ -504,6 +695,11 @@ Result ResultImpl::create_result(ResultImpl *impl)
     return Result(impl);
 }
 
+ResultImpl const& ResultImpl::get(Result const& result)
+{
+    return *result.p;
+}
+
 } // namespace internal
 
 } // namespace scopes
@@ -22,6 +22,7 @@
 #include <unity/scopes/Category.h>
 #include <unity/scopes/CategorisedResult.h>
 #include <unity/scopes/internal/CategorisedResultImpl.h>
+#include <unity/scopes/internal/CategoryRendererImpl.h>
 #include <unity/scopes/internal/DepartmentImpl.h>
 #include <unity/scopes/FilterBase.h>
 #include <unity/scopes/internal/FilterGroupImpl.h>
@@ -51,7 +52,8 @@ ResultReplyObject::ResultReplyObject(SearchListenerBase::SPtr const& receiver, R
     receiver_(receiver),
     cat_registry_(new CategoryRegistry()),
     cardinality_(cardinality),
-    num_pushes_(0)
+    num_pushes_(0),
+    finished_called_(false)
 {
     assert(receiver_);
     assert(runtime);
@@ -84,7 +86,22 @@ bool ResultReplyObject::process_data(VariantMap const& data)
     it = data.find("category");
     if (it != data.end())
     {
-        auto cat = cat_registry_->register_category(it->second.get_dict());
+        auto cat_dict = it->second.get_dict();
+        auto h = cat_dict.find("renderer_hash");
+        if (h != cat_dict.end())
+        {
+            // We send only hashes of templates we kept, so this works even if the cache has
+            // evicted the template since.
+            lock_guard<mutex> lock(known_renderers_mutex_);
+            auto t = known_renderers_.find(h->second.get_string());
+            if (t != known_renderers_.end())
+            {
+                cat_dict["renderer_template"] = *t->second;
+                cat_dict.erase(h);
+            }
+        }
+        auto cat = cat_registry_->register_category(cat_dict);
+        CategoryRendererImpl::note_received(origin_proxy(), cat->renderer_template());
         receiver_->push(cat);
     }
 
@@ -123,11 +140,40 @@ bool ResultReplyObject::process_data(VariantMap const& data)
         }
 
         CategorisedResult result(impl.release());
+        if (prefetcher_)
+        {
+            prefetcher_->add(result);
+        }
         receiver_->push(std::move(result));
     }
     return false;
 }
 
+void ResultReplyObject::finished(CompletionDetails const& details) noexcept
+{
+    // ReplyObject::finished() can destroy this instance, so we hang on to the prefetcher.
+    auto prefetcher = prefetcher_;
+    bool const first_call = !finished_called_.exchange(true);
+
+    ReplyObject::finished(details);
+
+    if (prefetcher && first_call && details.status() == CompletionDetails::OK)
+    {
+        prefetcher->start();
+    }
+}
+
+void ResultReplyObject::set_prefetcher(PreviewPrefetcher::SPtr const& prefetcher)
+{
+    prefetcher_ = prefetcher;
+}
+
+void ResultReplyObject::set_known_renderers(std::map<std::string, std::shared_ptr<std::string const>> const& templates)
+{
+    lock_guard<mutex> lock(known_renderers_mutex_);
+    known_renderers_ = templates;
+}
+
 } // namespace internal
 
 } // namespace scopes
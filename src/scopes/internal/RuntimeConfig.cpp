@@ -54,6 +54,8 @@ const string cache_dir_key = "CacheDir";
 const string app_dir_key = "AppDir";
 const string config_dir_key = "ConfigDir";
 const string trace_channels_key = "Log.TraceChannels";
+const string preview_prefetch_key = "Preview.Prefetch";
+const string preview_cache_size_key = "Preview.CacheSize";
 
 }  // namespace
 
@@ -70,6 +72,8 @@ RuntimeConfig::RuntimeConfig(string const& configfile) :
         default_middleware_configfile_ = snap_root() + DFLT_ZMQ_MIDDLEWARE_INI;
         reap_expiry_ = DFLT_REAP_EXPIRY;
         reap_interval_ = DFLT_REAP_INTERVAL;
+        preview_prefetch_ = DFLT_PREVIEW_PREFETCH;
+        preview_cache_size_ = DFLT_PREVIEW_CACHE_SIZE;
         cache_directory_ = default_cache_directory();
         app_directory_ = default_app_directory();
         config_directory_ = default_config_directory();
@@ -94,6 +98,16 @@ RuntimeConfig::RuntimeConfig(string const& configfile) :
         {
             throw_ex("Illegal value (" + to_string(reap_interval_) + ") for " + reap_interval_key + ": value must be > 0");
         }
+        preview_prefetch_ = get_optional_int(runtime_config_group, preview_prefetch_key, DFLT_PREVIEW_PREFETCH);
+        if (preview_prefetch_ < 0 || preview_prefetch_ > 100)
+        {
+            throw_ex("Illegal value (" + to_string(preview_prefetch_) + ") for " + preview_prefetch_key + ": value must be 0-100");
+        }
+        preview_cache_size_ = get_optional_int(runtime_config_group, preview_cache_size_key, DFLT_PREVIEW_CACHE_SIZE);
+        if (preview_cache_size_ < 1 || preview_cache_size_ > 65536)
+        {
+            throw_ex("Illegal value (" + to_string(preview_cache_size_) + ") for " + preview_cache_size_key + ": value must be 1-65536");
+        }
 
         cache_directory_ = get_optional_string(runtime_config_group, cache_dir_key);
         if (cache_directory_.empty())
@@ -170,7 +184,9 @@ RuntimeConfig::RuntimeConfig(string const& configfile) :
                                                 cache_dir_key,
                                                 app_dir_key,
                                                 config_dir_key,
-                                                trace_channels_key
+                                                trace_channels_key,
+                                                preview_prefetch_key,
+                                                preview_cache_size_key
                                              }
                                           }
                                        };
@@ -221,6 +237,16 @@ int RuntimeConfig::reap_interval() const
     return reap_interval_;
 }
 
+int RuntimeConfig::preview_prefetch() const
+{
+    return preview_prefetch_;
+}
+
+int RuntimeConfig::preview_cache_size() const
+{
+    return preview_cache_size_;
+}
+
 string RuntimeConfig::cache_directory() const
 {
     return cache_directory_;
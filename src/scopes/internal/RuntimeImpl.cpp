@@ -18,8 +18,10 @@
 
 #include <unity/scopes/internal/RuntimeImpl.h>
 
+#include <unity/scopes/internal/CancellationToken.h>
 #include <unity/scopes/internal/ChildScopesRepository.h>
 #include <unity/scopes/internal/DfltConfig.h>
+#include <unity/scopes/internal/HostedScopeObject.h>
 #include <unity/scopes/internal/Logger.h>
 #include <unity/scopes/internal/MWStateReceiver.h>
 #include <unity/scopes/internal/RegistryConfig.h>
@@ -29,6 +31,7 @@
 #include <unity/scopes/internal/ScopeConfig.h>
 #include <unity/scopes/internal/ScopeObject.h>
 #include <unity/scopes/internal/SettingsDB.h>
+#include <unity/scopes/internal/SurfacingCache.h>
 #include <unity/scopes/internal/UniqueID.h>
 #include <unity/scopes/internal/Utils.h>
 #include <unity/scopes/ScopeBase.h>
@@ -93,8 +96,8 @@ RuntimeImpl::RuntimeImpl(string const& scope_id, string const& configfile)
             }
         }
 
-        string default_middleware = config.default_middleware();
-        string middleware_configfile = config.default_middleware_configfile();
+        default_middleware_ = config.default_middleware();
+        default_middleware_configfile_ = config.default_middleware_configfile();
         middleware_factory_.reset(new MiddlewareFactory(this));
         registry_configfile_ = config.registry_configfile();
         registry_identity_ = config.registry_identity();
@@ -102,8 +105,13 @@ RuntimeImpl::RuntimeImpl(string const& scope_id, string const& configfile)
         reap_interval_ = config.reap_interval();
         ss_configfile_ = config.ss_configfile();
         ss_registry_identity_ = config.ss_registry_identity();
+        preview_prefetch_ = config.preview_prefetch();
+        if (preview_prefetch_ > 0)
+        {
+            preview_cache_ = make_shared<PreviewCache>(size_t(config.preview_cache_size()) * 1024);
+        }
 
-        middleware_ = middleware_factory_->create(scope_id_, default_middleware, middleware_configfile);
+        middleware_ = middleware_factory_->create(scope_id_, default_middleware_, default_middleware_configfile_);
         middleware_->start();
 
         async_pool_ = make_shared<ThreadPool>(1); // TODO: configurable pool size
@@ -120,7 +128,15 @@ RuntimeImpl::RuntimeImpl(string const& scope_id, string const& configfile)
             // Create the registry proxy
             RegistryConfig reg_config(registry_identity_, registry_configfile_);
             auto registry_mw_proxy = middleware_->registry_proxy();
-            registry_ = make_shared<RegistryImpl>(registry_mw_proxy);
+            if (registry_mw_proxy)
+            {
+                registry_ = make_shared<RegistryImpl>(registry_mw_proxy);
+            }
+            else
+            {
+                logger()(LoggerSeverity::Warning) << "middleware " << default_middleware_ << " has no registry";
+                registry_identity_ = "";
+            }
         }
 
         cache_dir_ = config.cache_directory();
@@ -197,6 +213,18 @@ void RuntimeImpl::destroy()
         waiter_thread_.join();
     }
 
+    if (preview_cache_ && preview_cache_->hits() + preview_cache_->misses() > 0)
+    {
+        auto hits = preview_cache_->hits();
+        auto lookups = hits + preview_cache_->misses();
+        logger()(LoggerSeverity::Info) << "preview cache: "
+                                       << hits << " hits, "
+                                       << preview_cache_->misses() << " misses ("
+                                       << hits * 100 / lookups << "% hit rate), "
+                                       << preview_cache_->prefetched() << " previews prefetched, "
+                                       << preview_cache_->saved_latency().count() << " ms saved";
+    }
+
     // Shut down server-side.
     if (middleware_)
     {
@@ -304,6 +332,16 @@ ThreadSafeQueue<future<void>>::SPtr RuntimeImpl::future_queue() const
     return future_queue_;  // Immutable
 }
 
+PreviewCache::SPtr RuntimeImpl::preview_cache() const
+{
+    return preview_cache_;  // Immutable
+}
+
+int RuntimeImpl::preview_prefetch() const
+{
+    return preview_prefetch_;  // Immutable
+}
+
 internal::Logger& RuntimeImpl::logger() const
 {
     return *logger_;
@@ -342,28 +380,17 @@ private:
 
 }
 
-void RuntimeImpl::run_scope(ScopeBase* scope_base,
-                            string const& scope_ini_file,
-                            std::promise<void> ready_promise)
+void RuntimeImpl::configure_scope(ScopeBase* scope_base, string const& scope_id, string const& scope_ini_file)
 {
-    if (!scope_base)
-    {
-        throw InvalidArgumentException("Runtime::run_scope(): scope_base cannot be nullptr");
-    }
-
-    // Create a middleware for this scope.
-    RegistryConfig reg_conf(registry_identity_, registry_configfile_);
-    auto mw = factory()->create(scope_id_, reg_conf.mw_kind(), reg_conf.mw_configfile());
-
     boost::filesystem::path scope_dir = boost::filesystem::canonical(scope_ini_file).parent_path();
     scope_base->p->set_scope_directory(scope_dir.native());
 
     {
         // Try to open the scope settings database, if any.
-        string config_dir = config_dir_ + "/" + scope_id_;
+        string config_dir = config_dir_ + "/" + scope_id;
         string settings_db = config_dir + "/settings.ini";
 
-        string settings_schema = scope_dir.native() + "/" + scope_id_ + "-settings.ini";
+        string settings_schema = scope_dir.native() + "/" + scope_id + "-settings.ini";
 
         boost::system::error_code ec;
         if (boost::filesystem::exists(settings_schema, ec) && boost::filesystem::file_size(settings_schema) > 0)
@@ -384,9 +411,49 @@ void RuntimeImpl::run_scope(ScopeBase* scope_base,
     }
 
     scope_base->p->set_registry(registry_);
-    scope_base->p->set_cache_directory(find_cache_dir());
-    scope_base->p->set_app_directory(find_app_dir());
-    scope_base->p->set_tmp_directory(find_tmp_dir());
+    scope_base->p->set_cache_directory(find_cache_dir(scope_id));
+    scope_base->p->set_app_directory(find_app_dir(scope_id));
+    scope_base->p->set_tmp_directory(find_tmp_dir(scope_id));
+}
+
+void RuntimeImpl::log_cancellation_stats(string const& scope_id, CancellationStats const& stats)
+{
+    if (stats.cancelled_queries() == 0)
+    {
+        return;
+    }
+    logger()(LoggerSeverity::Info) << "Scope " << scope_id << ": "
+                                   << stats.cancelled_queries() << " queries cancelled, "
+                                   << stats.dropped_results() << " results dropped after cancellation ("
+                                   << stats.dropped_after_marshaling() << " after marshaling)";
+}
+
+// Scopes normally run on the registry's middleware, so the registry can reach them. The in-process
+// middleware has no registry, so scopes run on the default middleware in that case.
+
+MiddlewareBase::SPtr RuntimeImpl::scope_middleware()
+{
+    if (default_middleware_ == "Inproc")
+    {
+        return factory()->create(scope_id_, default_middleware_, default_middleware_configfile_);
+    }
+    RegistryConfig reg_conf(registry_identity_, registry_configfile_);
+    return factory()->create(scope_id_, reg_conf.mw_kind(), reg_conf.mw_configfile());
+}
+
+void RuntimeImpl::run_scope(ScopeBase* scope_base,
+                            string const& scope_ini_file,
+                            std::promise<void> ready_promise)
+{
+    if (!scope_base)
+    {
+        throw InvalidArgumentException("Runtime::run_scope(): scope_base cannot be nullptr");
+    }
+
+    // Create a middleware for this scope.
+    auto mw = scope_middleware();
+
+    configure_scope(scope_base, scope_id_, scope_ini_file);
 
     // TODO: redirect log messages to scope-specific file.
 
@@ -428,39 +495,51 @@ void RuntimeImpl::run_scope(ScopeBase* scope_base,
     try
     {
         // Create a servant for the scope and register the servant.
+        SurfacingCache::SPtr surfacing_cache;
+        CancellationStats::SPtr cancellation_stats;
         if (!scope_ini_file.empty())
         {
             // Check if this scope has requested debug mode, if so, disable the idle timeout
             ScopeConfig scope_config(scope_ini_file);
             int idle_timeout_ms = scope_config.debug_mode() ? -1 : scope_config.idle_timeout() * 1000;
+            // Results for a scope that needs the location differ from one location to the next, so we don't cache them.
+            if (scope_config.results_ttl_type() != ScopeMetadata::ResultsTtlType::None && !scope_config.debug_mode()
+                && !scope_config.location_data_needed())
+            {
+                surfacing_cache = make_shared<SurfacingCache>(scope_config.results_ttl_type());
+            }
             auto scope = unique_ptr<internal::ScopeObject>(new internal::ScopeObject(scope_base,
-                                                                                     scope_config.debug_mode()));
+                                                                                     scope_config.debug_mode(),
+                                                                                     surfacing_cache));
+            cancellation_stats = scope->cancellation_stats();
             mw->add_scope_object(scope_id_, move(scope), idle_timeout_ms);
         }
         else
         {
             auto scope = unique_ptr<internal::ScopeObject>(new internal::ScopeObject(scope_base));
+            cancellation_stats = scope->cancellation_stats();
             mw->add_scope_object(scope_id_, move(scope));
         }
 
-        // Inform the registry that this scope is now ready to process requests
-        {
-            auto reg_state_receiver = mw->create_registry_state_receiver_proxy("StateReceiver");
-            reg_state_receiver->push_state(scope_id_, StateReceiverObject::State::ScopeReady);
-        }
+        // Inform the registry that this scope is now ready to process requests.
+        // We hang on to the proxy, so we can still use it once mw has shut down.
+        auto reg_state_receiver = mw->create_registry_state_receiver_proxy("StateReceiver");
+        reg_state_receiver->push_state(scope_id_, StateReceiverObject::State::ScopeReady);
 
         promise.set_value();
         mw->wait_for_shutdown();
-        cleanup_scope.dealloc();   // Causes ScopeBase::run() to return if the scope is properly written
-
+        if (surfacing_cache)
         {
-            // mw is now shut down, so we need a separate one to send the state update to the registry.
-            auto sd_runtime = create(scope_id_ + "-shutdown", runtime_configfile_);
-            auto sd_mw = sd_runtime->factory()->find(scope_id_ + "-shutdown", reg_conf.mw_kind());
-            auto reg_state_receiver = sd_mw->create_registry_state_receiver_proxy("StateReceiver");
-            // Inform the registry that this scope is shutting down
-            reg_state_receiver->push_state(scope_id_, StateReceiverObject::State::ScopeStopping);
+            logger()(LoggerSeverity::Info) << "Scope " << scope_id_ << ": surfacing cache: "
+                                           << surfacing_cache->hits() << " hits, "
+                                           << surfacing_cache->stale_hits() << " stale hits, "
+                                           << surfacing_cache->misses() << " misses";
         }
+        log_cancellation_stats(scope_id_, *cancellation_stats);
+        cleanup_scope.dealloc();   // Causes ScopeBase::run() to return if the scope is properly written
+
+        // Inform the registry that this scope is shutting down
+        reg_state_receiver->push_state(scope_id_, StateReceiverObject::State::ScopeStopping);
     }
     catch (...)
     {
@@ -485,6 +564,152 @@ void RuntimeImpl::run_scope(ScopeBase* scope_base,
     }
 }
 
+void RuntimeImpl::run_hosted_scopes(vector<string> const& scope_ini_files,
+                                    ScopeLoadFunction const& load_scope,
+                                    std::promise<void> ready_promise)
+{
+    if (scope_ini_files.empty())
+    {
+        throw InvalidArgumentException("Runtime::run_hosted_scopes(): no scopes to run");
+    }
+    if (!load_scope)
+    {
+        throw InvalidArgumentException("Runtime::run_hosted_scopes(): load_scope cannot be nullptr");
+    }
+
+    // All the scopes share a single middleware. Each scope gets its own adapter, so
+    // the endpoint for each scope is the same as when it runs in a process of its own.
+    auto mw = scope_middleware();
+
+    PromiseWrapper promise(move(ready_promise));
+
+    vector<string> scope_ids;
+    vector<HostedScopeObject::SPtr> hosted_scopes;
+    for (auto const& ini_file : scope_ini_files)
+    {
+        string scope_id = boost::filesystem::path(ini_file).stem().native();
+        ScopeConfig scope_config(ini_file);
+        bool debug_mode = scope_config.debug_mode();
+        // Results for a scope that needs the location differ from one location to the next, so we don't cache them.
+        auto ttl_type = scope_config.location_data_needed() ? ScopeMetadata::ResultsTtlType::None
+                                                            : scope_config.results_ttl_type();
+
+        auto load = [this, load_scope, scope_id, ini_file, debug_mode, ttl_type]() -> HostedScopeObject::Instance
+        {
+            logger()(LoggerSeverity::Info) << "Scope " << scope_id << ": loading";
+
+            ScopeLoader::SPtr loader = load_scope(scope_id, ini_file);
+            ScopeBase* scope_base = loader->scope_base();
+            configure_scope(scope_base, scope_id, ini_file);
+            try
+            {
+                scope_base->start(scope_id);
+            }
+            catch (...)
+            {
+                throw unity::ResourceException("Scope " + scope_id +": exception from start()");
+            }
+            auto run_future = make_shared<future<void>>(std::async(launch::async, [scope_base] { scope_base->run(); }));
+
+            SurfacingCache::SPtr surfacing_cache;
+            if (ttl_type != ScopeMetadata::ResultsTtlType::None && !debug_mode)
+            {
+                surfacing_cache = make_shared<SurfacingCache>(ttl_type);
+            }
+
+            HostedScopeObject::Instance instance;
+            instance.scope_object = make_shared<ScopeObject>(scope_base, debug_mode, surfacing_cache, scope_id);
+            auto cancellation_stats = instance.scope_object->cancellation_stats();
+            instance.stop = [this, scope_id, loader, scope_base, run_future, cancellation_stats]
+            {
+                logger()(LoggerSeverity::Info) << "Scope " << scope_id << ": unloading";
+                log_cancellation_stats(scope_id, *cancellation_stats);
+                try
+                {
+                    scope_base->stop();  // Causes ScopeBase::run() to return if the scope is properly written
+                }
+                catch (...)
+                {
+                    logger()(LoggerSeverity::Error) << "Scope " << scope_id << ": exception from stop()";
+                }
+                try
+                {
+                    run_future->get();
+                }
+                catch (...)
+                {
+                    logger()(LoggerSeverity::Error) << "Scope " << scope_id << ": exception from run()";
+                }
+            };
+            return instance;
+        };
+
+        scope_ids.push_back(scope_id);
+        hosted_scopes.push_back(make_shared<HostedScopeObject>(scope_id, debug_mode, load));
+    }
+
+    try
+    {
+        for (size_t i = 0; i < hosted_scopes.size(); ++i)
+        {
+            // When a scope goes idle, we unload it. Once the last scope is unloaded, we shut down.
+            weak_ptr<MiddlewareBase> weak_mw(mw);
+            auto hosted = hosted_scopes[i];
+            auto all_scopes = hosted_scopes;
+            auto on_idle = [weak_mw, hosted, all_scopes]
+            {
+                if (!hosted->unload())
+                {
+                    return;  // Still busy
+                }
+                for (auto const& s : all_scopes)
+                {
+                    if (s->loaded())
+                    {
+                        return;
+                    }
+                }
+                auto mw = weak_mw.lock();
+                if (mw)
+                {
+                    mw->stop();
+                }
+            };
+            ScopeConfig scope_config(scope_ini_files[i]);
+            int idle_timeout_ms = scope_config.debug_mode() ? -1 : scope_config.idle_timeout() * 1000;
+            mw->add_scope_object(scope_ids[i], hosted, idle_timeout_ms, on_idle);
+        }
+
+        // Inform the registry that the scopes are now ready to process requests
+        auto reg_state_receiver = mw->create_registry_state_receiver_proxy("StateReceiver");
+        for (auto const& id : scope_ids)
+        {
+            reg_state_receiver->push_state(id, StateReceiverObject::State::ScopeReady);
+        }
+
+        promise.set_value();
+        mw->wait_for_shutdown();
+        for (auto const& s : hosted_scopes)
+        {
+            s->unload(true);
+        }
+
+        // Inform the registry that the scopes are shutting down
+        for (auto const& id : scope_ids)
+        {
+            reg_state_receiver->push_state(id, StateReceiverObject::State::ScopeStopping);
+        }
+    }
+    catch (...)
+    {
+        for (auto const& s : hosted_scopes)
+        {
+            s->unload(true);
+        }
+        throw unity::ResourceException("Scope host " + scope_id_ + ": failure during initialization");
+    }
+}
+
 ObjectProxy RuntimeImpl::string_to_proxy(string const& s) const
 {
     try
@@ -517,12 +742,12 @@ string RuntimeImpl::proxy_to_string(ObjectProxy const& proxy) const
 
 string RuntimeImpl::cache_directory() const
 {
-    return find_cache_dir();
+    return find_cache_dir(scope_id_);
 }
 
 string RuntimeImpl::tmp_directory() const
 {
-    return find_tmp_dir();
+    return find_tmp_dir(scope_id_);
 }
 
 string RuntimeImpl::config_directory() const
@@ -575,7 +800,7 @@ string RuntimeImpl::confinement_type() const
     return confined() ? "leaf-net" : "unconfined";
 }
 
-string RuntimeImpl::find_cache_dir() const
+string RuntimeImpl::find_cache_dir(string const& id) const
 {
     // Create the cache_dir_/<confinement-type>/<id> directories if they don't exist.
     string dir = cache_dir_ + "/" + confinement_type();
@@ -584,15 +809,15 @@ string RuntimeImpl::find_cache_dir() const
         make_directories(dir, 0700);
     }
     // A confined scope is allowed to create this dir.
-    dir += "/" + demangled_id(scope_id_);
+    dir += "/" + demangled_id(id);
     make_directories(dir, 0700);
     return dir;
 }
 
-string RuntimeImpl::find_app_dir() const
+string RuntimeImpl::find_app_dir(string const& id) const
 {
     // Create the app_dir_/<id> directories if they don't exist.
-    string dir = app_dir_ + "/" + demangled_id(scope_id_);
+    string dir = app_dir_ + "/" + demangled_id(id);
     if (!confined())  // Avoid apparmor noise
     {
         make_directories(dir, 0700);
@@ -616,7 +841,7 @@ string RuntimeImpl::find_log_dir(string const& id) const
     return dir;
 }
 
-string RuntimeImpl::find_tmp_dir() const
+string RuntimeImpl::find_tmp_dir(string const& id) const
 {
     // Set tmp dir.
     // We need to create any directories under /run/user/<uid> because they might not
@@ -628,7 +853,7 @@ string RuntimeImpl::find_tmp_dir() const
         make_directories(dir, 0700);
     }
     // A confined scope is allowed to create this dir.
-    dir += "/" + scope_id_;  // Not demangled, use the real scope ID.
+    dir += "/" + id;  // Not demangled, use the real scope ID.
     make_directories(dir, 0700);
     return dir;
 }
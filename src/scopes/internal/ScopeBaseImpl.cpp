@@ -45,6 +45,8 @@ ScopeBaseImpl::ScopeBaseImpl()
     , registry_initialized_(false)
     , settings_db_initialized_(false)
     , child_scopes_repo_initialized_(false)
+    , child_scopes_generation_(0)
+    , list_update_subscribed_(false)
 {
 }
 
@@ -134,6 +136,13 @@ void ScopeBaseImpl::set_registry(RegistryProxy const& registry)
     lock_guard<mutex> lock(mutex_);
     registry_ = registry;
     registry_initialized_ = true;
+
+    // Forget anything we cached from a previous registry.
+    lock_guard<mutex> cache_lock(child_scopes_mutex_);
+    list_update_connection_.reset();
+    list_update_subscribed_ = false;
+    ++child_scopes_generation_;
+    child_scopes_cache_.reset();
 }
 
 RegistryProxy ScopeBaseImpl::registry() const
@@ -190,15 +199,54 @@ ChildScopeList ScopeBaseImpl::find_child_scopes() const
         return ChildScopeList();
     }
 
+    // list() transfers the metadata of all scopes, so we cache the result and only
+    // call list() again once the registry tells us that the list of scopes has changed.
+    int generation;
+    {
+        lock_guard<mutex> lock(child_scopes_mutex_);
+        if (child_scopes_cache_)
+        {
+            return *child_scopes_cache_;
+        }
+        if (!list_update_subscribed_)
+        {
+            list_update_subscribed_ = true;
+            try
+            {
+                list_update_connection_.reset(
+                    new core::ScopedConnection(reg->set_list_update_callback([this]{ invalidate_child_scopes_cache(); })));
+            }
+            catch (std::exception const&)
+            {
+                // Without notifications, we can't cache.
+            }
+        }
+        generation = child_scopes_generation_;
+    }
+
     // The default behaviour of this method is to simply return all available scopes on the system.
-    ChildScopeList return_list;
+    auto return_list = make_shared<ChildScopeList>();
     auto all_scopes = reg->list();
     for (auto const& scope : all_scopes)
     {
         // New scopes are added enabled by default
-        return_list.push_back( ChildScope{scope.first, scope.second} );
+        return_list->push_back( ChildScope{scope.first, scope.second} );
+    }
+
+    lock_guard<mutex> lock(child_scopes_mutex_);
+    if (list_update_connection_ && generation == child_scopes_generation_)
+    {
+        // Only cache the list if no update arrived while we were calling list().
+        child_scopes_cache_ = return_list;
     }
-    return return_list;
+    return *return_list;
+}
+
+void ScopeBaseImpl::invalidate_child_scopes_cache() const
+{
+    lock_guard<mutex> lock(child_scopes_mutex_);
+    ++child_scopes_generation_;
+    child_scopes_cache_.reset();
 }
 
 ChildScopeList ScopeBaseImpl::child_scopes(ChildScopeList const& child_scopes_defaulted) const
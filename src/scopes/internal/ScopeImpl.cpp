@@ -20,13 +20,17 @@
 
 #include <unity/scopes/ActionMetadata.h>
 #include <unity/scopes/internal/ActivationReplyObject.h>
+#include <unity/scopes/internal/CategoryRendererImpl.h>
 #include <unity/scopes/internal/MiddlewareBase.h>
 #include <unity/scopes/internal/MWQueryCtrl.h>
+#include <unity/scopes/internal/MWReply.h>
 #include <unity/scopes/internal/MWScope.h>
+#include <unity/scopes/internal/PreviewPrefetcher.h>
 #include <unity/scopes/internal/PreviewReplyObject.h>
 #include <unity/scopes/internal/QueryCtrlImpl.h>
 #include <unity/scopes/internal/ResultImpl.h>
 #include <unity/scopes/internal/ResultReplyObject.h>
+#include <unity/scopes/internal/RuntimeImpl.h>
 #include <unity/scopes/SearchMetadata.h>
 #include <unity/UnityExceptions.h>
 
@@ -43,6 +47,58 @@ namespace scopes
 namespace internal
 {
 
+namespace
+{
+
+// Returns the completion callback for an asynchronous query request. The callback
+// runs on a middleware thread, so it must not call into the listener directly.
+// On success, it replaces the MWQueryCtrlProxy of the "fake" ctrl with the real one;
+// on failure, it sends finished() to the reply object, which calls the listener on
+// the reply adapter's thread as for any other reply. The callback holds on to impl
+// to keep the forwarding proxy alive until the request has completed.
+
+MWScope::QueryCtrlCallback make_ctrl_callback(shared_ptr<ScopeImpl> const& impl,
+                                              shared_ptr<QueryCtrlImpl> const& ctrl,
+                                              MWReplyProxy const& rp)
+{
+    return [impl, ctrl, rp](QueryCtrlProxy const& proxy, exception_ptr const& error)
+    {
+        if (!error)
+        {
+            auto real_ctrl = dynamic_pointer_cast<QueryCtrlImpl>(proxy);
+            assert(real_ctrl);
+
+            auto new_proxy = dynamic_pointer_cast<MWQueryCtrl>(real_ctrl->proxy());
+            assert(new_proxy);
+            ctrl->set_proxy(new_proxy);
+            return;
+        }
+
+        string msg;
+        try
+        {
+            rethrow_exception(error);
+        }
+        catch (std::exception const& e)
+        {
+            msg = e.what();
+        }
+        catch (...)
+        {
+            msg = "unknown exception";
+        }
+        try
+        {
+            rp->finished(CompletionDetails(CompletionDetails::Error, msg));
+        }
+        catch (...)
+        {
+        }
+    };
+}
+
+} // namespace
+
 ScopeImpl::ScopeImpl(MWScopeProxy const& mw_proxy, std::string const& scope_id) :
     ObjectImpl(mw_proxy),
     runtime_(mw_proxy->mw_base()->runtime()),
@@ -95,7 +151,8 @@ QueryCtrlProxy ScopeImpl::search(std::string const& query_string,
                                  std::unique_ptr<Variant> user_data,
                                  SearchMetadata const& metadata,
                                  SearchQueryBaseImpl::History const& history,
-                                 SearchListenerBase::SPtr const& reply)
+                                 SearchListenerBase::SPtr const& reply,
+                                 std::string const& client_id)
 {
     CannedQuery query(scope_id_, query_string, department_id);
     query.set_filter_state(filter_state);
@@ -103,7 +160,7 @@ QueryCtrlProxy ScopeImpl::search(std::string const& query_string,
     {
         query.set_user_data(*user_data);
     }
-    return search(query, metadata, history, reply);
+    return search(query, metadata, history, reply, client_id);
 }
 
 QueryCtrlProxy ScopeImpl::search(std::string const& query_string,
@@ -122,18 +179,16 @@ QueryCtrlProxy ScopeImpl::search(std::string const& query_string,
 QueryCtrlProxy ScopeImpl::search(CannedQuery const& query,
                                  SearchMetadata const& metadata,
                                  SearchQueryBaseImpl::History const& history,
-                                 SearchListenerBase::SPtr const& reply)
+                                 SearchListenerBase::SPtr const& reply,
+                                 std::string const& client_id)
 {
     if (reply == nullptr)
     {
         throw unity::InvalidArgumentException("Scope::search(): invalid SearchListenerBase (nullptr)");
     }
 
-    ReplyObject::SPtr ro(make_shared<ResultReplyObject>(reply, runtime_, to_string(), metadata.cardinality(), fwd()->debug_mode()));
-    MWReplyProxy rp = fwd()->mw_base()->add_reply_object(ro);
-
-    // "Fake" QueryCtrlProxy that doesn't have a real MWQueryCtrlProxy yet.
-    shared_ptr<QueryCtrlImpl> ctrl = make_shared<QueryCtrlImpl>(nullptr, rp);
+    auto result_ro = make_shared<ResultReplyObject>(reply, runtime_, to_string(), metadata.cardinality(), fwd()->debug_mode());
+    ReplyObject::SPtr ro(result_ro);
 
     // We pass a shared pointer to the lambda (instead of the this pointer)
     // to keep ourselves alive until after the lambda fires.
@@ -141,8 +196,27 @@ QueryCtrlProxy ScopeImpl::search(CannedQuery const& query,
     // sent in the new thread, the lambda will call into this by-now-destroyed instance.
     auto impl = dynamic_pointer_cast<ScopeImpl>(shared_from_this());
 
-    string const my_id = runtime_->scope_id();
-    auto send_search = [my_id, impl, query, metadata, history, rp, ro, ctrl]() -> void
+    // Previews prefetched for the previous search are no longer of interest.
+    auto cache = runtime_->preview_cache();
+    if (cache)
+    {
+        cache->invalidate(to_string());
+        ActionMetadata hints(metadata.locale(), metadata.form_factor());
+        if (metadata.internet_connectivity() != QueryMetadata::Unknown)
+        {
+            hints.set_internet_connectivity(metadata.internet_connectivity());
+        }
+        result_ro->set_prefetcher(make_shared<PreviewPrefetcher>(impl, cache, runtime_->preview_prefetch(), hints));
+    }
+
+    MWReplyProxy rp = fwd()->mw_base()->add_reply_object(ro);
+
+    // "Fake" QueryCtrlProxy that doesn't have a real MWQueryCtrlProxy yet.
+    shared_ptr<QueryCtrlImpl> ctrl = make_shared<QueryCtrlImpl>(nullptr, rp);
+
+    // If we are called by a scope that shares its run time with other scopes, client_id tells us which one.
+    string const my_id = client_id.empty() ? runtime_->scope_id() : client_id;
+    auto send_search = [my_id, impl, query, metadata, history, rp, ro, result_ro, ctrl]() -> void
     {
         try
         {
@@ -162,19 +236,22 @@ QueryCtrlProxy ScopeImpl::search(CannedQuery const& query,
             }
             context["history"] = Variant(hist);
 
-            // Forward the (synchronous) search() method across the bus.
-            auto real_ctrl = dynamic_pointer_cast<QueryCtrlImpl>(impl->fwd()->search(query,
-                                                                                     metadata.serialize(),
-                                                                                     context,
-                                                                                     rp));
-
-            assert(real_ctrl);
+            // Tell the scope which renderer templates we have already, so it can send just their hashes.
+            auto const templates = CategoryRendererImpl::received_templates(impl->to_string());
+            if (!templates.empty())
+            {
+                VariantArray renderers;
+                for (auto const& t : templates)
+                {
+                    renderers.push_back(Variant(t.first));
+                }
+                context["renderers"] = Variant(renderers);
+                result_ro->set_known_renderers(templates);
+            }
 
-            // Call has completed now, so we update the MWQueryCtrlProxy for the fake proxy
-            // with the real proxy that was returned.
-            auto new_proxy = dynamic_pointer_cast<MWQueryCtrl>(real_ctrl->proxy());
-            assert(new_proxy);
-            ctrl->set_proxy(new_proxy);
+            // Forward the search() method across the bus. This returns as soon as the request
+            // is on its way; the real ctrl proxy is filled in once the scope has replied.
+            impl->fwd()->search_async(query, metadata.serialize(), context, rp, make_ctrl_callback(impl, ctrl, rp));
         }
         catch (std::exception const& e)
         {
@@ -188,8 +265,9 @@ QueryCtrlProxy ScopeImpl::search(CannedQuery const& query,
         }
     };
 
-    // Send the blocking twoway request asynchronously via the async invocation pool. The waiter thread
-    // waits on the future, so it gets cleaned up.
+    // Send the request via the async invocation pool. The pool task returns once the request
+    // has been queued, so it does not hold a pool thread while the scope processes the request.
+    // The waiter thread waits on the future, so it gets cleaned up.
     auto future = runtime_->async_pool()->submit(send_search);
     runtime_->future_queue()->push(move(future));
     return ctrl;
@@ -215,14 +293,10 @@ QueryCtrlProxy ScopeImpl::activate(Result const& result,
     {
         try
         {
-            auto real_ctrl = dynamic_pointer_cast<QueryCtrlImpl>(impl->fwd()->activate(result.p->activation_target(),
-                                                                                       metadata.serialize(),
-                                                                                       rp));
-            assert(real_ctrl);
-
-            auto new_proxy = dynamic_pointer_cast<MWQueryCtrl>(real_ctrl->proxy());
-            assert(new_proxy);
-            ctrl->set_proxy(new_proxy);
+            impl->fwd()->activate_async(result.p->activation_target(),
+                                        metadata.serialize(),
+                                        rp,
+                                        make_ctrl_callback(impl, ctrl, rp));
         }
         catch (std::exception const& e)
         {
@@ -263,17 +337,12 @@ QueryCtrlProxy ScopeImpl::perform_action(Result const& result,
     {
         try
         {
-            auto real_ctrl = dynamic_pointer_cast<QueryCtrlImpl>(impl->fwd()->perform_action(
-                                                                               result.p->activation_target(),
-                                                                               metadata.serialize(),
-                                                                               widget_id,
-                                                                               action_id,
-                                                                               rp));
-            assert(real_ctrl);
-
-            auto new_proxy = dynamic_pointer_cast<MWQueryCtrl>(real_ctrl->proxy());
-            assert(new_proxy);
-            ctrl->set_proxy(new_proxy);
+            impl->fwd()->perform_action_async(result.p->activation_target(),
+                                              metadata.serialize(),
+                                              widget_id,
+                                              action_id,
+                                              rp,
+                                              make_ctrl_callback(impl, ctrl, rp));
         }
         catch (std::exception const& e)
         {
@@ -302,6 +371,23 @@ QueryCtrlProxy ScopeImpl::preview(Result const& result,
     }
 
     ReplyObject::SPtr ro(make_shared<PreviewReplyObject>(reply, runtime_, to_string(), fwd()->debug_mode()));
+
+    auto cache = runtime_->preview_cache();
+    if (cache)
+    {
+        auto entry = cache->lookup(to_string(), PreviewCache::key(result, hints));
+        if (entry)
+        {
+            return replay_preview(entry, ro);
+        }
+    }
+    return send_preview(result, hints, ro);
+}
+
+QueryCtrlProxy ScopeImpl::send_preview(Result const& result,
+                                       ActionMetadata const& hints,
+                                       ReplyObject::SPtr const& ro)
+{
     MWReplyProxy rp = fwd()->mw_base()->add_reply_object(ro);
 
     shared_ptr<QueryCtrlImpl> ctrl = make_shared<QueryCtrlImpl>(nullptr, rp);
@@ -312,14 +398,10 @@ QueryCtrlProxy ScopeImpl::preview(Result const& result,
     {
         try
         {
-            auto real_ctrl = dynamic_pointer_cast<QueryCtrlImpl>(impl->fwd()->preview(result.p->activation_target(),
-                                                                                      hints.serialize(),
-                                                                                      rp));
-            assert(real_ctrl);
-
-            auto new_proxy = dynamic_pointer_cast<MWQueryCtrl>(real_ctrl->proxy());
-            assert(new_proxy);
-            ctrl->set_proxy(new_proxy);
+            impl->fwd()->preview_async(result.p->activation_target(),
+                                       hints.serialize(),
+                                       rp,
+                                       make_ctrl_callback(impl, ctrl, rp));
         }
         catch (std::exception const& e)
         {
@@ -338,6 +420,31 @@ QueryCtrlProxy ScopeImpl::preview(Result const& result,
     return ctrl;
 }
 
+// Passes the cached replies to the reply object as if they had come from the scope.
+// We still register the reply object with the middleware, so it is disconnected
+// in the normal way when it finishes. The query cannot be cancelled, but it
+// completes without any remote calls anyway.
+
+QueryCtrlProxy ScopeImpl::replay_preview(PreviewCache::Entry::SCPtr const& entry, ReplyObject::SPtr const& ro)
+{
+    MWReplyProxy rp = fwd()->mw_base()->add_reply_object(ro);
+
+    shared_ptr<QueryCtrlImpl> ctrl = make_shared<QueryCtrlImpl>(nullptr, rp);
+
+    auto replay = [entry, ro]() -> void
+    {
+        for (auto const& data : entry->replies)
+        {
+            ro->push(data);
+        }
+        ro->finished(CompletionDetails(CompletionDetails::OK));
+    };
+
+    auto future = runtime_->async_pool()->submit(replay);
+    runtime_->future_queue()->push(move(future));
+    return ctrl;
+}
+
 QueryCtrlProxy ScopeImpl::activate_result_action(Result const& result,
                                       ActionMetadata const& metadata,
                                       std::string const& action_id,
@@ -359,16 +466,11 @@ QueryCtrlProxy ScopeImpl::activate_result_action(Result const& result,
     {
         try
         {
-            auto real_ctrl = dynamic_pointer_cast<QueryCtrlImpl>(impl->fwd()->activate_result_action(
-                                                                               result.p->activation_target(),
-                                                                               metadata.serialize(),
-                                                                               action_id,
-                                                                               rp));
-            assert(real_ctrl);
-
-            auto new_proxy = dynamic_pointer_cast<MWQueryCtrl>(real_ctrl->proxy());
-            assert(new_proxy);
-            ctrl->set_proxy(new_proxy);
+            impl->fwd()->activate_result_action_async(result.p->activation_target(),
+                                                      metadata.serialize(),
+                                                      action_id,
+                                                      rp,
+                                                      make_ctrl_callback(impl, ctrl, rp));
         }
         catch (std::exception const& e)
         {
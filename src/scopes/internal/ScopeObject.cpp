@@ -48,9 +48,16 @@ namespace scopes
 namespace internal
 {
 
-ScopeObject::ScopeObject(ScopeBase* scope_base, bool debug_mode) :
+ScopeObject::ScopeObject(ScopeBase* scope_base,
+                         bool debug_mode,
+                         SurfacingCache::SPtr const& surfacing_cache,
+                         string const& scope_id) :
     scope_base_(scope_base),
-    debug_mode_(debug_mode)
+    debug_mode_(debug_mode),
+    surfacing_cache_(surfacing_cache),
+    query_token_(make_shared<int>(0)),
+    cancellation_stats_(make_shared<CancellationStats>()),
+    scope_id_(scope_id)
 {
     assert(scope_base);
 }
@@ -72,7 +79,7 @@ MWQueryCtrlProxy ScopeObject::query(MWReplyProxy const& reply,
         // to be safe, we don't assert, in case someone is running a broken client.
 
         // TODO: log error about incoming request containing an invalid reply proxy.
-        throw LogicException("Scope \"" + mw_base->runtime()->scope_id() + "\": "
+        throw LogicException("Scope \"" + scope_id(mw_base) + "\": "
                              + method + " called with null reply proxy");
     }
 
@@ -83,15 +90,19 @@ MWQueryCtrlProxy ScopeObject::query(MWReplyProxy const& reply,
         query_base = query_factory_fun();
         if (!query_base)
         {
-            string msg = "Scope \"" + mw_base->runtime()->scope_id() + "\" returned nullptr from " + method + "()";
+            string msg = "Scope \"" + scope_id(mw_base) + "\" returned nullptr from " + method + "()";
             mw_base->runtime()->logger()() << msg;
             throw ResourceException(msg);
         }
         query_base->p->set_settings_db(scope_base_->p->settings_db());
+
+        // The query keeps a reference to query_token_ for as long as it exists.
+        auto holder = make_shared<pair<QueryBase::SPtr, shared_ptr<int>>>(query_base, query_token_);
+        query_base = QueryBase::SPtr(holder, holder->first.get());
     }
     catch (...)
     {
-        string msg = "Scope \"" + mw_base->runtime()->scope_id() + "\" threw an exception from " + method + "()";
+        string msg = "Scope \"" + scope_id(mw_base) + "\" threw an exception from " + method + "()";
         mw_base->runtime()->logger()() << msg;
         throw ResourceException(msg);
     }
@@ -108,6 +119,11 @@ MWQueryCtrlProxy ScopeObject::query(MWReplyProxy const& reply,
         // to destroy itself.
         QueryObjectBase::SPtr qo(query_object_factory_fun(query_base, ctrl_proxy));
         MWQueryProxy query_proxy = mw_base->add_query_object(qo);
+        auto query_object = dynamic_pointer_cast<QueryObject>(qo);
+        if (query_object)
+        {
+            query_object->set_cancellation_stats(cancellation_stats_);
+        }
 
         // We tell the ctrl what the query facade is so, when cancel() is sent
         // to the ctrl, it can forward it to the facade.
@@ -191,10 +207,43 @@ MWQueryCtrlProxy ScopeObject::search(CannedQuery const& q,
                          sqb->set_history(history);
                       }
 
+                      // Hashes of the renderer templates that the client has received from us before.
+                      auto const r_it = context.find("renderers");
+                      if (r_it != context.end())
+                      {
+                          set<string> hashes;
+                          for (auto const& h : r_it->second.get_array())
+                          {
+                              hashes.insert(h.get_string());
+                          }
+                          sqb->set_known_renderers(hashes);
+                      }
+
                       return search_query;
                  },
-                 [&reply, &hints, this](QueryBase::SPtr query_base, MWQueryCtrlProxy ctrl_proxy) -> QueryObjectBase::SPtr {
-                     return make_shared<QueryObject>(query_base, hints.cardinality(), reply, ctrl_proxy);
+                 [&q, &reply, &hints, this](QueryBase::SPtr query_base, MWQueryCtrlProxy ctrl_proxy) -> QueryObjectBase::SPtr {
+                     auto qo = make_shared<QueryObject>(query_base, hints.cardinality(), reply, ctrl_proxy);
+                     if (!scope_id_.empty())
+                     {
+                         // We share the run time with other scopes, so its cache directory is not ours.
+                         try
+                         {
+                             qo->set_cache_directory(this->scope_base_->p->cache_directory());
+                         }
+                         catch (...)
+                         {
+                             // Can't happen: the run time sets the cache directory before it creates us.
+                         }
+                     }
+                     if (surfacing_cache_)
+                     {
+                         auto const key = SurfacingCache::key(q, hints);
+                         if (!key.empty())
+                         {
+                             qo->set_surfacing_cache(surfacing_cache_, key);
+                         }
+                     }
+                     return qo;
                  }
     );
 }
@@ -293,6 +342,22 @@ bool ScopeObject::debug_mode() const
     return debug_mode_;
 }
 
+long ScopeObject::active_queries() const noexcept
+{
+    return query_token_.use_count() - 1;
+}
+
+CancellationStats::SPtr ScopeObject::cancellation_stats() const noexcept
+{
+    return cancellation_stats_;
+}
+
+string ScopeObject::scope_id(MiddlewareBase* mw_base) const
+{
+    // If we share the run time with other scopes, its scope ID is that of the scope host.
+    return scope_id_.empty() ? mw_base->runtime()->scope_id() : scope_id_;
+}
+
 } // namespace internal
 
 } // namespace scopes
@@ -48,7 +48,8 @@ SearchQueryBaseImpl::SearchQueryBaseImpl(CannedQuery const& query, SearchMetadat
     : QueryBaseImpl(),
       canned_query_(query),
       search_metadata_(metadata),
-      valid_(true)
+      valid_(true),
+      runtime_(nullptr)
 {
 }
 
@@ -105,8 +106,12 @@ QueryCtrlProxy SearchQueryBaseImpl::subsearch(ScopeProxy const& scope,
         //             We need to remove this once a scope is able to do this itself.
         SearchMetadata clean_metadata = filter_metadata(scope_impl, metadata);
 
+        // We pass our own scope ID as the client ID because our run time may be shared with other scopes.
         query_ctrl = scope_impl->search(query_string, department_id, filter_state, std::move(user_data), clean_metadata,
-                                        history_, reply);
+                                        history_, reply, canned_query_.scope_id());
+
+        lock_guard<mutex> lock(mutex_);
+        runtime_ = scope_impl->runtime();
     }
     else
     {
@@ -115,28 +120,59 @@ QueryCtrlProxy SearchQueryBaseImpl::subsearch(ScopeProxy const& scope,
                          scope->search(query_string, department_id, filter_state, metadata, reply);
     }
 
-    lock_guard<mutex> lock(mutex_);
-    subqueries_.push_back(query_ctrl);  // Remember subsearch in case we get a cancel() later that we need to forward.
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (valid_)
+        {
+            subqueries_.push_back(query_ctrl);  // Remember subsearch in case we get a cancel() later that we need to forward.
+            return query_ctrl;
+        }
+    }
+    // We were cancelled while the subsearch was being sent, so it won't be cancelled by cancel().
+    query_ctrl->cancel();
     return query_ctrl;
 }
 
 void SearchQueryBaseImpl::cancel()
 {
-    lock_guard<mutex> lock(mutex_);
-
-    if (!valid_)
+    vector<QueryCtrlProxy> subqueries;
+    RuntimeImpl* runtime;
     {
-        return;
+        lock_guard<mutex> lock(mutex_);
+
+        if (!valid_)
+        {
+            return;
+        }
+        valid_ = false;
+        // We take the subquery controls out of the member here. Once cancelled, this QueryBase
+        // will be destroyed shortly anyway, so there is no point in keeping them.
+        subqueries.swap(subqueries_);
+        runtime = runtime_;
     }
-    valid_ = false;
-    for (auto& ctrl : subqueries_)
+
+    // Forward the cancellation to any subqueries that might be active. Each cancel sends
+    // a message, so we cancel the subqueries in parallel, instead of one after the other,
+    // and without holding the lock. The last one is cancelled by the calling thread.
+    ThreadPool::SPtr pool = runtime ? runtime->async_pool() : nullptr;
+    for (size_t i = 0; i < subqueries.size(); ++i)
     {
-        ctrl->cancel(); // Forward the cancellation to any subqueries that might be active
+        QueryCtrlProxy ctrl = subqueries[i];
+        if (pool && i + 1 < subqueries.size())
+        {
+            try
+            {
+                auto future = pool->submit([ctrl] { ctrl->cancel(); });
+                runtime->future_queue()->push(move(future));
+                continue;
+            }
+            catch (std::exception const&)
+            {
+                // Run time is shutting down, cancel synchronously below.
+            }
+        }
+        ctrl->cancel();
     }
-    // We release the memory for the subquery controls here. That's just a micro-optimization
-    // because this QueryBase will be destroyed shortly anyway, once the cancelled() (and possibly
-    // run()) methods of the application return. (Not deallocating here would work too.)
-    vector<QueryCtrlProxy>().swap(subqueries_);
 }
 
 void SearchQueryBaseImpl::set_department_id(std::string const& department_id)
@@ -163,6 +199,18 @@ void SearchQueryBaseImpl::set_history(History const& h)
     history_ = h;
 }
 
+void SearchQueryBaseImpl::set_known_renderers(std::set<std::string> const& hashes)
+{
+    lock_guard<mutex> lock(mutex_);
+    known_renderers_ = hashes;
+}
+
+std::set<std::string> SearchQueryBaseImpl::known_renderers() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return known_renderers_;
+}
+
 bool SearchQueryBaseImpl::valid() const
 {
     lock_guard<mutex> lock(mutex_);
@@ -21,6 +21,7 @@
 
 #include <unity/scopes/Annotation.h>
 #include <unity/scopes/internal/CategorisedResultImpl.h>
+#include <unity/scopes/internal/CategoryRendererImpl.h>
 #include <unity/scopes/internal/DepartmentImpl.h>
 #include <unity/scopes/internal/FilterBaseImpl.h>
 #include <unity/scopes/internal/FilterStateImpl.h>
@@ -53,7 +54,8 @@ SearchReplyImpl::SearchReplyImpl(MWReplyProxy const& mw_proxy,
                                  shared_ptr<QueryObjectBase> const& qo,
                                  int cardinality,
                                  string const& query_string,
-                                 string const& current_department_id)
+                                 string const& current_department_id,
+                                 set<string> const& known_renderers)
     : ObjectImpl(mw_proxy)
     , ReplyImpl(mw_proxy, qo)
     , cat_registry_(new CategoryRegistry())
@@ -62,6 +64,7 @@ SearchReplyImpl::SearchReplyImpl(MWReplyProxy const& mw_proxy,
     , finished_(false)
     , query_string_(query_string)
     , current_department_(current_department_id)
+    , known_renderers_(known_renderers)
 {
 }
 
@@ -141,9 +144,7 @@ bool SearchReplyImpl::push(unity::scopes::CategorisedResult const& result)
         register_category(result.category());
     }
 
-    VariantMap var;
-    var["result"] = result.serialize();
-    if (!ReplyImpl::push(var))
+    if (!push_result(ResultImpl::get(result)))
     {
         return false;
     }
@@ -205,8 +206,19 @@ bool SearchReplyImpl::push(unity::scopes::Filters const& filters)
 
 bool SearchReplyImpl::push(Category::SCPtr category)
 {
+    VariantMap cat = category->serialize();
+    if (!known_renderers_.empty())
+    {
+        // If the client has the template already, we send just its hash.
+        auto const hash = CategoryRendererImpl::hash(category->renderer_template());
+        if (known_renderers_.find(hash) != known_renderers_.end())
+        {
+            cat.erase("renderer_template");
+            cat["renderer_hash"] = hash;
+        }
+    }
     VariantMap var;
-    var["category"] = category->serialize();
+    var["category"] = move(cat);
     return ReplyImpl::push(var);
 }
 
@@ -217,9 +229,69 @@ void SearchReplyImpl::finished()
         return;
     }
     write_cached_results();
+    store_surfacing_results();
     ReplyImpl::finished();  // Upcall to deal with the normal case
 }
 
+void SearchReplyImpl::set_surfacing_cache(SurfacingCache::SPtr const& cache, string const& key)
+{
+    assert(query_string_.empty());
+
+    lock_guard<mutex> lock(mutex_);
+    surfacing_cache_ = cache;
+    surfacing_cache_key_ = key;
+}
+
+void SearchReplyImpl::set_cache_directory(string const& dir)
+{
+    cache_directory_ = dir;
+}
+
+string SearchReplyImpl::cache_directory() const
+{
+    return cache_directory_.empty() ? mw_proxy_->mw_base()->runtime()->cache_directory() : cache_directory_;
+}
+
+void SearchReplyImpl::store_surfacing_results() noexcept
+{
+    assert(finished_);
+
+    try
+    {
+        SurfacingCache::SPtr cache;
+        string key;
+        auto entry = make_shared<SurfacingCache::Entry>();
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (!surfacing_cache_)
+            {
+                return;
+            }
+            cache = surfacing_cache_;
+            key = surfacing_cache_key_;
+            entry->departments = cached_departments_;
+            entry->filters = cached_filters_;
+            entry->results = cached_results_;
+        }
+        if (!pushable())
+        {
+            return;  // Don't cache the results of a query that was cancelled or failed.
+        }
+        entry->categories = cat_registry_->categories();
+        cache->store(key, entry);
+    }
+    // LCOV_EXCL_START
+    catch (std::exception const& e)
+    {
+        mw_proxy_->mw_base()->runtime()->logger()() << "SearchReply::store_surfacing_results(): " << e.what();
+    }
+    catch (...)
+    {
+        mw_proxy_->mw_base()->runtime()->logger()() << "SearchReply::store_surfacing_results(): unknown exception";
+    }
+    // LCOV_EXCL_STOP
+}
+
 static constexpr char const* cache_file_name = ".surfacing_cache";
 
 void SearchReplyImpl::write_cached_results() noexcept
@@ -235,7 +307,7 @@ void SearchReplyImpl::write_cached_results() noexcept
     try
     {
         // Open a temporary file for writing.
-        tmp_path = mw_proxy_->mw_base()->runtime()->cache_directory() + "/" + cache_file_name + "XXXXXX";
+        tmp_path = cache_directory() + "/" + cache_file_name + "XXXXXX";
         auto opener = [&tmp_path]()
         {
             int tmp_fd = mkstemp(const_cast<char*>(tmp_path.c_str()));
@@ -296,7 +368,7 @@ void SearchReplyImpl::write_cached_results() noexcept
         tmp_file.dealloc();  // Close tmp file.
 
         // Atomically replace the old cache with the new one.
-        string cache_path = mw_proxy_->mw_base()->runtime()->cache_directory() + "/" + cache_file_name;
+        string cache_path = cache_directory() + "/" + cache_file_name;
         if (rename(tmp_path.c_str(), cache_path.c_str()) == -1)
         {
             throw FileException("cannot rename tmp file " + tmp_path + " to " + cache_path, errno);  // LCOV_EXCL_LINE
@@ -328,7 +400,7 @@ void SearchReplyImpl::push_surfacing_results_from_cache() noexcept
         return;
     }
 
-    string cache_path = mw_proxy_->mw_base()->runtime()->cache_directory() + "/" + cache_file_name;
+    string cache_path = cache_directory() + "/" + cache_file_name;
     try
     {
         // Read cache file.
@@ -428,6 +500,47 @@ void SearchReplyImpl::push_surfacing_results_from_cache() noexcept
     ReplyImpl::finished();
 }
 
+void SearchReplyImpl::push_surfacing_results(SurfacingCache::Entry const& entry) noexcept
+{
+    if (finished_.exchange(true))
+    {
+        return;
+    }
+
+    try
+    {
+        if (entry.departments)
+        {
+            register_departments(entry.departments);
+        }
+        for (auto const& c : entry.categories)
+        {
+            register_category(c);
+        }
+        push(entry.filters);
+        for (auto const& r : entry.results)
+        {
+            if (!push(r))
+            {
+                break;  // Cardinality limit reached.
+            }
+        }
+    }
+    catch (std::exception const& e)
+    {
+        mw_proxy_->mw_base()->runtime()->logger()() << "SearchReply::push_surfacing_results(): " << e.what();
+    }
+    // LCOV_EXCL_START
+    catch (...)
+    {
+        mw_proxy_->mw_base()->runtime()->logger()() << "SearchReply::push_surfacing_results(): unknown exception";
+    }
+    // LCOV_EXCL_STOP
+
+    // Query is complete.
+    ReplyImpl::finished();
+}
+
 } // namespace internal
 
 } // namespace scopes
@@ -28,6 +28,7 @@
 #include <boost/filesystem.hpp>
 
 #include <fcntl.h>
+#include <sys/inotify.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -120,6 +121,10 @@ SettingsDB::SettingsDB(string const& db_path, SettingsSchema const& schema)
     , last_write_time_nsec_(-1)
     , last_write_time_sec_(-1)
     , last_write_inode_(0)
+    , inotify_fd_(-1)
+    , watch_fd_(-1)
+    , watching_(false)
+    , stopping_(false)
 {
     // Initialize the def_map_ so we can look things
     // up quickly.
@@ -128,6 +133,156 @@ SettingsDB::SettingsDB(string const& db_path, SettingsSchema const& schema)
     {
         def_map_.emplace(make_pair(d.get_dict()["id"].get_string(), d));
     }
+
+    // Start watching before the first read, so we can't miss a change in between.
+    start_watch();
+    refresh();
+}
+
+SettingsDB::~SettingsDB()
+{
+    stop_watch();
+}
+
+// We watch the directory rather than the file, so we notice when the DB is
+// created, deleted, or replaced by a rename. If the directory doesn't exist
+// (yet), or the watch can't be established for some other reason, settings()
+// falls back to checking the DB on each call.
+
+void SettingsDB::start_watch()
+{
+    boost::filesystem::path dir = boost::filesystem::path(db_path_).parent_path();
+    if (dir.empty())
+    {
+        dir = ".";
+    }
+
+    inotify_fd_ = inotify_init1(IN_CLOEXEC);
+    if (inotify_fd_ < 0)
+    {
+        return;
+    }
+    watch_fd_ = inotify_add_watch(inotify_fd_, dir.c_str(), IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM |
+                                                            IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE |
+                                                            IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (watch_fd_ < 0)
+    {
+        ::close(inotify_fd_);
+        inotify_fd_ = -1;
+        return;
+    }
+    watching_ = true;
+    watcher_ = thread(&SettingsDB::watch_thread, this);
+}
+
+void SettingsDB::stop_watch()
+{
+    if (watcher_.joinable())
+    {
+        stopping_ = true;
+        inotify_rm_watch(inotify_fd_, watch_fd_);  // Causes read() in the watcher to return.
+        watcher_.join();
+    }
+    if (inotify_fd_ >= 0)
+    {
+        ::close(inotify_fd_);
+    }
+}
+
+void SettingsDB::watch_thread()
+{
+    string const filename = boost::filesystem::path(db_path_).filename().native();
+
+    alignas(inotify_event) char buf[4096];
+    while (true)
+    {
+        ssize_t bytes_read = ::read(inotify_fd_, buf, sizeof(buf));
+        if (bytes_read < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        // A burst of events, such as a write followed by a close, results in a single refresh.
+        bool changed = false;
+        bool watch_gone = false;
+        for (ssize_t i = 0; i < bytes_read; )
+        {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-align"
+            auto event = reinterpret_cast<inotify_event const*>(&buf[i]);
+#pragma GCC diagnostic pop
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                watch_gone = true;
+            }
+            else if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && filename == event->name))
+            {
+                changed = true;
+            }
+            i += sizeof(inotify_event) + event->len;
+        }
+
+        if (stopping_)
+        {
+            break;
+        }
+        if (changed || watch_gone)
+        {
+            refresh();
+        }
+        if (watch_gone)
+        {
+            break;  // Directory was removed, we can't see changes anymore.
+        }
+    }
+    watching_ = false;
+}
+
+void SettingsDB::refresh()
+{
+    auto snapshot = make_shared<Snapshot>();
+    {
+        lock_guard<mutex> lock(mutex_);
+        snapshot->file_state = file_state();
+        try
+        {
+            process_all_docs();
+        }
+        catch (...)
+        {
+            snapshot->error = current_exception();
+        }
+        snapshot->values = values_;
+    }
+    atomic_store(&snapshot_, shared_ptr<Snapshot const>(snapshot));
+    lock_guard<mutex> lock(snapshot_mutex_);
+    snapshot_cond_.notify_all();
+}
+
+SettingsDB::FileState SettingsDB::file_state() const
+{
+    FileState state = FileState();
+    struct stat st;
+    if (::stat(db_path_.c_str(), &st) == 0)
+    {
+        state.exists = true;
+        state.ctime = st.st_ctim;
+        state.inode = st.st_ino;
+    }
+    return state;
+}
+
+bool SettingsDB::FileState::operator==(FileState const& other) const
+{
+    if (!exists || !other.exists)
+    {
+        return exists == other.exists;
+    }
+    return ctime.tv_sec == other.ctime.tv_sec && ctime.tv_nsec == other.ctime.tv_nsec && inode == other.inode;
 }
 
 // Called once for each setting. We are lenient when parsing
@@ -267,8 +422,33 @@ void SettingsDB::set_defaults()
 
 VariantMap SettingsDB::settings()
 {
-    process_all_docs();
-    return values_;
+    if (!watching_)
+    {
+        refresh();
+    }
+    auto snapshot = atomic_load(&snapshot_);
+    if (snapshot->error)
+    {
+        rethrow_exception(snapshot->error);
+    }
+    return snapshot->values;
+}
+
+// The snapshot is current once it was made by a refresh that saw the DB file as it is now.
+// Any change to the file (including a chmod) changes its ctime, and we refresh after every change.
+
+bool SettingsDB::wait_for_refresh(chrono::milliseconds timeout)
+{
+    if (!watching_)
+    {
+        return true;  // settings() reads the DB itself.
+    }
+    FileState const current = file_state();
+    unique_lock<mutex> lock(snapshot_mutex_);
+    return snapshot_cond_.wait_for(lock, timeout, [this, &current]
+    {
+        return atomic_load(&snapshot_)->file_state == current;
+    });
 }
 
 }  // namespace internal
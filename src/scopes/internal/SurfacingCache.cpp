@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/SurfacingCache.h>
+
+#include <unity/UnityExceptions.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+SurfacingCache::SurfacingCache(ScopeMetadata::ResultsTtlType ttl_type, int max_entries)
+    : SurfacingCache(ttl(ttl_type), max_entries)
+{
+}
+
+SurfacingCache::SurfacingCache(chrono::steady_clock::duration ttl, int max_entries)
+    : ttl_(ttl)
+    , max_entries_(max_entries)
+    , hits_(0)
+    , stale_hits_(0)
+    , misses_(0)
+{
+    if (ttl <= chrono::steady_clock::duration::zero())
+    {
+        throw InvalidArgumentException("SurfacingCache(): ttl must be greater than zero");
+    }
+    if (max_entries < 1)
+    {
+        throw InvalidArgumentException("SurfacingCache(): invalid max_entries: " + std::to_string(max_entries));
+    }
+}
+
+// The values match the description of ResultsTtlType in the tutorial.
+
+chrono::seconds SurfacingCache::ttl(ScopeMetadata::ResultsTtlType ttl_type)
+{
+    switch (ttl_type)
+    {
+        case ScopeMetadata::ResultsTtlType::Small:
+            return chrono::seconds(60);
+        case ScopeMetadata::ResultsTtlType::Medium:
+            return chrono::seconds(5 * 60);
+        case ScopeMetadata::ResultsTtlType::Large:
+            return chrono::seconds(60 * 60);
+        default:
+            return chrono::seconds(0);
+    }
+}
+
+string SurfacingCache::key(CannedQuery const& query, SearchMetadata const& metadata)
+{
+    if (!query.query_string().empty())
+    {
+        return string();  // Only surfacing queries are cached.
+    }
+
+    // The canned query includes the department and filter state. The metadata includes
+    // the location, so results are never served for a location other than the one they
+    // were created for. (The runtime does not create a cache for scopes that need the location.)
+    return query.to_uri() + "\n" + Variant(metadata.serialize()).serialize_json();
+}
+
+SurfacingCache::Entry::SCPtr SurfacingCache::lookup(string const& key, bool& stale)
+{
+    assert(!key.empty());
+
+    lock_guard<mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        ++misses_;
+        return nullptr;
+    }
+    stale = chrono::steady_clock::now() - it->second->created >= ttl_;
+    if (stale)
+    {
+        ++stale_hits_;
+    }
+    else
+    {
+        ++hits_;
+    }
+    return it->second;
+}
+
+void SurfacingCache::store(string const& key, Entry::SPtr const& entry)
+{
+    assert(!key.empty());
+    assert(entry);
+
+    entry->created = chrono::steady_clock::now();
+
+    lock_guard<mutex> lock(mutex_);
+    if (entries_.size() >= max_entries_ && entries_.find(key) == entries_.end())
+    {
+        // Make room by evicting the oldest entry.
+        auto oldest = entries_.begin();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->second->created < oldest->second->created)
+            {
+                oldest = it;
+            }
+        }
+        entries_.erase(oldest);
+    }
+    entries_[key] = entry;
+}
+
+bool SurfacingCache::begin_refresh(string const& key)
+{
+    lock_guard<mutex> lock(mutex_);
+    return refreshing_.insert(key).second;
+}
+
+void SurfacingCache::end_refresh(string const& key)
+{
+    lock_guard<mutex> lock(mutex_);
+    refreshing_.erase(key);
+}
+
+int64_t SurfacingCache::hits() const
+{
+    return hits_;
+}
+
+int64_t SurfacingCache::stale_hits() const
+{
+    return stale_hits_;
+}
+
+int64_t SurfacingCache::misses() const
+{
+    return misses_;
+}
+
+SurfacingRefreshReply::SurfacingRefreshReply(SurfacingCache::SPtr const& cache, string const& key, int cardinality)
+    : SearchReply()
+    , cache_(cache)
+    , key_(key)
+    , cardinality_(cardinality)
+    , finished_(false)
+    , entry_(make_shared<SurfacingCache::Entry>())
+{
+    assert(cache);
+}
+
+SurfacingRefreshReply::~SurfacingRefreshReply()
+{
+    // A query that returns from run() without calling finished() finishes normally,
+    // the same as for SearchReplyImpl.
+    complete(true);
+}
+
+void SurfacingRefreshReply::register_departments(Department::SCPtr const& parent)
+{
+    lock_guard<mutex> lock(mutex_);
+    if (entry_)
+    {
+        entry_->departments = parent;
+    }
+}
+
+Category::SCPtr SurfacingRefreshReply::register_category(string const& id,
+                                                         string const& title,
+                                                         string const &icon,
+                                                         CategoryRenderer const& renderer_template)
+{
+    return cat_registry_.register_category(id, title, icon, nullptr, renderer_template);
+}
+
+Category::SCPtr SurfacingRefreshReply::register_category(string const& id,
+                                                         string const& title,
+                                                         string const &icon,
+                                                         CannedQuery const &query,
+                                                         CategoryRenderer const& renderer_template)
+{
+    return cat_registry_.register_category(id, title, icon, make_shared<CannedQuery>(query), renderer_template);
+}
+
+void SurfacingRefreshReply::register_category(Category::SCPtr category)
+{
+    cat_registry_.register_category(category);
+}
+
+Category::SCPtr SurfacingRefreshReply::lookup_category(string const& id)
+{
+    return cat_registry_.lookup_category(id);
+}
+
+bool SurfacingRefreshReply::push(unity::scopes::experimental::Annotation const&)
+{
+    lock_guard<mutex> lock(mutex_);
+    return entry_ != nullptr;  // Annotations are not cached.
+}
+
+bool SurfacingRefreshReply::push(unity::scopes::CategorisedResult const& result)
+{
+    if (cat_registry_.lookup_category(result.category()->id()) == nullptr)
+    {
+        cat_registry_.register_category(result.category());
+    }
+
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (!entry_)
+        {
+            return false;
+        }
+        entry_->results.push_back(result);
+        if (cardinality_ == 0 || int(entry_->results.size()) < cardinality_)
+        {
+            return true;
+        }
+    }
+    finished();
+    return false;
+}
+
+bool SurfacingRefreshReply::push(unity::scopes::Filters const& filters, unity::scopes::FilterState const&)
+{
+    return push(filters);
+}
+
+bool SurfacingRefreshReply::push(unity::scopes::Filters const& filters)
+{
+    lock_guard<mutex> lock(mutex_);
+    if (!entry_)
+    {
+        return false;
+    }
+    entry_->filters = filters;
+    return true;
+}
+
+void SurfacingRefreshReply::push_surfacing_results_from_cache() noexcept
+{
+    // The scope has no new results. The cache entry remains stale, so we try again next time.
+    lock_guard<mutex> lock(mutex_);
+    entry_.reset();
+}
+
+void SurfacingRefreshReply::finished()
+{
+    complete(true);
+}
+
+void SurfacingRefreshReply::error(std::exception_ptr)
+{
+    complete(false);
+}
+
+void SurfacingRefreshReply::info(OperationInfo const&)
+{
+}
+
+string SurfacingRefreshReply::endpoint()
+{
+    return string();
+}
+
+string SurfacingRefreshReply::identity()
+{
+    return string();
+}
+
+string SurfacingRefreshReply::target_category()
+{
+    return string();
+}
+
+int64_t SurfacingRefreshReply::timeout()
+{
+    return -1;
+}
+
+string SurfacingRefreshReply::to_string()
+{
+    return "SurfacingRefreshReply(" + key_ + ")";
+}
+
+void SurfacingRefreshReply::complete(bool ok)
+{
+    SurfacingCache::Entry::SPtr entry;
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (finished_)
+        {
+            return;
+        }
+        finished_ = true;
+        entry = move(entry_);
+    }
+    if (ok && entry)
+    {
+        entry->categories = cat_registry_.categories();
+        cache_->store(key_, entry);
+    }
+    cache_->end_refresh(key_);
+}
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
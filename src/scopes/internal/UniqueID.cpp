@@ -29,25 +29,73 @@ namespace scopes
 namespace internal
 {
 
+namespace
+{
+
+atomic<uint64_t> instance_count(0);
+
+// The counter values that the calling thread can still hand out, for the generator it used last.
+// A thread that alternates between generators takes a new block whenever it switches.
+
+struct CounterBlock
+{
+    uint64_t instance = 0;
+    uint32_t next = 0;
+    uint32_t end = 0;
+};
+
+thread_local CounterBlock block;
+
+// splitmix64 finalizer, so consecutive counter values produce unrelated random parts.
+
+inline uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+inline void to_hex(uint32_t v, char* p)
+{
+    static char const digits[] = "0123456789abcdef";
+    for (int i = 7; i >= 0; --i)
+    {
+        p[i] = digits[v & 0xf];
+        v >>= 4;
+    }
+}
+
+} // namespace
+
+constexpr uint32_t UniqueID::block_size;
+
 UniqueID::UniqueID() :
     UniqueID(random_device()())
 {
 }
 
 UniqueID::UniqueID(std::mt19937::result_type seed) :
-    engine(seed),
-    counter(0)
+    salt_(mt19937_64(seed)()),
+    instance_(++instance_count),
+    next_block_(0)
 {
-    s << hex << setfill('0');
 }
 
 string UniqueID::gen()
 {
-    lock_guard<std::mutex> lock(m);
-    s << setw(8) << uniform_dist(engine) << setw(8) << counter++;
-    string id(s.str());
-    s.str("");
-    return id;
+    if (block.instance != instance_ || block.next == block.end)
+    {
+        block.instance = instance_;
+        block.next = next_block_.fetch_add(block_size, memory_order_relaxed);
+        block.end = block.next + block_size;
+    }
+    uint32_t const counter = block.next++;
+
+    char buf[16];
+    to_hex(uint32_t(mix(salt_ ^ counter)), buf);
+    to_hex(counter, buf + 8);
+    return string(buf, sizeof(buf));
 }
 
 } // namespace internal
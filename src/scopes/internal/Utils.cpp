@@ -51,24 +51,32 @@ VariantMap::const_iterator find_or_throw(string const& context, VariantMap const
     return it;
 }
 
-string to_percent_encoding(string const& str)
+namespace
 {
-    ostringstream result;
-    for (auto const& c: str)
+
+inline bool is_unreserved(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+inline int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
     {
-        if ((!isalnum(c)))
-        {
-            result << '%' << setw(2) << setfill('0') << hex << uppercase << static_cast<int>(static_cast<unsigned char>(c)) << nouppercase;
-        }
-        else
-        {
-            result << c;
-        }
+        return c - '0';
     }
-    return result.str();
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
 }
 
-string from_percent_encoding(string const& str)
+string decode_percent_encoding_slow(string const& str)
 {
     ostringstream result;
     for (auto it = str.begin(); it != str.end(); it++)
@@ -111,6 +119,66 @@ string from_percent_encoding(string const& str)
     return result.str();
 }
 
+} // namespace
+
+void append_percent_encoding(char const* str, size_t len, string& out)
+{
+    static char const hex_digits[] = "0123456789ABCDEF";
+
+    for (auto end = str + len; str != end; ++str)
+    {
+        char const c = *str;
+        if (is_unreserved(c))
+        {
+            out += c;
+        }
+        else
+        {
+            auto const u = static_cast<unsigned char>(c);
+            char const encoded[] = { '%', hex_digits[u >> 4], hex_digits[u & 0xf] };
+            out.append(encoded, sizeof(encoded));
+        }
+    }
+}
+
+void append_percent_decoding(char const* begin, char const* end, string& out)
+{
+    for (auto p = begin; p != end; ++p)
+    {
+        if (*p != '%')
+        {
+            out += *p;
+            continue;
+        }
+        int hi, lo;
+        if (end - p < 3 || (hi = hex_value(p[1])) < 0 || (lo = hex_value(p[2])) < 0)
+        {
+            // Malformed, or at least unusual. Leave it to the slow path, so we accept
+            // and reject exactly what we always did, with the same error messages.
+            out += decode_percent_encoding_slow(string(p, end));
+            return;
+        }
+        out += static_cast<char>(hi << 4 | lo);
+        p += 2;
+    }
+}
+
+string to_percent_encoding(string const& str)
+{
+    string result;
+    result.reserve(str.size() * 3);
+    append_percent_encoding(str.data(), str.size(), result);
+    return result;
+}
+
+string from_percent_encoding(string const& str)
+{
+    string result;
+    result.reserve(str.size());
+    append_percent_decoding(str.data(), str.data() + str.size(), result);
+    return result;
+}
+
 string uncamelcase(string const& str)
 {
     const locale loc("C"); // Use "C" to avoid the Turkish I problem
@@ -0,0 +1,523 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/inproc_middleware/InprocMiddleware.h>
+
+#include <unity/scopes/internal/DfltConfig.h>
+#include <unity/scopes/internal/inproc_middleware/InprocQuery.h>
+#include <unity/scopes/internal/inproc_middleware/InprocQueryCtrl.h>
+#include <unity/scopes/internal/inproc_middleware/InprocReply.h>
+#include <unity/scopes/internal/inproc_middleware/InprocScope.h>
+#include <unity/scopes/internal/inproc_middleware/InprocStateReceiver.h>
+#include <unity/scopes/internal/RuntimeImpl.h>
+#include <unity/scopes/internal/ScopeImpl.h>
+#include <unity/scopes/ScopeExceptions.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+namespace
+{
+
+char const* query_suffix = "-q";     // Appended to server_name_ to create query adapter name
+char const* ctrl_suffix = "-c";      // Appended to server_name_ to create control adapter name
+char const* reply_suffix = "-r";     // Appended to server_name_ to create reply adapter name
+char const* state_suffix = "-s";     // Appended to server_name_ to create state adapter name
+
+char const* query_category = "Query";       // query adapter category name
+char const* ctrl_category = "QueryCtrl";    // control adapter category name
+char const* reply_category = "Reply";       // reply adapter category name
+char const* state_category = "State";       // state adapter category name
+char const* scope_category = "Scope";       // scope adapter category name
+
+void bad_proxy_string(string const& msg)
+{
+    throw MiddlewareException("string_to_proxy(): " + msg);
+}
+
+} // namespace
+
+InprocMiddleware::InprocMiddleware(string const& server_name, RuntimeImpl* runtime) :
+    MiddlewareBase(runtime),
+    server_name_(server_name),
+    state_(Created),
+    shutdown_flag_(false),
+    twoway_timeout_(DFLT_ZMQ_TWOWAY_TIMEOUT)  // Same as for Zmq, so scopes behave the same with either middleware
+{
+    assert(!server_name.empty());
+
+    if (runtime)  // runtime can be nullptr for some of the tests. It is never null otherwise.
+    {
+        registry_identity_ = runtime->registry_identity();
+    }
+}
+
+InprocMiddleware::~InprocMiddleware()
+{
+    try
+    {
+        stop();
+        wait_for_shutdown();
+    }
+    catch (...)
+    {
+    }
+}
+
+void InprocMiddleware::start()
+{
+    lock_guard<mutex> lock(state_mutex_);
+
+    switch (state_)
+    {
+        case Started:
+        {
+            return; // Already started, no-op
+        }
+        case Stopping:
+        case Stopped:
+        {
+            throw MiddlewareException("Cannot re-start stopped middleware");
+        }
+        case Created:
+        {
+            state_ = Started;
+            state_changed_.notify_all();
+            break;
+        }
+        default:
+        {
+            assert(false);  // LCOV_EXCL_LINE
+        }
+    }
+}
+
+void InprocMiddleware::stop()
+{
+    lock_guard<mutex> lock(state_mutex_);
+    switch (state_)
+    {
+        case Stopped:
+        case Stopping:
+        {
+            break;  // Already stopped, about to stop, or never started: no-op
+        }
+        case Created:
+        case Started:
+        {
+            // Initiate shutdown of all adapters
+            lock_guard<mutex> data_lock(data_mutex_);
+            for (auto& pair : am_)
+            {
+                pair.second->shutdown();
+            }
+
+            state_ = Stopping;
+            state_changed_.notify_all();
+            break;
+        }
+        default:
+        {
+            assert(false);  // LCOV_EXCL_LINE
+        }
+    }
+}
+
+void InprocMiddleware::wait_for_shutdown()
+{
+    {
+        unique_lock<mutex> state_lock(state_mutex_);
+        state_changed_.wait(state_lock, [this] {
+            return state_ == Stopping || state_ == Stopped || state_ == Created;
+        });
+        if (state_ == Stopped)
+        {
+            return; // Return immediately if stopped already, or never started in the first place.
+        }
+
+        // Several threads may see state_ == Stopping here. Exactly one of them
+        // waits for the object adapters to shut down; the others wait until
+        // shut down is complete.
+        if (shutdown_flag_)
+        {
+            state_changed_.wait(state_lock, [this] { return state_ == Stopped; });
+            return;
+        }
+        shutdown_flag_ = true;
+    }
+
+    // Exactly one thread gets to this point.
+    AdapterMap adapter_map;
+    {
+        lock_guard<mutex> data_lock(data_mutex_);
+        adapter_map = move(am_);
+    }
+    for (auto&& pair : adapter_map)
+    {
+        pair.second->wait_for_shutdown();
+    }
+
+    lock_guard<mutex> state_lock(state_mutex_);
+    state_ = Stopped;
+    state_changed_.notify_all();
+}
+
+// Proxy strings have the same syntax as for Zmq, but with an inproc:// endpoint that
+// names the target adapter, for example, "inproc://myscope#myscope!t=500".
+
+ObjectProxy InprocMiddleware::string_to_proxy(string const& s)
+{
+    if (s == "nullproxy:")
+    {
+        return nullptr;
+    }
+    string const scheme = ObjectAdapter::scheme;
+    if (s.substr(0, scheme.size()) != scheme)
+    {
+        bad_proxy_string("invalid proxy scheme prefix: \"" + s + "\" (expected \"" + scheme + "\")");
+    }
+    auto fragment_pos = s.find('#');
+    if (fragment_pos == string::npos)
+    {
+        bad_proxy_string("invalid proxy: missing # separator: " + s);
+    }
+    string endpoint = s.substr(0, fragment_pos);
+    if (endpoint.size() == scheme.size())
+    {
+        bad_proxy_string("invalid proxy: empty endpoint path: " + s);
+    }
+
+    auto excl_pos = s.find('!', fragment_pos);
+    string identity = s.substr(fragment_pos + 1, excl_pos == string::npos ? string::npos : excl_pos - fragment_pos - 1);
+    if (identity.empty())
+    {
+        bad_proxy_string("invalid proxy: empty identity: " + s);
+    }
+
+    string category = scope_category;
+    int64_t timeout = -1;
+    while (excl_pos != string::npos)
+    {
+        auto next_pos = s.find('!', excl_pos + 1);
+        string field = s.substr(excl_pos + 1, next_pos == string::npos ? string::npos : next_pos - excl_pos - 1);
+        excl_pos = next_pos;
+        if (field.size() < 2 || field[1] != '=')
+        {
+            bad_proxy_string("invalid proxy: bad field specification (\"" + field + "\"): " + s);
+        }
+        string val = field.substr(2);
+        switch (field[0])
+        {
+            case 'c':
+            {
+                category = val;
+                break;
+            }
+            case 't':
+            {
+                size_t pos = 0;
+                try
+                {
+                    timeout = std::stol(val, &pos);
+                }
+                catch (std::exception const&)
+                {
+                    pos = 0;
+                }
+                if (val.empty() || pos != val.size() || timeout < -1)
+                {
+                    bad_proxy_string("invalid proxy: bad timeout value (\"t=" + val + "\"): " + s);
+                }
+                break;
+            }
+            default:
+            {
+                bad_proxy_string("invalid proxy: invalid field identifier (\"" + field + "\"): " + s);
+            }
+        }
+    }
+
+    // For the time being we only support Scope proxies. (There is no in-process registry.)
+    if (category != scope_category)
+    {
+        bad_proxy_string("unknown category: " + category);
+    }
+    auto p = make_shared<InprocScope>(this, endpoint, identity, category, timeout);
+    return ScopeImpl::create(p, identity);
+}
+
+string InprocMiddleware::proxy_to_string(MWProxy const& proxy)
+{
+    if (!proxy)
+    {
+        return "nullproxy:";
+    }
+    return proxy->to_string();
+}
+
+MWRegistryProxy InprocMiddleware::registry_proxy()
+{
+    return nullptr;
+}
+
+MWRegistryProxy InprocMiddleware::ss_registry_proxy()
+{
+    return nullptr;
+}
+
+MWScopeProxy InprocMiddleware::create_scope_proxy(string const& identity)
+{
+    return make_shared<InprocScope>(this, ObjectAdapter::scheme + identity, identity, scope_category, twoway_timeout_);
+}
+
+MWScopeProxy InprocMiddleware::create_scope_proxy(string const& identity, string const& endpoint)
+{
+    return make_shared<InprocScope>(this, endpoint, identity, scope_category, twoway_timeout_);
+}
+
+MWQueryProxy InprocMiddleware::create_query_proxy(string const& identity, string const& endpoint)
+{
+    return make_shared<InprocQuery>(this, endpoint, identity, query_category);
+}
+
+MWQueryCtrlProxy InprocMiddleware::create_query_ctrl_proxy(string const& identity, string const& endpoint)
+{
+    return make_shared<InprocQueryCtrl>(this, endpoint, identity, ctrl_category);
+}
+
+MWStateReceiverProxy InprocMiddleware::create_state_receiver_proxy(string const& identity)
+{
+    string endpoint = ObjectAdapter::scheme + server_name_ + state_suffix;
+    return make_shared<InprocStateReceiver>(this, endpoint, identity, state_category);
+}
+
+// Without a registry, nothing listens on the endpoint, so state updates are discarded.
+
+MWStateReceiverProxy InprocMiddleware::create_registry_state_receiver_proxy(string const& identity)
+{
+    string endpoint = ObjectAdapter::scheme + registry_identity_ + state_suffix;
+    return make_shared<InprocStateReceiver>(this, endpoint, identity, state_category);
+}
+
+MWQueryCtrlProxy InprocMiddleware::add_query_ctrl_object(QueryCtrlObjectBase::SPtr const& ctrl)
+{
+    assert(ctrl);
+
+    auto adapter = find_adapter(server_name_ + ctrl_suffix);
+    function<void()> df;
+    auto id = safe_add(df, adapter, "", ctrl);
+    ctrl->set_disconnect_function(df);
+    return make_shared<InprocQueryCtrl>(this, adapter->endpoint(), id, ctrl_category);
+}
+
+void InprocMiddleware::add_dflt_query_ctrl_object(QueryCtrlObjectBase::SPtr const& ctrl)
+{
+    assert(ctrl);
+
+    auto adapter = find_adapter(server_name_ + ctrl_suffix);
+    auto df = safe_dflt_add(adapter, ctrl_category, ctrl);
+    ctrl->set_disconnect_function(df);
+}
+
+MWQueryProxy InprocMiddleware::add_query_object(QueryObjectBase::SPtr const& query)
+{
+    assert(query);
+
+    auto adapter = find_adapter(server_name_ + query_suffix);
+    function<void()> df;
+    auto id = safe_add(df, adapter, "", query);
+    query->set_disconnect_function(df);
+    return make_shared<InprocQuery>(this, adapter->endpoint(), id, query_category);
+}
+
+void InprocMiddleware::add_dflt_query_object(QueryObjectBase::SPtr const& query)
+{
+    assert(query);
+
+    auto adapter = find_adapter(server_name_ + query_suffix);
+    auto df = safe_dflt_add(adapter, query_category, query);
+    query->set_disconnect_function(df);
+}
+
+MWRegistryProxy InprocMiddleware::add_registry_object(string const&, RegistryObjectBase::SPtr const&)
+{
+    throw MiddlewareException("InprocMiddleware: cannot add registry object: registry is not supported");
+}
+
+MWReplyProxy InprocMiddleware::add_reply_object(ReplyObjectBase::SPtr const& reply)
+{
+    assert(reply);
+
+    auto adapter = find_adapter(server_name_ + reply_suffix);
+    function<void()> df;
+    auto id = safe_add(df, adapter, "", reply);
+    reply->set_disconnect_function(df);
+    return make_shared<InprocReply>(this, adapter->endpoint(), id, reply_category);
+}
+
+MWScopeProxy InprocMiddleware::add_scope_object(string const& identity, ScopeObjectBase::SPtr const& scope,
+                                                int64_t, function<void()> const&)
+{
+    assert(!identity.empty());
+    assert(scope);
+
+    // Each scope gets its own adapter, so several scopes can share a middleware.
+    auto adapter = find_adapter(identity);
+    function<void()> df;
+    auto id = safe_add(df, adapter, identity, scope);
+    scope->set_disconnect_function(df);
+    return make_shared<InprocScope>(this, adapter->endpoint(), id, scope_category, twoway_timeout_);
+}
+
+void InprocMiddleware::add_dflt_scope_object(ScopeObjectBase::SPtr const& scope)
+{
+    assert(scope);
+
+    auto adapter = find_adapter(server_name_);
+    auto df = safe_dflt_add(adapter, scope_category, scope);
+    scope->set_disconnect_function(df);
+}
+
+MWStateReceiverProxy InprocMiddleware::add_state_receiver_object(std::string const& identity,
+                                                                 StateReceiverObject::SPtr const& state_receiver)
+{
+    assert(!identity.empty());
+    assert(state_receiver);
+
+    auto adapter = find_adapter(server_name_ + state_suffix);
+    function<void()> df;
+    auto id = safe_add(df, adapter, identity, state_receiver);
+    state_receiver->set_disconnect_function(df);
+    return make_shared<InprocStateReceiver>(this, adapter->endpoint(), id, state_category);
+}
+
+MWPublisher::UPtr InprocMiddleware::create_publisher(std::string const&)
+{
+    throw MiddlewareException("InprocMiddleware: cannot create publisher: publishers are not supported");
+}
+
+MWSubscriber::UPtr InprocMiddleware::create_subscriber(std::string const&, std::string const&)
+{
+    throw MiddlewareException("InprocMiddleware: cannot create subscriber: subscribers are not supported");
+}
+
+std::string InprocMiddleware::get_scope_endpoint()
+{
+    return ObjectAdapter::scheme + server_name_;
+}
+
+std::string InprocMiddleware::get_query_endpoint()
+{
+    return ObjectAdapter::scheme + server_name_ + query_suffix;
+}
+
+std::string InprocMiddleware::get_query_ctrl_endpoint()
+{
+    return ObjectAdapter::scheme + server_name_ + ctrl_suffix;
+}
+
+ObjectAdapter::SPtr InprocMiddleware::find_adapter(string const& name)
+{
+    lock(state_mutex_, data_mutex_);
+    lock_guard<mutex> state_lock(state_mutex_, std::adopt_lock);
+    lock_guard<mutex> map_lock(data_mutex_, std::adopt_lock);
+
+    if (state_ == Stopping || state_ == Stopped)
+    {
+        throw MiddlewareException("Cannot invoke operations while middleware is stopped");
+    }
+
+    auto it = am_.find(name);
+    if (it != am_.end())
+    {
+        return it->second;
+    }
+
+    // We don't have the requested adapter yet, so we create it on the fly.
+    auto a = make_shared<ObjectAdapter>(*this, name);
+    a->activate();
+    am_[name] = a;
+    return a;
+}
+
+string InprocMiddleware::safe_add(function<void()>& disconnect_func,
+                                  ObjectAdapter::SPtr const& adapter,
+                                  string const& identity,
+                                  AbstractObject::SPtr const& servant)
+{
+    string id = identity;
+    if (id.empty())
+    {
+        lock_guard<mutex> lock(data_mutex_);
+        id = unique_id_.gen();
+    }
+
+    disconnect_func = [adapter, id]
+    {
+        try
+        {
+            adapter->remove(id);
+        }
+        catch (...)
+        {
+            // No error here; for concurrent invocations that each disconnect the servant,
+            // only one of them will succeed.
+        }
+    };
+    adapter->add(id, servant);
+    return id;
+}
+
+function<void()> InprocMiddleware::safe_dflt_add(ObjectAdapter::SPtr const& adapter,
+                                                 string const& category,
+                                                 AbstractObject::SPtr const& servant)
+{
+    function<void()> disconnect_func = [adapter, category]
+    {
+        try
+        {
+            adapter->remove_dflt_servant(category);
+        }
+        catch (...)
+        {
+            // No error here; for concurrent invocations that each disconnect the servant,
+            // only one of them will succeed.
+        }
+    };
+    adapter->add_dflt_servant(category, servant);
+    return disconnect_func;
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
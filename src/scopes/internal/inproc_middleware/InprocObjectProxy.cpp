@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/inproc_middleware/InprocObjectProxy.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+InprocObjectProxy::InprocObjectProxy(InprocMiddleware* mw_base,
+                                     string const& endpoint,
+                                     string const& identity,
+                                     string const& category,
+                                     int64_t timeout) :
+    MWObjectProxy(mw_base),
+    endpoint_(endpoint),
+    identity_(identity),
+    category_(category),
+    timeout_(timeout)
+{
+    assert(timeout >= -1);
+}
+
+InprocObjectProxy::~InprocObjectProxy()
+{
+}
+
+InprocMiddleware* InprocObjectProxy::mw_base() const noexcept
+{
+    return dynamic_cast<InprocMiddleware*>(MWObjectProxy::mw_base());
+}
+
+string InprocObjectProxy::endpoint() const
+{
+    return endpoint_;
+}
+
+string InprocObjectProxy::identity() const
+{
+    return identity_;
+}
+
+string InprocObjectProxy::target_category() const
+{
+    return category_;
+}
+
+int64_t InprocObjectProxy::timeout() const noexcept
+{
+    return timeout_;
+}
+
+string InprocObjectProxy::to_string() const
+{
+    if (endpoint_.empty() || identity_.empty())
+    {
+        return "nullproxy:";
+    }
+    string s = endpoint_ + "#" + identity_;
+    if (!category_.empty())
+    {
+        s += "!c=" + category_;
+    }
+    if (timeout_ != -1)
+    {
+        s += "!t=" + std::to_string(timeout_);
+    }
+    return s;
+}
+
+void InprocObjectProxy::ping()
+{
+    invoke_twoway_<AbstractObject>("ping", [](AbstractObject::SPtr const&, InvokeInfo const&) {});
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/inproc_middleware/InprocQuery.h>
+
+#include <unity/scopes/internal/inproc_middleware/InprocReply.h>
+#include <unity/scopes/internal/QueryObjectBase.h>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+InprocQuery::InprocQuery(InprocMiddleware* mw_base,
+                         string const& endpoint,
+                         string const& identity,
+                         string const& category) :
+    MWObjectProxy(mw_base),
+    InprocObjectProxy(mw_base, endpoint, identity, category),
+    MWQuery(mw_base)
+{
+}
+
+InprocQuery::~InprocQuery()
+{
+}
+
+void InprocQuery::run(MWReplyProxy const& r)
+{
+    invoke_oneway_<QueryObjectBase>([r](QueryObjectBase::SPtr const& query, InvokeInfo const& info)
+    {
+        query->run(InprocReply::rebind(r, info.mw), info);
+    });
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
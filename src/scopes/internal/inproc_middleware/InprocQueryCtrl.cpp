@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/inproc_middleware/InprocQueryCtrl.h>
+
+#include <unity/scopes/internal/QueryCtrlObjectBase.h>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+InprocQueryCtrl::InprocQueryCtrl(InprocMiddleware* mw_base,
+                                 string const& endpoint,
+                                 string const& identity,
+                                 string const& category) :
+    MWObjectProxy(mw_base),
+    InprocObjectProxy(mw_base, endpoint, identity, category),
+    MWQueryCtrl(mw_base)
+{
+}
+
+InprocQueryCtrl::~InprocQueryCtrl()
+{
+}
+
+void InprocQueryCtrl::cancel()
+{
+    invoke_oneway_<QueryCtrlObjectBase>([](QueryCtrlObjectBase::SPtr const& ctrl, InvokeInfo const& info)
+    {
+        ctrl->cancel(info);
+    });
+}
+
+void InprocQueryCtrl::destroy()
+{
+    invoke_oneway_<QueryCtrlObjectBase>([](QueryCtrlObjectBase::SPtr const& ctrl, InvokeInfo const& info)
+    {
+        ctrl->destroy(info);
+    });
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
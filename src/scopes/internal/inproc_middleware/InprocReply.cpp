@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/inproc_middleware/InprocReply.h>
+
+#include <unity/scopes/internal/inproc_middleware/InprocMiddleware.h>
+#include <unity/scopes/internal/ReplyObjectBase.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+InprocReply::InprocReply(InprocMiddleware* mw_base,
+                         string const& endpoint,
+                         string const& identity,
+                         string const& category) :
+    MWObjectProxy(mw_base),
+    InprocObjectProxy(mw_base, endpoint, identity, category),
+    MWReply(mw_base)
+{
+}
+
+InprocReply::~InprocReply()
+{
+}
+
+void InprocReply::push(VariantMap const& result)
+{
+    auto token = cancellation_token();
+    if (token && token->cancelled())
+    {
+        token->dropped_result(false);
+        return;
+    }
+
+    // This is the only copy of the result. From here on, it is moved along until the servant gets it.
+    invoke_oneway_<ReplyObjectBase>(bind([](ReplyObjectBase::SPtr const& reply,
+                                            InvokeInfo const&,
+                                            CancellationToken::SPtr const& token,
+                                            VariantMap const& result)
+                                         {
+                                             // The query may have been cancelled while the result was queued.
+                                             if (token && token->cancelled())
+                                             {
+                                                 token->dropped_result(true);
+                                                 return;
+                                             }
+                                             reply->push(result);
+                                         },
+                                         placeholders::_1, placeholders::_2, token, result));
+}
+
+void InprocReply::finished(CompletionDetails const& details)
+{
+    invoke_oneway_<ReplyObjectBase>(bind([](ReplyObjectBase::SPtr const& reply,
+                                            InvokeInfo const&,
+                                            CompletionDetails const& details)
+                                         {
+                                             reply->finished(details);
+                                         },
+                                         placeholders::_1, placeholders::_2, details));
+}
+
+void InprocReply::info(OperationInfo const& op_info)
+{
+    invoke_oneway_<ReplyObjectBase>(bind([](ReplyObjectBase::SPtr const& reply,
+                                            InvokeInfo const&,
+                                            OperationInfo const& op_info)
+                                         {
+                                             reply->info(op_info);
+                                         },
+                                         placeholders::_1, placeholders::_2, op_info));
+}
+
+MWReplyProxy InprocReply::rebind(MWReplyProxy const& reply, MiddlewareBase* mw)
+{
+    if (!reply)
+    {
+        return nullptr;
+    }
+    auto inproc_mw = dynamic_cast<InprocMiddleware*>(mw);
+    assert(inproc_mw);
+    return make_shared<InprocReply>(inproc_mw, reply->endpoint(), reply->identity(), reply->target_category());
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/inproc_middleware/InprocScope.h>
+
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/internal/ActionMetadataImpl.h>
+#include <unity/scopes/internal/inproc_middleware/InprocMiddleware.h>
+#include <unity/scopes/internal/inproc_middleware/InprocQueryCtrl.h>
+#include <unity/scopes/internal/inproc_middleware/InprocReply.h>
+#include <unity/scopes/internal/QueryCtrlImpl.h>
+#include <unity/scopes/internal/ResultImpl.h>
+#include <unity/scopes/internal/ScopeMetadataImpl.h>
+#include <unity/scopes/internal/ScopeObjectBase.h>
+#include <unity/scopes/internal/SearchMetadataImpl.h>
+#include <unity/scopes/Result.h>
+
+#include <cassert>
+
+using namespace std;
+using namespace std::placeholders;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+namespace
+{
+
+// Returns a copy of child_scopes whose metadata refers to mw.
+
+ChildScopeList rebind(ChildScopeList const& child_scopes, MiddlewareBase* mw)
+{
+    ChildScopeList list;
+    list.reserve(child_scopes.size());
+    for (auto const& child : child_scopes)
+    {
+        unique_ptr<ScopeMetadataImpl> smdi(new ScopeMetadataImpl(child.metadata.serialize(), mw));
+        auto metadata = ScopeMetadata(ScopeMetadataImpl::create(move(smdi)));
+        list.emplace_back(child.id, metadata, child.enabled, child.keywords);
+    }
+    return list;
+}
+
+} // namespace
+
+InprocScope::InprocScope(InprocMiddleware* mw_base,
+                         string const& endpoint,
+                         string const& identity,
+                         string const& category,
+                         int64_t timeout) :
+    MWObjectProxy(mw_base),
+    InprocObjectProxy(mw_base, endpoint, identity, category, timeout),
+    MWScope(mw_base)
+{
+}
+
+InprocScope::~InprocScope()
+{
+}
+
+QueryCtrlProxy InprocScope::search(CannedQuery const& query,
+                                   VariantMap const& hints,
+                                   VariantMap const& context,
+                                   MWReplyProxy const& reply)
+{
+    auto ctrl = invoke_twoway_<ScopeObjectBase>("search",
+                                                bind([](ScopeObjectBase::SPtr const& scope,
+                                                        InvokeInfo const& info,
+                                                        CannedQuery const& query,
+                                                        SearchMetadata const& metadata,
+                                                        VariantMap const& context,
+                                                        MWReplyProxy const& reply)
+                                                     {
+                                                         return scope->search(query,
+                                                                              metadata,
+                                                                              context,
+                                                                              InprocReply::rebind(reply, info.mw),
+                                                                              info);
+                                                     },
+                                                     _1, _2, query, SearchMetadataImpl::create(hints), context, reply));
+    return make_query_ctrl_(ctrl, reply);
+}
+
+QueryCtrlProxy InprocScope::activate(VariantMap const& result, VariantMap const& hints, MWReplyProxy const& reply)
+{
+    auto ctrl = invoke_twoway_<ScopeObjectBase>("activate",
+                                                bind([](ScopeObjectBase::SPtr const& scope,
+                                                        InvokeInfo const& info,
+                                                        Result const& result,
+                                                        ActionMetadata const& metadata,
+                                                        MWReplyProxy const& reply)
+                                                     {
+                                                         return scope->activate(result,
+                                                                                metadata,
+                                                                                InprocReply::rebind(reply, info.mw),
+                                                                                info);
+                                                     },
+                                                     _1, _2,
+                                                     ResultImpl::create_result(result),
+                                                     ActionMetadataImpl::create(hints),
+                                                     reply));
+    return make_query_ctrl_(ctrl, reply);
+}
+
+QueryCtrlProxy InprocScope::perform_action(VariantMap const& result,
+                                           VariantMap const& hints,
+                                           string const& widget_id,
+                                           string const& action_id,
+                                           MWReplyProxy const& reply)
+{
+    auto ctrl = invoke_twoway_<ScopeObjectBase>("perform_action",
+                                                bind([](ScopeObjectBase::SPtr const& scope,
+                                                        InvokeInfo const& info,
+                                                        Result const& result,
+                                                        ActionMetadata const& metadata,
+                                                        string const& widget_id,
+                                                        string const& action_id,
+                                                        MWReplyProxy const& reply)
+                                                     {
+                                                         return scope->perform_action(result,
+                                                                                      metadata,
+                                                                                      widget_id,
+                                                                                      action_id,
+                                                                                      InprocReply::rebind(reply, info.mw),
+                                                                                      info);
+                                                     },
+                                                     _1, _2,
+                                                     ResultImpl::create_result(result),
+                                                     ActionMetadataImpl::create(hints),
+                                                     widget_id,
+                                                     action_id,
+                                                     reply));
+    return make_query_ctrl_(ctrl, reply);
+}
+
+QueryCtrlProxy InprocScope::activate_result_action(VariantMap const& result,
+                                                   VariantMap const& hints,
+                                                   string const& action_id,
+                                                   MWReplyProxy const& reply)
+{
+    auto ctrl = invoke_twoway_<ScopeObjectBase>("activate_result_action",
+                                                bind([](ScopeObjectBase::SPtr const& scope,
+                                                        InvokeInfo const& info,
+                                                        Result const& result,
+                                                        ActionMetadata const& metadata,
+                                                        string const& action_id,
+                                                        MWReplyProxy const& reply)
+                                                     {
+                                                         return scope->activate_result_action(result,
+                                                                                              metadata,
+                                                                                              action_id,
+                                                                                              InprocReply::rebind(reply, info.mw),
+                                                                                              info);
+                                                     },
+                                                     _1, _2,
+                                                     ResultImpl::create_result(result),
+                                                     ActionMetadataImpl::create(hints),
+                                                     action_id,
+                                                     reply));
+    return make_query_ctrl_(ctrl, reply);
+}
+
+QueryCtrlProxy InprocScope::preview(VariantMap const& result, VariantMap const& hints, MWReplyProxy const& reply)
+{
+    auto ctrl = invoke_twoway_<ScopeObjectBase>("preview",
+                                                bind([](ScopeObjectBase::SPtr const& scope,
+                                                        InvokeInfo const& info,
+                                                        Result const& result,
+                                                        ActionMetadata const& metadata,
+                                                        MWReplyProxy const& reply)
+                                                     {
+                                                         return scope->preview(result,
+                                                                               metadata,
+                                                                               InprocReply::rebind(reply, info.mw),
+                                                                               info);
+                                                     },
+                                                     _1, _2,
+                                                     ResultImpl::create_result(result),
+                                                     ActionMetadataImpl::create(hints),
+                                                     reply));
+    return make_query_ctrl_(ctrl, reply);
+}
+
+ChildScopeList InprocScope::child_scopes()
+{
+    auto list = invoke_twoway_<ScopeObjectBase>("child_scopes",
+                                                [](ScopeObjectBase::SPtr const& scope, InvokeInfo const&)
+                                                {
+                                                    return scope->child_scopes();
+                                                });
+    return rebind(list, mw_base());
+}
+
+bool InprocScope::set_child_scopes(ChildScopeList const& child_scopes)
+{
+    return invoke_twoway_<ScopeObjectBase>("set_child_scopes",
+                                           bind([](ScopeObjectBase::SPtr const& scope,
+                                                   InvokeInfo const& info,
+                                                   ChildScopeList const& child_scopes)
+                                                {
+                                                    return scope->set_child_scopes(rebind(child_scopes, info.mw));
+                                                },
+                                                _1, _2, child_scopes));
+}
+
+bool InprocScope::debug_mode()
+{
+    lock_guard<std::mutex> lock(debug_mode_mutex_);
+
+    // We only need to retrieve the debug mode state once, so we cache it in debug_mode_
+    if (!debug_mode_)
+    {
+        bool mode = invoke_twoway_<ScopeObjectBase>("debug_mode",
+                                                    [](ScopeObjectBase::SPtr const& scope, InvokeInfo const&)
+                                                    {
+                                                        return scope->debug_mode();
+                                                    });
+        debug_mode_.reset(new bool(mode));
+    }
+    return *debug_mode_;
+}
+
+// The servant returns a proxy that belongs to the scope's middleware, so we rebind it to ours.
+
+QueryCtrlProxy InprocScope::make_query_ctrl_(MWQueryCtrlProxy const& ctrl, MWReplyProxy const& reply)
+{
+    assert(ctrl);
+    MWQueryCtrlProxy p = make_shared<InprocQueryCtrl>(mw_base(),
+                                                      ctrl->endpoint(),
+                                                      ctrl->identity(),
+                                                      ctrl->target_category());
+    return make_shared<QueryCtrlImpl>(p, reply);
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
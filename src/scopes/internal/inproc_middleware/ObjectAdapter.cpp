@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/inproc_middleware/ObjectAdapter.h>
+
+#include <unity/UnityExceptions.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace inproc_middleware
+{
+
+namespace
+{
+
+// Maps the endpoints of all active adapters in the process to their adapters.
+// The directory is never destroyed, so adapters that are shut down during
+// static destruction can still remove themselves.
+
+struct Directory
+{
+    mutex m;
+    map<string, weak_ptr<ObjectAdapter>> adapters;
+};
+
+Directory& directory()
+{
+    static Directory* d = new Directory;
+    return *d;
+}
+
+} // namespace
+
+char const* const ObjectAdapter::scheme = "inproc://";
+
+ObjectAdapter::ObjectAdapter(InprocMiddleware& mw, string const& name) :
+    mw_(mw),
+    name_(name),
+    endpoint_(scheme + name),
+    pool_(1),  // Single thread, so requests for a servant are dispatched in order
+    state_(Inactive)
+{
+    assert(!name.empty());
+}
+
+ObjectAdapter::~ObjectAdapter()
+{
+    shutdown();
+    wait_for_shutdown();
+}
+
+InprocMiddleware* ObjectAdapter::mw() const noexcept
+{
+    return &mw_;
+}
+
+string ObjectAdapter::name() const
+{
+    return name_;
+}
+
+string ObjectAdapter::endpoint() const
+{
+    return endpoint_;
+}
+
+void ObjectAdapter::activate()
+{
+    lock_guard<mutex> lock(mutex_);
+    switch (state_)
+    {
+        case Active:
+        {
+            return;
+        }
+        case Destroyed:
+        {
+            throw MiddlewareException("Object adapter " + name_ + " cannot be activated after shutdown");
+        }
+        case Inactive:
+        {
+            auto& d = directory();
+            lock_guard<mutex> directory_lock(d.m);
+            auto& entry = d.adapters[endpoint_];
+            if (entry.lock())
+            {
+                throw MiddlewareException("Object adapter " + name_ + ": endpoint " + endpoint_ + " is already in use");
+            }
+            entry = shared_from_this();
+            state_ = Active;
+            break;
+        }
+        default:
+        {
+            assert(false);  // LCOV_EXCL_LINE
+        }
+    }
+}
+
+void ObjectAdapter::shutdown() noexcept
+{
+    lock_guard<mutex> lock(mutex_);
+    if (state_ == Active)
+    {
+        auto& d = directory();
+        lock_guard<mutex> directory_lock(d.m);
+        auto it = d.adapters.find(endpoint_);
+        if (it != d.adapters.end() && it->second.lock().get() == this)
+        {
+            d.adapters.erase(it);
+        }
+    }
+    state_ = Destroyed;
+}
+
+void ObjectAdapter::wait_for_shutdown() noexcept
+{
+    pool_.destroy_once_empty();
+
+    // Servants may call back into the middleware from their destructor, so we do not hold the lock here.
+    map<string, AbstractObject::SPtr> servants;
+    map<string, AbstractObject::SPtr> dflt_servants;
+    {
+        lock_guard<mutex> lock(mutex_);
+        servants.swap(servants_);
+        dflt_servants.swap(dflt_servants_);
+    }
+}
+
+void ObjectAdapter::add(string const& id, AbstractObject::SPtr const& obj)
+{
+    if (!obj)
+    {
+        throw InvalidArgumentException("ObjectAdapter::add(): invalid nullptr object (adapter: " + name_ + ")");
+    }
+
+    lock_guard<mutex> lock(mutex_);
+    if (state_ == Destroyed)
+    {
+        throw MiddlewareException("ObjectAdapter::add(): adapter " + name_ + " is shut down");
+    }
+    if (!servants_.insert(make_pair(id, obj)).second)
+    {
+        throw MiddlewareException("ObjectAdapter::add(): cannot add id \"" + id
+                                  + "\": id already in use (adapter: " + name_ + ")");
+    }
+}
+
+void ObjectAdapter::remove(string const& id)
+{
+    AbstractObject::SPtr servant;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto it = servants_.find(id);
+        if (it == servants_.end())
+        {
+            throw MiddlewareException("ObjectAdapter::remove(): cannot remove id \"" + id
+                                      + "\": id not present (adapter: " + name_ + ")");
+        }
+        servant = it->second;
+        servants_.erase(it);
+    }
+    // Lock released here, so we don't call servant destructor while holding a lock
+}
+
+void ObjectAdapter::add_dflt_servant(string const& category, AbstractObject::SPtr const& obj)
+{
+    if (!obj)
+    {
+        throw InvalidArgumentException("ObjectAdapter::add_dflt_servant(): invalid nullptr object (adapter: "
+                                       + name_ + ")");
+    }
+
+    lock_guard<mutex> lock(mutex_);
+    if (state_ == Destroyed)
+    {
+        throw MiddlewareException("ObjectAdapter::add_dflt_servant(): adapter " + name_ + " is shut down");
+    }
+    if (!dflt_servants_.insert(make_pair(category, obj)).second)
+    {
+        throw MiddlewareException("ObjectAdapter::add_dflt_servant(): cannot add category \"" + category
+                                  + "\": category already in use (adapter: " + name_ + ")");
+    }
+}
+
+void ObjectAdapter::remove_dflt_servant(string const& category)
+{
+    AbstractObject::SPtr servant;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto it = dflt_servants_.find(category);
+        if (it == dflt_servants_.end())
+        {
+            throw MiddlewareException("ObjectAdapter::remove_dflt_servant(): cannot remove category \"" + category
+                                      + "\": category not present (adapter: " + name_ + ")");
+        }
+        servant = it->second;
+        dflt_servants_.erase(it);
+    }
+    // Lock released here, so we don't call servant destructor while holding a lock
+}
+
+AbstractObject::SPtr ObjectAdapter::find_servant(string const& id, string const& category) const
+{
+    lock_guard<mutex> lock(mutex_);
+    auto it = servants_.find(id);
+    if (it != servants_.end())
+    {
+        return it->second;
+    }
+    auto dflt_it = dflt_servants_.find(category);
+    return dflt_it != dflt_servants_.end() ? dflt_it->second : nullptr;
+}
+
+ObjectAdapter::SPtr ObjectAdapter::find(string const& endpoint)
+{
+    auto& d = directory();
+    lock_guard<mutex> lock(d.m);
+    auto it = d.adapters.find(endpoint);
+    return it != d.adapters.end() ? it->second.lock() : nullptr;
+}
+
+} // namespace inproc_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -58,14 +58,17 @@ char const* pump_suffix = "-pump";
 
 }  // namespace
 
+constexpr size_t ObjectAdapter::num_shards;
+
 ObjectAdapter::ObjectAdapter(ZmqMiddleware& mw, string const& name, string const& endpoint, RequestMode m,
-                             int pool_size, int64_t idle_timeout) :
+                             int pool_size, int64_t idle_timeout, function<void()> const& idle_callback) :
     mw_(mw),
     name_(name),
     endpoint_(endpoint),
     mode_(m),
     pool_size_(pool_size),
     idle_timeout_(idle_timeout != -1 ? idle_timeout : zmqpp::poller::wait_forever),
+    idle_callback_(idle_callback),
     state_(Inactive),
     // Some tests use a nullptr for the run time, so we use different loggers in that case.
     test_logger_(mw.runtime() ? nullptr : new Logger("ObjectAdapter_test_logger"))
@@ -137,49 +140,36 @@ ZmqProxy ObjectAdapter::add(std::string const& id, std::shared_ptr<ServantBase>
         throw InvalidArgumentException("ObjectAdapter::add(): invalid nullptr object (adapter: " + name_ + ")");
     }
 
-    lock(map_mutex_, state_mutex_);
-    lock_guard<mutex> map_lock(map_mutex_, adopt_lock);
+    throw_if_destroyed("add()");
+
     {
-        lock_guard<mutex> state_lock(state_mutex_, adopt_lock);
-        if (state_ == Destroyed || state_ == Failed)
+        auto& sh = shard(id);
+        lock_guard<mutex> map_lock(sh.mutex);
+        if (!sh.servants.insert(make_pair(id, obj)).second)
         {
-            throw_bad_state("add()", state_);
+            throw MiddlewareException("ObjectAdapter::add(): cannot add id \"" + id
+                                      + "\": id already in use (adapter: " + name_ + ")");
         }
     }
-
-    auto pair = servants_.insert(make_pair(id, obj));
-    if (!pair.second)
-    {
-        ostringstream s;
-        s << "ObjectAdapter::add(): " << "cannot add id \"" << id << "\": id already in use (adapter: " << name_  << ")";
-        throw MiddlewareException(s.str());
-    }
     return ZmqProxy(new ZmqObjectProxy(&mw_, endpoint_, id, "", mode_));
 }
 
 void ObjectAdapter::remove(std::string const& id)
 {
     shared_ptr<ServantBase> servant;
-    {
-        lock(map_mutex_, state_mutex_);
-        lock_guard<mutex> map_lock(map_mutex_, adopt_lock);
-        {
-            lock_guard<mutex> state_lock(state_mutex_, adopt_lock);
-            if (state_ == Destroyed || state_ == Failed)
-            {
-                throw_bad_state("remove()", state_);
-            }
-        }
+    throw_if_destroyed("remove()");
 
-        auto it = servants_.find(id);
-        if (it == servants_.end())
+    {
+        auto& sh = shard(id);
+        lock_guard<mutex> map_lock(sh.mutex);
+        auto it = sh.servants.find(id);
+        if (it == sh.servants.end())
         {
-            ostringstream s;
-            s << "ObjectAdapter::remove(): " << "cannot remove id \"" << id << "\": id not present (adapter: " << name_ << ")";
-            throw MiddlewareException(s.str());
+            throw MiddlewareException("ObjectAdapter::remove(): cannot remove id \"" + id
+                                      + "\": id not present (adapter: " + name_ + ")");
         }
-        servant = it->second;
-        servants_.erase(it);
+        servant = move(it->second);
+        sh.servants.erase(it);
     }
     // Lock released here, so we don't call servant destructor while holding a lock
 
@@ -188,18 +178,12 @@ void ObjectAdapter::remove(std::string const& id)
 
 shared_ptr<ServantBase> ObjectAdapter::find(std::string const& id) const
 {
-    lock(map_mutex_, state_mutex_);
-    lock_guard<mutex> map_lock(map_mutex_, adopt_lock);
-    {
-        lock_guard<mutex> state_lock(state_mutex_, adopt_lock);
-        if (state_ == Destroyed || state_ == Failed)
-        {
-            throw_bad_state("find()", state_);
-        }
-    }
+    throw_if_destroyed("find()");
 
-    auto it = servants_.find(id);
-    if (it != servants_.end())
+    auto& sh = shard(id);
+    lock_guard<mutex> map_lock(sh.mutex);
+    auto it = sh.servants.find(id);
+    if (it != sh.servants.end())
     {
         return it->second;
     }
@@ -213,15 +197,9 @@ void ObjectAdapter::add_dflt_servant(std::string const& category, std::shared_pt
         throw InvalidArgumentException("ObjectAdapter::add_dflt_servant(): invalid nullptr object (adapter: " + name_ + ")");
     }
 
-    lock(map_mutex_, state_mutex_);
-    lock_guard<mutex> map_lock(map_mutex_, adopt_lock);
-    {
-        lock_guard<mutex> state_lock(state_mutex_, adopt_lock);
-        if (state_ == Destroyed || state_ == Failed)
-        {
-            throw_bad_state("add_dflt_servant()", state_);
-        }
-    }
+    throw_if_destroyed("add_dflt_servant()");
+
+    lock_guard<mutex> map_lock(dflt_mutex_);
 
     auto pair = dflt_servants_.insert(make_pair(category, obj));
     if (!pair.second)
@@ -236,16 +214,10 @@ void ObjectAdapter::add_dflt_servant(std::string const& category, std::shared_pt
 void ObjectAdapter::remove_dflt_servant(std::string const& category)
 {
     shared_ptr<ServantBase> servant;
+    throw_if_destroyed("remove_dflt_servant()");
+
     {
-        lock(map_mutex_, state_mutex_);
-        lock_guard<mutex> map_lock(map_mutex_, adopt_lock);
-        {
-            lock_guard<mutex> state_lock(state_mutex_, adopt_lock);
-            if (state_ == Destroyed || state_ == Failed)
-            {
-                throw_bad_state("remove_dflt_servant()", state_);
-            }
-        }
+        lock_guard<mutex> map_lock(dflt_mutex_);
 
         auto it = dflt_servants_.find(category);
         if (it == dflt_servants_.end())
@@ -265,15 +237,9 @@ void ObjectAdapter::remove_dflt_servant(std::string const& category)
 
 shared_ptr<ServantBase> ObjectAdapter::find_dflt_servant(std::string const& category) const
 {
-    lock(map_mutex_, state_mutex_);
-    lock_guard<mutex> map_lock(map_mutex_, adopt_lock);
-    {
-        lock_guard<mutex> state_lock(state_mutex_, adopt_lock);
-        if (state_ == Destroyed || state_ == Failed)
-        {
-            throw_bad_state("find_dflt_servant()", state_);
-        }
-    }
+    throw_if_destroyed("find_dflt_servant()");
+
+    lock_guard<mutex> map_lock(dflt_mutex_);
 
     auto it = dflt_servants_.find(category);
     if (it != dflt_servants_.end())
@@ -442,6 +408,24 @@ void ObjectAdapter::throw_bad_state(string const& label, AdapterState state) con
     throw e;
 }
 
+// Called on every add(), remove(), and find(), so we check the state without locking.
+// We need the lock only to throw, so throw_bad_state() sees the stored exception.
+
+void ObjectAdapter::throw_if_destroyed(char const* label) const
+{
+    AdapterState const state = state_.load();
+    if (state == Destroyed || state == Failed)
+    {
+        lock_guard<mutex> state_lock(state_mutex_);
+        throw_bad_state(label, state);
+    }
+}
+
+ObjectAdapter::ServantShard& ObjectAdapter::shard(string const& id) const
+{
+    return shards_[hash<string>()(id) % num_shards];
+}
+
 void ObjectAdapter::run_workers()
 {
     {
@@ -528,8 +512,16 @@ void ObjectAdapter::pump(std::promise<void> ready)
         {
             if (!poller.poll(idle_timeout_))
             {
-                // Shut down, no activity for the idle timeout period.
-                mw_.stop();
+                // No activity for the idle timeout period. Unless someone else
+                // wants to decide what to do about that, we shut down.
+                if (idle_callback_)
+                {
+                    idle_callback_();
+                }
+                else
+                {
+                    mw_.stop();
+                }
             }
             if (!shutting_down && poller.has_input(stop))
             {
@@ -815,17 +807,74 @@ void ObjectAdapter::dispatch(zmqpp::socket& pump, string const& client_address)
     }
 }
 
+void ObjectAdapter::dispatch_oneway(capnp::MessageReader& message)
+{
+    assert(mode_ == RequestMode::Oneway);
+
+    if (state_ != Active)
+    {
+        return;
+    }
+
+    capnproto::Request::Reader req;
+    Current current;
+    try
+    {
+        req = message.getRoot<capnproto::Request>();
+        current.adapter = this;
+        current.id = req.getId().cStr();
+        current.category = req.getCat().cStr();
+        current.op_name = req.getOpName().cStr();
+        if (current.id.empty() || current.op_name.empty() || req.getMode() != capnproto::RequestMode::ONEWAY)
+        {
+            logger()() << "ObjectAdapter: invalid oneway message header "
+                       << "(id: " << current.id << ", adapter: " << name_ << ", op: " << current.op_name << ")";
+            return;
+        }
+    }
+    catch (std::exception const& e)
+    {
+        logger()() << "ObjectAdapter: error unmarshaling request header "
+                   << "(id: " << current.id << ", adapter: " << name_ << ", op: " << current.op_name << "): " << e.what();
+        return;
+    }
+
+    shared_ptr<ServantBase> servant;
+    try
+    {
+        servant = find_servant(current.id, current.category);
+    }
+    catch (std::exception const&)
+    {
+        // Ignore failure to find servant during destruction phase.
+    }
+    if (!servant)
+    {
+        return;
+    }
+
+    auto in_params = req.getInParams();
+    capnp::MallocMessageBuilder b;
+    auto r = b.initRoot<capnproto::Response>();
+    trace_dispatch(current);
+    servant->safe_dispatch_(current, in_params, r); // noexcept
+}
+
 void ObjectAdapter::cleanup()
 {
     join_with_all_threads();
+
+    // Don't hold a lock while the servant destructors run.
+    vector<ServantMap> servants(num_shards + 1);
+    for (size_t i = 0; i < num_shards; ++i)
     {
-        // Need a full fence here to make sure this thread sees up-to-date
-        // memory for servants_ and dflt_servants_.
-        lock_guard<mutex> lock(map_mutex_);
+        lock_guard<mutex> lock(shards_[i].mutex);
+        servants[i].swap(shards_[i].servants);
+    }
+    {
+        lock_guard<mutex> lock(dflt_mutex_);
+        servants[num_shards].swap(dflt_servants_);
     }
-    // Don't hold a lock while the servant destructors run.
-    servants_.clear();
-    dflt_servants_.clear();
 }
 
 void ObjectAdapter::join_with_all_threads()
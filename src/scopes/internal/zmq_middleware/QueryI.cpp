@@ -69,7 +69,8 @@ void QueryI::run_(Current const& current,
     ZmqReplyProxy reply_proxy(new ZmqReply(current.adapter->mw(),
                               proxy.getEndpoint().cStr(),
                               proxy.getIdentity().cStr(),
-                              proxy.getCategory().cStr()));
+                              proxy.getCategory().cStr(),
+                              proxy.getVersion()));
     assert(del());
     auto delegate = dynamic_pointer_cast<QueryObjectBase>(del());
     assert(delegate);
@@ -66,9 +66,18 @@ void ReplyI::push_(Current const&,
                    capnproto::Response::Builder&)
 {
     auto req = in_params.getAs<capnproto::Reply::PushRequest>();
-    auto result = req.getResult();
     auto delegate = dynamic_pointer_cast<ReplyObjectBase>(del());
-    delegate->push(to_variant_map(result));
+    if (req.hasCompactResult())
+    {
+        VariantMap result;
+        {
+            lock_guard<mutex> lock(decoder_mutex_);
+            result = decoder_.decode(req.getCompactResult());
+        }
+        delegate->push(result);
+        return;
+    }
+    delegate->push(to_variant_map(req.getResult()));
 }
 
 void ReplyI::finished_(Current const&,
@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/zmq_middleware/ResultCodec.h>
+
+#include <unity/scopes/internal/JsonCodec.h>
+#include <unity/scopes/internal/ResultImpl.h>
+#include <unity/scopes/internal/zmq_middleware/VariantConverter.h>
+#include <unity/scopes/ScopeExceptions.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace zmq_middleware
+{
+
+namespace
+{
+
+inline kj::StringPtr to_text(string const& s)
+{
+    return kj::StringPtr(s.data(), s.size());
+}
+
+inline string text_to_string(capnp::Text::Reader const& t)
+{
+    return string(t.cStr(), t.size());
+}
+
+// Only non-empty strings go into the fixed fields. Anything else (which a well-behaved
+// scope does not send) goes with the custom attributes, so it arrives unchanged.
+inline bool fixed_string(Variant const& v)
+{
+    return v.which() == Variant::String && !v.get_string().empty();
+}
+
+bool set_fixed_attr(string const& name, Variant const& v, capnproto::Reply::Result::Builder& b)
+{
+    if (!fixed_string(v))
+    {
+        return false;
+    }
+    auto const& s = v.get_string();
+    if (name == "uri")
+    {
+        b.setUri(to_text(s));
+    }
+    else if (name == "title")
+    {
+        b.setTitle(to_text(s));
+    }
+    else if (name == "art")
+    {
+        b.setArt(to_text(s));
+    }
+    else if (name == "dnd_uri")
+    {
+        b.setDndUri(to_text(s));
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool set_fixed_internal(string const& name, Variant const& v, capnproto::Reply::Result::Builder& b)
+{
+    if (name == "flags")
+    {
+        if (v.which() != Variant::Int || v.get_int() == 0)
+        {
+            return false;
+        }
+        b.setFlags(v.get_int());
+        return true;
+    }
+    if (!fixed_string(v))
+    {
+        return false;
+    }
+    if (name == "cat_id")
+    {
+        b.setCatId(to_text(v.get_string()));
+    }
+    else if (name == "origin")
+    {
+        b.setOrigin(to_text(v.get_string()));
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+ResultEncoder::ResultEncoder()
+{
+}
+
+bool ResultEncoder::encodable(VariantMap const& push) noexcept
+{
+    if (push.size() != 1 || push.begin()->first != "result" || push.begin()->second.which() != Variant::Dict)
+    {
+        return false;
+    }
+    auto const& result = push.begin()->second.get_dict();
+    if (result.size() != 2)
+    {
+        return false;
+    }
+    auto attrs = result.find("attrs");
+    auto internal = result.find("internal");
+    return attrs != result.end() && attrs->second.which() == Variant::Dict
+           && internal != result.end() && internal->second.which() == Variant::Dict;
+}
+
+void ResultEncoder::encode(VariantMap const& push, capnproto::Reply::Result::Builder& b)
+{
+    assert(encodable(push));
+
+    auto const& result = push.begin()->second.get_dict();
+    auto const& attrs = result.find("attrs")->second.get_dict();
+    auto const& internal = result.find("internal")->second.get_dict();
+
+    vector<Attr> attr_list;
+    attr_list.reserve(attrs.size());
+    for (auto const& attr : attrs)
+    {
+        attr_list.emplace_back(&attr.first, &attr.second);
+    }
+    encode_(attr_list, internal, b);
+}
+
+void ResultEncoder::encode(ResultImpl const& result, capnproto::Reply::Result::Builder& b)
+{
+    result.check_serializable();
+
+    vector<Attr> attr_list;
+    result.visit_attributes([&attr_list](string const& key, Variant const& value)
+    {
+        attr_list.emplace_back(&key, &value);
+    });
+    encode_(attr_list, result.internal_values(), b);
+}
+
+void ResultEncoder::encode_(vector<Attr> const& attrs, VariantMap const& internal, capnproto::Reply::Result::Builder& b)
+{
+    vector<Attr> custom_attrs;
+    custom_attrs.reserve(attrs.size());
+    for (auto const& attr : attrs)
+    {
+        if (!set_fixed_attr(*attr.first, *attr.second, b))
+        {
+            custom_attrs.push_back(attr);
+        }
+    }
+
+    uint32_t const first_new_key = key_ids_.size();
+    vector<string const*> new_keys;
+    vector<uint32_t> ids;
+    ids.reserve(custom_attrs.size());
+    for (auto const& attr : custom_attrs)
+    {
+        auto it = key_ids_.find(*attr.first);
+        if (it == key_ids_.end())
+        {
+            it = key_ids_.emplace(*attr.first, key_ids_.size()).first;
+            new_keys.push_back(&it->first);
+        }
+        ids.push_back(it->second);
+    }
+
+    b.setFirstNewKey(first_new_key);
+    if (!new_keys.empty())
+    {
+        auto keys = b.initNewKeys(new_keys.size());
+        for (unsigned i = 0; i < new_keys.size(); ++i)
+        {
+            keys.set(i, to_text(*new_keys[i]));
+        }
+    }
+    if (!custom_attrs.empty())
+    {
+        auto keys = b.initAttrKeys(custom_attrs.size());
+        auto values = b.initAttrValues(custom_attrs.size());
+        for (unsigned i = 0; i < custom_attrs.size(); ++i)
+        {
+            keys.set(i, ids[i]);
+            auto value = values[i];
+            to_value(*custom_attrs[i].second, value);
+        }
+    }
+
+    vector<VariantMap::value_type const*> other_internal;
+    for (auto const& entry : internal)
+    {
+        if (!set_fixed_internal(entry.first, entry.second, b))
+        {
+            other_internal.push_back(&entry);
+        }
+    }
+    if (!other_internal.empty())
+    {
+        auto pairs = b.initInternal().initPairs(other_internal.size());
+        for (unsigned i = 0; i < other_internal.size(); ++i)
+        {
+            pairs[i].setName(to_text(other_internal[i]->first));
+            auto value = pairs[i].initValue();
+            to_value(other_internal[i]->second, value);
+        }
+    }
+}
+
+void ResultEncoder::reset() noexcept
+{
+    key_ids_.clear();
+}
+
+ResultDecoder::ResultDecoder()
+{
+}
+
+VariantMap ResultDecoder::decode(capnproto::Reply::Result::Reader const& r)
+{
+    size_t const first_new_key = r.getFirstNewKey();
+    if (first_new_key > keys_.size())
+    {
+        throw MiddlewareException("ResultDecoder::decode(): missing key dictionary entries "
+                                  + std::to_string(keys_.size()) + " to " + std::to_string(first_new_key - 1));
+    }
+    keys_.resize(first_new_key);  // No-op unless the sender has started a new dictionary.
+    for (auto const& key : r.getNewKeys())
+    {
+        keys_.push_back(text_to_string(key));
+    }
+
+    VariantMap attrs;
+    auto attr_keys = r.getAttrKeys();
+    auto attr_values = r.getAttrValues();
+    if (attr_keys.size() != attr_values.size())
+    {
+        throw MiddlewareException("ResultDecoder::decode(): attribute keys and values do not match");
+    }
+    for (unsigned i = 0; i < attr_keys.size(); ++i)
+    {
+        uint32_t const id = attr_keys[i];
+        if (id >= keys_.size())
+        {
+            throw MiddlewareException("ResultDecoder::decode(): invalid key index " + std::to_string(id));
+        }
+        attrs[keys_[id]] = to_variant(attr_values[i]);
+    }
+    if (r.hasUri())
+    {
+        attrs["uri"] = Variant(text_to_string(r.getUri()));
+    }
+    if (r.hasTitle())
+    {
+        attrs["title"] = Variant(text_to_string(r.getTitle()));
+    }
+    if (r.hasArt())
+    {
+        attrs["art"] = Variant(text_to_string(r.getArt()));
+    }
+    if (r.hasDndUri())
+    {
+        attrs["dnd_uri"] = Variant(text_to_string(r.getDndUri()));
+    }
+
+    VariantMap internal;
+    if (r.hasInternal())
+    {
+        internal = to_variant_map(r.getInternal());
+    }
+    if (r.hasCatId())
+    {
+        internal["cat_id"] = Variant(text_to_string(r.getCatId()));
+    }
+    if (r.hasOrigin())
+    {
+        internal["origin"] = Variant(text_to_string(r.getOrigin()));
+    }
+    if (r.getFlags() != 0)
+    {
+        internal["flags"] = Variant(r.getFlags());
+    }
+
+    VariantMap result;
+    result["attrs"] = VariantAccess::from_dict(move(attrs));
+    result["internal"] = VariantAccess::from_dict(move(internal));
+
+    VariantMap push;
+    push["result"] = VariantAccess::from_dict(move(result));
+    return push;
+}
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
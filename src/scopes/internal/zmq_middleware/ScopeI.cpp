@@ -99,7 +99,8 @@ void ScopeI::search_(Current const& current,
     ZmqReplyProxy reply_proxy(new ZmqReply(current.adapter->mw(),
                               proxy.getEndpoint().cStr(),
                               proxy.getIdentity().cStr(),
-                              proxy.getCategory().cStr()));
+                              proxy.getCategory().cStr(),
+                              proxy.getVersion()));
     auto context = to_variant_map(req.getContext());
     auto delegate = dynamic_pointer_cast<ScopeObjectBase>(del());
     assert(delegate);
@@ -128,7 +129,8 @@ void ScopeI::activate_(Current const& current,
     ZmqReplyProxy reply_proxy(new ZmqReply(current.adapter->mw(),
                                            proxy.getEndpoint().cStr(),
                                            proxy.getIdentity().cStr(),
-                                           proxy.getCategory().cStr()));
+                                           proxy.getCategory().cStr(),
+                                           proxy.getVersion()));
     auto delegate = dynamic_pointer_cast<ScopeObjectBase>(del());
     assert(delegate);
     auto ctrl_proxy = dynamic_pointer_cast<ZmqQueryCtrl>(delegate->activate(result,
@@ -157,7 +159,8 @@ void ScopeI::perform_action_(Current const& current,
     ZmqReplyProxy reply_proxy(new ZmqReply(current.adapter->mw(),
                                            proxy.getEndpoint().cStr(),
                                            proxy.getIdentity().cStr(),
-                                           proxy.getCategory().cStr()));
+                                           proxy.getCategory().cStr(),
+                                           proxy.getVersion()));
     auto delegate = dynamic_pointer_cast<ScopeObjectBase>(del());
     assert(delegate);
     auto ctrl_proxy = dynamic_pointer_cast<ZmqQueryCtrl>(delegate->perform_action(result,
@@ -186,7 +189,8 @@ void ScopeI::preview_(Current const& current,
     ZmqReplyProxy reply_proxy(new ZmqReply(current.adapter->mw(),
                                            proxy.getEndpoint().cStr(),
                                            proxy.getIdentity().cStr(),
-                                           proxy.getCategory().cStr()));
+                                           proxy.getCategory().cStr(),
+                                           proxy.getVersion()));
     auto delegate = dynamic_pointer_cast<ScopeObjectBase>(del());
     assert(delegate);
     auto ctrl_proxy = dynamic_pointer_cast<ZmqQueryCtrl>(delegate->preview(result,
@@ -214,7 +218,8 @@ void ScopeI::activate_result_action_(Current const& current,
     ZmqReplyProxy reply_proxy(new ZmqReply(current.adapter->mw(),
                                            proxy.getEndpoint().cStr(),
                                            proxy.getIdentity().cStr(),
-                                           proxy.getCategory().cStr()));
+                                           proxy.getCategory().cStr(),
+                                           proxy.getVersion()));
     auto delegate = dynamic_pointer_cast<ScopeObjectBase>(del());
     assert(delegate);
     auto ctrl_proxy = dynamic_pointer_cast<ZmqQueryCtrl>(delegate->activate_result_action(result,
@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/zmq_middleware/ShmChannel.h>
+
+#include <unity/scopes/ScopeExceptions.h>
+#include <unity/UnityExceptions.h>
+
+#include <capnp/serialize.h>
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace zmq_middleware
+{
+
+namespace
+{
+
+char const* ipc_prefix = "ipc://";
+char const* shm_suffix = ".shm";
+
+int const num_fds = 3;  // The ring's memory, data and space descriptors, in that order
+
+// Returns true if the peer has closed the connection.
+bool hung_up(int fd) noexcept
+{
+    struct pollfd pfd = { fd, POLLRDHUP, 0 };
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+}
+
+bool make_address(string const& path, struct sockaddr_un& addr) noexcept
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        return false;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+} // namespace
+
+string shm_channel_path(string const& endpoint)
+{
+    if (endpoint.compare(0, strlen(ipc_prefix), ipc_prefix) != 0)
+    {
+        return "";
+    }
+    return endpoint.substr(strlen(ipc_prefix)) + shm_suffix;
+}
+
+struct ShmListener::Channel
+{
+    int conn_fd;
+    ShmRing::UPtr ring;
+
+    ~Channel()
+    {
+        ::close(conn_fd);
+    }
+};
+
+ShmListener::ShmListener(string const& path, size_t ring_size, DispatchFunction const& dispatch)
+    : path_(path)
+    , ring_size_(ring_size)
+    , dispatch_(dispatch)
+    , listen_fd_(-1)
+    , epoll_fd_(-1)
+    , stop_fd_(-1)
+{
+    assert(dispatch);
+
+    struct sockaddr_un addr;
+    if (!make_address(path, addr))
+    {
+        throw InvalidArgumentException("ShmListener(): path too long: " + path);
+    }
+
+    // The listener belongs to an object adapter that has bound its endpoint successfully,
+    // so no other live process can be using the path.
+    unlink(path.c_str());
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if ((listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) == -1
+        || bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1
+        || listen(listen_fd_, SOMAXCONN) == -1
+        || (stop_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1
+        || (epoll_fd_ = epoll_create1(EPOLL_CLOEXEC)) == -1
+        || (ev.data.fd = listen_fd_, epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev)) == -1
+        || (ev.data.fd = stop_fd_, epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &ev)) == -1)
+    {
+        int err = errno;
+        close_fds();
+        throw SyscallException("ShmListener(): cannot listen on " + path, err);
+    }
+
+    thread_ = thread(&ShmListener::run, this);
+}
+
+ShmListener::~ShmListener()
+{
+    stop();
+}
+
+string ShmListener::path() const
+{
+    return path_;
+}
+
+void ShmListener::stop() noexcept
+{
+    call_once(stop_once_, [this]
+    {
+        eventfd_write(stop_fd_, 1);
+        thread_.join();
+        for (auto& pair : channels_)
+        {
+            pair.second->ring->close();  // Wakes up a sender that waits for space.
+        }
+        channels_.clear();
+        close_fds();
+    });
+}
+
+void ShmListener::run() noexcept
+{
+    struct epoll_event events[64];
+    for (;;)
+    {
+        int n = epoll_wait(epoll_fd_, events, 64, -1);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == stop_fd_)
+            {
+                return;
+            }
+            if (fd == listen_fd_)
+            {
+                accept_channels();
+                continue;
+            }
+            auto it = channels_.find(fd);
+            if (it == channels_.end())
+            {
+                continue;  // Removed earlier in this round.
+            }
+            auto c = it->second;
+            read_channel(*c);
+            if (fd == c->conn_fd || c->ring->closed())
+            {
+                // The sender has gone away (it never writes to the connection), or the ring is unusable.
+                remove_channel(c);
+            }
+        }
+    }
+}
+
+void ShmListener::accept_channels()
+{
+    for (;;)
+    {
+        int conn_fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (conn_fd == -1)
+        {
+            return;  // EAGAIN, or the peer gave up already.
+        }
+        auto c = make_shared<Channel>();
+        c->conn_fd = conn_fd;
+        try
+        {
+            c->ring = ShmRing::create(ring_size_);
+        }
+        catch (std::exception const&)
+        {
+            continue;  // The sender sees the connection close and uses zmq instead.
+        }
+
+        // Hand the ring's descriptors to the sender.
+        int fds[num_fds] = { c->ring->mem_fd(), c->ring->data_fd(), c->ring->space_fd() };
+        char byte = 0;
+        struct iovec iov = { &byte, 1 };
+        union
+        {
+            char buf[CMSG_SPACE(sizeof(fds))];
+            struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        if (sendmsg(conn_fd, &msg, MSG_NOSIGNAL) != 1)
+        {
+            continue;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = conn_fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, conn_fd, &ev) == -1)
+        {
+            continue;
+        }
+        ev.events = EPOLLIN;
+        ev.data.fd = c->ring->data_fd();
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, c->ring->data_fd(), &ev) == -1)
+        {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn_fd, nullptr);
+            continue;
+        }
+        channels_[conn_fd] = c;
+        channels_[c->ring->data_fd()] = c;
+
+        read_channel(*c);  // Tells the sender to wake us up once it has written something.
+    }
+}
+
+void ShmListener::read_channel(Channel& c)
+{
+    c.ring->read([this](kj::ArrayPtr<capnp::word const> words)
+    {
+        try
+        {
+            capnp::FlatArrayMessageReader message(words);
+            dispatch_(message);
+        }
+        catch (...)
+        {
+            // Malformed message; the dispatch function deals with anything else.
+        }
+    });
+}
+
+void ShmListener::remove_channel(shared_ptr<Channel> const& c)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, c->conn_fd, nullptr);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, c->ring->data_fd(), nullptr);
+    c->ring->close();
+    channels_.erase(c->ring->data_fd());
+    channels_.erase(c->conn_fd);  // Last reference, unless the caller holds one.
+}
+
+void ShmListener::close_fds() noexcept
+{
+    for (int fd : { listen_fd_, epoll_fd_, stop_fd_ })
+    {
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+    }
+    listen_fd_ = epoll_fd_ = stop_fd_ = -1;
+    unlink(path_.c_str());
+}
+
+struct ShmSender::Channel
+{
+    int conn_fd;
+    ShmRing::UPtr ring;
+
+    ~Channel()
+    {
+        ::close(conn_fd);
+    }
+};
+
+ShmSender::ShmSender(int64_t timeout)
+    : timeout_(timeout)
+{
+}
+
+ShmSender::~ShmSender()
+{
+    // Closing the connections tells the listeners to read what is left and to discard the rings.
+}
+
+bool ShmSender::send(string const& path, kj::ArrayPtr<kj::ArrayPtr<capnp::word const> const> segments)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto it = channels_.find(path);
+    if (it == channels_.end())
+    {
+        it = channels_.emplace(path, connect(path)).first;
+    }
+    auto& c = it->second;
+    if (!c)
+    {
+        return false;
+    }
+
+    int const timeout = timeout_ < 0 ? -1 : static_cast<int>(min<int64_t>(timeout_, numeric_limits<int>::max()));
+    if (!c->ring->closed())
+    {
+        if (ShmRing::message_size(segments) <= c->ring->max_message_size()
+            && c->ring->write(segments, timeout, c->conn_fd))
+        {
+            return true;
+        }
+
+        // Too large for the ring, or the receiver did not make room in time. We switch to the other
+        // route for good, but only once the receiver has dispatched everything in the ring, so this
+        // request does not overtake earlier ones. If the receiver is still there but does not drain
+        // the ring, the request cannot be sent in order at all.
+        if (!c->ring->wait_until_empty(timeout, c->conn_fd) && !c->ring->closed() && !hung_up(c->conn_fd))
+        {
+            c.reset();
+            throw TimeoutException("ShmSender::send(): receiver at " + path + " does not drain its channel");
+        }
+    }
+    c.reset();
+    return false;
+}
+
+unique_ptr<ShmSender::Channel> ShmSender::connect(string const& path) noexcept
+{
+    struct sockaddr_un addr;
+    if (!make_address(path, addr))
+    {
+        return nullptr;
+    }
+    int conn_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn_fd == -1)
+    {
+        return nullptr;
+    }
+    unique_ptr<Channel> c(new Channel);
+    c->conn_fd = conn_fd;
+    if (::connect(conn_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1)
+    {
+        return nullptr;  // No listener, so the receiver does not do shared memory after all.
+    }
+
+    // The listener answers with the ring's descriptors straight away.
+    struct timeval tv;
+    int64_t const timeout = timeout_ < 0 ? 0 : timeout_;  // A zero SO_RCVTIMEO blocks indefinitely.
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = timeout % 1000 * 1000;
+    setsockopt(conn_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int fds[num_fds];
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (recvmsg(conn_fd, &msg, MSG_CMSG_CLOEXEC) != 1)
+    {
+        return nullptr;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        return nullptr;
+    }
+    if (cmsg->cmsg_len != CMSG_LEN(sizeof(fds)) || (msg.msg_flags & MSG_CTRUNC))
+    {
+        // Close whatever we were sent.
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < n && i < num_fds; ++i)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            ::close(fd);
+        }
+        return nullptr;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    try
+    {
+        c->ring = ShmRing::attach(fds[0], fds[1], fds[2]);
+    }
+    catch (std::exception const&)
+    {
+        return nullptr;
+    }
+    return c;
+}
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/zmq_middleware/ShmRing.h>
+
+#include <unity/UnityExceptions.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Older C libraries have neither a memfd_create() wrapper nor the sealing constants.
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace zmq_middleware
+{
+
+// The segment starts with a page that holds the header, followed by the ring proper.
+// head and tail count the bytes written and read since the ring was created; they are
+// on separate cache lines so the two sides do not contend for them.
+//
+// Each message is a 64-bit length, followed by that many bytes of flat array message
+// (segment table and segments). A message never wraps around the end of the ring;
+// if it does not fit, the producer writes wrap_marker and continues at the start.
+
+struct ShmRing::Header
+{
+    atomic<uint64_t> head;              // Advanced by the producer
+    char pad1[64 - sizeof(atomic<uint64_t>)];
+    atomic<uint64_t> tail;              // Advanced by the consumer
+    char pad2[64 - sizeof(atomic<uint64_t>)];
+    atomic<uint32_t> consumer_waiting;  // Set by the consumer before it sleeps on data_fd
+    atomic<uint32_t> producer_waiting;  // Set by the producer before it sleeps on space_fd
+    atomic<uint32_t> closed;
+};
+
+namespace
+{
+
+size_t const header_size = 4096;
+uint64_t const wrap_marker = ~uint64_t(0);
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "ShmRing needs address-free 64-bit atomics");
+
+void close_fds(int mem_fd, int data_fd, int space_fd) noexcept
+{
+    for (int fd : { mem_fd, data_fd, space_fd })
+    {
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+inline size_t table_size(size_t num_segments) noexcept
+{
+    // Segment count and one size per segment, as 32-bit values, padded to a whole word.
+    return (num_segments + 2) / 2 * sizeof(capnp::word);
+}
+
+} // namespace
+
+ShmRing::UPtr ShmRing::create(size_t capacity)
+{
+    size_t const page_size = sysconf(_SC_PAGESIZE);
+    capacity = max(page_size, (capacity + page_size - 1) / page_size * page_size);
+
+    int mem_fd = -1;
+    int data_fd = -1;
+    int space_fd = -1;
+    mem_fd = syscall(SYS_memfd_create, "unity-scopes-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mem_fd == -1
+        || ftruncate(mem_fd, header_size + capacity) == -1
+        // The size is fixed from now on, so the producer cannot make us fault by shrinking the file.
+        || fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1
+        || (data_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1
+        || (space_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1)
+    {
+        int err = errno;
+        close_fds(mem_fd, data_fd, space_fd);
+        throw SyscallException("ShmRing::create(): cannot create shared memory ring", err);
+    }
+    return UPtr(new ShmRing(mem_fd, data_fd, space_fd));
+}
+
+ShmRing::UPtr ShmRing::attach(int mem_fd, int data_fd, int space_fd)
+{
+    // We only map segments whose size cannot change underneath us.
+    int seals = fcntl(mem_fd, F_GET_SEALS);
+    if (seals == -1 || (seals & (F_SEAL_SHRINK | F_SEAL_SEAL)) != (F_SEAL_SHRINK | F_SEAL_SEAL))
+    {
+        close_fds(mem_fd, data_fd, space_fd);
+        throw ResourceException("ShmRing::attach(): shared memory segment is not sealed");
+    }
+    return UPtr(new ShmRing(mem_fd, data_fd, space_fd));
+}
+
+ShmRing::ShmRing(int mem_fd, int data_fd, int space_fd)
+    : mem_fd_(mem_fd)
+    , data_fd_(data_fd)
+    , space_fd_(space_fd)
+    , map_(MAP_FAILED)
+{
+    static_assert(sizeof(Header) <= header_size, "ShmRing header does not fit into its page");
+
+    struct stat st;
+    if (fstat(mem_fd, &st) == -1)
+    {
+        int err = errno;
+        close_fds(mem_fd, data_fd, space_fd);
+        throw SyscallException("ShmRing: cannot stat shared memory segment", err);
+    }
+    map_size_ = st.st_size;
+    if (map_size_ <= header_size || (map_size_ - header_size) % sizeof(capnp::word) != 0)
+    {
+        close_fds(mem_fd, data_fd, space_fd);
+        throw ResourceException("ShmRing: invalid shared memory segment size: " + to_string(map_size_));
+    }
+    map_ = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (map_ == MAP_FAILED)
+    {
+        int err = errno;
+        close_fds(mem_fd, data_fd, space_fd);
+        throw SyscallException("ShmRing: cannot map shared memory segment", err);
+    }
+    header_ = static_cast<Header*>(map_);
+    data_ = static_cast<char*>(map_) + header_size;
+    capacity_ = map_size_ - header_size;
+}
+
+ShmRing::~ShmRing()
+{
+    munmap(map_, map_size_);
+    close_fds(mem_fd_, data_fd_, space_fd_);
+}
+
+int ShmRing::mem_fd() const noexcept
+{
+    return mem_fd_;
+}
+
+int ShmRing::data_fd() const noexcept
+{
+    return data_fd_;
+}
+
+int ShmRing::space_fd() const noexcept
+{
+    return space_fd_;
+}
+
+size_t ShmRing::capacity() const noexcept
+{
+    return capacity_;
+}
+
+size_t ShmRing::message_size(kj::ArrayPtr<kj::ArrayPtr<capnp::word const> const> segments) noexcept
+{
+    size_t size = sizeof(uint64_t) + table_size(segments.size());
+    for (auto const& s : segments)
+    {
+        size += s.size() * sizeof(capnp::word);
+    }
+    return size;
+}
+
+size_t ShmRing::max_message_size() const noexcept
+{
+    // With messages no larger than half the ring, a message plus the padding in front
+    // of it always fits into an empty ring.
+    return capacity_ / 2 / sizeof(capnp::word) * sizeof(capnp::word);
+}
+
+bool ShmRing::write(kj::ArrayPtr<kj::ArrayPtr<capnp::word const> const> segments, int timeout, int peer_fd)
+{
+    assert(segments.size() > 0);
+
+    size_t const size = message_size(segments);
+    if (size > max_message_size())
+    {
+        return false;
+    }
+
+    uint64_t head = header_->head.load(memory_order_relaxed);  // Only we write head.
+    size_t pos = head % capacity_;
+    size_t const contiguous = capacity_ - pos;
+    if (!wait_for_space(size <= contiguous ? size : contiguous + size, timeout, peer_fd))
+    {
+        return false;
+    }
+    if (size > contiguous)
+    {
+        memcpy(data_ + pos, &wrap_marker, sizeof(wrap_marker));
+        head += contiguous;
+        pos = 0;
+    }
+
+    char* p = data_ + pos;
+    uint64_t const body_size = size - sizeof(uint64_t);
+    memcpy(p, &body_size, sizeof(body_size));
+    p += sizeof(body_size);
+
+    auto table = reinterpret_cast<uint32_t*>(p);
+    table[0] = segments.size() - 1;
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        table[i + 1] = segments[i].size();
+    }
+    if (segments.size() % 2 == 0)
+    {
+        table[segments.size() + 1] = 0;
+    }
+    p += table_size(segments.size());
+
+    for (auto const& s : segments)
+    {
+        memcpy(p, s.begin(), s.size() * sizeof(capnp::word));
+        p += s.size() * sizeof(capnp::word);
+    }
+
+    // Publish the message, then check whether the consumer went to sleep before it could see it.
+    header_->head.store(head + size);
+    if (header_->consumer_waiting.load() && header_->consumer_waiting.exchange(0))
+    {
+        eventfd_write(data_fd_, 1);
+    }
+    return true;
+}
+
+bool ShmRing::wait_until_empty(int timeout, int peer_fd)
+{
+    return wait_for_space(capacity_, timeout, peer_fd);
+}
+
+bool ShmRing::wait_for_space(size_t needed, int timeout, int peer_fd)
+{
+    auto const deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+    uint64_t const head = header_->head.load(memory_order_relaxed);
+    for (;;)
+    {
+        if (closed())
+        {
+            return false;
+        }
+        uint64_t tail = header_->tail.load(memory_order_acquire);
+        if (head - tail > capacity_)
+        {
+            close();  // The consumer has written garbage into the header.
+            return false;
+        }
+        if (capacity_ - (head - tail) >= needed)
+        {
+            return true;
+        }
+
+        // Announce that we are about to sleep, then look again, in case the consumer
+        // made room before it could see the announcement.
+        header_->producer_waiting.store(1);
+        tail = header_->tail.load();
+        if (head - tail <= capacity_ && capacity_ - (head - tail) >= needed)
+        {
+            header_->producer_waiting.store(0);
+            continue;
+        }
+
+        int remaining = -1;
+        if (timeout >= 0)
+        {
+            remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            if (remaining <= 0)
+            {
+                return false;
+            }
+        }
+        struct pollfd fds[2] = { { space_fd_, POLLIN, 0 }, { peer_fd, POLLRDHUP, 0 } };
+        int rc = poll(fds, peer_fd == -1 ? 1 : 2, remaining);
+        if (rc == -1 && errno != EINTR)
+        {
+            return false;
+        }
+        if (peer_fd != -1 && (fds[1].revents & (POLLRDHUP | POLLHUP | POLLERR)))
+        {
+            return false;
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            eventfd_t value;
+            eventfd_read(space_fd_, &value);
+        }
+    }
+}
+
+size_t ShmRing::read(function<void(kj::ArrayPtr<capnp::word const>)> const& f)
+{
+    eventfd_t value;
+    eventfd_read(data_fd_, &value);  // Clear any pending wake-up.
+    header_->consumer_waiting.store(0);
+
+    size_t count = 0;
+    uint64_t tail = header_->tail.load(memory_order_relaxed);  // Only we write tail.
+    for (;;)
+    {
+        uint64_t head = header_->head.load(memory_order_acquire);
+        if (head == tail)
+        {
+            // Announce that we are about to sleep, then look again, in case the producer
+            // added a message before it could see the announcement.
+            header_->consumer_waiting.store(1);
+            if (header_->head.load() == tail)
+            {
+                return count;
+            }
+            header_->consumer_waiting.store(0);
+            continue;
+        }
+
+        uint64_t const available = head - tail;
+        size_t const pos = tail % capacity_;
+        if (available > capacity_ || available % sizeof(capnp::word) != 0)
+        {
+            close();  // The producer has written garbage into the header.
+            return count;
+        }
+
+        uint64_t body_size;
+        memcpy(&body_size, data_ + pos, sizeof(body_size));
+        if (body_size == wrap_marker)
+        {
+            if (capacity_ - pos > available)
+            {
+                close();
+                return count;
+            }
+            tail += capacity_ - pos;
+        }
+        else
+        {
+            if (body_size % sizeof(capnp::word) != 0 || body_size > min<uint64_t>(available, capacity_ - pos) - sizeof(body_size))
+            {
+                close();
+                return count;
+            }
+            f(kj::ArrayPtr<capnp::word const>(reinterpret_cast<capnp::word const*>(data_ + pos + sizeof(body_size)),
+                                              body_size / sizeof(capnp::word)));
+            ++count;
+            tail += sizeof(body_size) + body_size;
+        }
+
+        header_->tail.store(tail);
+        wake_producer();
+    }
+}
+
+void ShmRing::close() noexcept
+{
+    header_->closed.store(1);
+    eventfd_write(data_fd_, 1);
+    eventfd_write(space_fd_, 1);
+}
+
+bool ShmRing::closed() const noexcept
+{
+    return header_->closed.load() != 0;
+}
+
+void ShmRing::wake_producer() noexcept
+{
+    if (header_->producer_waiting.load() && header_->producer_waiting.exchange(0))
+    {
+        eventfd_write(space_fd_, 1);
+    }
+}
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/zmq_middleware/TwowayInvoker.h>
+
+#include <scopes/internal/zmq_middleware/capnproto/Message.capnp.h>
+#include <unity/scopes/internal/zmq_middleware/ZmqReceiver.h>
+#include <unity/scopes/internal/zmq_middleware/ZmqSender.h>
+#include <unity/scopes/ScopeExceptions.h>
+#include <unity/UnityExceptions.h>
+
+#include <capnp/serialize.h>
+#include <zmqpp/poller.hpp>
+#include <zmqpp/socket.hpp>
+
+#include <cassert>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace internal
+{
+
+namespace zmq_middleware
+{
+
+namespace
+{
+
+string describe(capnp::MessageBuilder& request, string const& endpoint)
+{
+    string op_name = request.getRoot<capnproto::Request>().getOpName().cStr();
+    return "(endpoint = " + endpoint + ", op = " + op_name + ")";
+}
+
+} // namespace
+
+TwowayInvoker::TwowayInvoker(zmqpp::context& context, int max_requests, int max_per_endpoint) :
+    context_(context),
+    max_requests_(max_requests),
+    max_per_endpoint_(max_per_endpoint),
+    stopped_(false)
+{
+    assert(max_requests > 0);
+    assert(max_per_endpoint > 0);
+
+    if ((wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1)
+    {
+        throw SyscallException("TwowayInvoker(): cannot create eventfd", errno);
+    }
+    try
+    {
+        thread_ = thread(&TwowayInvoker::run, this);
+    }
+    catch (...)
+    {
+        close(wake_fd_);
+        throw;
+    }
+}
+
+TwowayInvoker::~TwowayInvoker()
+{
+    stop();
+    close(wake_fd_);
+}
+
+future<TwowayOutParams> TwowayInvoker::invoke(string const& endpoint, capnp::MessageBuilder& request, int64_t timeout)
+{
+    assert(timeout >= -1);
+
+    Request r;
+    r.endpoint = endpoint;
+    r.message = &request;
+    r.timeout = timeout;
+    r.deadline = timeout == -1 ? Clock::time_point::max() : Clock::now() + chrono::milliseconds(timeout);
+    auto future = r.promise.get_future();
+    submit(move(r));
+    return future;
+}
+
+void TwowayInvoker::invoke_async(string const& endpoint,
+                                 shared_ptr<capnp::MessageBuilder> const& request,
+                                 int64_t timeout,
+                                 ReplyCallback on_reply)
+{
+    assert(timeout >= -1);
+    assert(request);
+    assert(on_reply);
+
+    Request r;
+    r.endpoint = endpoint;
+    r.message = request.get();
+    r.timeout = timeout;
+    r.deadline = timeout == -1 ? Clock::time_point::max() : Clock::now() + chrono::milliseconds(timeout);
+    r.owned_message = request;
+    r.on_reply = move(on_reply);
+    submit(move(r));
+}
+
+void TwowayInvoker::submit(Request r)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (stopped_)
+        {
+            throw MiddlewareException("Cannot invoke operations while middleware is stopped");
+        }
+        submitted_.push_back(move(r));
+    }
+    eventfd_write(wake_fd_, 1);
+}
+
+void TwowayInvoker::stop() noexcept
+{
+    call_once(stop_once_, [this]
+    {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        eventfd_write(wake_fd_, 1);
+        thread_.join();
+    });
+}
+
+void TwowayInvoker::run() noexcept
+{
+    zmqpp::poller poller;
+    try
+    {
+        poller.add(wake_fd_);
+        for (;;)
+        {
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (stopped_)
+                {
+                    break;
+                }
+                for (auto& r : submitted_)
+                {
+                    waiting_.push_back(move(r));
+                }
+                submitted_.clear();
+            }
+
+            auto now = Clock::now();
+            expire_requests(poller, now);
+            send_requests(poller);
+
+            poller.poll(poll_timeout(now));
+            if (poller.has_input(wake_fd_))
+            {
+                eventfd_t value;
+                eventfd_read(wake_fd_, &value);
+            }
+            receive_replies(poller);
+        }
+    }
+    catch (...)
+    {
+        // The poller failed, so there is no way to collect any more replies. We treat this as
+        // if we had been stopped; subsequent invocations throw.
+    }
+
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopped_ = true;
+        for (auto& r : submitted_)
+        {
+            waiting_.push_back(move(r));
+        }
+        submitted_.clear();
+    }
+    for (auto& r : waiting_)
+    {
+        abandon(r);
+    }
+    for (auto& f : in_flight_)
+    {
+        abandon(f.request);
+    }
+    waiting_.clear();
+    in_flight_.clear();  // Outgoing twoway sockets closed here.
+    per_endpoint_.clear();
+}
+
+// Fail the requests whose deadline has passed, whether they are still waiting or in flight.
+
+void TwowayInvoker::expire_requests(zmqpp::poller& poller, Clock::time_point now)
+{
+    for (auto it = waiting_.begin(); it != waiting_.end(); )
+    {
+        if (it->deadline <= now)
+        {
+            time_out(*it);
+            it = waiting_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (auto it = in_flight_.begin(); it != in_flight_.end(); )
+    {
+        if (it->request.deadline <= now)
+        {
+            time_out(it->request);
+            it = retire(poller, it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+// Send waiting requests, oldest first, for as long as the limits permit.
+// A request to a busy endpoint does not hold up requests to other endpoints.
+
+void TwowayInvoker::send_requests(zmqpp::poller& poller)
+{
+    for (auto it = waiting_.begin(); it != waiting_.end() && in_flight_.size() < size_t(max_requests_); )
+    {
+        auto count = per_endpoint_.find(it->endpoint);
+        if (count != per_endpoint_.end() && count->second >= max_per_endpoint_)
+        {
+            ++it;
+            continue;
+        }
+        send_request(poller, *it);
+        it = waiting_.erase(it);
+    }
+}
+
+void TwowayInvoker::send_request(zmqpp::poller& poller, Request& r)
+{
+    try
+    {
+        unique_ptr<zmqpp::socket> s(new zmqpp::socket(context_, zmqpp::socket_type::request));
+        // Allow some linger time so we don't hang indefinitely if the other end disappears.
+        s->set(zmqpp::socket_option::linger, 100);
+        // We set a reconnect interval of 20 ms, so we get to the peer quickly, in case
+        // the peer hasn't finished binding to its endpoint yet after being exec'd.
+        // We back off exponentially to half the call timeout. If we haven't connected
+        // by then, the request will time out anyway. For infinite timeout, we try
+        // once a second.
+        int reconnect_max = r.timeout == -1 ? 1000 : r.timeout / 2;
+        s->set(zmqpp::socket_option::reconnect_interval, 20);
+        s->set(zmqpp::socket_option::reconnect_interval_max, reconnect_max);
+        s->connect(r.endpoint);
+        ZmqSender sender(*s);
+        sender.send(r.message->getSegmentsForOutput());
+
+        poller.add(*s);
+        ++per_endpoint_[r.endpoint];
+        in_flight_.push_back(InFlight{ move(r), move(s) });
+    }
+    catch (...)
+    {
+        r.promise.set_exception(current_exception());
+        complete(r);
+    }
+}
+
+void TwowayInvoker::receive_replies(zmqpp::poller& poller)
+{
+    for (auto it = in_flight_.begin(); it != in_flight_.end(); )
+    {
+        if (!poller.has_input(*it->socket))
+        {
+            ++it;
+            continue;
+        }
+        try
+        {
+            // Because the ZmqReceiver holds the memory for the unmarshaling buffer, we pass both the receiver
+            // and the capnp reader in a struct.
+            TwowayOutParams out_params;
+            out_params.receiver.reset(new ZmqReceiver(*it->socket));
+            auto segments = out_params.receiver->receive();
+            out_params.reader.reset(new capnp::SegmentArrayMessageReader(segments));
+            it->request.promise.set_value(move(out_params));
+        }
+        catch (...)
+        {
+            it->request.promise.set_exception(current_exception());
+        }
+        complete(it->request);
+        it = retire(poller, it);
+    }
+}
+
+// Returns the number of milliseconds until the nearest deadline, or wait_forever if there is none.
+// We round up, so we do not wake up just before a deadline and go around the loop for nothing.
+
+long TwowayInvoker::poll_timeout(Clock::time_point now) const
+{
+    auto deadline = Clock::time_point::max();
+    for (auto const& r : waiting_)
+    {
+        deadline = min(deadline, r.deadline);
+    }
+    for (auto const& f : in_flight_)
+    {
+        deadline = min(deadline, f.request.deadline);
+    }
+    if (deadline == Clock::time_point::max())
+    {
+        return zmqpp::poller::wait_forever;
+    }
+    return chrono::duration_cast<chrono::milliseconds>(deadline - now).count() + 1;
+}
+
+list<TwowayInvoker::InFlight>::iterator TwowayInvoker::retire(zmqpp::poller& poller, list<InFlight>::iterator it)
+{
+    poller.remove(*it->socket);
+    auto count = per_endpoint_.find(it->request.endpoint);
+    assert(count != per_endpoint_.end());
+    if (--count->second == 0)
+    {
+        per_endpoint_.erase(count);
+    }
+    return in_flight_.erase(it);
+}
+
+void TwowayInvoker::time_out(Request& r)
+{
+    r.promise.set_exception(make_exception_ptr(
+        TimeoutException("Request timed out after " + std::to_string(r.timeout) + " milliseconds "
+                         + describe(*r.message, r.endpoint))));
+    complete(r);
+}
+
+void TwowayInvoker::abandon(Request& r)
+{
+    r.promise.set_exception(make_exception_ptr(
+        MiddlewareException("Twoway request abandoned because the middleware was stopped "
+                            + describe(*r.message, r.endpoint))));
+    complete(r);
+}
+
+// Called once r.promise is ready. For a request that was submitted with invoke_async(),
+// hands the future to the callback.
+
+void TwowayInvoker::complete(Request& r) noexcept
+{
+    if (!r.on_reply)
+    {
+        return;
+    }
+    ReplyCallback on_reply;
+    swap(on_reply, r.on_reply);  // Runs at most once, and releases what it captured on return
+    try
+    {
+        on_reply(r.promise.get_future());
+    }
+    catch (...)
+    {
+        // Nobody to report this to; the callback is expected to deal with its own errors.
+    }
+}
+
+} // namespace zmq_middleware
+
+} // namespace internal
+
+} // namespace scopes
+
+} // namespace unity
@@ -45,6 +45,9 @@ namespace
     const string child_scopes_timeout_key = "ChildScopes.Timeout";
     const string registry_endpoint_dir_key = "Registry.EndpointDir";
     const string ss_registry_endpoint_dir_key = "Smartscopes.Registry.EndpointDir";
+    const string shm_ring_size_key = "SharedMemory.RingSize";
+    const string twoway_max_requests_key = "Twoway.MaxRequests";
+    const string twoway_max_requests_per_endpoint_key = "Twoway.MaxRequestsPerEndpoint";
 }
 
 ZmqConfig::ZmqConfig(string const& configfile) :
@@ -97,6 +100,27 @@ ZmqConfig::ZmqConfig(string const& configfile) :
         throw_ex("Illegal value (" + to_string(child_scopes_timeout_) + ") for " + child_scopes_timeout_key + ": value must be 10-60000");
     }
 
+    shm_ring_size_ = get_optional_int(zmq_config_group, shm_ring_size_key, DFLT_ZMQ_SHM_RING_SIZE);
+    if (shm_ring_size_ != 0 && (shm_ring_size_ < 64 || shm_ring_size_ > 65536))
+    {
+        throw_ex("Illegal value (" + to_string(shm_ring_size_) + ") for " + shm_ring_size_key + ": value must be 0 or 64-65536");
+    }
+
+    twoway_max_requests_ = get_optional_int(zmq_config_group, twoway_max_requests_key, DFLT_ZMQ_TWOWAY_MAX_REQUESTS);
+    if (twoway_max_requests_ < 1 || twoway_max_requests_ > 4096)
+    {
+        throw_ex("Illegal value (" + to_string(twoway_max_requests_) + ") for " + twoway_max_requests_key + ": value must be 1-4096");
+    }
+
+    twoway_max_requests_per_endpoint_ = get_optional_int(zmq_config_group,
+                                                         twoway_max_requests_per_endpoint_key,
+                                                         DFLT_ZMQ_TWOWAY_MAX_REQUESTS_PER_ENDPOINT);
+    if (twoway_max_requests_per_endpoint_ < 1 || twoway_max_requests_per_endpoint_ > twoway_max_requests_)
+    {
+        throw_ex("Illegal value (" + to_string(twoway_max_requests_per_endpoint_) + ") for "
+                 + twoway_max_requests_per_endpoint_key + ": value must be 1-" + to_string(twoway_max_requests_));
+    }
+
     registry_endpoint_dir_ = get_optional_string(zmq_config_group, registry_endpoint_dir_key);
     ss_registry_endpoint_dir_ = get_optional_string(zmq_config_group, ss_registry_endpoint_dir_key);
 
@@ -109,7 +133,10 @@ ZmqConfig::ZmqConfig(string const& configfile) :
                                                 registry_timeout_key,
                                                 child_scopes_timeout_key,
                                                 registry_endpoint_dir_key,
-                                                ss_registry_endpoint_dir_key
+                                                ss_registry_endpoint_dir_key,
+                                                shm_ring_size_key,
+                                                twoway_max_requests_key,
+                                                twoway_max_requests_per_endpoint_key
                                              }
                                           }
                                        };
@@ -145,6 +172,21 @@ int ZmqConfig::child_scopes_timeout() const
     return child_scopes_timeout_;
 }
 
+int ZmqConfig::shm_ring_size() const
+{
+    return shm_ring_size_;
+}
+
+int ZmqConfig::twoway_max_requests() const
+{
+    return twoway_max_requests_;
+}
+
+int ZmqConfig::twoway_max_requests_per_endpoint() const
+{
+    return twoway_max_requests_per_endpoint_;
+}
+
 string ZmqConfig::registry_endpoint_dir() const
 {
     return registry_endpoint_dir_;
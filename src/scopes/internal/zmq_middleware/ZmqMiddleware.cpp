@@ -29,7 +29,9 @@
 #include <unity/scopes/internal/zmq_middleware/RegistryI.h>
 #include <unity/scopes/internal/zmq_middleware/ReplyI.h>
 #include <unity/scopes/internal/zmq_middleware/ScopeI.h>
+#include <unity/scopes/internal/zmq_middleware/ShmChannel.h>
 #include <unity/scopes/internal/zmq_middleware/StateReceiverI.h>
+#include <unity/scopes/internal/zmq_middleware/TwowayInvoker.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqConfig.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqPublisher.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqQuery.h>
@@ -91,7 +93,9 @@ void create_dir(string const& dir, mode_t mode)
 ZmqMiddleware::ZmqMiddleware(string const& server_name, RuntimeImpl* runtime, string const& configfile) :
     MiddlewareBase(runtime),
     server_name_(server_name),
+    shm_listener_failed_(false),
     state_(Created),
+    stopping_invokers_(false),
     shutdown_flag_(false),
     // Some tests use a nullptr for the run time, so we use a different logger in that case.
     test_logger_(runtime ? nullptr : new Logger("ZmqMiddleware_test_logger")),
@@ -107,6 +111,9 @@ ZmqMiddleware::ZmqMiddleware(string const& server_name, RuntimeImpl* runtime, st
         locate_timeout_ = config.locate_timeout();
         registry_timeout_ = config.registry_timeout();
         child_scopes_timeout_ = config.child_scopes_timeout();
+        shm_ring_size_ = config.shm_ring_size() * 1024;
+        twoway_max_requests_ = config.twoway_max_requests();
+        twoway_max_requests_per_endpoint_ = config.twoway_max_requests_per_endpoint();
         public_endpoint_dir_ = config.endpoint_dir();
         private_endpoint_dir_ = public_endpoint_dir_ + "/priv";
         registry_endpoint_dir_ = public_endpoint_dir_;
@@ -138,6 +145,8 @@ ZmqMiddleware::ZmqMiddleware(string const& server_name, RuntimeImpl* runtime, st
         create_dir(private_endpoint_dir_, 0700 | S_ISVTX);
         create_dir(registry_endpoint_dir_, 0755 | S_ISVTX);
         create_dir(ss_registry_endpoint_dir_, 0755 | S_ISVTX);
+
+        shm_sender_.reset(new ShmSender(twoway_timeout_));
     }
     catch (...)
     {
@@ -206,17 +215,11 @@ void ZmqMiddleware::start()
                 try
                 {
                     oneway_invoker_.reset(new ThreadPool(1));  // Oneway pool must have a single thread
-                    // N.B. We absolutely MUST have AT LEAST 5 two-way invoke threads:
-                    // * 3 threads are required to execute a standard scope invocation as both
-                    //   rebinding and debug_mode requests could be invoked within a single two-way
-                    //   invocation.
-                    // * We then need an extra thread available per layer of hierarchy under an
-                    //   aggregating scope as an aggregator may invoke a nested scope while running in
-                    //   a thread of its own.
-                    // * 5 threads therefore, at least allows for an aggregating scope to invoke nested
-                    //   aggregators.
-                    // (NOTE: To be safe, we should keep some headroom above this 5 thread minimum)
-                    twoway_invokers_.reset(new ThreadPool(8));  // TODO: get pool size from config
+                    // Callers wait for twoway replies on their own thread, so nested invocations
+                    // (such as an aggregator calling its children) cannot exhaust the invoker.
+                    twoway_invoker_.reset(new TwowayInvoker(context_,
+                                                            twoway_max_requests_,
+                                                            twoway_max_requests_per_endpoint_));
                 }
                 catch (std::exception const& e)
                 {
@@ -252,20 +255,42 @@ void ZmqMiddleware::stop()
         case Created:
         case Started:
         {
-            lock_guard<mutex> lock(data_mutex_);
+            if (stopping_invokers_)
+            {
+                // Another thread is stopping the invokers; wait for it to finish the job.
+                state_changed_.wait(lock, [this] { return state_ != Started; });
+                break;
+            }
 
-            // No more outgoing invocations
-            assert((oneway_invoker_ && twoway_invokers_) || (!oneway_invoker_ && !twoway_invokers_));
-            if (oneway_invoker_)
+            ThreadPool* oneway_invoker;
+            TwowayInvoker* twoway_invoker;
             {
-                twoway_invokers_->destroy();            // Destroy immediately, because invocations can take time.
-                oneway_invoker_->destroy_once_empty();  // Wait for queued oneways to go out first.
+                lock_guard<mutex> data_lock(data_mutex_);
+                assert((oneway_invoker_ && twoway_invoker_) || (!oneway_invoker_ && !twoway_invoker_));
+                oneway_invoker = oneway_invoker_.get();
+                twoway_invoker = twoway_invoker_.get();
+            }
+
+            // No more outgoing invocations. Stopping the twoway invoker fails outstanding requests, which runs
+            // the callbacks of asynchronous requests. Those callbacks call back into the middleware to send
+            // a oneway or another twoway request, so we must not hold our locks here. The invokers are never
+            // replaced once the middleware has started, so the pointers remain valid.
+            if (oneway_invoker)
+            {
+                stopping_invokers_ = true;
+                lock.unlock();
+                twoway_invoker->stop();                // Fail outstanding requests immediately, because replies can take time.
+                oneway_invoker->destroy_once_empty();  // Wait for queued oneways to go out first.
+                lock.lock();
             }
 
             // Initiate shutdown of all adapters
-            for (auto& pair : am_)
             {
-                pair.second->shutdown();
+                lock_guard<mutex> data_lock(data_mutex_);
+                for (auto& pair : am_)
+                {
+                    pair.second->shutdown();
+                }
             }
 
             state_ = Stopping;
@@ -305,9 +330,16 @@ void ZmqMiddleware::wait_for_shutdown()
 
     // Exactly one thread gets to this point.
     AdapterMap adapter_map;
+    unique_ptr<ShmListener> shm_listener;
     {
         lock_guard<mutex> data_lock(data_mutex_);
         adapter_map = move(am_);
+        shm_listener = move(shm_listener_);
+        shm_listener_failed_ = true;  // No new listener once we are shutting down.
+    }
+    if (shm_listener)
+    {
+        shm_listener->stop();  // Before the reply adapter goes away.
     }
     for (auto&& pair : adapter_map)
     {
@@ -666,8 +698,10 @@ MWReplyProxy ZmqMiddleware::add_reply_object(ReplyObjectBase::SPtr const& reply)
         function<void()> df;
         auto p = safe_add(df, adapter, "", ri);
         reply->set_disconnect_function(df);
-        proxy = ZmqReplyProxy(new ZmqReply(this, p->endpoint(), p->identity(), reply_category));
         adapter->activate();
+        // Scopes learn from the version whether they can send replies via shared memory.
+        auto version = start_shm_listener(adapter) ? ZmqReply::shm_channel_version : ZmqReply::compact_results_version;
+        proxy = ZmqReplyProxy(new ZmqReply(this, p->endpoint(), p->identity(), reply_category, version));
     }
     catch (std::exception const& e)  // Can happen during shutdown
     {
@@ -677,7 +711,8 @@ MWReplyProxy ZmqMiddleware::add_reply_object(ReplyObjectBase::SPtr const& reply)
     return proxy;
 }
 
-MWScopeProxy ZmqMiddleware::add_scope_object(string const& identity, ScopeObjectBase::SPtr const& scope, int64_t idle_timeout)
+MWScopeProxy ZmqMiddleware::add_scope_object(string const& identity, ScopeObjectBase::SPtr const& scope,
+                                             int64_t idle_timeout, function<void()> const& idle_callback)
 {
     assert(!identity.empty());
     assert(scope);
@@ -686,7 +721,9 @@ MWScopeProxy ZmqMiddleware::add_scope_object(string const& identity, ScopeObject
     try
     {
         shared_ptr<ScopeI> si(make_shared<ScopeI>(scope));
-        auto adapter = find_adapter(server_name_, private_endpoint_dir_, scope_category, idle_timeout);
+        // Each scope gets its own adapter, so several scopes can share a middleware.
+        // For a process with a single scope, the identity is the same as the server name.
+        auto adapter = find_adapter(identity, private_endpoint_dir_, scope_category, idle_timeout, idle_callback);
         function<void()> df;
         auto p = safe_add(df, adapter, identity, si);
         scope->set_disconnect_function(df);
@@ -792,7 +829,7 @@ ThreadPool* ZmqMiddleware::oneway_pool()
     return oneway_invoker_.get();
 }
 
-ThreadPool* ZmqMiddleware::twoway_pool()
+TwowayInvoker* ZmqMiddleware::twoway_invoker()
 {
     lock(state_mutex_, data_mutex_);
     lock_guard<mutex> state_lock(state_mutex_, std::adopt_lock);
@@ -801,7 +838,12 @@ ThreadPool* ZmqMiddleware::twoway_pool()
     {
         throw MiddlewareException("Cannot invoke operations while middleware is stopped");
     }
-    return twoway_invokers_.get();
+    return twoway_invoker_.get();
+}
+
+ShmSender* ZmqMiddleware::shm_sender() const noexcept
+{
+    return shm_sender_.get();
 }
 
 int64_t ZmqMiddleware::locate_timeout() const noexcept
@@ -848,7 +890,8 @@ ObjectProxy ZmqMiddleware::make_typed_proxy(string const& endpoint,
 }
 
 shared_ptr<ObjectAdapter> ZmqMiddleware::find_adapter(string const& name, string const& endpoint_dir,
-                                                      string const& category, int64_t idle_timeout)
+                                                      string const& category, int64_t idle_timeout,
+                                                      function<void()> const& idle_callback)
 {
     lock(state_mutex_, data_mutex_);
     lock_guard<mutex> state_lock(state_mutex_, std::adopt_lock);
@@ -930,7 +973,7 @@ shared_ptr<ObjectAdapter> ZmqMiddleware::find_adapter(string const& name, string
         endpoint = "ipc://" + endpoint_dir + "/" + name;
     }
 
-    auto a = make_shared<ObjectAdapter>(*this, name, endpoint, mode, pool_size, idle_timeout);
+    auto a = make_shared<ObjectAdapter>(*this, name, endpoint, mode, pool_size, idle_timeout, idle_callback);
     am_[name] = a;
     return a;
 }
@@ -977,6 +1020,41 @@ function<void()> ZmqMiddleware::safe_dflt_add(shared_ptr<ObjectAdapter> const& a
     return disconnect_func;
 }
 
+// Starts the listener for replies via shared memory, unless that is disabled or has failed
+// before. Returns true if the listener is running.
+
+bool ZmqMiddleware::start_shm_listener(shared_ptr<ObjectAdapter> const& reply_adapter)
+{
+    if (shm_ring_size_ == 0)
+    {
+        return false;
+    }
+
+    lock_guard<mutex> lock(data_mutex_);
+    if (!shm_listener_ && !shm_listener_failed_)
+    {
+        weak_ptr<ObjectAdapter> weak_adapter(reply_adapter);
+        auto dispatch = [weak_adapter](capnp::MessageReader& message)
+        {
+            auto adapter = weak_adapter.lock();
+            if (adapter)
+            {
+                adapter->dispatch_oneway(message);
+            }
+        };
+        try
+        {
+            shm_listener_.reset(new ShmListener(shm_channel_path(reply_adapter->endpoint()), shm_ring_size_, dispatch));
+        }
+        catch (std::exception const& e)
+        {
+            shm_listener_failed_ = true;
+            logger_() << "cannot receive replies via shared memory: " << e.what();
+        }
+    }
+    return shm_listener_ != nullptr;
+}
+
 } // namespace zmq_middleware
 
 } // namespace internal
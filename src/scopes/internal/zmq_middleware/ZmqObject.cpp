@@ -27,7 +27,6 @@
 #include <unity/scopes/ScopeExceptions.h>
 
 #include <capnp/serialize.h>
-#include <zmqpp/poller.hpp>
 #include <zmqpp/socket.hpp>
 
 using namespace std;
@@ -138,9 +137,7 @@ void ZmqObjectProxy::ping()
     capnp::MallocMessageBuilder request_builder;
     make_request_(request_builder, "ping");
 
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_twoway_(request_builder); });
-
-    auto out_params = future.get();
+    auto out_params = invoke_twoway_(request_builder);
     auto response = out_params.reader->getRoot<capnproto::Response>();
     throw_if_runtime_exception(response);
 }
@@ -186,6 +183,24 @@ void ZmqObjectProxy::invoke_oneway_(capnp::MessageBuilder& request)
     }
 }
 
+void ZmqObjectProxy::invoke_oneway_direct_(capnp::MessageBuilder& request)
+{
+    assert(mode_ == RequestMode::Oneway);
+
+    // The context outlives the middleware's thread pools and adapters, so we can still
+    // use it once the middleware is stopped. The socket is closed again straight away;
+    // the linger time gives the message a chance to get to the peer.
+    zmqpp::socket s(*mw_base()->context(), zmqpp::socket_type::push);
+    s.set(zmqpp::socket_option::linger, 50);
+    s.connect(endpoint_);
+
+    lock_guard<mutex> lock(shared_mutex);
+    ZmqSender sender(s);
+    auto segments = request.getSegmentsForOutput();
+    trace_request_(request);
+    sender.send(segments, ZmqSender::DontWait);  // If there is nothing at the other end, the message is discarded.
+}
+
 ZmqObjectProxy::TwowayOutParams ZmqObjectProxy::invoke_twoway_(capnp::MessageBuilder& request)
 {
     return invoke_twoway_(request, timeout_, mw_base()->locate_timeout());
@@ -242,8 +257,7 @@ ZmqObjectProxy::TwowayOutParams ZmqObjectProxy::invoke_twoway_(capnp::MessageBui
     return invoke_twoway__(request, twoway_timeout);
 }
 
-// Get a socket to the endpoint for this proxy and write the request on the wire.
-// Poll for the reply with the given timeout.
+// Hand the request to the middleware's twoway invoker and wait for the reply.
 // Return a reader for the response or throw if the timeout expires.
 
 ZmqObjectProxy::TwowayOutParams ZmqObjectProxy::invoke_twoway__(capnp::MessageBuilder& request, int64_t timeout)
@@ -255,51 +269,111 @@ ZmqObjectProxy::TwowayOutParams ZmqObjectProxy::invoke_twoway__(capnp::MessageBu
         assert(mode_ == RequestMode::Twoway);
     }
 
-    zmqpp::socket s(*mw_base()->context(), zmqpp::socket_type::request);
-    // Allow some linger time so we don't hang indefinitely if the other end disappears.
-    s.set(zmqpp::socket_option::linger, 100);
-    // We set a reconnect interval of 20 ms, so we get to the peer quickly, in case
-    // the peer hasn't finished binding to its endpoint yet after being exec'd.
-    // We back off exponentially to half the call timeout. If we haven't connected
-    // by then, the poll below will time out anyway. For infinite timeout, we try
-    // once a second.
-    int reconnect_max = timeout == -1 ? 1000 : timeout / 2;
-    s.set(zmqpp::socket_option::reconnect_interval, 20);
-    s.set(zmqpp::socket_option::reconnect_interval_max, reconnect_max);
-    s.connect(endpoint);
-    ZmqSender sender(s);
-    auto segments = request.getSegmentsForOutput();
+    // The invoker's thread sends the request and collects the reply; we only wait for the result.
     trace_request_(request);
-    sender.send(segments);
+    auto out_params = mw_base()->twoway_invoker()->invoke(endpoint, request, timeout).get();
+    trace_reply_(request, *out_params.reader);
+    return out_params;
+}
+
+void ZmqObjectProxy::invoke_twoway_async_(shared_ptr<capnp::MessageBuilder> const& request,
+                                          int64_t twoway_timeout,
+                                          int64_t locate_timeout,
+                                          TwowayCallback on_reply)
+{
+    auto registry_proxy = dynamic_pointer_cast<ZmqRegistry>(mw_base()->registry_proxy());
+    auto ss_registry_proxy = mw_base()->ss_registry_proxy();
 
-    zmqpp::poller p;
-    p.add(s);
+    // TODO: HACK: this builds knowledge about the smartscopes proxy running permanently into the run time.
+    bool this_is_registry = registry_proxy && identity() == registry_proxy->identity();
+    bool this_is_ss_registry = ss_registry_proxy && identity() == ss_registry_proxy->identity();
 
-    if (timeout == -1)
+    if (!registry_proxy || this_is_registry || this_is_ss_registry)
     {
-        p.poll();
+        invoke_twoway_async__(request, twoway_timeout, move(on_reply));
+        return;
     }
-    else
+
+    // Send the request once the registry has told us where the scope is. As for
+    // invoke_twoway_(), we go ahead anyway if the registry doesn't know the scope.
+    registry_proxy->locate_async(identity(), locate_timeout,
+                                 [this, registry_proxy, request, twoway_timeout, on_reply]
+                                 (ObjectProxy const& new_proxy, exception_ptr const& error)
     {
-        p.poll(timeout);
-    }
+        try
+        {
+            if (error)
+            {
+                rethrow_exception(error);
+            }
+            std::string endpoint = new_proxy->endpoint();
+            std::string identity = new_proxy->identity();
+            std::string category = new_proxy->target_category();
+            int64_t timeout = new_proxy->timeout();
+            {
+                lock_guard<mutex> lock(shared_mutex);
+                endpoint_ = endpoint;
+                identity_ = identity;
+                category_ = category;
+                timeout_ = timeout;
+            }
+        }
+        catch (NotFoundException const&)
+        {
+            // Ignore a failed locate() for scopes unknown to the registry
+        }
+        catch (...)
+        {
+            fail_async_(on_reply, current_exception());
+            return;
+        }
 
-    if (!p.has_input(s))
+        try
+        {
+            invoke_twoway_async__(request, twoway_timeout, on_reply);
+        }
+        catch (...)
+        {
+            fail_async_(on_reply, current_exception());
+        }
+    });
+}
+
+void ZmqObjectProxy::invoke_twoway_async__(shared_ptr<capnp::MessageBuilder> const& request,
+                                           int64_t timeout,
+                                           TwowayCallback on_reply)
+{
+    std::string endpoint;
     {
-        string op_name = request.getRoot<capnproto::Request>().getOpName().cStr();
-        throw TimeoutException("Request timed out after " + std::to_string(timeout) + " milliseconds (endpoint = " +
-                               endpoint + ", op = " + op_name + ")");
+        lock_guard<mutex> lock(shared_mutex);
+        endpoint = endpoint_;
+        assert(mode_ == RequestMode::Twoway);
     }
 
-    // Because the ZmqReceiver holds the memory for the unmarshaling buffer, we pass both the receiver
-    // and the capnp reader in a struct.
-    ZmqObjectProxy::TwowayOutParams out_params;
-    out_params.receiver.reset(new ZmqReceiver(s));
-    auto params = out_params.receiver->receive();
-    out_params.reader.reset(new capnp::SegmentArrayMessageReader(params));
-    trace_reply_(request, *out_params.reader);
-    return out_params;
-    // Outgoing twoway socket closed here.
+    trace_request_(*request);
+    mw_base()->twoway_invoker()->invoke_async(endpoint, request, timeout,
+                                              [this, request, on_reply](future<TwowayOutParams> f)
+    {
+        promise<TwowayOutParams> p;
+        try
+        {
+            auto out_params = f.get();
+            trace_reply_(*request, *out_params.reader);
+            p.set_value(move(out_params));
+        }
+        catch (...)
+        {
+            p.set_exception(current_exception());
+        }
+        on_reply(p.get_future());
+    });
+}
+
+void ZmqObjectProxy::fail_async_(TwowayCallback const& on_reply, exception_ptr const& e)
+{
+    promise<TwowayOutParams> p;
+    p.set_exception(e);
+    on_reply(p.get_future());
 }
 
 string ZmqObjectProxy::decode_request_(capnp::MessageBuilder& request)
@@ -65,6 +65,7 @@ void ZmqQuery::run(MWReplyProxy const& reply)
     proxy.setEndpoint(rp->endpoint().c_str());
     proxy.setIdentity(rp->identity().c_str());
     proxy.setCategory(rp->target_category().c_str());
+    proxy.setVersion(rp->version());
 
     auto future = mw_base()->oneway_pool()->submit([&] { return this->invoke_oneway_(request_builder); });
     future.get();
@@ -88,8 +88,7 @@ ScopeMetadata ZmqRegistry::get_metadata(std::string const& scope_id)
 
     // Registry operations can be slow during start-up of the phone
     int64_t timeout = mw_base()->registry_timeout();
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_twoway_(request_builder, timeout); });
-    auto out_params = future.get();
+    auto out_params = invoke_twoway_(request_builder, timeout);
     auto response = out_params.reader->getRoot<capnproto::Response>();
     throw_if_runtime_exception(response);
 
@@ -122,8 +121,7 @@ MetadataMap ZmqRegistry::list()
 
     // Registry operations can be slow during start-up of the phone
     int64_t timeout = mw_base()->registry_timeout();
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_twoway_(request_builder, timeout); });
-    auto out_params = future.get();
+    auto out_params = invoke_twoway_(request_builder, timeout);
     auto response = out_params.reader->getRoot<capnproto::Response>();
     throw_if_runtime_exception(response);
 
@@ -144,14 +142,50 @@ MetadataMap ZmqRegistry::list()
 ObjectProxy ZmqRegistry::locate(std::string const& identity, int64_t timeout)
 {
     capnp::MallocMessageBuilder request_builder;
-    auto request = make_request_(request_builder, "locate");
+    make_locate_request_(request_builder, identity);
+
+    // locate uses a custom timeout because it needs to potentially fork/exec a scope.
+    auto out_params = invoke_twoway_(request_builder, timeout);
+    return locate_result_(*out_params.reader, identity);
+}
+
+ObjectProxy ZmqRegistry::locate(std::string const& identity)
+{
+    return locate(identity, mw_base()->locate_timeout());
+}
+
+void ZmqRegistry::locate_async(std::string const& identity, int64_t timeout, LocateCallback on_located)
+{
+    auto request_builder = make_shared<capnp::MallocMessageBuilder>();
+    make_locate_request_(*request_builder, identity);
+
+    invoke_twoway_async_(request_builder, timeout, -1, [this, identity, on_located](future<TwowayOutParams> f)
+    {
+        ObjectProxy proxy;
+        try
+        {
+            auto out_params = f.get();
+            proxy = locate_result_(*out_params.reader, identity);
+        }
+        catch (...)
+        {
+            on_located(nullptr, current_exception());
+            return;
+        }
+        on_located(proxy, nullptr);
+    });
+}
+
+void ZmqRegistry::make_locate_request_(capnp::MessageBuilder& b, std::string const& identity) const
+{
+    auto request = make_request_(b, "locate");
     auto in_params = request.initInParams().getAs<capnproto::Registry::LocateRequest>();
     in_params.setIdentity(identity.c_str());
+}
 
-    // locate uses a custom timeout because it needs to potentially fork/exec a scope.
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_twoway_(request_builder, timeout); });
-    auto out_params = future.get();
-    auto response = out_params.reader->getRoot<capnproto::Response>();
+ObjectProxy ZmqRegistry::locate_result_(capnp::MessageReader& reply, std::string const& identity)
+{
+    auto response = reply.getRoot<capnproto::Response>();
     throw_if_runtime_exception(response);
 
     auto locate_response = response.getPayload().getAs<capnproto::Registry::LocateResponse>().getResponse();
@@ -186,11 +220,6 @@ ObjectProxy ZmqRegistry::locate(std::string const& identity, int64_t timeout)
     }
 }
 
-ObjectProxy ZmqRegistry::locate(std::string const& identity)
-{
-    return locate(identity, mw_base()->locate_timeout());
-}
-
 bool ZmqRegistry::is_scope_running(std::string const& scope_id)
 {
     string op_name = "is_scope_running";
@@ -201,8 +230,7 @@ bool ZmqRegistry::is_scope_running(std::string const& scope_id)
 
     // Registry operations can be slow during start-up of the phone
     int64_t timeout = mw_base()->registry_timeout();
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_twoway_(request_builder, timeout); });
-    auto out_params = future.get();
+    auto out_params = invoke_twoway_(request_builder, timeout);
     auto response = out_params.reader->getRoot<capnproto::Response>();
     throw_if_runtime_exception(response);
 
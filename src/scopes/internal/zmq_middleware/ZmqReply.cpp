@@ -17,6 +17,7 @@
  */
 
 #include <unity/scopes/internal/zmq_middleware/ZmqReply.h>
+#include <unity/scopes/internal/zmq_middleware/ShmChannel.h>
 #include <unity/scopes/internal/zmq_middleware/VariantConverter.h>
 #include <scopes/internal/zmq_middleware/capnproto/Reply.capnp.h>
 
@@ -44,10 +45,19 @@ interface Reply
 
 */
 
-ZmqReply::ZmqReply(ZmqMiddleware* mw_base, string const& endpoint, string const& identity, string const& category) :
+int32_t const ZmqReply::compact_results_version;
+int32_t const ZmqReply::shm_channel_version;
+
+ZmqReply::ZmqReply(ZmqMiddleware* mw_base,
+                   string const& endpoint,
+                   string const& identity,
+                   string const& category,
+                   int32_t version) :
     MWObjectProxy(mw_base),
     ZmqObjectProxy(mw_base, endpoint, identity, category, RequestMode::Oneway),
-    MWReply(mw_base)
+    MWReply(mw_base),
+    version_(version),
+    shm_path_(version >= shm_channel_version ? shm_channel_path(endpoint) : "")
 {
 }
 
@@ -57,15 +67,100 @@ ZmqReply::~ZmqReply()
 
 void ZmqReply::push(VariantMap const& result)
 {
+    bool const compact = version_ >= compact_results_version && ResultEncoder::encodable(result);
+    push_(compact, [&](capnproto::Reply::PushRequest::Builder& in_params)
+    {
+        if (compact)
+        {
+            auto resultBuilder = in_params.initCompactResult();
+            encoder_.encode(result, resultBuilder);
+        }
+        else
+        {
+            auto resultBuilder = in_params.getResult();
+            to_value_dict(result, resultBuilder);
+        }
+    });
+}
+
+// Encodes the result straight from its attributes, without building a VariantMap first.
+
+void ZmqReply::push_result(ResultImpl const& result)
+{
+    if (version_ < compact_results_version)
+    {
+        MWReply::push_result(result);
+        return;
+    }
+    push_(true, [&](capnproto::Reply::PushRequest::Builder& in_params)
+    {
+        auto resultBuilder = in_params.initCompactResult();
+        encoder_.encode(result, resultBuilder);
+    });
+}
+
+void ZmqReply::push_(bool compact, function<void(capnproto::Reply::PushRequest::Builder&)> const& set_result)
+{
+    auto token = cancellation_token();
+    if (token && token->cancelled())
+    {
+        token->dropped_result(false);
+        return;
+    }
+
     capnp::MallocMessageBuilder request_builder;
     auto request = make_request_(request_builder, "push");
     auto in_params = request.initInParams().getAs<capnproto::Reply::PushRequest>();
 
-    auto resultBuilder = in_params.getResult();
-    to_value_dict(result, resultBuilder);
+    std::future<void> future;
+    {
+        // Compact results refer to key dictionary entries that were sent with earlier results,
+        // so they must go out in the order in which they were encoded. The oneway pool has
+        // a single thread, so it is sufficient to hold the lock until the request is queued.
+        unique_lock<mutex> lock(encoder_mutex_, defer_lock);
+        if (compact)
+        {
+            lock.lock();
+        }
+        set_result(in_params);
+
+        try
+        {
+            future = mw_base()->oneway_pool()->submit([&]
+            {
+                // The query may have been cancelled while we were waiting behind other oneway requests.
+                if (token && token->cancelled())
+                {
+                    token->dropped_result(true);
+                    return;
+                }
+                this->send_(request_builder);
+            });
+        }
+        catch (...)
+        {
+            if (compact)
+            {
+                encoder_.reset();
+            }
+            throw;
+        }
+    }
 
-    auto future = mw_base()->oneway_pool()->submit([&] { return this->invoke_oneway_(request_builder); });
-    future.get();
+    try
+    {
+        future.get();
+    }
+    catch (...)
+    {
+        if (compact)
+        {
+            // The receiver may not have seen the new dictionary entries, so we start over.
+            lock_guard<mutex> lock(encoder_mutex_);
+            encoder_.reset();
+        }
+        throw;
+    }
 }
 
 void ZmqReply::finished(CompletionDetails const& details)
@@ -100,7 +195,7 @@ void ZmqReply::finished(CompletionDetails const& details)
     in_params.setStatus(s);
     in_params.setMessage(details.message());
 
-    auto future = mw_base()->oneway_pool()->submit([&] { return this->invoke_oneway_(request_builder); });
+    auto future = mw_base()->oneway_pool()->submit([&] { return this->send_(request_builder); });
     future.get();
 }
 
@@ -113,10 +208,29 @@ void ZmqReply::info(OperationInfo const& op_info)
     in_params.setCode(static_cast<int16_t>(op_info.code()));
     in_params.setMessage(op_info.message());
 
-    auto future = mw_base()->oneway_pool()->submit([&] { return this->invoke_oneway_(request_builder); });
+    auto future = mw_base()->oneway_pool()->submit([&] { return this->send_(request_builder); });
     future.get();
 }
 
+int32_t ZmqReply::version() const noexcept
+{
+    return version_;
+}
+
+// Called by the oneway pool thread, so the requests for a receiver go out in order.
+// ShmSender refuses a request only once the receiver has dispatched everything it
+// sent earlier (and throws if that does not happen), so switching to zmq keeps the order.
+
+void ZmqReply::send_(capnp::MessageBuilder& request)
+{
+    if (!shm_path_.empty() && mw_base()->shm_sender()->send(shm_path_, request.getSegmentsForOutput()))
+    {
+        trace_request_(request);
+        return;
+    }
+    invoke_oneway_(request);
+}
+
 } // namespace zmq_middleware
 
 } // namespace internal
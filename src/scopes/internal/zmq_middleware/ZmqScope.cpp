@@ -86,63 +86,20 @@ QueryCtrlProxy ZmqScope::search(CannedQuery const& query,
 {
     capnp::MallocMessageBuilder request_builder;
     auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
-    {
-        auto request = make_request_(request_builder, "search");
-        auto in_params = request.initInParams().getAs<capnproto::Scope::CreateQueryRequest>();
-        auto q = in_params.initQuery();
-        to_value_dict(query.serialize(), q);
-        auto h = in_params.initHints();
-        to_value_dict(hints, h);
-        auto p = in_params.initReplyProxy();
-        p.setEndpoint(reply_proxy->endpoint().c_str());
-        p.setIdentity(reply_proxy->identity().c_str());
-        p.setCategory(reply_proxy->target_category().c_str());
-        auto d = in_params.initContext();
-        to_value_dict(context, d);
-    }
-
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_scope_(request_builder); });
+    make_search_request_(request_builder, query, hints, context, *reply_proxy);
 
-    auto out_params = future.get();
-    auto response = out_params.reader->getRoot<capnproto::Response>();
-    throw_if_runtime_exception(response);
-
-    auto proxy = response.getPayload().getAs<capnproto::Scope::CreateQueryResponse>().getReturnValue();
-    ZmqQueryCtrlProxy p(new ZmqQueryCtrl(mw_base(),
-                                         proxy.getEndpoint().cStr(),
-                                         proxy.getIdentity().cStr(),
-                                         proxy.getCategory().cStr()));
-    return make_shared<QueryCtrlImpl>(p, reply_proxy);
+    auto out_params = invoke_scope_(request_builder);
+    return query_ctrl_(*out_params.reader, reply_proxy);
 }
 
 QueryCtrlProxy ZmqScope::activate(VariantMap const& result, VariantMap const& hints, MWReplyProxy const& reply)
 {
     capnp::MallocMessageBuilder request_builder;
     auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
-    {
-        auto request = make_request_(request_builder, "activate");
-        auto in_params = request.initInParams().getAs<capnproto::Scope::ActivationRequest>();
-        auto res = in_params.initResult();
-        to_value_dict(result, res);
-        auto h = in_params.initHints();
-        to_value_dict(hints, h);
-        auto p = in_params.initReplyProxy();
-        p.setEndpoint(reply_proxy->endpoint().c_str());
-        p.setIdentity(reply_proxy->identity().c_str());
-    }
-
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_scope_(request_builder); });
-
-    auto out_params = future.get();
-    auto response = out_params.reader->getRoot<capnproto::Response>();
-    throw_if_runtime_exception(response);
+    make_activate_request_(request_builder, result, hints, *reply_proxy);
 
-    auto proxy = response.getPayload().getAs<capnproto::Scope::CreateQueryResponse>().getReturnValue();
-    ZmqQueryCtrlProxy p(new ZmqQueryCtrl(mw_base(),
-                                         proxy.getEndpoint().cStr(),
-                                         proxy.getIdentity().cStr(),
-                                         proxy.getCategory().cStr()));
-    return make_shared<QueryCtrlImpl>(p, reply_proxy);
+    auto out_params = invoke_scope_(request_builder);
+    return query_ctrl_(*out_params.reader, reply_proxy);
 }
 
 QueryCtrlProxy ZmqScope::perform_action(VariantMap const& result,
@@ -150,32 +107,10 @@ QueryCtrlProxy ZmqScope::perform_action(VariantMap const& result,
 {
     capnp::MallocMessageBuilder request_builder;
     auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
-    {
-        auto request = make_request_(request_builder, "perform_action");
-        auto in_params = request.initInParams().getAs<capnproto::Scope::ActionActivationRequest>();
-        auto res = in_params.initResult();
-        to_value_dict(result, res);
-        auto h = in_params.initHints();
-        to_value_dict(hints, h);
-        in_params.setWidgetId(widget_id);
-        in_params.setActionId(action_id);
-        auto p = in_params.initReplyProxy();
-        p.setEndpoint(reply_proxy->endpoint().c_str());
-        p.setIdentity(reply_proxy->identity().c_str());
-    }
+    make_perform_action_request_(request_builder, result, hints, widget_id, action_id, *reply_proxy);
 
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_scope_(request_builder); });
-
-    auto out_params = future.get();
-    auto response = out_params.reader->getRoot<capnproto::Response>();
-    throw_if_runtime_exception(response);
-
-    auto proxy = response.getPayload().getAs<capnproto::Scope::CreateQueryResponse>().getReturnValue();
-    ZmqQueryCtrlProxy p(new ZmqQueryCtrl(mw_base(),
-                                         proxy.getEndpoint().cStr(),
-                                         proxy.getIdentity().cStr(),
-                                         proxy.getCategory().cStr()));
-    return make_shared<QueryCtrlImpl>(p, reply_proxy);
+    auto out_params = invoke_scope_(request_builder);
+    return query_ctrl_(*out_params.reader, reply_proxy);
 }
 
 QueryCtrlProxy ZmqScope::activate_result_action(VariantMap const& result,
@@ -185,61 +120,79 @@ QueryCtrlProxy ZmqScope::activate_result_action(VariantMap const& result,
 {
     capnp::MallocMessageBuilder request_builder;
     auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
-    {
-        auto request = make_request_(request_builder, "activate_result_action");
-        auto in_params = request.initInParams().getAs<capnproto::Scope::ResultActionActivationRequest>();
-        auto res = in_params.initResult();
-        to_value_dict(result, res);
-        auto h = in_params.initHints();
-        to_value_dict(hints, h);
-        in_params.setActionId(action_id);
-        auto p = in_params.initReplyProxy();
-        p.setEndpoint(reply_proxy->endpoint().c_str());
-        p.setIdentity(reply_proxy->identity().c_str());
-    }
-
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_scope_(request_builder); });
+    make_activate_result_action_request_(request_builder, result, hints, action_id, *reply_proxy);
 
-    auto out_params = future.get();
-    auto response = out_params.reader->getRoot<capnproto::Response>();
-    throw_if_runtime_exception(response);
-
-    auto proxy = response.getPayload().getAs<capnproto::Scope::CreateQueryResponse>().getReturnValue();
-    ZmqQueryCtrlProxy p(new ZmqQueryCtrl(mw_base(),
-                                         proxy.getEndpoint().cStr(),
-                                         proxy.getIdentity().cStr(),
-                                         proxy.getCategory().cStr()));
-    return make_shared<QueryCtrlImpl>(p, reply_proxy);
+    auto out_params = invoke_scope_(request_builder);
+    return query_ctrl_(*out_params.reader, reply_proxy);
 }
 
 QueryCtrlProxy ZmqScope::preview(VariantMap const& result, VariantMap const& hints, MWReplyProxy const& reply)
 {
     capnp::MallocMessageBuilder request_builder;
     auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
-    {
-        auto request = make_request_(request_builder, "preview");
-        auto in_params = request.initInParams().getAs<capnproto::Scope::PreviewRequest>();
-        auto res = in_params.initResult();
-        to_value_dict(result, res);
-        auto h = in_params.initHints();
-        to_value_dict(hints, h);
-        auto p = in_params.initReplyProxy();
-        p.setEndpoint(reply_proxy->endpoint().c_str());
-        p.setIdentity(reply_proxy->identity().c_str());
-    }
+    make_preview_request_(request_builder, result, hints, *reply_proxy);
+
+    auto out_params = invoke_scope_(request_builder);
+    return query_ctrl_(*out_params.reader, reply_proxy);
+}
 
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_scope_(request_builder); });
+void ZmqScope::search_async(CannedQuery const& query,
+                            VariantMap const& hints,
+                            VariantMap const& context,
+                            MWReplyProxy const& reply,
+                            QueryCtrlCallback on_done)
+{
+    auto request_builder = make_shared<capnp::MallocMessageBuilder>();
+    auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
+    make_search_request_(*request_builder, query, hints, context, *reply_proxy);
+    invoke_query_async_(request_builder, reply_proxy, move(on_done));
+}
 
-    auto out_params = future.get();
-    auto response = out_params.reader->getRoot<capnproto::Response>();
-    throw_if_runtime_exception(response);
+void ZmqScope::activate_async(VariantMap const& result,
+                              VariantMap const& hints,
+                              MWReplyProxy const& reply,
+                              QueryCtrlCallback on_done)
+{
+    auto request_builder = make_shared<capnp::MallocMessageBuilder>();
+    auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
+    make_activate_request_(*request_builder, result, hints, *reply_proxy);
+    invoke_query_async_(request_builder, reply_proxy, move(on_done));
+}
 
-    auto proxy = response.getPayload().getAs<capnproto::Scope::CreateQueryResponse>().getReturnValue();
-    ZmqQueryCtrlProxy p(new ZmqQueryCtrl(mw_base(),
-                                         proxy.getEndpoint().cStr(),
-                                         proxy.getIdentity().cStr(),
-                                         proxy.getCategory().cStr()));
-    return make_shared<QueryCtrlImpl>(p, reply_proxy);
+void ZmqScope::perform_action_async(VariantMap const& result,
+                                    VariantMap const& hints,
+                                    std::string const& widget_id,
+                                    std::string const& action_id,
+                                    MWReplyProxy const& reply,
+                                    QueryCtrlCallback on_done)
+{
+    auto request_builder = make_shared<capnp::MallocMessageBuilder>();
+    auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
+    make_perform_action_request_(*request_builder, result, hints, widget_id, action_id, *reply_proxy);
+    invoke_query_async_(request_builder, reply_proxy, move(on_done));
+}
+
+void ZmqScope::preview_async(VariantMap const& result,
+                             VariantMap const& hints,
+                             MWReplyProxy const& reply,
+                             QueryCtrlCallback on_done)
+{
+    auto request_builder = make_shared<capnp::MallocMessageBuilder>();
+    auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
+    make_preview_request_(*request_builder, result, hints, *reply_proxy);
+    invoke_query_async_(request_builder, reply_proxy, move(on_done));
+}
+
+void ZmqScope::activate_result_action_async(VariantMap const& result,
+                                            VariantMap const& hints,
+                                            std::string const& action_id,
+                                            MWReplyProxy const& reply,
+                                            QueryCtrlCallback on_done)
+{
+    auto request_builder = make_shared<capnp::MallocMessageBuilder>();
+    auto reply_proxy = dynamic_pointer_cast<ZmqReply>(reply);
+    make_activate_result_action_request_(*request_builder, result, hints, action_id, *reply_proxy);
+    invoke_query_async_(request_builder, reply_proxy, move(on_done));
 }
 
 ChildScopeList ZmqScope::child_scopes()
@@ -248,9 +201,7 @@ ChildScopeList ZmqScope::child_scopes()
     make_request_(request_builder, "child_scopes");
 
     int64_t timeout = mw_base()->child_scopes_timeout();
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_scope_(request_builder, timeout); });
-
-    auto out_params = future.get();
+    auto out_params = invoke_scope_(request_builder, timeout);
     auto response = out_params.reader->getRoot<capnproto::Response>();
     throw_if_runtime_exception(response);
 
@@ -306,8 +257,7 @@ bool ZmqScope::set_child_scopes(ChildScopeList const& child_scopes)
     }
 
     int64_t timeout = mw_base()->child_scopes_timeout();
-    auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_scope_(request_builder, timeout); });
-    auto out_params = future.get();
+    auto out_params = invoke_scope_(request_builder, timeout);
     auto r = out_params.reader->getRoot<capnproto::Response>();
     throw_if_runtime_exception(r);
 
@@ -336,8 +286,7 @@ bool ZmqScope::debug_mode()
         // "Process.Timeout" will kick in, meaning that the implicit locate() call will return at a regular timeout for
         // regular scopes, and will not timeout for debugged scopes.
 
-        auto future = mw_base()->twoway_pool()->submit([&] { return this->invoke_twoway_(request_builder, timeout(), -1); });
-        auto out_params = future.get();
+        auto out_params = invoke_twoway_(request_builder, timeout(), -1);
         auto response = out_params.reader->getRoot<capnproto::Response>();
         throw_if_runtime_exception(response);
 
@@ -363,6 +312,208 @@ ZmqObjectProxy::TwowayOutParams ZmqScope::invoke_scope_(capnp::MessageBuilder& i
     return this->invoke_twoway_(in_params, timeout);
 }
 
+void ZmqScope::make_search_request_(capnp::MessageBuilder& b,
+                                    CannedQuery const& query,
+                                    VariantMap const& hints,
+                                    VariantMap const& context,
+                                    ZmqReply& reply_proxy) const
+{
+    auto request = make_request_(b, "search");
+    auto in_params = request.initInParams().getAs<capnproto::Scope::CreateQueryRequest>();
+    auto q = in_params.initQuery();
+    to_value_dict(query.serialize(), q);
+    auto h = in_params.initHints();
+    to_value_dict(hints, h);
+    auto p = in_params.initReplyProxy();
+    p.setEndpoint(reply_proxy.endpoint().c_str());
+    p.setIdentity(reply_proxy.identity().c_str());
+    p.setCategory(reply_proxy.target_category().c_str());
+    p.setVersion(reply_proxy.version());
+    auto d = in_params.initContext();
+    to_value_dict(context, d);
+}
+
+void ZmqScope::make_activate_request_(capnp::MessageBuilder& b,
+                                      VariantMap const& result,
+                                      VariantMap const& hints,
+                                      ZmqReply& reply_proxy) const
+{
+    auto request = make_request_(b, "activate");
+    auto in_params = request.initInParams().getAs<capnproto::Scope::ActivationRequest>();
+    auto res = in_params.initResult();
+    to_value_dict(result, res);
+    auto h = in_params.initHints();
+    to_value_dict(hints, h);
+    auto p = in_params.initReplyProxy();
+    p.setEndpoint(reply_proxy.endpoint().c_str());
+    p.setIdentity(reply_proxy.identity().c_str());
+    p.setVersion(reply_proxy.version());
+}
+
+void ZmqScope::make_perform_action_request_(capnp::MessageBuilder& b,
+                                            VariantMap const& result,
+                                            VariantMap const& hints,
+                                            std::string const& widget_id,
+                                            std::string const& action_id,
+                                            ZmqReply& reply_proxy) const
+{
+    auto request = make_request_(b, "perform_action");
+    auto in_params = request.initInParams().getAs<capnproto::Scope::ActionActivationRequest>();
+    auto res = in_params.initResult();
+    to_value_dict(result, res);
+    auto h = in_params.initHints();
+    to_value_dict(hints, h);
+    in_params.setWidgetId(widget_id);
+    in_params.setActionId(action_id);
+    auto p = in_params.initReplyProxy();
+    p.setEndpoint(reply_proxy.endpoint().c_str());
+    p.setIdentity(reply_proxy.identity().c_str());
+    p.setVersion(reply_proxy.version());
+}
+
+void ZmqScope::make_activate_result_action_request_(capnp::MessageBuilder& b,
+                                                    VariantMap const& result,
+                                                    VariantMap const& hints,
+                                                    std::string const& action_id,
+                                                    ZmqReply& reply_proxy) const
+{
+    auto request = make_request_(b, "activate_result_action");
+    auto in_params = request.initInParams().getAs<capnproto::Scope::ResultActionActivationRequest>();
+    auto res = in_params.initResult();
+    to_value_dict(result, res);
+    auto h = in_params.initHints();
+    to_value_dict(hints, h);
+    in_params.setActionId(action_id);
+    auto p = in_params.initReplyProxy();
+    p.setEndpoint(reply_proxy.endpoint().c_str());
+    p.setIdentity(reply_proxy.identity().c_str());
+    p.setVersion(reply_proxy.version());
+}
+
+void ZmqScope::make_preview_request_(capnp::MessageBuilder& b,
+                                     VariantMap const& result,
+                                     VariantMap const& hints,
+                                     ZmqReply& reply_proxy) const
+{
+    auto request = make_request_(b, "preview");
+    auto in_params = request.initInParams().getAs<capnproto::Scope::PreviewRequest>();
+    auto res = in_params.initResult();
+    to_value_dict(result, res);
+    auto h = in_params.initHints();
+    to_value_dict(hints, h);
+    auto p = in_params.initReplyProxy();
+    p.setEndpoint(reply_proxy.endpoint().c_str());
+    p.setIdentity(reply_proxy.identity().c_str());
+    p.setVersion(reply_proxy.version());
+}
+
+// Decodes the reply to any of the operations that create a query.
+
+QueryCtrlProxy ZmqScope::query_ctrl_(capnp::MessageReader& reply, ZmqReplyProxy const& reply_proxy)
+{
+    auto response = reply.getRoot<capnproto::Response>();
+    throw_if_runtime_exception(response);
+
+    auto proxy = response.getPayload().getAs<capnproto::Scope::CreateQueryResponse>().getReturnValue();
+    ZmqQueryCtrlProxy p(new ZmqQueryCtrl(mw_base(),
+                                         proxy.getEndpoint().cStr(),
+                                         proxy.getIdentity().cStr(),
+                                         proxy.getCategory().cStr()));
+    return make_shared<QueryCtrlImpl>(p, reply_proxy);
+}
+
+void ZmqScope::invoke_query_async_(shared_ptr<capnp::MessageBuilder> const& in_params,
+                                   ZmqReplyProxy const& reply_proxy,
+                                   QueryCtrlCallback on_done)
+{
+    invoke_scope_async_(in_params, [this, reply_proxy, on_done](future<TwowayOutParams> f)
+    {
+        QueryCtrlProxy ctrl;
+        try
+        {
+            auto out_params = f.get();
+            ctrl = query_ctrl_(*out_params.reader, reply_proxy);
+        }
+        catch (...)
+        {
+            on_done(nullptr, current_exception());
+            return;
+        }
+        on_done(ctrl, nullptr);
+    });
+}
+
+// Asynchronous version of invoke_scope_(). If we don't know yet whether the scope is in debug mode,
+// we ask it first (without blocking), and send the request once the answer is in.
+// We never wait for debug_mode_mutex_ here, because a synchronous debug_mode() call holds it
+// while it waits for the twoway invoker thread, on which our callback runs.
+
+void ZmqScope::invoke_scope_async_(shared_ptr<capnp::MessageBuilder> const& in_params, TwowayCallback on_reply)
+{
+    {
+        unique_lock<std::mutex> lock(debug_mode_mutex_, try_to_lock);
+        if (lock.owns_lock() && debug_mode_)
+        {
+            bool debug = *debug_mode_;
+            lock.unlock();
+            if (debug)
+            {
+                invoke_twoway_async_(in_params, -1, -1, move(on_reply));
+            }
+            else
+            {
+                invoke_twoway_async_(in_params, timeout(), mw_base()->locate_timeout(), move(on_reply));
+            }
+            return;
+        }
+    }
+
+    auto request_builder = make_shared<capnp::MallocMessageBuilder>();
+    make_request_(*request_builder, "debug_mode");
+
+    // See debug_mode() for why there is no locate() timeout.
+    invoke_twoway_async_(request_builder, timeout(), -1, [this, in_params, on_reply](future<TwowayOutParams> f)
+    {
+        bool debug;
+        try
+        {
+            auto out_params = f.get();
+            auto response = out_params.reader->getRoot<capnproto::Response>();
+            throw_if_runtime_exception(response);
+            debug = response.getPayload().getAs<capnproto::Scope::DebugModeResponse>().getReturnValue();
+        }
+        catch (...)
+        {
+            fail_async_(on_reply, current_exception());
+            return;
+        }
+
+        {
+            unique_lock<std::mutex> lock(debug_mode_mutex_, try_to_lock);
+            if (lock.owns_lock() && !debug_mode_)
+            {
+                debug_mode_.reset(new bool(debug));
+            }
+        }
+
+        try
+        {
+            if (debug)
+            {
+                invoke_twoway_async_(in_params, -1, -1, on_reply);
+            }
+            else
+            {
+                invoke_twoway_async_(in_params, timeout(), mw_base()->locate_timeout(), on_reply);
+            }
+        }
+        catch (...)
+        {
+            fail_async_(on_reply, current_exception());
+        }
+    });
+}
+
 } // namespace zmq_middleware
 
 } // namespace internal
@@ -18,6 +18,8 @@
 
 #include <unity/scopes/internal/zmq_middleware/ZmqStateReceiver.h>
 
+#include <unity/scopes/ScopeExceptions.h>
+
 #include <scopes/internal/zmq_middleware/capnproto/StateReceiver.capnp.h>
 
 #include <capnp/message.h>
@@ -83,7 +85,19 @@ void ZmqStateReceiver::push_state(std::string const& sender_id, StateReceiverObj
     in_params.setState(s);
     in_params.setSenderId(sender_id);
 
-    auto future = mw_base()->oneway_pool()->submit([&] { return this->invoke_oneway_(request_builder); });
+    ThreadPool* pool;
+    try
+    {
+        pool = mw_base()->oneway_pool();
+    }
+    catch (MiddlewareException const&)
+    {
+        // The middleware is stopped already. This is normal for a scope that
+        // tells the registry it is shutting down, so we send the state directly.
+        invoke_oneway_direct_(request_builder);
+        return;
+    }
+    auto future = pool->submit([&] { return this->invoke_oneway_(request_builder); });
     future.get();
 }
 
@@ -17,11 +17,21 @@
 */
 
 #include <unity/scopes/qt/HttpAsyncReader.h>
+#include <unity/scopes/qt/internal/HttpResponseCache.h>
+#include <core/net/http/streaming_client.h>
+#include <core/net/http/streaming_request.h>
+#include <core/net/http/status.h>
 #include <core/net/uri.h>
 
+#include <map>
+#include <mutex>
+#include <sstream>
+
 namespace http = core::net::http;
 using namespace unity::scopes::qt;
 
+using unity::scopes::qt::internal::HttpResponseCache;
+
 /// @cond
 // Private class that holds the httpclient and the worker thread
 class HttpAsyncReader::Priv
@@ -30,12 +40,14 @@ public:
     NONCOPYABLE(Priv);
     UNITY_DEFINES_PTRS(Priv);
     Priv()
-        : client_(http::make_client())
+        : client_(http::make_streaming_client())
         , worker_{[this]()
                   {
                       client_->run();
                   }}
         , cancelled_(false)
+        , generation_(std::make_shared<std::atomic<unsigned int>>(0))
+        , in_flight_(std::make_shared<InFlight>())
     {
     }
 
@@ -48,13 +60,125 @@ public:
         }
     }
 
-    std::shared_ptr<core::net::http::Client> client_;
+    std::shared_ptr<core::net::http::StreamingClient> client_;
 
     std::thread worker_;
 
     std::atomic<bool> cancelled_;
+
+    // Incremented by cancel(). A download is aborted if the generation changes while it is
+    // in progress. (Held by shared_ptr because the handlers of a download can outlive us.)
+    std::shared_ptr<std::atomic<unsigned int>> generation_;
+
+    HttpResponseCache::SPtr cache() const
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        return cache_;
+    }
+
+    mutable std::mutex cache_mutex_;
+    HttpResponseCache::SPtr cache_;
+
+    // The handlers of the requests that wait for a download in progress, indexed by URI.
+    // (Held by shared_ptr for the same reason as generation_.)
+    struct InFlight
+    {
+        std::mutex mutex;
+        std::map<std::string, std::vector<http::Request::Handler>> waiters;
+
+        std::vector<http::Request::Handler> take(std::string const& uri)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<http::Request::Handler> handlers;
+            auto it = waiters.find(uri);
+            if (it != waiters.end())
+            {
+                handlers.swap(it->second);
+                waiters.erase(it);
+            }
+            return handlers;
+        }
+    };
+    std::shared_ptr<InFlight> in_flight_;
 };
 
+namespace
+{
+
+// State of a streamed download. All callbacks for a download run on the client's worker thread.
+
+struct Stream
+{
+    std::string uri;
+    HttpAsyncReader::ChunkFunc on_chunk;
+    std::shared_ptr<std::atomic<unsigned int>> generation;
+    unsigned int start_generation;
+    std::promise<void> promise;
+    std::atomic<bool> stopped{false};  // on_chunk returned false
+    std::string error;                 // Set by on_chunk
+    bool done = false;
+
+    bool cancelled() const
+    {
+        return *generation != start_generation;
+    }
+
+    void feed(std::string const& chunk)
+    {
+        if (!stopped && !cancelled() && !on_chunk(chunk, error))
+        {
+            stopped = true;
+        }
+    }
+
+    // Completes the future. net-cpp reports an aborted download as an error, so we
+    // check whether we aborted it ourselves before reporting the download error.
+    void finish(std::string const& download_error)
+    {
+        if (done)
+        {
+            return;
+        }
+        done = true;
+        if (stopped)
+        {
+            if (error.empty())
+            {
+                promise.set_value();
+                return;
+            }
+            unity::LogicException e("AsyncReader::async_get_stream: error parsing data: " + error);
+            promise.set_exception(e.self());
+            return;
+        }
+        if (cancelled())
+        {
+            unity::LogicException e("AsyncReader::async_get_stream: download cancelled ( uri = " + uri + " )");
+            promise.set_exception(e.self());
+            return;
+        }
+        if (!download_error.empty())
+        {
+            unity::LogicException e("AsyncReader::async_get_stream: " + download_error + "( uri = " + uri + " )");
+            promise.set_exception(e.self());
+            return;
+        }
+        promise.set_value();
+    }
+};
+
+// Returns a response with the given cached body.
+
+http::Response cached_response(HttpResponseCache::Entry const& entry)
+{
+    http::Response response;
+    response.status = http::Status::ok;
+    response.body = entry.body;
+    return response;
+}
+
+}  // namespace
+
 HttpAsyncReader::HttpAsyncReader()
     : p_(new HttpAsyncReader::Priv)
 {
@@ -71,17 +195,204 @@ core::net::http::Request::Progress::Next HttpAsyncReader::progress_report(
                             http::Request::Progress::Next::continue_operation;
 }
 
+std::function<http::Request::Progress::Next(http::Request::Progress const&)> HttpAsyncReader::progress_handler() const
+{
+    auto generation = p_->generation_;
+    unsigned int start_generation = *generation;
+    return [generation, start_generation](http::Request::Progress const&)
+    {
+        return *generation != start_generation ? http::Request::Progress::Next::abort_operation :
+                                                 http::Request::Progress::Next::continue_operation;
+    };
+}
+
+void HttpAsyncReader::cancel()
+{
+    ++*p_->generation_;
+}
+
 void HttpAsyncReader::async_execute(core::net::http::Request::Handler const& handler, std::string const& uri) const
 {
     http::Request::Configuration configuration;
     configuration.uri = uri;
     configuration.header.add("User-Agent", "test-agent");
 
+    auto cache = p_->cache();
+    if (!cache)
+    {
+        auto request = p_->client_->head(configuration);
+        request->async_execute(handler);
+        return;
+    }
+
+    auto entry = cache->lookup(uri);
+    if (entry && entry->is_fresh())
+    {
+        cache->count_hit();
+        handler.on_response()(cached_response(*entry));
+        return;
+    }
+
+    // If the same URI is being downloaded already, we wait for that download to complete.
+    auto in_flight = p_->in_flight_;
+    {
+        std::lock_guard<std::mutex> lock(in_flight->mutex);
+        auto& waiters = in_flight->waiters[uri];
+        waiters.push_back(handler);
+        if (waiters.size() > 1)
+        {
+            cache->count_coalesced();
+            return;
+        }
+    }
+
+    if (entry)
+    {
+        HttpResponseCache::add_validators(*entry, configuration.header);
+    }
+
+    http::Request::Handler shared_handler;
+    shared_handler.on_progress(handler.on_progress());
+    shared_handler.on_error([in_flight, uri](core::net::Error const& e)
+                            {
+                                for (auto const& h : in_flight->take(uri))
+                                {
+                                    h.on_error()(e);
+                                }
+                            });
+    shared_handler.on_response([in_flight, cache, entry, uri](http::Response const& response)
+                               {
+                                   if (response.status == http::Status::not_modified && entry)
+                                   {
+                                       cache->refresh(uri, *entry, response);
+                                       cache->count_revalidated();
+                                       auto cached = cached_response(*entry);
+                                       for (auto const& h : in_flight->take(uri))
+                                       {
+                                           h.on_response()(cached);
+                                       }
+                                       return;
+                                   }
+                                   cache->store(uri, response);
+                                   cache->count_miss();
+                                   for (auto const& h : in_flight->take(uri))
+                                   {
+                                       h.on_response()(response);
+                                   }
+                               });
+
     auto request = p_->client_->head(configuration);
-    request->async_execute(handler);
+    request->async_execute(shared_handler);
+}
+
+void HttpAsyncReader::set_cache(std::string const& directory, int64_t max_size)
+{
+    auto cache = HttpResponseCache::open(directory, max_size);
+    std::lock_guard<std::mutex> lock(p_->cache_mutex_);
+    p_->cache_ = cache;
+}
+
+HttpAsyncReader::CacheStats HttpAsyncReader::cache_stats() const
+{
+    auto cache = p_->cache();
+    if (!cache)
+    {
+        return CacheStats{ 0, 0, 0, 0 };
+    }
+    return CacheStats{ cache->hits(), cache->revalidated(), cache->misses(), cache->coalesced() };
 }
 /// @endcond
 
+HttpAsyncReader::StreamFuture HttpAsyncReader::async_get_stream(std::string const& uri,
+                                                                ChunkFunc const& on_chunk) const
+{
+    auto stream = std::make_shared<Stream>();
+    stream->uri = uri;
+    stream->on_chunk = on_chunk;
+    stream->generation = p_->generation_;
+    stream->start_generation = *p_->generation_;
+    auto future = stream->promise.get_future();
+
+    http::Request::Configuration configuration;
+    configuration.uri = uri;
+    configuration.header.add("User-Agent", "test-agent");
+
+    // Streams are not coalesced with other requests for the same URI, but they do use the cache.
+    // A cached body is handed to on_chunk in one piece.
+    auto cache = p_->cache();
+    HttpResponseCache::Entry::SPtr entry;
+    if (cache)
+    {
+        entry = cache->lookup(uri);
+        if (entry && entry->is_fresh())
+        {
+            cache->count_hit();
+            stream->feed(entry->body);
+            stream->feed("");
+            stream->finish("");
+            return future;
+        }
+        if (entry)
+        {
+            HttpResponseCache::add_validators(*entry, configuration.header);
+        }
+    }
+    auto body = std::make_shared<std::string>();  // Only needed if we have a cache
+
+    http::Request::Handler handler;
+    handler.on_progress([stream](http::Request::Progress const&)
+                        {
+                            return stream->stopped || stream->cancelled() ?
+                                       http::Request::Progress::Next::abort_operation :
+                                       http::Request::Progress::Next::continue_operation;
+                        });
+    handler.on_error([stream](core::net::Error const& e)
+                     {
+                         stream->finish(e.what());
+                     });
+    handler.on_response([stream, cache, entry, body](http::Response const& response)
+                        {
+                            if (cache && response.status == http::Status::not_modified && entry)
+                            {
+                                cache->refresh(stream->uri, *entry, response);
+                                cache->count_revalidated();
+                                stream->feed(entry->body);
+                                stream->feed("");
+                                stream->finish("");
+                                return;
+                            }
+                            if (response.status != http::Status::ok)
+                            {
+                                std::ostringstream msg;
+                                msg << "HTTP request failed with: " << response.status;
+                                stream->finish(msg.str());
+                                return;
+                            }
+                            if (cache && !stream->stopped)
+                            {
+                                http::Response complete(response);
+                                complete.body = *body;
+                                cache->store(stream->uri, complete);
+                                cache->count_miss();
+                            }
+                            stream->feed("");  // End of data
+                            stream->finish("");
+                        });
+
+    auto request = p_->client_->streaming_get(configuration);
+    request->async_execute(handler,
+                           [stream, cache, body](std::string const& data)
+                           {
+                               if (cache)
+                               {
+                                   body->append(data);
+                               }
+                               stream->feed(data);
+                           });
+
+    return future;
+}
+
 std::string HttpAsyncReader::get_uri(std::string const& host,
                                      std::vector<std::pair<std::string, std::string>> const& parameters) const
 {
@@ -18,10 +18,188 @@
 
 #include <unity/scopes/qt/JsonAsyncReader.h>
 
+#include <cctype>
+#include <vector>
+
 using namespace std;
 using namespace unity::scopes::qt;
 
 /// @cond
+namespace
+{
+
+// Scans a JSON document that arrives in chunks and extracts the objects with a given name
+// (see JsonAsyncReader::async_get_stream()). The scanner only tracks the structure of the document:
+// strings, nesting, and member names. The text of each matching object is collected and, once the
+// object is complete, parsed with QJsonDocument. Everything else is discarded as soon as it has been
+// scanned, so memory use is bounded by the size of the largest object.
+
+class JsonObjectScanner
+{
+public:
+    JsonObjectScanner(string const& object_name, function<bool(QJsonObject&)> const& on_object)
+        : object_name_(object_name)
+        , on_object_(on_object)
+    {
+    }
+
+    bool feed(string const& chunk, string& error)
+    {
+        if (chunk.empty())
+        {
+            if (!stack_.empty() || in_string_)
+            {
+                error = "JsonAsyncReader::async_get_stream: unexpected end of document";
+                return false;
+            }
+            return true;
+        }
+
+        for (char c : chunk)
+        {
+            if (capture_level_ >= 0)
+            {
+                object_ += c;
+            }
+
+            if (in_string_)
+            {
+                if (escape_)
+                {
+                    escape_ = false;
+                }
+                else if (c == '\\')
+                {
+                    escape_ = true;
+                }
+                else if (c == '"')
+                {
+                    in_string_ = false;
+                    have_name_ = true;
+                    continue;
+                }
+                if (capture_level_ < 0)
+                {
+                    name_ += c;
+                }
+                continue;
+            }
+
+            switch (c)
+            {
+                case '"':
+                {
+                    in_string_ = true;
+                    have_name_ = false;
+                    match_value_ = false;  // A string value or, if followed by ':', a member name
+                    name_.clear();
+                    break;
+                }
+                case ':':
+                {
+                    // The last string was a member name.
+                    match_value_ = capture_level_ < 0 && have_name_ && name_ == object_name_;
+                    have_name_ = false;
+                    break;
+                }
+                case '{':
+                case '[':
+                {
+                    bool starts_object = c == '{' && capture_level_ < 0 &&
+                                         (match_value_ || int(stack_.size()) == array_level_);
+                    if (c == '[' && match_value_)
+                    {
+                        array_level_ = stack_.size() + 1;  // Objects in this array match.
+                    }
+                    match_value_ = false;
+                    if (starts_object)
+                    {
+                        capture_level_ = stack_.size();
+                        object_ = "{";
+                    }
+                    stack_.push_back(c == '{' ? '}' : ']');
+                    break;
+                }
+                case '}':
+                case ']':
+                {
+                    if (stack_.empty() || stack_.back() != c)
+                    {
+                        error = "JsonAsyncReader::async_get_stream: mismatched '" + string(1, c) + "'";
+                        return false;
+                    }
+                    stack_.pop_back();
+                    match_value_ = false;
+                    have_name_ = false;
+                    if (int(stack_.size()) < array_level_)
+                    {
+                        array_level_ = -1;
+                    }
+                    if (int(stack_.size()) == capture_level_)
+                    {
+                        capture_level_ = -1;
+                        if (!deliver(error))
+                        {
+                            return false;
+                        }
+                    }
+                    break;
+                }
+                case ' ':
+                case '\t':
+                case '\n':
+                case '\r':
+                {
+                    break;
+                }
+                default:
+                {
+                    // Separator, or part of a number, true, false, or null.
+                    if (c != ',' && c != '.' && c != '-' && c != '+' && !isalnum(static_cast<unsigned char>(c)))
+                    {
+                        error = "JsonAsyncReader::async_get_stream: illegal value";
+                        return false;
+                    }
+                    match_value_ = false;
+                    have_name_ = false;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    bool deliver(string& error)
+    {
+        QJsonParseError json_error;
+        QJsonDocument doc = QJsonDocument::fromJson(QByteArray(object_.data(), object_.size()), &json_error);
+        object_.clear();
+        if (!doc.isObject())
+        {
+            error = "JsonAsyncReader::async_get_stream: " + json_error.errorString().toStdString();
+            return false;
+        }
+        QJsonObject obj = doc.object();
+        return on_object_(obj);
+    }
+
+    string const object_name_;
+    function<bool(QJsonObject&)> const on_object_;
+
+    vector<char> stack_;       // Expected closing brackets of the enclosing objects and arrays
+    bool in_string_ = false;
+    bool escape_ = false;
+    string name_;              // Contents of the last string outside a matching object
+    bool have_name_ = false;   // name_ is complete and may be followed by ':'
+    bool match_value_ = false; // The next value belongs to a member with the object name
+    int array_level_ = -1;     // Nesting level of the objects in a matching array
+    int capture_level_ = -1;   // Nesting level of the matching object we are collecting
+    string object_;            // Text of that object
+};
+
+}  // namespace
+
 JsonAsyncReader::JsonAsyncReader()
     : p_(new HttpAsyncReader)
 {
@@ -45,6 +223,31 @@ JsonAsyncReader::QJsonDocumentSptr JsonAsyncReader::create_parser_with_data(std:
     return res;
 }
 
+HttpAsyncReader::ChunkFunc JsonAsyncReader::create_stream_parser(std::string const& object_name,
+                                                                  std::function<bool(QJsonObject&)> const& on_object)
+{
+    auto scanner = make_shared<JsonObjectScanner>(object_name, on_object);
+    return [scanner](string const& chunk, string& error)
+    {
+        return scanner->feed(chunk, error);
+    };
+}
+
+void JsonAsyncReader::cancel()
+{
+    p_->cancel();
+}
+
+void JsonAsyncReader::set_cache(std::string const& directory, int64_t max_size)
+{
+    p_->set_cache(directory, max_size);
+}
+
+HttpAsyncReader::CacheStats JsonAsyncReader::cache_stats() const
+{
+    return p_->cache_stats();
+}
+
 JsonAsyncReader::JsonDocumentFuture JsonAsyncReader::async_get_parser(std::string const& uri) const
 {
     return p_->async_get_parser<QJsonDocument>(uri, JsonAsyncReader::create_parser_with_data);
@@ -20,10 +20,115 @@
 
 #include <unity/scopes/qt/XmlAsyncReader.h>
 
+#include <QtCore/QTextCodec>
+
 using namespace std;
 using namespace unity::scopes::qt;
 
 /// @cond
+namespace
+{
+
+// Parses a XML document that arrives in chunks and extracts the elements with a given name
+// (see XmlAsyncReader::async_get_stream()). QXmlStreamReader can parse incrementally, but an object
+// must be constructed from a complete element, so we keep the text of the current element and,
+// once its end tag has arrived, hand a separate reader for just that element to the callback.
+// Text outside matching elements is discarded as soon as it has been parsed.
+
+class XmlObjectScanner
+{
+public:
+    XmlObjectScanner(string const& object_name, function<bool(QXmlStreamReader&)> const& on_object)
+        : object_name_(QString::fromStdString(object_name))
+        , on_object_(on_object)
+        , decoder_(QTextCodec::codecForName("UTF-8")->makeDecoder())
+    {
+    }
+
+    bool feed(string const& chunk, string& error)
+    {
+        if (complete_)
+        {
+            return true;
+        }
+        if (chunk.empty())
+        {
+            error = "get_results: ERROR: Premature end of document. at line: " + to_string(xml_.lineNumber());
+            return false;
+        }
+
+        // A chunk can end in the middle of a multi-byte character, so we need a stateful decoder.
+        QString text = decoder_->toUnicode(chunk.data(), chunk.size());
+        text_ += text;
+        xml_.addData(text);
+
+        for (;;)
+        {
+            QXmlStreamReader::TokenType token = xml_.readNext();
+            if (xml_.hasError())
+            {
+                if (xml_.error() == QXmlStreamReader::PrematureEndOfDocumentError)
+                {
+                    return true;  // Wait for more data.
+                }
+                error = "get_results: ERROR: " + xml_.errorString().toStdString() + " at line: " +
+                        to_string(xml_.lineNumber());
+                return false;
+            }
+            if (token == QXmlStreamReader::EndDocument)
+            {
+                complete_ = true;
+                return true;
+            }
+
+            if (depth_ == 0)
+            {
+                if (token == QXmlStreamReader::StartElement && xml_.name() == object_name_)
+                {
+                    start_ = offset_;
+                    depth_ = 1;
+                }
+            }
+            else if (token == QXmlStreamReader::StartElement)
+            {
+                ++depth_;
+            }
+            else if (token == QXmlStreamReader::EndElement && --depth_ == 0)
+            {
+                QXmlStreamReader element(text_.mid(start_ - base_, xml_.characterOffset() - start_));
+                while (!element.atEnd() && element.readNext() != QXmlStreamReader::StartElement)
+                {
+                }
+                if (!on_object_(element))
+                {
+                    return false;
+                }
+            }
+
+            offset_ = xml_.characterOffset();
+            if (depth_ == 0)
+            {
+                text_.remove(0, offset_ - base_);
+                base_ = offset_;
+            }
+        }
+    }
+
+private:
+    QString const object_name_;
+    function<bool(QXmlStreamReader&)> const on_object_;
+    unique_ptr<QTextDecoder> decoder_;
+    QXmlStreamReader xml_;
+    bool complete_ = false;
+    QString text_;       // Text of the document from offset base_ onwards
+    qint64 base_ = 0;
+    qint64 offset_ = 0;  // Offset of the end of the last complete token
+    qint64 start_ = 0;   // Offset of the start of the current matching element
+    int depth_ = 0;      // Nesting level within the current matching element
+};
+
+}  // namespace
+
 XmlAsyncReader::XmlAsyncReader()
     : p_(new HttpAsyncReader)
 {
@@ -43,6 +148,31 @@ XmlAsyncReader::QXmlStreamReaderSptr XmlAsyncReader::create_parser_with_data(std
     return res;
 }
 
+HttpAsyncReader::ChunkFunc XmlAsyncReader::create_stream_parser(std::string const& object_name,
+                                                                 std::function<bool(QXmlStreamReader&)> const& on_object)
+{
+    auto scanner = make_shared<XmlObjectScanner>(object_name, on_object);
+    return [scanner](string const& chunk, string& error)
+    {
+        return scanner->feed(chunk, error);
+    };
+}
+
+void XmlAsyncReader::cancel()
+{
+    p_->cancel();
+}
+
+void XmlAsyncReader::set_cache(std::string const& directory, int64_t max_size)
+{
+    p_->set_cache(directory, max_size);
+}
+
+HttpAsyncReader::CacheStats XmlAsyncReader::cache_stats() const
+{
+    return p_->cache_stats();
+}
+
 XmlAsyncReader::QXmlStreamReaderFuture XmlAsyncReader::async_get_parser(std::string const& uri) const
 {
     return p_->async_get_parser<QXmlStreamReader>(uri, XmlAsyncReader::create_parser_with_data);
@@ -0,0 +1,549 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/qt/internal/HttpResponseCache.h>
+
+#include <unity/UnityExceptions.h>
+
+#include <core/net/http/status.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <sstream>
+
+#include <utime.h>
+
+using namespace std;
+
+namespace http = core::net::http;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace qt
+{
+
+namespace internal
+{
+
+namespace
+{
+
+// All caches that are in use, indexed by directory. Readers that use the same directory share
+// a cache, so they agree on the LRU order and total size of the files.
+
+struct Registry
+{
+    mutex m;
+    map<string, weak_ptr<HttpResponseCache>> caches;
+};
+
+Registry& registry()
+{
+    static Registry* r = new Registry;
+    return *r;
+}
+
+string to_lower(string s)
+{
+    transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return tolower(c); });
+    return s;
+}
+
+string trim(string const& s)
+{
+    auto begin = s.find_first_not_of(" \t\r\n");
+    if (begin == string::npos)
+    {
+        return "";
+    }
+    auto end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+// Returns the values of the named header, ignoring case. (Servers differ in how
+// they capitalize header names, such as "ETag" and "Etag".)
+vector<string> header_values(http::Header const& header, string const& name)
+{
+    vector<string> values;
+    string const key = to_lower(name);
+    header.enumerate([&](string const& k, set<string> const& vals)
+                     {
+                         if (to_lower(k) == key)
+                         {
+                             for (auto const& v : vals)
+                             {
+                                 values.push_back(trim(v));
+                             }
+                         }
+                     });
+    return values;
+}
+
+string header_value(http::Header const& header, string const& name)
+{
+    auto values = header_values(header, name);
+    return values.empty() ? "" : values.front();
+}
+
+// Parses an HTTP date, such as "Sun, 06 Nov 1994 08:49:37 GMT". Returns -1 if the date is invalid.
+int64_t parse_http_date(string const& date)
+{
+    struct tm tm = {};
+    char const* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S", &tm);
+    if (!end)
+    {
+        return -1;
+    }
+    return timegm(&tm);
+}
+
+// Freshness of a response, as determined by its Cache-Control and Expires headers.
+
+struct Freshness
+{
+    bool no_store;
+    int64_t expires;
+};
+
+Freshness freshness(http::Header const& header)
+{
+    Freshness f{ false, -1 };
+    int64_t const now = time(nullptr);
+    bool no_cache = false;
+    int64_t max_age = -1;
+
+    for (auto const& value : header_values(header, "Cache-Control"))
+    {
+        istringstream s(value);
+        string directive;
+        while (getline(s, directive, ','))
+        {
+            directive = to_lower(trim(directive));
+            if (directive == "no-store")
+            {
+                f.no_store = true;
+            }
+            else if (directive == "no-cache")
+            {
+                no_cache = true;
+            }
+            else if (directive.compare(0, 8, "max-age=") == 0)
+            {
+                try
+                {
+                    max_age = stoll(directive.substr(8));
+                }
+                catch (std::exception const&)
+                {
+                    max_age = 0;
+                }
+            }
+        }
+    }
+
+    if (no_cache)
+    {
+        f.expires = 0;  // Must always be revalidated
+    }
+    else if (max_age >= 0)
+    {
+        f.expires = now + max_age;
+    }
+    else
+    {
+        auto expires = header_value(header, "Expires");
+        f.expires = expires.empty() ? 0 : max(parse_http_date(expires), int64_t(0));
+    }
+    return f;
+}
+
+string serialize(string const& uri, HttpResponseCache::Entry const& entry)
+{
+    ostringstream s;
+    s << "uri " << uri << "\n"
+      << "etag " << entry.etag << "\n"
+      << "last-modified " << entry.last_modified << "\n"
+      << "expires " << entry.expires << "\n"
+      << "\n"
+      << entry.body;
+    return s.str();
+}
+
+// Returns nullptr if the data is not a valid entry for uri.
+HttpResponseCache::Entry::SPtr deserialize(string const& uri, QByteArray const& data)
+{
+    auto entry = make_shared<HttpResponseCache::Entry>();
+    entry->expires = 0;
+    bool uri_matches = false;
+
+    int pos = 0;
+    for (;;)
+    {
+        int eol = data.indexOf('\n', pos);
+        if (eol == -1)
+        {
+            return nullptr;
+        }
+        string line(data.constData() + pos, eol - pos);
+        pos = eol + 1;
+        if (line.empty())
+        {
+            break;  // End of metadata
+        }
+        auto space = line.find(' ');
+        string key = line.substr(0, space);
+        string value = space == string::npos ? "" : line.substr(space + 1);
+        if (key == "uri")
+        {
+            uri_matches = value == uri;
+        }
+        else if (key == "etag")
+        {
+            entry->etag = value;
+        }
+        else if (key == "last-modified")
+        {
+            entry->last_modified = value;
+        }
+        else if (key == "expires")
+        {
+            try
+            {
+                entry->expires = stoll(value);
+            }
+            catch (std::exception const&)
+            {
+                return nullptr;
+            }
+        }
+    }
+    if (!uri_matches)
+    {
+        return nullptr;
+    }
+    entry->body.assign(data.constData() + pos, data.size() - pos);
+    return entry;
+}
+
+bool is_entry_file(QString const& name)
+{
+    static QRegExp const hex("[0-9a-f]{40}");
+    return hex.exactMatch(name);
+}
+
+}  // namespace
+
+bool HttpResponseCache::Entry::is_fresh() const
+{
+    return expires > time(nullptr);
+}
+
+HttpResponseCache::SPtr HttpResponseCache::open(string const& directory, int64_t max_size)
+{
+    if (max_size < 0)
+    {
+        throw InvalidArgumentException("HttpResponseCache: invalid max_size: " + to_string(max_size));
+    }
+
+    auto& r = registry();
+    lock_guard<mutex> lock(r.m);
+    auto& cache = r.caches[directory];
+    auto sptr = cache.lock();
+    if (!sptr)
+    {
+        if (!QDir().mkpath(QString::fromStdString(directory)))
+        {
+            throw ResourceException("HttpResponseCache: cannot create cache directory " + directory);
+        }
+        sptr.reset(new HttpResponseCache(directory, max_size));
+        cache = sptr;
+    }
+    return sptr;
+}
+
+HttpResponseCache::HttpResponseCache(string const& directory, int64_t max_size)
+    : directory_(directory)
+    , max_size_(max_size)
+    , size_(0)
+    , hits_(0)
+    , revalidated_(0)
+    , misses_(0)
+    , coalesced_(0)
+{
+    load_index();
+}
+
+HttpResponseCache::~HttpResponseCache()
+{
+    auto& r = registry();
+    lock_guard<mutex> lock(r.m);
+    auto it = r.caches.find(directory_);
+    if (it != r.caches.end() && it->second.expired())
+    {
+        r.caches.erase(it);
+    }
+}
+
+string HttpResponseCache::directory() const
+{
+    return directory_;
+}
+
+HttpResponseCache::Entry::SPtr HttpResponseCache::lookup(string const& uri)
+{
+    string const file = path(uri);
+
+    lock_guard<mutex> lock(mutex_);
+    if (index_.find(file) == index_.end())
+    {
+        return nullptr;
+    }
+    QFile f(QString::fromStdString(directory_ + "/" + file));
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        erase(file);
+        return nullptr;
+    }
+    auto entry = deserialize(uri, f.readAll());
+    if (!entry)
+    {
+        return nullptr;  // Damaged file, or different URI with the same hash
+    }
+    touch(file);
+    return entry;
+}
+
+void HttpResponseCache::add_validators(Entry const& entry, http::Header& header)
+{
+    if (!entry.etag.empty())
+    {
+        header.add("If-None-Match", entry.etag);
+    }
+    if (!entry.last_modified.empty())
+    {
+        header.add("If-Modified-Since", entry.last_modified);
+    }
+}
+
+void HttpResponseCache::store(string const& uri, http::Response const& response)
+{
+    if (response.status != http::Status::ok)
+    {
+        return;
+    }
+
+    auto f = freshness(response.header);
+    Entry entry;
+    entry.body = response.body;
+    entry.etag = header_value(response.header, "ETag");
+    entry.last_modified = header_value(response.header, "Last-Modified");
+    entry.expires = f.expires;
+
+    lock_guard<mutex> lock(mutex_);
+    // A response that is stale and cannot be revalidated is of no use.
+    if (f.no_store || (!entry.is_fresh() && entry.etag.empty() && entry.last_modified.empty()))
+    {
+        erase(path(uri));
+        return;
+    }
+    write(uri, entry);
+}
+
+void HttpResponseCache::refresh(string const& uri, Entry const& entry, http::Response const& response)
+{
+    auto f = freshness(response.header);
+    Entry e(entry);
+    e.expires = f.expires;
+    auto etag = header_value(response.header, "ETag");
+    if (!etag.empty())
+    {
+        e.etag = etag;
+    }
+    auto last_modified = header_value(response.header, "Last-Modified");
+    if (!last_modified.empty())
+    {
+        e.last_modified = last_modified;
+    }
+
+    lock_guard<mutex> lock(mutex_);
+    if (f.no_store)
+    {
+        erase(path(uri));
+        return;
+    }
+    write(uri, e);
+}
+
+void HttpResponseCache::count_hit()
+{
+    ++hits_;
+}
+
+void HttpResponseCache::count_revalidated()
+{
+    ++revalidated_;
+}
+
+void HttpResponseCache::count_miss()
+{
+    ++misses_;
+}
+
+void HttpResponseCache::count_coalesced()
+{
+    ++coalesced_;
+}
+
+int64_t HttpResponseCache::hits() const
+{
+    return hits_;
+}
+
+int64_t HttpResponseCache::revalidated() const
+{
+    return revalidated_;
+}
+
+int64_t HttpResponseCache::misses() const
+{
+    return misses_;
+}
+
+int64_t HttpResponseCache::coalesced() const
+{
+    return coalesced_;
+}
+
+// The file name for a URI is the SHA1 hash of the URI.
+
+string HttpResponseCache::path(string const& uri) const
+{
+    return QCryptographicHash::hash(QByteArray::fromStdString(uri), QCryptographicHash::Sha1).toHex().toStdString();
+}
+
+// Writes the entry to the cache directory and evicts the least-recently used entries
+// if the cache is too large. Caller must hold the lock.
+// Failure to write an entry is not an error; the response simply is not cached.
+
+void HttpResponseCache::write(string const& uri, Entry const& entry)
+{
+    string const file = path(uri);
+    string const data = serialize(uri, entry);
+    if (int64_t(data.size()) > max_size_)
+    {
+        erase(file);
+        return;
+    }
+
+    // QSaveFile writes to a temporary file and renames it, so readers never see a partial entry.
+    QSaveFile f(QString::fromStdString(directory_ + "/" + file));
+    if (!f.open(QIODevice::WriteOnly)
+        || f.write(data.data(), data.size()) != int64_t(data.size())
+        || !f.commit())
+    {
+        erase(file);
+        return;
+    }
+
+    auto it = index_.find(file);
+    if (it != index_.end())
+    {
+        size_ -= it->second->size;
+        lru_.erase(it->second);
+    }
+    index_[file] = lru_.insert(lru_.end(), IndexEntry{ file, int64_t(data.size()) });
+    size_ += data.size();
+    evict();
+}
+
+// Marks the entry as most-recently used. We also update the modification time of the file,
+// so the LRU order is preserved when the cache is loaded again. Caller must hold the lock.
+
+void HttpResponseCache::touch(string const& file)
+{
+    auto it = index_.find(file);
+    if (it == index_.end())
+    {
+        return;
+    }
+    lru_.splice(lru_.end(), lru_, it->second);
+    ::utime((directory_ + "/" + file).c_str(), nullptr);
+}
+
+// Caller must hold the lock.
+
+void HttpResponseCache::erase(string const& file)
+{
+    auto it = index_.find(file);
+    if (it != index_.end())
+    {
+        size_ -= it->second->size;
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    QFile::remove(QString::fromStdString(directory_ + "/" + file));
+}
+
+// Caller must hold the lock.
+
+void HttpResponseCache::evict()
+{
+    while (size_ > max_size_ && !lru_.empty())
+    {
+        erase(lru_.front().file);
+    }
+}
+
+// Builds the index from the files in the cache directory, in order of their modification time.
+
+void HttpResponseCache::load_index()
+{
+    QDir dir(QString::fromStdString(directory_));
+    auto files = dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);  // Oldest first
+
+    lock_guard<mutex> lock(mutex_);
+    for (auto const& info : files)
+    {
+        if (!is_entry_file(info.fileName()))
+        {
+            continue;  // Not ours, or left behind by a write that did not complete
+        }
+        string const file = info.fileName().toStdString();
+        index_[file] = lru_.insert(lru_.end(), IndexEntry{ file, info.size() });
+        size_ += info.size();
+    }
+    evict();
+}
+
+}  // namespace internal
+
+}  // namespace qt
+
+}  // namespace scopes
+
+}  // namespace unity
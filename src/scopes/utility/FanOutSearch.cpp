@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/utility/FanOutSearch.h>
+
+#include <unity/scopes/SearchQueryBase.h>
+#include <unity/scopes/utility/internal/FanOutSearchImpl.h>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace utility
+{
+
+/*!
+\class FanOutSearch
+
+\brief Helper for aggregator scopes that sends a query to a list of child scopes in parallel.
+
+FanOutSearch sends a search to each enabled child and forwards the results upstream in the
+order of the child list. Ordering is implemented with a chain of BufferedResultForwarder
+instances, so the results of a child are held back only until all children ahead of it
+have pushed their first result; results are not buffered beyond that point.
+
+To prevent a slow child from delaying the display of results from children that follow it,
+you can set a per-child deadline with set_child_timeout(). When the deadline for a child
+expires, the child is cancelled and the children after it no longer wait for it. You can also
+limit the total number of results that are forwarded with set_cardinality(); once the limit is
+reached, all outstanding children are cancelled. To drop duplicate results from different children,
+set a ResultMerger with set_merger().
+
+run() returns statistics for each child, such as the time to the first result, the total latency,
+and whether the child timed out. The statistics can be used to log or tune slow children.
+
+Here is an example of an aggregator query that searches all of its children:
+
+\code
+class AggregatorQuery : public SearchQueryBase
+{
+public:
+    AggregatorQuery(CannedQuery const& query, SearchMetadata const& metadata, ChildScopeList const& children)
+        : SearchQueryBase(query, metadata)
+        , children_(children)
+    {
+    }
+
+    void run(SearchReplyProxy const& upstream_reply) override
+    {
+        utility::FanOutSearch fan_out(upstream_reply, children_);
+        fan_out.set_child_timeout(2000);
+        fan_out.set_cardinality(search_metadata().cardinality());
+
+        // cancelled() can be called from another thread at any time, including before run().
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_)
+            {
+                return;
+            }
+            fan_out_ = &fan_out;
+        }
+        auto stats = fan_out.run(*this);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fan_out_ = nullptr;
+        }
+
+        for (auto const& s : stats)
+        {
+            if (s.timed_out)
+            {
+                timeouts_[s.scope_id]++;  // For example, to lower the priority of slow children.
+            }
+        }
+    }
+
+    void cancelled() override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        if (fan_out_)
+        {
+            fan_out_->cancel();  // Does not block, so we can call it with the lock held.
+        }
+    }
+
+private:
+    ChildScopeList children_;
+    std::map<std::string, int> timeouts_;
+    std::mutex mutex_;
+    bool cancelled_ = false;
+    utility::FanOutSearch* fan_out_ = nullptr;
+};
+\endcode
+
+\see BufferedResultForwarder, ResultMerger
+*/
+
+FanOutSearch::FanOutSearch(SearchReplyProxy const& upstream, ChildScopeList const& children)
+    : p(new internal::FanOutSearchImpl(upstream, children))
+{
+}
+
+/// @cond
+FanOutSearch::~FanOutSearch() = default;
+/// @endcond
+
+void FanOutSearch::set_child_timeout(int64_t timeout)
+{
+    p->set_child_timeout(timeout);
+}
+
+void FanOutSearch::set_cardinality(int cardinality)
+{
+    p->set_cardinality(cardinality);
+}
+
+void FanOutSearch::set_merger(ResultMerger::SPtr const& merger)
+{
+    p->set_merger(merger);
+}
+
+std::vector<FanOutSearch::ChildStats> FanOutSearch::run(SearchQueryBase& query)
+{
+    auto const canned_query = query.query();
+    auto const metadata = query.search_metadata();
+    auto search_func = [&query, canned_query, metadata](ChildScope const& child, SearchListenerBase::SPtr const& listener)
+    {
+        return query.subsearch(child,
+                               canned_query.query_string(),
+                               canned_query.department_id(),
+                               canned_query.filter_state(),
+                               metadata,
+                               listener);
+    };
+    return p->run(search_func);
+}
+
+std::vector<FanOutSearch::ChildStats> FanOutSearch::run(SearchFunc const& search_func)
+{
+    return p->run(search_func);
+}
+
+void FanOutSearch::cancel()
+{
+    p->cancel();
+}
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/utility/ResultMerger.h>
+#include <unity/scopes/utility/internal/ResultMergerImpl.h>
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace utility
+{
+
+/*!
+\class ResultMerger
+
+\brief De-duplicates the results that an aggregator receives from several children.
+
+Different child scopes often return the same item, for example, the same URI. ResultMerger
+sits between the children and the upstream reply proxy and drops duplicates before they are
+pushed, so duplicates are never serialized, sent to the client, or counted against the
+cardinality of the query.
+
+Results are considered duplicates if they have the same value for the key attribute ("uri" by default).
+Each child pushes its results via its own reply proxy, which is returned by child_reply(). The order
+in which the child replies are created determines the priority of the children.
+
+With the FirstWins policy, the first result to arrive is pushed immediately and all later duplicates
+are dropped. With the PreferChildOrder and CombineAttributes policies, a result from a child is held back
+while a child with higher priority is still running, so a duplicate from the higher-priority child can
+replace it. This trades display latency for consistency. CombineAttributes also copies attributes
+that are missing from the result that is pushed from the duplicates that are dropped.
+
+To bound memory consumption, the merger remembers at most `max_keys` distinct keys per query.
+
+You can use a ResultMerger directly with your own forwarders, or pass it to FanOutSearch::set_merger().
+
+\see FanOutSearch
+*/
+
+ResultMerger::ResultMerger(SearchReplyProxy const& upstream,
+                           std::string const& key,
+                           Policy policy,
+                           size_t max_keys)
+    : p(std::make_shared<internal::ResultMergerImpl>(upstream, key, policy, max_keys))
+{
+}
+
+/// @cond
+ResultMerger::~ResultMerger() = default;
+/// @endcond
+
+SearchReplyProxy ResultMerger::child_reply()
+{
+    return p->child_reply();
+}
+
+void ResultMerger::flush()
+{
+    p->flush();
+}
+
+int ResultMerger::duplicates() const
+{
+    return p->duplicates();
+}
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/utility/internal/FanOutSearchImpl.h>
+
+#include <unity/scopes/QueryCtrl.h>
+#include <unity/scopes/SearchReply.h>
+#include <unity/scopes/utility/BufferedResultForwarder.h>
+#include <unity/scopes/utility/internal/ResultMergerImpl.h>
+#include <unity/UnityExceptions.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace utility
+{
+
+namespace internal
+{
+
+namespace
+{
+
+int64_t elapsed_ms(FanOutState::Clock::time_point start)
+{
+    return chrono::duration_cast<chrono::milliseconds>(FanOutState::Clock::now() - start).count();
+}
+
+} // namespace
+
+// Forwarder for a single child. The forwarders are chained in child order, so the
+// BufferedResultForwarder machinery takes care of keeping the results in order while
+// passing them upstream as soon as all preceding children are ready.
+
+class FanOutForwarder : public BufferedResultForwarder
+{
+public:
+    // If the results pass through a ResultMerger, upstream is the child reply of the merger.
+    FanOutForwarder(shared_ptr<FanOutState> const& state,
+                    size_t index,
+                    SearchReplyProxy const& upstream,
+                    bool merging,
+                    BufferedResultForwarder::SPtr const& next)
+        : BufferedResultForwarder(upstream, next)
+        , state_(state)
+        , index_(index)
+        , merge_reply_(merging ? upstream : nullptr)
+    {
+    }
+
+    void push(CategorisedResult result) override
+    {
+        if (state_->admit(index_, merge_reply_ != nullptr))
+        {
+            upstream()->push(result);
+        }
+        set_ready();
+    }
+
+    void finished(CompletionDetails const& details) override
+    {
+        state_->child_finished(index_, details);
+        BufferedResultForwarder::finished(details);
+        child_done();
+    }
+
+    // Called when the child is abandoned, so children following this one no longer wait for it.
+    void expire()
+    {
+        set_ready();
+        child_done();
+    }
+
+private:
+    // Tell the merger that it no longer needs to hold back results of lower-priority children for this one.
+    void child_done()
+    {
+        if (merge_reply_)
+        {
+            merge_reply_->finished();
+        }
+    }
+
+    shared_ptr<FanOutState> const state_;
+    size_t const index_;
+    SearchReplyProxy const merge_reply_;
+};
+
+FanOutState::FanOutState()
+    : cardinality_(0)
+    , num_forwarded_(0)
+    , outstanding_(0)
+    , cancelled_(false)
+{
+}
+
+bool FanOutState::admit(size_t child, bool merging)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    assert(child < stats_.size());
+    if (done_[child] || cancelled_ || limit_reached())
+    {
+        return false;  // Child was abandoned, or we already have enough results.
+    }
+    if (!merging)
+    {
+        count_forwarded(child);
+    }
+    return true;
+}
+
+// Called by the merger for each result that was not dropped as a duplicate. The merger
+// may have held the result back until after its child finished, which is fine, unless
+// the child was abandoned in the mean time.
+
+bool FanOutState::admit_merged(size_t child)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    assert(child < stats_.size());
+    if (abandoned(child) || cancelled_ || limit_reached())
+    {
+        return false;
+    }
+    count_forwarded(child);
+    return true;
+}
+
+bool FanOutState::limit_reached() const
+{
+    return cardinality_ > 0 && num_forwarded_ >= cardinality_;
+}
+
+bool FanOutState::abandoned(size_t child) const
+{
+    return done_[child] && stats_[child].status == CompletionDetails::Cancelled;
+}
+
+void FanOutState::count_forwarded(size_t child)
+{
+    auto& s = stats_[child];
+    if (s.results++ == 0)
+    {
+        s.first_result_ms = elapsed_ms(start_times_[child]);
+    }
+    if (++num_forwarded_ == cardinality_)
+    {
+        cond_.notify_all();  // Wake up run(), so it can cancel the remaining children.
+    }
+}
+
+void FanOutState::child_finished(size_t child, CompletionDetails const& details)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    assert(child < stats_.size());
+    if (done_[child])
+    {
+        return;  // Late completion of a child that timed out or was cancelled.
+    }
+    done_[child] = true;
+    stats_[child].latency_ms = elapsed_ms(start_times_[child]);
+    stats_[child].status = details.status();
+    if (--outstanding_ == 0)
+    {
+        cond_.notify_all();
+    }
+}
+
+FanOutSearchImpl::FanOutSearchImpl(SearchReplyProxy const& upstream, ChildScopeList const& children)
+    : upstream_(upstream)
+    , child_timeout_(-1)
+    , started_(false)
+    , state_(make_shared<FanOutState>())
+{
+    if (!upstream)
+    {
+        throw InvalidArgumentException("FanOutSearch(): upstream reply proxy cannot be nullptr");
+    }
+    for (auto const& child : children)
+    {
+        if (child.enabled)
+        {
+            children_.push_back(child);
+        }
+    }
+}
+
+FanOutSearchImpl::~FanOutSearchImpl()
+{
+    cancel();
+}
+
+void FanOutSearchImpl::set_child_timeout(int64_t timeout)
+{
+    if (timeout < -1)
+    {
+        throw InvalidArgumentException("FanOutSearch::set_child_timeout(): invalid timeout: " + std::to_string(timeout));
+    }
+    child_timeout_ = timeout;
+}
+
+void FanOutSearchImpl::set_merger(ResultMerger::SPtr const& merger)
+{
+    merger_ = merger;
+}
+
+void FanOutSearchImpl::set_cardinality(int cardinality)
+{
+    if (cardinality < 0)
+    {
+        throw InvalidArgumentException("FanOutSearch::set_cardinality(): invalid cardinality: "
+                                       + std::to_string(cardinality));
+    }
+    lock_guard<mutex> lock(state_->mutex_);
+    state_->cardinality_ = cardinality;
+}
+
+vector<FanOutSearch::ChildStats> FanOutSearchImpl::run(FanOutSearch::SearchFunc const& search_func)
+{
+    if (!search_func)
+    {
+        throw InvalidArgumentException("FanOutSearch::run(): search_func cannot be nullptr");
+    }
+
+    {
+        lock_guard<mutex> lock(state_->mutex_);
+        if (started_)
+        {
+            throw LogicException("FanOutSearch::run(): cannot run the same search more than once");
+        }
+        started_ = true;
+        auto const num_children = children_.size();
+        state_->stats_.resize(num_children);
+        state_->start_times_.assign(num_children, FanOutState::Clock::now());
+        state_->done_.assign(num_children, false);
+        state_->outstanding_ = num_children;
+        for (size_t i = 0; i < num_children; ++i)
+        {
+            state_->stats_[i] = FanOutSearch::ChildStats{ children_[i].id, -1, -1, 0, false, CompletionDetails::OK };
+        }
+
+        // The merger ranks children in the order in which their replies are created.
+        vector<SearchReplyProxy> replies;
+        for (size_t i = 0; i < num_children; ++i)
+        {
+            replies.push_back(merger_ ? merger_->child_reply() : upstream_);
+        }
+
+        // Duplicates must not use up the cardinality, so we count results as they leave the merger.
+        if (merger_ && num_children > 0)
+        {
+            auto first = dynamic_pointer_cast<ChildMergeReply>(replies[0]);
+            assert(first);
+            size_t const first_rank = first->rank();
+            auto state = state_;
+            first->merger()->set_output_filter([state, first_rank, num_children](size_t rank)
+            {
+                if (rank < first_rank || rank >= first_rank + num_children)
+                {
+                    return true;  // Not one of our children.
+                }
+                return state->admit_merged(rank - first_rank);
+            });
+        }
+
+        // Chain the forwarders in reverse, so each one knows its successor.
+        forwarders_.resize(num_children);
+        for (size_t i = num_children; i-- > 0; )
+        {
+            auto next = i + 1 < num_children ? forwarders_[i + 1] : nullptr;
+            forwarders_[i] = make_shared<FanOutForwarder>(state_, i, replies[i], merger_ != nullptr, next);
+        }
+        ctrls_.resize(num_children);
+    }
+
+    // Send all the searches before waiting for any of them. search() does not wait for the
+    // child to produce results, so all children are busy in parallel.
+    for (size_t i = 0; i < children_.size(); ++i)
+    {
+        {
+            lock_guard<mutex> lock(state_->mutex_);
+            if (state_->cancelled_)
+            {
+                break;
+            }
+            state_->start_times_[i] = FanOutState::Clock::now();
+        }
+        QueryCtrlProxy ctrl;
+        try
+        {
+            ctrl = search_func(children_[i], forwarders_[i]);
+        }
+        catch (std::exception const& e)
+        {
+            forwarders_[i]->finished(CompletionDetails(CompletionDetails::Error, e.what()));
+        }
+        bool abandoned;
+        {
+            lock_guard<mutex> lock(state_->mutex_);
+            ctrls_[i] = ctrl;
+            abandoned = state_->abandoned(i);
+        }
+        if (abandoned && ctrl)
+        {
+            // cancel() got in before we stored the ctrl, so abandon() could not cancel the child.
+            ctrl->cancel();
+        }
+    }
+
+    unique_lock<mutex> lock(state_->mutex_);
+    while (true)
+    {
+        if (state_->outstanding_ == 0 || state_->cancelled_ || state_->limit_reached())
+        {
+            break;
+        }
+
+        if (child_timeout_ == -1)
+        {
+            state_->cond_.wait(lock);
+            continue;
+        }
+
+        // Find the earliest deadline of the children that are still outstanding.
+        auto const timeout = chrono::milliseconds(child_timeout_);
+        auto deadline = FanOutState::Clock::time_point::max();
+        for (size_t i = 0; i < state_->done_.size(); ++i)
+        {
+            if (!state_->done_[i])
+            {
+                deadline = min(deadline, state_->start_times_[i] + timeout);
+            }
+        }
+        if (state_->cond_.wait_until(lock, deadline) == cv_status::no_timeout)
+        {
+            continue;
+        }
+
+        vector<size_t> expired;
+        auto const now = FanOutState::Clock::now();
+        for (size_t i = 0; i < state_->done_.size(); ++i)
+        {
+            if (!state_->done_[i] && state_->start_times_[i] + timeout <= now)
+            {
+                expired.push_back(i);
+            }
+        }
+        lock.unlock();
+        abandon(expired, true);
+        lock.lock();
+    }
+    lock.unlock();
+
+    // Whatever is still outstanding at this point was cancelled or is surplus to the cardinality limit.
+    // We don't cancel the search as a whole, because the merger can still hold back results
+    // of children that finished normally.
+    abandon_outstanding();
+
+    lock.lock();
+    return state_->stats_;
+}
+
+void FanOutSearchImpl::cancel()
+{
+    {
+        lock_guard<mutex> lock(state_->mutex_);
+        state_->cancelled_ = true;
+    }
+    abandon_outstanding();
+}
+
+void FanOutSearchImpl::abandon_outstanding()
+{
+    vector<size_t> outstanding;
+    {
+        lock_guard<mutex> lock(state_->mutex_);
+        for (size_t i = 0; i < state_->done_.size(); ++i)
+        {
+            if (!state_->done_[i])
+            {
+                outstanding.push_back(i);
+            }
+        }
+        state_->cond_.notify_all();
+    }
+    abandon(outstanding, false);
+}
+
+// Mark the specified children as done and cancel their queries. We call into the
+// forwarders and the query controls without holding the lock because both can
+// end up calling back into the forwarders.
+
+void FanOutSearchImpl::abandon(vector<size_t> const& children, bool timed_out)
+{
+    vector<QueryCtrlProxy> ctrls;
+    {
+        lock_guard<mutex> lock(state_->mutex_);
+        for (auto i : children)
+        {
+            if (state_->done_[i])
+            {
+                continue;  // Finished in the mean time.
+            }
+            state_->done_[i] = true;
+            auto& s = state_->stats_[i];
+            s.latency_ms = elapsed_ms(state_->start_times_[i]);
+            s.timed_out = timed_out;
+            s.status = CompletionDetails::Cancelled;
+            --state_->outstanding_;
+            if (ctrls_[i])
+            {
+                ctrls.push_back(ctrls_[i]);
+            }
+        }
+        state_->cond_.notify_all();
+    }
+    for (auto i : children)
+    {
+        forwarders_[i]->expire();
+    }
+    for (auto const& c : ctrls)
+    {
+        c->cancel();
+    }
+}
+
+} // namespace internal
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/utility/internal/ResultMergerImpl.h>
+
+#include <unity/UnityExceptions.h>
+
+#include <cassert>
+
+using namespace std;
+
+namespace unity
+{
+
+namespace scopes
+{
+
+namespace utility
+{
+
+namespace internal
+{
+
+ResultMergerImpl::ResultMergerImpl(SearchReplyProxy const& upstream,
+                                   string const& key,
+                                   ResultMerger::Policy policy,
+                                   size_t max_keys)
+    : upstream_(upstream)
+    , key_(key)
+    , policy_(policy)
+    , max_keys_(max_keys)
+    , duplicates_(0)
+{
+    if (!upstream)
+    {
+        throw InvalidArgumentException("ResultMerger(): upstream reply proxy cannot be nullptr");
+    }
+    if (key.empty())
+    {
+        throw InvalidArgumentException("ResultMerger(): key cannot be empty");
+    }
+    if (max_keys == 0)
+    {
+        throw InvalidArgumentException("ResultMerger(): max_keys must be greater than zero");
+    }
+}
+
+SearchReplyProxy ResultMergerImpl::upstream() const
+{
+    return upstream_;
+}
+
+SearchReplyProxy ResultMergerImpl::child_reply()
+{
+    size_t rank;
+    {
+        lock_guard<mutex> lock(mutex_);
+        rank = finished_.size();
+        finished_.push_back(false);
+    }
+    return make_shared<ChildMergeReply>(shared_from_this(), rank);
+}
+
+// Duplicates are detected and dropped here, before the result is handed to the upstream
+// proxy, so we never pay for serializing or sending a duplicate.
+
+bool ResultMergerImpl::push(size_t rank, CategorisedResult const& result)
+{
+    if (!result.contains(key_))
+    {
+        return push_upstream(rank, result);  // No key, so it can't be a duplicate.
+    }
+
+    Variant const& v = result.value(key_);
+    string const k = v.which() == Variant::String ? v.get_string() : v.serialize_json();
+
+    unique_ptr<CategorisedResult> to_push;
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        auto it = seen_.find(k);
+        if (it == seen_.end())
+        {
+            if (seen_.size() >= max_keys_)
+            {
+                // Memory bound reached, we no longer track new keys.
+                to_push.reset(new CategorisedResult(result));
+            }
+            else if (policy_ == ResultMerger::Policy::FirstWins || can_push(rank))
+            {
+                seen_.emplace(k, Entry{ rank, false, nullptr });
+                to_push.reset(new CategorisedResult(result));
+            }
+            else
+            {
+                // A child with higher priority may still produce a duplicate, so we hang on to this one.
+                seen_.emplace(k, Entry{ rank, true, unique_ptr<CategorisedResult>(new CategorisedResult(result)) });
+                pending_order_.push_back(k);
+            }
+        }
+        else
+        {
+            ++duplicates_;
+            Entry& e = it->second;
+            if (policy_ == ResultMerger::Policy::FirstWins)
+            {
+                return true;
+            }
+            if (e.pending && rank < e.rank)
+            {
+                // The new result comes from a child with higher priority and replaces the pending one.
+                unique_ptr<CategorisedResult> r(new CategorisedResult(result));
+                if (policy_ == ResultMerger::Policy::CombineAttributes)
+                {
+                    combine(*r, *e.result);
+                }
+                e.rank = rank;
+                if (can_push(rank))
+                {
+                    e.pending = false;
+                    e.result.reset();
+                    to_push = move(r);
+                }
+                else
+                {
+                    e.result = move(r);
+                }
+            }
+            else if (e.pending && policy_ == ResultMerger::Policy::CombineAttributes)
+            {
+                combine(*e.result, result);
+            }
+        }
+    }
+
+    return to_push ? push_upstream(rank, *to_push) : true;
+}
+
+void ResultMergerImpl::child_finished(size_t rank)
+{
+    vector<pair<size_t, CategorisedResult>> results;
+    {
+        lock_guard<mutex> lock(mutex_);
+        assert(rank < finished_.size());
+        if (finished_[rank])
+        {
+            return;
+        }
+        finished_[rank] = true;
+        results = release_pending(false);
+    }
+    for (auto const& r : results)
+    {
+        push_upstream(r.first, r.second);
+    }
+}
+
+void ResultMergerImpl::flush()
+{
+    vector<pair<size_t, CategorisedResult>> results;
+    {
+        lock_guard<mutex> lock(mutex_);
+        results = release_pending(true);
+    }
+    for (auto const& r : results)
+    {
+        push_upstream(r.first, r.second);
+    }
+}
+
+int ResultMergerImpl::duplicates() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return duplicates_;
+}
+
+void ResultMergerImpl::set_output_filter(OutputFilter const& filter)
+{
+    lock_guard<mutex> lock(mutex_);
+    filter_ = filter;
+}
+
+// Passes a result that survived de-duplication upstream, unless the output filter drops it.
+// Must be called without mutex_ locked, because both the filter and the upstream proxy can block.
+
+bool ResultMergerImpl::push_upstream(size_t rank, CategorisedResult const& result)
+{
+    OutputFilter filter;
+    {
+        lock_guard<mutex> lock(mutex_);
+        filter = filter_;
+    }
+    if (filter && !filter(rank))
+    {
+        return true;
+    }
+    return upstream_->push(result);
+}
+
+// A result from the child with the given rank can be pushed once all children
+// with higher priority (lower rank) have finished.
+
+bool ResultMergerImpl::can_push(size_t rank) const
+{
+    for (size_t i = 0; i < rank && i < finished_.size(); ++i)
+    {
+        if (!finished_[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the pending results that can be pushed now, in the order in which they arrived.
+// Must be called with mutex_ locked.
+
+vector<pair<size_t, CategorisedResult>> ResultMergerImpl::release_pending(bool all)
+{
+    vector<pair<size_t, CategorisedResult>> results;
+    vector<string> still_pending;
+    for (auto const& k : pending_order_)
+    {
+        auto it = seen_.find(k);
+        assert(it != seen_.end());
+        Entry& e = it->second;
+        if (!e.pending)
+        {
+            continue;  // Was replaced by a result that has been pushed already.
+        }
+        if (all || can_push(e.rank))
+        {
+            results.emplace_back(e.rank, move(*e.result));
+            e.result.reset();
+            e.pending = false;
+        }
+        else
+        {
+            still_pending.push_back(k);
+        }
+    }
+    pending_order_.swap(still_pending);
+    return results;
+}
+
+// Copy those attributes of source that are not present in target.
+
+void ResultMergerImpl::combine(CategorisedResult& target, CategorisedResult const& source)
+{
+    auto const attrs = source.serialize()["attrs"].get_dict();
+    for (auto const& attr : attrs)
+    {
+        if (!target.contains(attr.first))
+        {
+            target[attr.first] = attr.second;
+        }
+    }
+}
+
+ChildMergeReply::ChildMergeReply(shared_ptr<ResultMergerImpl> const& merger, size_t rank)
+    : SearchReply()
+    , merger_(merger)
+    , upstream_(merger->upstream())
+    , rank_(rank)
+{
+}
+
+shared_ptr<ResultMergerImpl> ChildMergeReply::merger() const
+{
+    return merger_;
+}
+
+size_t ChildMergeReply::rank() const
+{
+    return rank_;
+}
+
+void ChildMergeReply::register_departments(Department::SCPtr const& parent)
+{
+    upstream_->register_departments(parent);
+}
+
+Category::SCPtr ChildMergeReply::register_category(string const& id,
+                                                   string const& title,
+                                                   string const &icon,
+                                                   CategoryRenderer const& renderer_template)
+{
+    return upstream_->register_category(id, title, icon, renderer_template);
+}
+
+Category::SCPtr ChildMergeReply::register_category(string const& id,
+                                                   string const& title,
+                                                   string const &icon,
+                                                   CannedQuery const &query,
+                                                   CategoryRenderer const& renderer_template)
+{
+    return upstream_->register_category(id, title, icon, query, renderer_template);
+}
+
+void ChildMergeReply::register_category(Category::SCPtr category)
+{
+    upstream_->register_category(category);
+}
+
+Category::SCPtr ChildMergeReply::lookup_category(string const& id)
+{
+    return upstream_->lookup_category(id);
+}
+
+bool ChildMergeReply::push(unity::scopes::experimental::Annotation const& annotation)
+{
+    return upstream_->push(annotation);
+}
+
+bool ChildMergeReply::push(unity::scopes::CategorisedResult const& result)
+{
+    return merger_->push(rank_, result);
+}
+
+bool ChildMergeReply::push(unity::scopes::Filters const& filters, unity::scopes::FilterState const& filter_state)
+{
+    return upstream_->push(filters, filter_state);
+}
+
+bool ChildMergeReply::push(unity::scopes::Filters const& filters)
+{
+    return upstream_->push(filters);
+}
+
+void ChildMergeReply::push_surfacing_results_from_cache() noexcept
+{
+    upstream_->push_surfacing_results_from_cache();
+}
+
+// finished() and error() complete only this child, not the upstream query.
+
+void ChildMergeReply::finished()
+{
+    merger_->child_finished(rank_);
+}
+
+void ChildMergeReply::error(std::exception_ptr)
+{
+    merger_->child_finished(rank_);
+}
+
+void ChildMergeReply::info(OperationInfo const& op_info)
+{
+    upstream_->info(op_info);
+}
+
+string ChildMergeReply::endpoint()
+{
+    return upstream_->endpoint();
+}
+
+string ChildMergeReply::identity()
+{
+    return upstream_->identity();
+}
+
+string ChildMergeReply::target_category()
+{
+    return upstream_->target_category();
+}
+
+int64_t ChildMergeReply::timeout()
+{
+    return upstream_->timeout();
+}
+
+string ChildMergeReply::to_string()
+{
+    return upstream_->to_string();
+}
+
+} // namespace internal
+
+} // namespace utility
+
+} // namespace scopes
+
+} // namespace unity
@@ -23,10 +23,20 @@
 
 #include <unity/scopes/CannedQuery.h>
 #include <unity/scopes/internal/CannedQueryImpl.h>
+#include <unity/scopes/internal/FilterStateImpl.h>
+#include <unity/scopes/internal/JsonCppNode.h>
+#include <unity/scopes/internal/Utils.h>
 #include <unity/scopes/OptionSelectorFilter.h>
 #include <unity/scopes/FilterState.h>
 #include <unity/UnityExceptions.h>
 
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace std;
 using namespace unity::scopes;
 using namespace unity::scopes::internal;
 
@@ -383,3 +393,160 @@ TEST(CannedQuery, exceptions)
         EXPECT_THROW(q.user_data(), unity::LogicException);
     }
 }
+
+TEST(CannedQuery, uri_cache)
+{
+    CannedQuery q("scope-A");
+    q.set_query_string("foo");
+    EXPECT_EQ("scope://scope-A?q=foo", q.to_uri());
+
+    CannedQuery copy(q);
+    EXPECT_EQ("scope://scope-A?q=foo", copy.to_uri());
+
+    // Each setter must invalidate the cached URI.
+    q.set_query_string("bar");
+    EXPECT_EQ("scope://scope-A?q=bar", q.to_uri());
+    q.set_department_id("d");
+    EXPECT_EQ("scope://scope-A?q=bar&dep=d", q.to_uri());
+    q.set_user_data(Variant(1));
+    EXPECT_EQ("scope://scope-A?q=bar&dep=d&data=1%0A", q.to_uri());
+    FilterState fstate;
+    {
+        auto filter = OptionSelectorFilter::create("f1", "Choose an option", false);
+        auto option1 = filter->add_option("o1", "Option 1");
+        filter->update_state(fstate, option1, true);
+    }
+    q.set_filter_state(fstate);
+    EXPECT_EQ("scope://scope-A?q=bar&dep=d&filters=%7B%22f1%22%3A%5B%22o1%22%5D%7D%0A&data=1%0A", q.to_uri());
+
+    copy = q;
+    EXPECT_EQ(q.to_uri(), copy.to_uri());
+    EXPECT_EQ("scope://scope-A?q=foo", CannedQuery(CannedQuery::from_uri("scope://scope-A?q=foo")).to_uri());
+}
+
+namespace
+{
+
+// The implementation before the URI codec was rewritten, for comparison.
+
+string legacy_percent_encoding(string const& str)
+{
+    ostringstream result;
+    for (auto const& c: str)
+    {
+        if ((!isalnum(c)))
+        {
+            result << '%' << setw(2) << setfill('0') << hex << uppercase << static_cast<int>(static_cast<unsigned char>(c)) << nouppercase;
+        }
+        else
+        {
+            result << c;
+        }
+    }
+    return result.str();
+}
+
+string legacy_to_uri(CannedQuery const& q)
+{
+    ostringstream s;
+    s << CannedQueryImpl::scopes_schema << q.scope_id();
+    s << "?q=" << legacy_percent_encoding(q.query_string());
+    if (!q.department_id().empty())
+    {
+        s << "&dep=" << legacy_percent_encoding(q.department_id());
+    }
+    auto filters_var = q.filter_state().serialize();
+    if (filters_var.size())
+    {
+        JsonCppNode const jstr{Variant(filters_var)};
+        s << "&filters=" << legacy_percent_encoding(jstr.to_json_string());
+    }
+    if (q.has_user_data())
+    {
+        JsonCppNode const jstr(q.user_data());
+        s << "&data=" << legacy_percent_encoding(jstr.to_json_string());
+    }
+    return s.str();
+}
+
+CannedQuery legacy_from_uri(string const& uri)
+{
+    size_t pos = CannedQueryImpl::scopes_schema.length();
+    size_t next = uri.find("?", pos);
+    CannedQuery q(from_percent_encoding(uri.substr(pos, next - pos)));
+    string kv;
+    istringstream istr(uri.substr(next + 1));
+    while (getline(istr, kv, '&'))
+    {
+        auto eqpos = kv.find("=");
+        string const key = kv.substr(0, eqpos);
+        string const val = kv.substr(eqpos + 1);
+        if (key == "q")
+        {
+            q.set_query_string(from_percent_encoding(val));
+        }
+        else if (key == "dep")
+        {
+            q.set_department_id(from_percent_encoding(val));
+        }
+        else if (key == "filters")
+        {
+            JsonCppNode const node(from_percent_encoding(val));
+            q.set_filter_state(FilterStateImpl::deserialize(node.to_variant().get_dict()));
+        }
+        else if (key == "data")
+        {
+            JsonCppNode const node(from_percent_encoding(val));
+            q.set_user_data(node.to_variant());
+        }
+    }
+    return q;
+}
+
+template<typename F>
+double time_it(int iterations, F f)
+{
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        f();
+    }
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+TEST(CannedQuery, benchmark)
+{
+    CannedQuery q("com.canonical.scopes.aggregator");
+    q.set_query_string("search for \"something\" ünïcödé");
+    q.set_department_id("news/top-stories");
+    q.set_user_data(Variant(VariantMap{ { "page", Variant(2) }, { "sort", Variant("date") } }));
+    FilterState fstate;
+    {
+        auto filter = OptionSelectorFilter::create("f1", "Choose an option", false);
+        auto option1 = filter->add_option("o1", "Option 1");
+        filter->update_state(fstate, option1, true);
+    }
+    q.set_filter_state(fstate);
+
+    int const iterations = 5000;
+    vector<CannedQuery> fresh(iterations, q);  // Copied before to_uri() was called, so nothing is cached yet.
+
+    string const uri = q.to_uri();
+    ASSERT_EQ(legacy_to_uri(q), uri);
+    ASSERT_EQ(uri, legacy_from_uri(uri).to_uri());
+    ASSERT_EQ(uri, CannedQuery::from_uri(uri).to_uri());
+
+    int i = 0;
+    double legacy_write = time_it(iterations, [&]{ legacy_to_uri(q); });
+    double codec_write = time_it(iterations, [&]{ fresh[i++].to_uri(); });
+    double cached_write = time_it(iterations, [&]{ q.to_uri(); });
+    double legacy_read = time_it(iterations, [&]{ legacy_from_uri(uri); });
+    double codec_read = time_it(iterations, [&]{ CannedQuery::from_uri(uri); });
+
+    cout << "canned query (" << uri.size() << " bytes):" << endl
+         << "  to_uri:   legacy " << legacy_write << " us, codec " << codec_write
+         << " us, cached " << cached_write << " us" << endl
+         << "  from_uri: legacy " << legacy_read << " us, codec " << codec_read << " us" << endl;
+}
@@ -229,6 +229,97 @@ TEST(CategorisedResult, copy)
         EXPECT_EQ("xyz", copy2.serialize()["attrs"].get_dict()["foo"].get_string());
         EXPECT_EQ("1", copy2.category()->id());
     }
+
+    // writes via a reference obtained before the copy must not show up in the copy
+    {
+        CategorisedResult result(cat);
+        result.set_uri("uri a");
+        result["foo"] = 1;
+
+        Variant& ref = result["foo"];
+        CategorisedResult copy(result);
+        ref = Variant(2);
+
+        EXPECT_EQ(2, result["foo"].get_int());
+        EXPECT_EQ(1, copy["foo"].get_int());
+        EXPECT_FALSE(result == copy);
+
+        CategorisedResult copy2 = copy;
+        EXPECT_TRUE(copy == copy2);
+        copy2.set_title("title b");
+        EXPECT_EQ("", copy.title());
+        EXPECT_FALSE(copy.contains("title"));
+        EXPECT_FALSE(copy == copy2);
+    }
+}
+
+// copies share their attributes until one of them is modified
+TEST(CategorisedResult, copy_on_write)
+{
+    CategoryRegistry reg;
+    CategoryRenderer rdr;
+    auto cat = reg.register_category("1", "title", "icon", nullptr, rdr);
+
+    // copy, then write to either result
+    {
+        CategorisedResult result(cat);
+        result.set_uri("uri a");
+        result.set_title("title a");
+
+        CategorisedResult copy(result);
+        copy.set_title("title b");
+        EXPECT_EQ("title a", result.title());
+        EXPECT_EQ("title b", copy.title());
+
+        CategorisedResult copy2(result);
+        result.set_art("icon a");
+        EXPECT_EQ("icon a", result.art());
+        EXPECT_FALSE(copy2.contains("art"));
+        EXPECT_EQ("uri a", copy2.uri());
+        EXPECT_EQ("title a", copy2.title());
+
+        // writing via operator[] unshares too
+        CategorisedResult copy3(result);
+        copy3["foo"] = "bar";
+        EXPECT_FALSE(result.contains("foo"));
+        EXPECT_EQ("bar", copy3.value("foo").get_string());
+    }
+
+    // operator[] reference, then copy
+    {
+        CategorisedResult result(cat);
+        result.set_uri("uri a");
+        Variant& ref = result["foo"];
+        ref = "bar";
+
+        CategorisedResult copy(result);
+        ref = "baz";
+        EXPECT_EQ("baz", result.value("foo").get_string());
+        EXPECT_EQ("bar", copy.value("foo").get_string());
+
+        // the copy doesn't inherit the reference, so its own copies share again
+        CategorisedResult copy2(copy);
+        EXPECT_TRUE(copy == copy2);
+        copy.set_uri("uri b");
+        EXPECT_EQ("uri a", copy2.uri());
+        EXPECT_EQ("bar", copy2.value("foo").get_string());
+    }
+
+    // assignment from a result that handed out a reference
+    {
+        CategorisedResult result(cat);
+        result.set_uri("uri a");
+        Variant& ref = result["foo"];
+        ref = 1;
+
+        CategorisedResult other(cat);
+        other.set_uri("uri b");
+        other = result;
+        ref = 2;
+        EXPECT_EQ(2, result.value("foo").get_int());
+        EXPECT_EQ(1, other.value("foo").get_int());
+        EXPECT_EQ("uri a", other.uri());
+    }
 }
 
 // test conversion to VariantMap
@@ -17,6 +17,9 @@
  */
 
 #include <unity/scopes/CategoryRenderer.h>
+#include <unity/scopes/internal/CategoryImpl.h>
+#include <unity/scopes/internal/CategoryRendererImpl.h>
+#include <unity/scopes/ScopeExceptions.h>
 #include <unity/UnityExceptions.h>
 #include <fstream>
 
@@ -77,3 +80,79 @@ TEST(CategoryRenderer, exceptions)
         FAIL();
     }
 }
+
+TEST(CategoryRenderer, interning)
+{
+    std::string const json = R"({"schema-version":1,"template":{"category-layout":"carousel"},"components":{"title":"title"}})";
+    CategoryRenderer rdr(json);
+    auto const hash = CategoryRendererImpl::hash(rdr);
+    EXPECT_EQ(16u, hash.size());
+    EXPECT_EQ(hash, CategoryRendererImpl::hash(CategoryRenderer(json)));
+    EXPECT_NE(hash, CategoryRendererImpl::hash(CategoryRenderer()));
+
+    EXPECT_EQ(json, CategoryRendererImpl::from_hash(hash).data());
+    EXPECT_THROW(CategoryRendererImpl::from_hash("0000000000000000"), unity::scopes::NotFoundException);
+
+    // Invalid templates are not interned.
+    EXPECT_THROW(CategoryRenderer("{"), unity::InvalidArgumentException);
+    EXPECT_THROW(CategoryRenderer("{"), unity::InvalidArgumentException);
+}
+
+TEST(CategoryRenderer, received_templates)
+{
+    CategoryRenderer rdr(R"({"template":{"category-layout":"grid"}})");
+    auto const hash = CategoryRendererImpl::hash(rdr);
+
+    EXPECT_TRUE(CategoryRendererImpl::received_templates("scope-a").empty());
+    CategoryRendererImpl::note_received("scope-a", rdr);
+    CategoryRendererImpl::note_received("scope-a", rdr);
+    auto templates = CategoryRendererImpl::received_templates("scope-a");
+    ASSERT_EQ(1u, templates.size());
+    EXPECT_EQ(hash, templates.begin()->first);
+    EXPECT_EQ(rdr.data(), *templates.begin()->second);
+    EXPECT_TRUE(CategoryRendererImpl::received_templates("scope-b").empty());
+
+    // A category that carries only the hash is deserialized with the full template.
+    VariantMap var;
+    var["id"] = "cat1";
+    var["renderer_hash"] = hash;
+    CategoryImpl cat(var);
+    EXPECT_EQ(rdr.data(), cat.renderer_template().data());
+
+    var["renderer_hash"] = "ffffffffffffffff";
+    EXPECT_THROW(CategoryImpl c(var), unity::scopes::NotFoundException);
+}
+
+TEST(CategoryRenderer, eviction)
+{
+    CategoryRenderer old_rdr(R"({"template":{"category-layout":"carousel"}})");
+    auto const old_hash = CategoryRendererImpl::hash(old_rdr);
+    CategoryRenderer used_rdr(R"({"template":{"category-layout":"journal"}})");
+    auto const used_hash = CategoryRendererImpl::hash(used_rdr);
+    CategoryRendererImpl::note_received("scope-c", old_rdr);
+    CategoryRendererImpl::note_received("scope-c", used_rdr);
+    EXPECT_EQ(2u, CategoryRendererImpl::received_templates("scope-c").size());
+
+    // Fill the cache with new templates, using used_rdr every now and then.
+    for (int i = 0; i < 2000; ++i)
+    {
+        CategoryRenderer rdr(R"({"template":{"card-size":)" + std::to_string(i) + "}}");
+        if (i % 100 == 0)
+        {
+            CategoryRendererImpl::from_hash(used_hash);
+        }
+    }
+
+    // The least recently used template is gone, and the client no longer advertises its hash.
+    EXPECT_THROW(CategoryRendererImpl::from_hash(old_hash), unity::scopes::NotFoundException);
+    auto templates = CategoryRendererImpl::received_templates("scope-c");
+    ASSERT_EQ(1u, templates.size());
+    EXPECT_EQ(used_hash, templates.begin()->first);
+    EXPECT_EQ(used_rdr.data(), CategoryRendererImpl::from_hash(used_hash).data());
+
+    // Renderers that hold an evicted template remain usable, but are not recorded
+    // as received because we could not resolve their hash later.
+    EXPECT_EQ(R"({"template":{"category-layout":"carousel"}})", old_rdr.data());
+    CategoryRendererImpl::note_received("scope-c", old_rdr);
+    EXPECT_EQ(1u, CategoryRendererImpl::received_templates("scope-c").size());
+}
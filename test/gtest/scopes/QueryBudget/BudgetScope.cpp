@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BudgetScope.h"
+
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/PreviewReply.h>
+#include <unity/scopes/SearchReply.h>
+
+using namespace std;
+using namespace unity::scopes;
+
+namespace
+{
+
+class BudgetQuery : public SearchQueryBase
+{
+public:
+    BudgetQuery(CannedQuery const& query, SearchMetadata const& metadata)
+        : SearchQueryBase(query, metadata)
+    {
+    }
+
+    virtual void cancelled() override
+    {
+    }
+
+    virtual void run(SearchReplyProxy const& reply) override
+    {
+        auto location = settings()["locationSetting"].get_string();
+
+        auto cat = reply->register_category("cat1", "Category 1", "");
+        for (int i = 0; i < BudgetScope::num_results; ++i)
+        {
+            CategorisedResult res(cat);
+            res.set_uri("uri" + to_string(i));
+            res.set_title("title " + to_string(i) + " for " + query().query_string());
+            res.set_art("art");
+            res.set_dnd_uri("dnd_uri");
+            res["location"] = location;
+            if (!reply->push(res))
+            {
+                break;
+            }
+        }
+    }
+};
+
+class BudgetPreview : public PreviewQueryBase
+{
+public:
+    BudgetPreview(Result const& result, ActionMetadata const& metadata)
+        : PreviewQueryBase(result, metadata)
+    {
+    }
+
+    virtual void cancelled() override
+    {
+    }
+
+    virtual void run(PreviewReplyProxy const& reply) override
+    {
+        PreviewWidgetList widgets;
+        widgets.emplace_back(PreviewWidget(R"({"id": "header", "type": "header", "title": "title"})"));
+        widgets.emplace_back(PreviewWidget(R"({"id": "id", "type": "image", "art": "screenshot-url"})"));
+        reply->push(widgets);
+        reply->push("title", Variant(result().title()));
+    }
+};
+
+} // namespace
+
+SearchQueryBase::UPtr BudgetScope::search(CannedQuery const& query, SearchMetadata const& metadata)
+{
+    return SearchQueryBase::UPtr(new BudgetQuery(query, metadata));
+}
+
+PreviewQueryBase::UPtr BudgetScope::preview(Result const& result, ActionMetadata const& metadata)
+{
+    return PreviewQueryBase::UPtr(new BudgetPreview(result, metadata));
+}
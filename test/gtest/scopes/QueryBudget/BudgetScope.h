@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unity/scopes/ScopeBase.h>
+
+// A scope that does what a typical scope does for each query: it reads its settings
+// and pushes a handful of results, or a few preview widgets.
+
+class BudgetScope : public unity::scopes::ScopeBase
+{
+public:
+    static int const num_results = 10;
+
+    virtual unity::scopes::SearchQueryBase::UPtr search(unity::scopes::CannedQuery const& query,
+                                                        unity::scopes::SearchMetadata const& metadata) override;
+    virtual unity::scopes::PreviewQueryBase::UPtr preview(unity::scopes::Result const& result,
+                                                          unity::scopes::ActionMetadata const& metadata) override;
+};
@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Call counter library for the query budget test. See CallCounter.h.
+//
+// We deliberately avoid the system headers that declare the functions we
+// intercept (other than <fcntl.h>, whose declarations match ours), so the
+// definitions below do not clash with the exception specifications and
+// redirections in those headers.
+
+#include "CallCounter.h"
+
+#include <cstdarg>
+#include <cstddef>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+using namespace callcounter;
+
+namespace
+{
+
+Counts counts;  // Zero-initialized before any code runs, so allocations during startup are safe to count.
+
+inline void count(Call c)
+{
+    counts.calls[c].fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void count_allocation(size_t size)
+{
+    counts.allocations.fetch_add(1, std::memory_order_relaxed);
+    counts.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// Looks up the next definition of the function we are interposing on.
+#define NEXT(fn) \
+    static auto const next_##fn = reinterpret_cast<decltype(&fn)>(dlsym(RTLD_NEXT, #fn))
+
+struct stat;
+struct stat64;
+struct statx;
+struct msghdr;
+struct sockaddr;
+struct pollfd;
+struct timespec;
+struct timeval;
+struct epoll_event;
+struct iovec;
+struct _IO_FILE;
+
+extern "C"
+{
+
+callcounter::Counts* callcounter_counts()
+{
+    return &counts;
+}
+
+// Heap allocator. glibc exports its allocator under the __libc_ names, so we do
+// not need dlsym() (which itself allocates) to find it.
+
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void __libc_free(void*);
+
+void* malloc(size_t size)
+{
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    count_allocation(n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size)
+{
+    count_allocation(size);
+    return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size)
+{
+    count_allocation(size);
+    *p = __libc_memalign(alignment, size);
+    return *p ? 0 : 12;  // ENOMEM
+}
+
+void free(void* p)
+{
+    __libc_free(p);
+}
+
+// Files
+
+int open(char const* path, int flags, ...)
+{
+    NEXT(open);
+    count(Open);
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = va_arg(ap, mode_t);
+    va_end(ap);
+    return next_open(path, flags, mode);
+}
+
+int open64(char const* path, int flags, ...)
+{
+    NEXT(open64);
+    count(Open);
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = va_arg(ap, mode_t);
+    va_end(ap);
+    return next_open64(path, flags, mode);
+}
+
+int openat(int dirfd, char const* path, int flags, ...)
+{
+    NEXT(openat);
+    count(Open);
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = va_arg(ap, mode_t);
+    va_end(ap);
+    return next_openat(dirfd, path, flags, mode);
+}
+
+int creat(char const* path, mode_t mode)
+{
+    NEXT(creat);
+    count(Open);
+    return next_creat(path, mode);
+}
+
+_IO_FILE* fopen(char const* path, char const* mode)
+{
+    NEXT(fopen);
+    count(Open);
+    return next_fopen(path, mode);
+}
+
+_IO_FILE* fopen64(char const* path, char const* mode)
+{
+    NEXT(fopen64);
+    count(Open);
+    return next_fopen64(path, mode);
+}
+
+int close(int fd)
+{
+    NEXT(close);
+    count(Close);
+    return next_close(fd);
+}
+
+int fclose(_IO_FILE* f)
+{
+    NEXT(fclose);
+    count(Close);
+    return next_fclose(f);
+}
+
+// Since glibc 2.33, stat() and friends are real symbols. Older versions
+// implement them as wrappers around the __xstat() family.
+
+int stat(char const* path, struct stat* buf)
+{
+    NEXT(stat);
+    count(Stat);
+    return next_stat(path, buf);
+}
+
+int stat64(char const* path, struct stat64* buf)
+{
+    NEXT(stat64);
+    count(Stat);
+    return next_stat64(path, buf);
+}
+
+int lstat(char const* path, struct stat* buf)
+{
+    NEXT(lstat);
+    count(Stat);
+    return next_lstat(path, buf);
+}
+
+int fstat(int fd, struct stat* buf)
+{
+    NEXT(fstat);
+    count(Stat);
+    return next_fstat(fd, buf);
+}
+
+int fstat64(int fd, struct stat64* buf)
+{
+    NEXT(fstat64);
+    count(Stat);
+    return next_fstat64(fd, buf);
+}
+
+int fstatat(int dirfd, char const* path, struct stat* buf, int flags)
+{
+    NEXT(fstatat);
+    count(Stat);
+    return next_fstatat(dirfd, path, buf, flags);
+}
+
+int statx(int dirfd, char const* path, int flags, unsigned int mask, struct statx* buf)
+{
+    NEXT(statx);
+    count(Stat);
+    return next_statx(dirfd, path, flags, mask, buf);
+}
+
+int __xstat(int ver, char const* path, struct stat* buf)
+{
+    NEXT(__xstat);
+    count(Stat);
+    return next___xstat(ver, path, buf);
+}
+
+int __xstat64(int ver, char const* path, struct stat64* buf)
+{
+    NEXT(__xstat64);
+    count(Stat);
+    return next___xstat64(ver, path, buf);
+}
+
+int __lxstat(int ver, char const* path, struct stat* buf)
+{
+    NEXT(__lxstat);
+    count(Stat);
+    return next___lxstat(ver, path, buf);
+}
+
+int __fxstat(int ver, int fd, struct stat* buf)
+{
+    NEXT(__fxstat);
+    count(Stat);
+    return next___fxstat(ver, fd, buf);
+}
+
+int __fxstat64(int ver, int fd, struct stat64* buf)
+{
+    NEXT(__fxstat64);
+    count(Stat);
+    return next___fxstat64(ver, fd, buf);
+}
+
+int access(char const* path, int mode)
+{
+    NEXT(access);
+    count(Stat);
+    return next_access(path, mode);
+}
+
+int mkdir(char const* path, mode_t mode)
+{
+    NEXT(mkdir);
+    count(FsOp);
+    return next_mkdir(path, mode);
+}
+
+int unlink(char const* path)
+{
+    NEXT(unlink);
+    count(FsOp);
+    return next_unlink(path);
+}
+
+int rename(char const* from, char const* to)
+{
+    NEXT(rename);
+    count(FsOp);
+    return next_rename(from, to);
+}
+
+int ftruncate(int fd, off_t length)
+{
+    NEXT(ftruncate);
+    count(FsOp);
+    return next_ftruncate(fd, length);
+}
+
+int fsync(int fd)
+{
+    NEXT(fsync);
+    count(FsOp);
+    return next_fsync(fd);
+}
+
+int fdatasync(int fd)
+{
+    NEXT(fdatasync);
+    count(FsOp);
+    return next_fdatasync(fd);
+}
+
+int flock(int fd, int operation)
+{
+    NEXT(flock);
+    count(Lock);
+    return next_flock(fd, operation);
+}
+
+int fcntl(int fd, int cmd, ...)
+{
+    NEXT(fcntl);
+    count(Lock);
+    va_list ap;
+    va_start(ap, cmd);
+    void* arg = va_arg(ap, void*);
+    va_end(ap);
+    return next_fcntl(fd, cmd, arg);
+}
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+    NEXT(read);
+    ::count(Read);
+    return next_read(fd, buf, count);
+}
+
+ssize_t readv(int fd, struct iovec const* iov, int iovcnt)
+{
+    NEXT(readv);
+    count(Read);
+    return next_readv(fd, iov, iovcnt);
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset)
+{
+    NEXT(pread);
+    ::count(Read);
+    return next_pread(fd, buf, count, offset);
+}
+
+ssize_t write(int fd, void const* buf, size_t count)
+{
+    NEXT(write);
+    ::count(Write);
+    return next_write(fd, buf, count);
+}
+
+ssize_t writev(int fd, struct iovec const* iov, int iovcnt)
+{
+    NEXT(writev);
+    count(Write);
+    return next_writev(fd, iov, iovcnt);
+}
+
+ssize_t pwrite(int fd, void const* buf, size_t count, off_t offset)
+{
+    NEXT(pwrite);
+    ::count(Write);
+    return next_pwrite(fd, buf, count, offset);
+}
+
+// Sockets and descriptors
+
+int socket(int domain, int type, int protocol)
+{
+    NEXT(socket);
+    count(Socket);
+    return next_socket(domain, type, protocol);
+}
+
+int bind(int fd, struct sockaddr const* addr, unsigned int len)
+{
+    NEXT(bind);
+    count(Socket);
+    return next_bind(fd, addr, len);
+}
+
+int connect(int fd, struct sockaddr const* addr, unsigned int len)
+{
+    NEXT(connect);
+    count(Socket);
+    return next_connect(fd, addr, len);
+}
+
+int accept(int fd, struct sockaddr* addr, unsigned int* len)
+{
+    NEXT(accept);
+    count(Socket);
+    return next_accept(fd, addr, len);
+}
+
+int accept4(int fd, struct sockaddr* addr, unsigned int* len, int flags)
+{
+    NEXT(accept4);
+    count(Socket);
+    return next_accept4(fd, addr, len, flags);
+}
+
+int pipe(int fds[2])
+{
+    NEXT(pipe);
+    count(Socket);
+    return next_pipe(fds);
+}
+
+int pipe2(int fds[2], int flags)
+{
+    NEXT(pipe2);
+    count(Socket);
+    return next_pipe2(fds, flags);
+}
+
+int eventfd(unsigned int initval, int flags)
+{
+    NEXT(eventfd);
+    count(Socket);
+    return next_eventfd(initval, flags);
+}
+
+ssize_t send(int fd, void const* buf, size_t len, int flags)
+{
+    NEXT(send);
+    count(Send);
+    return next_send(fd, buf, len, flags);
+}
+
+ssize_t sendto(int fd, void const* buf, size_t len, int flags, struct sockaddr const* addr, unsigned int addr_len)
+{
+    NEXT(sendto);
+    count(Send);
+    return next_sendto(fd, buf, len, flags, addr, addr_len);
+}
+
+ssize_t sendmsg(int fd, struct msghdr const* msg, int flags)
+{
+    NEXT(sendmsg);
+    count(Send);
+    return next_sendmsg(fd, msg, flags);
+}
+
+ssize_t recv(int fd, void* buf, size_t len, int flags)
+{
+    NEXT(recv);
+    count(Recv);
+    return next_recv(fd, buf, len, flags);
+}
+
+ssize_t recvfrom(int fd, void* buf, size_t len, int flags, struct sockaddr* addr, unsigned int* addr_len)
+{
+    NEXT(recvfrom);
+    count(Recv);
+    return next_recvfrom(fd, buf, len, flags, addr, addr_len);
+}
+
+ssize_t recvmsg(int fd, struct msghdr* msg, int flags)
+{
+    NEXT(recvmsg);
+    count(Recv);
+    return next_recvmsg(fd, msg, flags);
+}
+
+int poll(struct pollfd* fds, unsigned long nfds, int timeout)
+{
+    NEXT(poll);
+    count(Poll);
+    return next_poll(fds, nfds, timeout);
+}
+
+int ppoll(struct pollfd* fds, unsigned long nfds, struct timespec const* timeout, void const* sigmask)
+{
+    NEXT(ppoll);
+    count(Poll);
+    return next_ppoll(fds, nfds, timeout, sigmask);
+}
+
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout)
+{
+    NEXT(select);
+    count(Poll);
+    return next_select(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout)
+{
+    NEXT(epoll_wait);
+    count(Poll);
+    return next_epoll_wait(epfd, events, maxevents, timeout);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+    NEXT(epoll_ctl);
+    count(Poll);
+    return next_epoll_ctl(epfd, op, fd, event);
+}
+
+} // extern "C"
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+
+// Counters maintained by the call counter library. When the library is preloaded
+// (LD_PRELOAD), it intercepts the libc entry points for system calls and the
+// heap allocator and counts every call, for all threads in the process.
+// Calls that libc makes internally (such as the open() underneath fopen())
+// do not go through these entry points, so they are counted where they enter libc.
+
+namespace callcounter
+{
+
+enum Call
+{
+    Open,    // open, openat, creat, fopen
+    Close,   // close, fclose
+    Stat,    // stat, lstat, fstat, fstatat, statx, access
+    FsOp,    // mkdir, unlink, rename, ftruncate, fsync, fdatasync
+    Lock,    // flock, fcntl
+    Read,    // read, readv, pread
+    Write,   // write, writev, pwrite
+    Socket,  // socket, bind, connect, accept, pipe, eventfd
+    Send,    // send, sendto, sendmsg
+    Recv,    // recv, recvfrom, recvmsg
+    Poll,    // poll, ppoll, select, epoll_wait, epoll_ctl
+    NumCalls
+};
+
+char const* const call_names[NumCalls] =
+{
+    "open", "close", "stat", "fsop", "lock", "read", "write", "socket", "send", "recv", "poll"
+};
+
+struct Counts
+{
+    std::atomic<unsigned long> calls[NumCalls];
+    std::atomic<unsigned long> allocations;     // malloc, calloc, realloc, memalign and friends
+    std::atomic<unsigned long> allocated_bytes;
+};
+
+} // namespace callcounter
+
+// Returns the counters. Look this up with dlsym(RTLD_DEFAULT, "callcounter_counts")
+// to find out whether the library is preloaded.
+
+extern "C" callcounter::Counts* callcounter_counts();
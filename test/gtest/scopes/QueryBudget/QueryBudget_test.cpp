@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Measures the system calls and heap allocations for a search, a surfacing search, a preview,
+// and an activation that run through the real middleware, with the scope and the client in the
+// same process. The counts are obtained by preloading the call counter library (see CallCounter.h);
+// if the test is not started with the library preloaded, it re-executes itself with LD_PRELOAD set.
+//
+// The per-operation counts are compared with the budgets in Budget.ini, so the test fails if the
+// cost of a query regresses. An operation without a budget fails as well, as does running without
+// the call counter library, so the checks cannot silently lapse.
+//
+// To record a new baseline (after an optimization, or on a new reference platform), run the test with
+// QUERY_BUDGET_RECORD=1. This writes the measured figures plus headroom to Budget.ini.recorded in the
+// build directory instead of checking them; copy that file over Budget.ini in the source tree.
+
+#include <unity/scopes/ActionMetadata.h>
+#include <unity/scopes/ActivationListenerBase.h>
+#include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/internal/RegistryObject.h>
+#include <unity/scopes/internal/RuntimeImpl.h>
+#include <unity/scopes/internal/ScopeImpl.h>
+#include <unity/scopes/PreviewListenerBase.h>
+#include <unity/scopes/QueryCtrl.h>
+#include <unity/scopes/Runtime.h>
+#include <unity/scopes/SearchListenerBase.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/util/IniParser.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include "BudgetScope.h"
+#include "CallCounter.h"
+
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+namespace
+{
+
+int const iterations = 20;
+
+// Time we give the run time to finish any work that trails the completion of an operation
+// (such as the scope side cleaning up after the reply has reached the client).
+chrono::milliseconds const settle_time(100);
+
+// Headroom added to the measured figures when recording a baseline, so that noise
+// (such as an extra poll() due to scheduling) does not fail the test.
+double const headroom = 1.2;
+
+string const recorded_budget_file = TEST_RUNTIME_PATH "/Budget.ini.recorded";
+
+bool recording()
+{
+    return getenv("QUERY_BUDGET_RECORD") != nullptr;
+}
+
+callcounter::Counts* counts()
+{
+    static auto const f = reinterpret_cast<decltype(&callcounter_counts)>(dlsym(RTLD_DEFAULT, "callcounter_counts"));
+    return f ? f() : nullptr;
+}
+
+struct Usage
+{
+    unsigned long calls[callcounter::NumCalls];
+    unsigned long allocations;
+    unsigned long allocated_bytes;
+
+    unsigned long syscalls() const
+    {
+        unsigned long total = 0;
+        for (auto c : calls)
+        {
+            total += c;
+        }
+        return total;
+    }
+};
+
+Usage current_usage()
+{
+    auto c = counts();
+    Usage u;
+    for (int i = 0; i < callcounter::NumCalls; ++i)
+    {
+        u.calls[i] = c->calls[i].load();
+    }
+    u.allocations = c->allocations.load();
+    u.allocated_bytes = c->allocated_bytes.load();
+    return u;
+}
+
+// Returns the average usage per operation between two snapshots.
+Usage per_operation(Usage const& before, Usage const& after, int ops)
+{
+    Usage u;
+    for (int i = 0; i < callcounter::NumCalls; ++i)
+    {
+        u.calls[i] = (after.calls[i] - before.calls[i]) / ops;
+    }
+    u.allocations = (after.allocations - before.allocations) / ops;
+    u.allocated_bytes = (after.allocated_bytes - before.allocated_bytes) / ops;
+    return u;
+}
+
+class Latch
+{
+public:
+    void signal()
+    {
+        lock_guard<mutex> lock(mutex_);
+        done_ = true;
+        cond_.notify_all();
+    }
+
+    void wait()
+    {
+        unique_lock<mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return done_; });
+    }
+
+private:
+    mutex mutex_;
+    condition_variable cond_;
+    bool done_ = false;
+};
+
+class SearchReceiver : public SearchListenerBase
+{
+public:
+    virtual void push(CategorisedResult result) override
+    {
+        lock_guard<mutex> lock(mutex_);
+        last_result_ = make_shared<Result>(move(result));
+    }
+
+    virtual void finished(CompletionDetails const& details) override
+    {
+        EXPECT_EQ(CompletionDetails::OK, details.status()) << details.message();
+        latch_.signal();
+    }
+
+    shared_ptr<Result> wait_until_finished()
+    {
+        latch_.wait();
+        lock_guard<mutex> lock(mutex_);
+        return last_result_;
+    }
+
+private:
+    Latch latch_;
+    mutex mutex_;
+    shared_ptr<Result> last_result_;
+};
+
+class PreviewReceiver : public PreviewListenerBase
+{
+public:
+    virtual void push(ColumnLayoutList const&) override
+    {
+    }
+
+    virtual void push(PreviewWidgetList const&) override
+    {
+    }
+
+    virtual void push(string const&, Variant const&) override
+    {
+    }
+
+    virtual void finished(CompletionDetails const& details) override
+    {
+        EXPECT_EQ(CompletionDetails::OK, details.status()) << details.message();
+        latch_.signal();
+    }
+
+    void wait_until_finished()
+    {
+        latch_.wait();
+    }
+
+private:
+    Latch latch_;
+};
+
+class ActivationReceiver : public ActivationListenerBase
+{
+public:
+    virtual void finished(CompletionDetails const& details) override
+    {
+        EXPECT_EQ(CompletionDetails::OK, details.status()) << details.message();
+        latch_.signal();
+    }
+
+    void wait_until_finished()
+    {
+        latch_.wait();
+    }
+
+private:
+    Latch latch_;
+};
+
+// Runs op once to warm up (connections, caches, lazy initialization), then iterations more times,
+// and checks the average cost of op against the budget in the given group of Budget.ini.
+
+void check_budget(string const& group, function<void()> const& op)
+{
+    op();
+    this_thread::sleep_for(settle_time);
+
+    auto before = current_usage();
+    for (int i = 0; i < iterations; ++i)
+    {
+        op();
+    }
+    this_thread::sleep_for(settle_time);
+    auto usage = per_operation(before, current_usage(), iterations);
+
+    ostringstream s;
+    s << group << ": " << usage.syscalls() << " system calls (";
+    for (int i = 0; i < callcounter::NumCalls; ++i)
+    {
+        s << (i == 0 ? "" : ", ") << callcounter::call_names[i] << " " << usage.calls[i];
+    }
+    s << "), " << usage.allocations << " allocations (" << usage.allocated_bytes << " bytes) per operation";
+    cerr << s.str() << endl;
+
+    if (recording())
+    {
+        ofstream f(recorded_budget_file, ios::app);
+        f << "\n[" << group << "]\n"
+          << "Syscalls = " << static_cast<unsigned long>(ceil(usage.syscalls() * headroom)) << "\n"
+          << "Allocations = " << static_cast<unsigned long>(ceil(usage.allocations * headroom)) << "\n";
+        EXPECT_TRUE(f.good()) << "cannot write " << recorded_budget_file;
+        return;
+    }
+
+    unity::util::IniParser budget(TEST_BUDGET_FILE);
+    ASSERT_TRUE(budget.has_group(group)) << "no budget for " << group << " in " << TEST_BUDGET_FILE
+                                         << " (run with QUERY_BUDGET_RECORD=1 to record one)";
+    EXPECT_LE(usage.syscalls(), static_cast<unsigned long>(budget.get_int(group, "Syscalls"))) << s.str();
+    EXPECT_LE(usage.allocations, static_cast<unsigned long>(budget.get_int(group, "Allocations"))) << s.str();
+}
+
+class QueryBudget : public ::testing::Test
+{
+protected:
+    virtual void SetUp() override
+    {
+        ASSERT_TRUE(counts() != nullptr) << "call counter library " << CALLCOUNTER_LIB << " is not loaded";
+        rt_ = RuntimeImpl::create("", TEST_RUNTIME_FILE);
+        auto mw = rt_->factory()->create("BudgetClient", "Zmq", TEST_RUNTIME_PATH "/Zmq.ini");
+        mw->start();
+        scope_ = ScopeImpl::create(mw->create_scope_proxy("BudgetScope"), "BudgetScope");
+    }
+
+    // Returns a result of the scope, for preview and activation.
+    Result get_result()
+    {
+        auto receiver = make_shared<SearchReceiver>();
+        scope_->search("test", SearchMetadata("en", "phone"), receiver);
+        auto result = receiver->wait_until_finished();
+        EXPECT_TRUE(result != nullptr);
+        return *result;
+    }
+
+    RuntimeImpl::UPtr rt_;
+    ScopeProxy scope_;
+};
+
+} // namespace
+
+TEST_F(QueryBudget, search)
+{
+    check_budget("Search", [this]
+    {
+        auto receiver = make_shared<SearchReceiver>();
+        scope_->search("test", SearchMetadata("en", "phone"), receiver);
+        receiver->wait_until_finished();
+    });
+}
+
+TEST_F(QueryBudget, surfacing_search)
+{
+    check_budget("Surfacing", [this]
+    {
+        auto receiver = make_shared<SearchReceiver>();
+        scope_->search("", SearchMetadata("en", "phone"), receiver);
+        receiver->wait_until_finished();
+    });
+}
+
+TEST_F(QueryBudget, preview)
+{
+    auto result = get_result();
+    check_budget("Preview", [this, &result]
+    {
+        auto receiver = make_shared<PreviewReceiver>();
+        scope_->preview(result, ActionMetadata("en", "phone"), receiver);
+        receiver->wait_until_finished();
+    });
+}
+
+TEST_F(QueryBudget, activation)
+{
+    auto result = get_result();
+    check_budget("Activation", [this, &result]
+    {
+        auto receiver = make_shared<ActivationReceiver>();
+        scope_->activate(result, ActionMetadata("en", "phone"), receiver);
+        receiver->wait_until_finished();
+    });
+}
+
+std::shared_ptr<core::posix::SignalTrap> trap(core::posix::trap_signals_for_all_subsequent_threads({core::posix::Signal::sig_chld}));
+std::unique_ptr<core::posix::ChildProcess::DeathObserver> death_observer(core::posix::ChildProcess::DeathObserver::create_once_with_signal_trap(trap));
+
+void scope_thread(Runtime::SPtr const& rt)
+{
+    BudgetScope scope;
+    rt->run_scope(&scope, TEST_RUNTIME_PATH "/BudgetScope.ini");
+}
+
+int main(int argc, char **argv)
+{
+    if (!counts() && !getenv("QUERY_BUDGET_REEXEC"))
+    {
+        // Run ourselves again, with the call counter library preloaded.
+        string preload = CALLCOUNTER_LIB;
+        if (auto old = getenv("LD_PRELOAD"))
+        {
+            preload += string(" ") + old;
+        }
+        setenv("LD_PRELOAD", preload.c_str(), 1);
+        setenv("QUERY_BUDGET_REEXEC", "1", 1);
+        execv("/proc/self/exe", argv);
+        cerr << "QueryBudget_test: cannot re-execute with " << CALLCOUNTER_LIB << " preloaded" << endl;
+    }
+    if (recording())
+    {
+        ofstream f(recorded_budget_file, ios::trunc);
+        f << "# Per-operation budgets for QueryBudget_test, recorded with " << headroom << " headroom.\n";
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+
+    auto reg_rt = RuntimeImpl::create("TestRegistry", TEST_RUNTIME_FILE);
+    auto reg_mw = reg_rt->factory()->create("TestRegistry", "Zmq", TEST_RUNTIME_PATH "/Zmq.ini");
+    auto reg_obj = make_shared<RegistryObject>(*death_observer, make_shared<Executor>(), reg_mw);
+    reg_mw->add_registry_object("TestRegistry", reg_obj);
+
+    Runtime::SPtr srt = move(Runtime::create_scope_runtime("BudgetScope", TEST_RUNTIME_FILE));
+    std::thread scope_t(scope_thread, srt);
+
+    // Give the scope some time to bind to its endpoint.
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    int rc = RUN_ALL_TESTS();
+
+    srt->destroy();
+    scope_t.join();
+
+    return rc;
+}
@@ -698,6 +698,78 @@ TEST(Registry, list_update_notify)
     EXPECT_EQ(list.end(), list.find("testscopeD"));
 }
 
+// A burst of installs, modifications, and removals must result in a single list update.
+
+TEST(Registry, list_update_coalesced)
+{
+    int updates = 0;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    Runtime::UPtr rt = Runtime::create(TEST_RUNTIME_FILE);
+    RegistryProxy r = rt->registry();
+
+    auto conn = r->set_list_update_callback([&updates, &mutex, &cond]
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++updates;
+        cond.notify_one();
+    });
+
+    auto wait_for_updates = [&updates, &mutex, &cond](int count)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return cond.wait_for(lock, wait_for_update_time, [&updates, count] { return updates >= count; });
+    };
+
+    system::error_code ec;
+
+    MetadataMap list = r->list();
+    EXPECT_EQ(2u, list.size());
+
+    // Install testscopeC and testscopeD, modify testscopeC, and remove testscopeD again,
+    // all well within the settle time of the scopes watcher.
+    std::cout << "Install, modify, and remove scopes in a burst" << std::endl;
+    filesystem::create_directory(TEST_RUNTIME_PATH "/scopes/testscopeC", ec);
+    ASSERT_EQ("Success", ec.message());
+    filesystem::copy(TEST_RUNTIME_PATH "/other_scopes/testscopeC/testscopeC.ini", TEST_RUNTIME_PATH "/scopes/testscopeC/testscopeC.ini", ec);
+    ASSERT_EQ("Success", ec.message());
+    filesystem::create_symlink(TEST_RUNTIME_PATH "/other_scopes/testscopeD", TEST_RUNTIME_PATH "/scopes/testscopeD", ec);
+    ASSERT_EQ("Success", ec.message());
+    {
+        std::ofstream ini(TEST_RUNTIME_PATH "/scopes/testscopeC/testscopeC.ini", std::ios::app);
+        ini << std::endl;
+        ASSERT_TRUE(ini.good());
+    }
+    filesystem::remove(TEST_RUNTIME_PATH "/scopes/testscopeD", ec);
+    ASSERT_EQ("Success", ec.message());
+
+    EXPECT_TRUE(wait_for_updates(1));
+
+    // The watcher flushes a batch at the latest ten settle times (5 seconds) after its
+    // first event. Wait a little longer to make sure that no further update arrives.
+    std::this_thread::sleep_for(std::chrono::seconds(6));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(1, updates);
+    }
+
+    list = r->list();
+    EXPECT_EQ(3u, list.size());
+    EXPECT_NE(list.end(), list.find("testscopeC"));
+    EXPECT_EQ(list.end(), list.find("testscopeD"));
+
+    // Removing testscopeC is another batch, with its own update.
+    std::cout << "Remove testscopeC from the scopes folder" << std::endl;
+    filesystem::remove_all(TEST_RUNTIME_PATH "/scopes/testscopeC", ec);
+    ASSERT_EQ("Success", ec.message());
+    EXPECT_TRUE(wait_for_updates(2));
+
+    list = r->list();
+    EXPECT_EQ(2u, list.size());
+    EXPECT_EQ(list.end(), list.find("testscopeC"));
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
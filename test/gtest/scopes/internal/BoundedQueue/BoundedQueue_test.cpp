@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/BoundedQueue.h>
+#include <unity/scopes/internal/ThreadSafeQueue.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <valgrind/valgrind.h>
+
+#include <cstdlib>
+#include <future>
+#include <iostream>
+
+using namespace std;
+using namespace unity::scopes::internal;
+
+typedef BoundedQueue<int>::OverflowPolicy Policy;
+
+TEST(BoundedQueue, basic)
+{
+    BoundedQueue<int> q(3);
+    EXPECT_EQ(4u, q.capacity());  // Rounded up to power of two
+    EXPECT_EQ(Policy::Block, q.overflow_policy());
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(0u, q.size());
+    int n;
+    EXPECT_FALSE(q.try_pop(n));
+
+    EXPECT_TRUE(q.push(5));   // R-value
+    EXPECT_FALSE(q.empty());
+    EXPECT_EQ(1u, q.size());
+    n = q.wait_and_pop();
+    EXPECT_EQ(5, n);
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(0u, q.size());
+
+    n = 6;                    // L-value
+    EXPECT_TRUE(q.push(n));
+    EXPECT_EQ(1u, q.size());
+    auto r = q.wait_and_pop();
+    EXPECT_EQ(6, r);
+    EXPECT_EQ(0u, q.size());
+
+    // Go around the ring a few times.
+    for (int i = 0; i < 20; ++i)
+    {
+        EXPECT_TRUE(q.push(i));
+        EXPECT_TRUE(q.push(i + 100));
+        EXPECT_EQ(2u, q.size());
+        EXPECT_TRUE(q.try_pop(r));
+        EXPECT_EQ(i, r);
+        EXPECT_TRUE(q.try_pop(r));
+        EXPECT_EQ(i + 100, r);
+    }
+
+    try
+    {
+        BoundedQueue<int> q(0);
+        FAIL();
+    }
+    catch (std::invalid_argument const& e)
+    {
+        EXPECT_STREQ("BoundedQueue: capacity must be > 0", e.what());
+    }
+}
+
+TEST(BoundedQueue, reject)
+{
+    BoundedQueue<int> q(2, Policy::Reject);
+    EXPECT_TRUE(q.push(1));
+    EXPECT_TRUE(q.push(2));
+    EXPECT_FALSE(q.push(3));
+    EXPECT_EQ(2u, q.size());
+    EXPECT_EQ(1, q.wait_and_pop());
+    EXPECT_TRUE(q.push(4));
+    EXPECT_EQ(2, q.wait_and_pop());
+    EXPECT_EQ(4, q.wait_and_pop());
+}
+
+TEST(BoundedQueue, drop_oldest)
+{
+    BoundedQueue<int> q(4, Policy::DropOldest);
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(q.push(i));
+    }
+    EXPECT_EQ(4u, q.size());
+    for (int i = 6; i < 10; ++i)
+    {
+        EXPECT_EQ(i, q.wait_and_pop());
+    }
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(BoundedQueue, block)
+{
+    BoundedQueue<int> q(2);
+    q.push(1);
+    q.push(2);
+
+    atomic_bool pushed(false);
+    auto fut = std::async(launch::async, [&q, &pushed] { q.push(3); pushed = true; });
+    this_thread::sleep_for(chrono::milliseconds(100));
+    EXPECT_FALSE(pushed);
+    EXPECT_EQ(1, q.wait_and_pop());
+    fut.wait();
+    EXPECT_TRUE(pushed);
+    EXPECT_EQ(2, q.wait_and_pop());
+    EXPECT_EQ(3, q.wait_and_pop());
+}
+
+TEST(BoundedQueue, destroy_while_blocked_in_push)
+{
+    BoundedQueue<int> q(2);
+    q.push(1);
+    q.push(2);
+
+    auto fut = std::async(launch::async, [&q] { q.push(3); });
+    this_thread::sleep_for(chrono::milliseconds(100));
+    q.destroy();
+    try
+    {
+        fut.get();
+        FAIL();
+    }
+    catch (std::runtime_error const& e)
+    {
+        EXPECT_STREQ("BoundedQueue: queue destroyed while thread was blocked in push()", e.what());
+    }
+    q.wait_for_destroy();
+}
+
+promise<void> waiter_ready;
+
+void waiter_thread(BoundedQueue<string>* q)
+{
+    EXPECT_EQ("fred", q->wait_and_pop());
+    waiter_ready.set_value();
+    try
+    {
+        q->wait_and_pop();
+        FAIL();
+    }
+    catch (std::runtime_error const& e)
+    {
+        EXPECT_STREQ("BoundedQueue: queue destroyed while thread was blocked in wait_and_pop()", e.what());
+    }
+}
+
+TEST(BoundedQueue, exception)
+{
+    unique_ptr<BoundedQueue<string>> q(new BoundedQueue<string>(8));
+    q->push("fred");
+    auto f = waiter_ready.get_future();
+    auto t = thread(waiter_thread, q.get());
+    f.wait();
+    this_thread::sleep_for(chrono::milliseconds(50));   // Make sure child thread has time to call wait_and_pop()
+    q->destroy();
+    t.join();
+
+    try
+    {
+        q->push("fred");    // Move push
+        FAIL();
+    }
+    catch (std::runtime_error const& e)
+    {
+        EXPECT_STREQ("BoundedQueue: cannot push onto destroyed queue", e.what());
+    }
+
+    try
+    {
+        string s = "fred";
+        q->push(s);         // Copy push
+        FAIL();
+    }
+    catch (std::runtime_error const& e)
+    {
+        EXPECT_STREQ("BoundedQueue: cannot push onto destroyed queue", e.what());
+    }
+}
+
+atomic_int call_count;
+
+void int_reader_thread(BoundedQueue<int>* q)
+{
+    try
+    {
+        q->wait_and_pop();
+        FAIL();
+    }
+    catch (std::runtime_error const&)
+    {
+        ++call_count;
+    }
+}
+
+TEST(BoundedQueue, wait_for_threads)
+{
+    BoundedQueue<int> q(8);
+    call_count = 0;
+    vector<thread> threads;
+    for (auto i = 0; i < 20; ++i)
+    {
+        threads.push_back(thread(int_reader_thread, &q));
+    }
+    this_thread::sleep_for(chrono::milliseconds(300));
+
+    // Destroy the queue while multiple threads are sleeping in wait_and_pop().
+    q.destroy();
+    q.wait_for_destroy();
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    EXPECT_EQ(20, call_count);
+}
+
+class MoveOnly
+{
+public:
+    MoveOnly(string s) :
+        s_(s)
+    {
+    }
+
+    MoveOnly(MoveOnly const&) = delete;
+    MoveOnly& operator=(MoveOnly const&) = delete;
+
+    MoveOnly(MoveOnly&& other)  = default;
+    MoveOnly& operator=(MoveOnly&& rhs) = default;
+
+    string const& val() { return s_; }
+
+private:
+    string s_;
+};
+
+TEST(BoundedQueue, move_only)
+{
+    BoundedQueue<MoveOnly> q(4);
+
+    q.push(move(MoveOnly("hello")));
+    q.push(move(MoveOnly("world")));
+    q.push(move(MoveOnly("again")));
+    q.push(move(MoveOnly("left behind")));  // Destroyed by the queue's destructor
+
+    MoveOnly m("");
+
+    EXPECT_TRUE(q.try_pop(m));
+    EXPECT_EQ("hello", m.val());
+    EXPECT_TRUE(q.try_pop(m));
+    EXPECT_EQ("world", m.val());
+    m = q.wait_and_pop();
+    EXPECT_EQ("again", m.val());
+}
+
+TEST(BoundedQueue, wait_until_empty)
+{
+    BoundedQueue<int> q(4);
+    q.push(99);
+    auto fut = std::async(launch::async, [&q] {
+        this_thread::sleep_for(chrono::milliseconds(300)); q.wait_and_pop(); q.destroy();
+    });
+    q.wait_until_empty();
+    EXPECT_TRUE(q.empty());
+    fut.wait();
+}
+
+// Several producers and consumers on a small queue, so producers block frequently.
+// Every item must arrive exactly once.
+
+TEST(BoundedQueue, mpmc)
+{
+    int const num_producers = 4;
+    int const num_consumers = 4;
+    int const items_per_producer = 20000;
+
+    BoundedQueue<int> q(16);
+    vector<atomic_int> seen(num_producers * items_per_producer);
+    for (auto& s : seen)
+    {
+        s = 0;
+    }
+
+    vector<thread> threads;
+    for (int p = 0; p < num_producers; ++p)
+    {
+        threads.emplace_back([&q, p]
+        {
+            for (int i = 0; i < items_per_producer; ++i)
+            {
+                q.push(p * items_per_producer + i);
+            }
+        });
+    }
+    for (int c = 0; c < num_consumers; ++c)
+    {
+        threads.emplace_back([&q, &seen]
+        {
+            for (int i = 0; i < num_producers * items_per_producer / num_consumers; ++i)
+            {
+                ++seen[q.wait_and_pop()];
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    EXPECT_TRUE(q.empty());
+    for (auto const& s : seen)
+    {
+        ASSERT_EQ(1, s);
+    }
+}
+
+namespace
+{
+
+// Runs the given number of producers and consumers, each pushing or popping iterations items,
+// and returns the elapsed time in milliseconds.
+
+template<typename Queue>
+double run(Queue& q, int producers, int consumers, int iterations)
+{
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&q, iterations] { for (int n = 0; n < iterations; ++n) q.push(n); });
+    }
+    for (int i = 0; i < consumers; ++i)
+    {
+        threads.emplace_back([&q, iterations] { for (int n = 0; n < iterations; ++n) q.wait_and_pop(); });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+// Throughput of ThreadSafeQueue and BoundedQueue with an increasing number
+// of producer/consumer pairs. This takes a while and checks nothing, so it
+// runs only if BOUNDED_QUEUE_BENCHMARK is set in the environment.
+
+TEST(BoundedQueue, benchmark)
+{
+    if (!getenv("BOUNDED_QUEUE_BENCHMARK") || RUNNING_ON_VALGRIND)
+    {
+        return;
+    }
+
+    int const iterations = 200000;
+    for (int threads : { 1, 2, 4, 8 })
+    {
+        ThreadSafeQueue<int> tsq;
+        BoundedQueue<int> bq(1024);
+        double tsq_ms = run(tsq, threads, threads, iterations);
+        double bq_ms = run(bq, threads, threads, iterations);
+        cout << threads << " producers/consumers: ThreadSafeQueue " << tsq_ms << " ms, BoundedQueue "
+             << bq_ms << " ms" << endl;
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/CancellationToken.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace unity::scopes::internal;
+
+TEST(CancellationToken, basic)
+{
+    CancellationToken t;
+    EXPECT_FALSE(t.cancelled());
+    t.dropped_result(true);  // No stats, no-op
+    t.cancel();
+    EXPECT_TRUE(t.cancelled());
+    t.cancel();
+    EXPECT_TRUE(t.cancelled());
+}
+
+TEST(CancellationToken, stats)
+{
+    auto stats = make_shared<CancellationStats>();
+    EXPECT_EQ(0, stats->cancelled_queries());
+    EXPECT_EQ(0, stats->dropped_results());
+    EXPECT_EQ(0, stats->dropped_after_marshaling());
+
+    CancellationToken t1(stats);
+    CancellationToken t2(stats);
+    t1.cancel();
+    t1.cancel();  // Counted once only
+    EXPECT_EQ(1, stats->cancelled_queries());
+    t2.cancel();
+    EXPECT_EQ(2, stats->cancelled_queries());
+
+    t1.dropped_result(false);
+    t1.dropped_result(true);
+    t2.dropped_result(true);
+    EXPECT_EQ(3, stats->dropped_results());
+    EXPECT_EQ(2, stats->dropped_after_marshaling());
+}
+
+TEST(CancellationToken, concurrent_cancel)
+{
+    auto stats = make_shared<CancellationStats>();
+    CancellationToken t(stats);
+
+    vector<thread> threads;
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&t] { t.cancel(); t.dropped_result(false); });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_TRUE(t.cancelled());
+    EXPECT_EQ(1, stats->cancelled_queries());
+    EXPECT_EQ(8, stats->dropped_results());
+    EXPECT_EQ(0, stats->dropped_after_marshaling());
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/ChildScopesRepository.h>
+
+#include <unity/scopes/testing/ScopeMetadataBuilder.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+namespace
+{
+
+string const repo_path = TEST_DIR "/child-scopes.json";
+
+ChildScope make_child(string const& id, bool enabled = true)
+{
+    unity::scopes::testing::ScopeMetadataBuilder builder;
+    builder.scope_id(id).proxy(ScopeProxy()).display_name(id).description(id).author(id);
+    return ChildScope{id, builder(), enabled};
+}
+
+string read_file()
+{
+    ifstream f(repo_path);
+    return string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+}
+
+void write_file(string const& contents)
+{
+    ofstream f(repo_path);
+    f << contents;
+}
+
+} // namespace
+
+TEST(ChildScopesRepository, write_on_change)
+{
+    ::unlink(repo_path.c_str());
+    ostringstream s;
+    Logger logger("ChildScopesRepository_test", s);
+
+    {
+        ChildScopesRepository repo(repo_path, logger);
+        auto list = repo.child_scopes({ make_child("A"), make_child("B", false) });
+        ASSERT_EQ(2u, list.size());
+        EXPECT_TRUE(list[0].enabled);
+        EXPECT_FALSE(list[1].enabled);
+    }   // Destructor completes the background write.
+    EXPECT_EQ(R"([{"id":"A","enabled":true},{"id":"B","enabled":false}])", read_file());
+
+    {
+        ChildScopesRepository repo(repo_path, logger);
+
+        // The repo is read on the first call. If nothing changes, it is neither read nor written again,
+        // so the marker we write to the file must survive.
+        auto list = repo.child_scopes({ make_child("A"), make_child("B") });
+        ASSERT_EQ(2u, list.size());
+        EXPECT_FALSE(list[1].enabled);
+        write_file("marker");
+        for (int i = 0; i < 10; ++i)
+        {
+            list = repo.child_scopes({ make_child("A"), make_child("B") });
+            EXPECT_FALSE(list[1].enabled);
+        }
+    }
+    EXPECT_EQ("marker", read_file());
+}
+
+TEST(ChildScopesRepository, coalesced_writes)
+{
+    ::unlink(repo_path.c_str());
+    ostringstream s;
+    Logger logger("ChildScopesRepository_test", s);
+
+    {
+        ChildScopesRepository repo(repo_path, logger);
+        ChildScopeList children;
+        for (int i = 0; i < 50; ++i)
+        {
+            children.push_back(make_child(to_string(i)));
+            EXPECT_EQ(children.size(), repo.child_scopes(children).size());
+        }
+    }
+    auto contents = read_file();
+    EXPECT_NE(string::npos, contents.find(R"({"id":"0","enabled":true})"));
+    EXPECT_NE(string::npos, contents.find(R"({"id":"49","enabled":true}])"));
+}
+
+TEST(ChildScopesRepository, set_child_scopes)
+{
+    ::unlink(repo_path.c_str());
+    ostringstream s;
+    Logger logger("ChildScopesRepository_test", s);
+
+    ChildScopesRepository repo(repo_path, logger);
+    EXPECT_TRUE(repo.child_scopes({ make_child("A"), make_child("B") })[0].enabled);
+
+    EXPECT_TRUE(repo.set_child_scopes({ make_child("B"), make_child("A", false) }));
+    EXPECT_EQ(R"([{"id":"B","enabled":true},{"id":"A","enabled":false}])", read_file());
+
+    // The enabled states come from the cache, not the file.
+    ::unlink(repo_path.c_str());
+    auto list = repo.child_scopes({ make_child("A"), make_child("B") });
+    ASSERT_EQ(2u, list.size());
+    EXPECT_FALSE(list[0].enabled);
+    EXPECT_TRUE(list[1].enabled);
+
+    EXPECT_FALSE(ChildScopesRepository("/no_such_dir/child-scopes.json", logger).set_child_scopes({ make_child("A") }));
+}
+
+TEST(ChildScopesRepository, set_child_scopes_same_ids)
+{
+    ::unlink(repo_path.c_str());
+    ostringstream s;
+    Logger logger("ChildScopesRepository_test", s);
+
+    ChildScopesRepository repo(repo_path, logger);
+    auto list = repo.child_scopes({ make_child("A"), make_child("B") });
+    list = repo.child_scopes({ make_child("A"), make_child("B") });
+    EXPECT_TRUE(list[0].enabled);
+
+    // Repeated calls with the same children must still see a change made by set_child_scopes().
+    EXPECT_TRUE(repo.set_child_scopes({ make_child("A", false), make_child("B") }));
+    list = repo.child_scopes({ make_child("A"), make_child("B") });
+    ASSERT_EQ(2u, list.size());
+    EXPECT_FALSE(list[0].enabled);
+    EXPECT_TRUE(list[1].enabled);
+
+    // The metadata of each child is passed through, even if the ids are unchanged.
+    ChildScope with_keywords = make_child("B");
+    with_keywords.keywords = { "music" };
+    list = repo.child_scopes({ make_child("A"), with_keywords });
+    ASSERT_EQ(2u, list.size());
+    EXPECT_EQ(set<string>{ "music" }, list[1].keywords);
+}
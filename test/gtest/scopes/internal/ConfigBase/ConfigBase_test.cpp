@@ -86,7 +86,7 @@ TEST(ConfigBase, middleware)
     catch (ConfigException const& e)
     {
         EXPECT_EQ("unity::scopes::ConfigException: \"" + TEST_INI + "\": Illegal value for Zmq.BadMiddleware: \"foo\": "
-                  "legal values are \"Zmq\" and \"REST\"",
+                  "legal values are \"Zmq\", \"REST\", and \"Inproc\"",
                   e.what());
     }
     try
@@ -97,7 +97,7 @@ TEST(ConfigBase, middleware)
     catch (ConfigException const& e)
     {
         EXPECT_EQ("unity::scopes::ConfigException: \"" + TEST_INI + "\": Illegal value for REST.BadMiddleware: \"bar\": "
-                  "legal values are \"Zmq\" and \"REST\"",
+                  "legal values are \"Zmq\", \"REST\", and \"Inproc\"",
                   e.what());
     }
 }
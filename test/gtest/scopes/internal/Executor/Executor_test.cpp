@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/Executor.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <valgrind/valgrind.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace unity::scopes::internal;
+
+namespace posix = core::posix;
+
+namespace
+{
+
+int exit_status(posix::ChildProcess& child)
+{
+    auto result = child.wait_for(posix::wait::Flags::untraced);
+    EXPECT_EQ(posix::wait::Result::Status::exited, result.status);
+    return static_cast<int>(result.detail.if_exited.status);
+}
+
+} // namespace
+
+TEST(Executor, spawn)
+{
+    Executor executor;
+    Executor::Command cmd("/bin/sh", { "-c", "echo \"$FOO $0\"", "arg0" }, { { "FOO", "bar" } }, "");
+    EXPECT_EQ("/bin/sh", cmd.program());
+    EXPECT_EQ((vector<string>{ "-c", "echo \"$FOO $0\"", "arg0" }), cmd.args());
+
+    // The same command can be used any number of times.
+    for (int i = 0; i < 3; ++i)
+    {
+        auto child = executor.spawn(cmd, posix::StandardStream::stdout);
+        ASSERT_GT(child.pid(), 0);
+        string line;
+        getline(child.cout(), line);
+        EXPECT_EQ("bar arg0", line);
+        EXPECT_EQ(0, exit_status(child));
+    }
+}
+
+TEST(Executor, exec)
+{
+    Executor executor;
+    auto child = executor.exec("/bin/sh", { "-c", "exit 3" }, {}, posix::StandardStream::empty, "");
+    ASSERT_GT(child.pid(), 0);
+    EXPECT_EQ(3, exit_status(child));
+}
+
+TEST(Executor, no_such_program)
+{
+    Executor executor;
+    Executor::Command cmd("/no/such/program", {}, {}, "");
+    auto child = executor.spawn(cmd, posix::StandardStream::empty);
+    ASSERT_GT(child.pid(), 0);
+    EXPECT_EQ(127, exit_status(child));
+}
+
+namespace
+{
+
+long rss_kb()
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+        {
+            return stol(line.substr(6));
+        }
+    }
+    return -1;
+}
+
+template<typename F>
+double time_it(int iterations, F f)
+{
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        f();
+    }
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+// Launch latency of fork() + exec() (as done by core::posix::exec()) and of spawn()
+// as the resident size of the launching process grows.
+
+TEST(Executor, benchmark)
+{
+    if (RUNNING_ON_VALGRIND)
+    {
+        return;
+    }
+
+    Executor executor;
+    Executor::Command cmd("/bin/true", {}, {}, "");
+    int const iterations = 20;
+
+    vector<unique_ptr<char[]>> ballast;
+    for (int mb : { 0, 64, 256, 512 })
+    {
+        size_t const size = 64 * 1024 * 1024;
+        while (ballast.size() * 64 < size_t(mb))
+        {
+            ballast.emplace_back(new char[size]);
+            memset(ballast.back().get(), 1, size);  // Touch the pages, so they are resident.
+        }
+
+        double fork_us = time_it(iterations, [&]
+        {
+            auto child = posix::exec(cmd.program(), cmd.args(), cmd.env(), posix::StandardStream::empty,
+                                     []{});
+            exit_status(child);
+        });
+        double spawn_us = time_it(iterations, [&]
+        {
+            auto child = executor.spawn(cmd, posix::StandardStream::empty);
+            exit_status(child);
+        });
+
+        cout << "RSS " << rss_kb() / 1024 << " MB: fork " << fork_us << " us, spawn " << spawn_us << " us" << endl;
+    }
+}
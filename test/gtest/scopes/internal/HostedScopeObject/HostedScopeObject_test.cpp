@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/HostedScopeObject.h>
+
+#include <unity/scopes/ScopeBase.h>
+#include <unity/UnityExceptions.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+
+using namespace std;
+using namespace unity;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+namespace
+{
+
+// Without a middleware, child_scopes() is the only call that reaches the scope.
+// ScopeBase::child_scopes() calls find_child_scopes(), and then throws LogicException
+// because the scope has no child scopes repository. That doesn't matter here: we only
+// care that the call was forwarded to the scope.
+
+class TestScope : public ScopeBase
+{
+public:
+    TestScope()
+        : calls(0)
+    {
+    }
+
+    virtual SearchQueryBase::UPtr search(CannedQuery const&, SearchMetadata const&) override
+    {
+        return nullptr;
+    }
+
+    virtual PreviewQueryBase::UPtr preview(Result const&, ActionMetadata const&) override
+    {
+        return nullptr;
+    }
+
+    virtual ChildScopeList find_child_scopes() const override
+    {
+        ++calls;
+        if (on_call)
+        {
+            on_call();
+        }
+        return ChildScopeList();
+    }
+
+    mutable atomic_int calls;
+    function<void()> on_call;
+};
+
+class HostedScopeObjectTest : public ::testing::Test
+{
+public:
+    HostedScopeObjectTest()
+        : loads(0)
+        , stops(0)
+    {
+    }
+
+protected:
+    HostedScopeObject::SPtr make_hosted()
+    {
+        return make_shared<HostedScopeObject>("scope-A", false, [this]
+        {
+            ++loads;
+            HostedScopeObject::Instance instance;
+            instance.scope_object = make_shared<ScopeObject>(&scope);
+            instance.stop = [this] { ++stops; };
+            return instance;
+        });
+    }
+
+    TestScope scope;
+    atomic_int loads;
+    atomic_int stops;
+};
+
+TEST_F(HostedScopeObjectTest, load_on_first_call)
+{
+    auto hosted = make_hosted();
+    EXPECT_EQ("scope-A", hosted->scope_id());
+    EXPECT_FALSE(hosted->debug_mode());
+    EXPECT_FALSE(hosted->loaded());
+    EXPECT_EQ(0, loads);
+
+    EXPECT_THROW(hosted->child_scopes(), LogicException);
+    EXPECT_TRUE(hosted->loaded());
+    EXPECT_EQ(1, loads);
+    EXPECT_EQ(1, scope.calls);
+
+    // The scope stays loaded for later calls.
+    EXPECT_THROW(hosted->child_scopes(), LogicException);
+    EXPECT_EQ(1, loads);
+    EXPECT_EQ(2, scope.calls);
+    EXPECT_EQ(0, stops);
+}
+
+TEST_F(HostedScopeObjectTest, load_failure)
+{
+    int attempts = 0;
+    HostedScopeObject hosted("scope-A", false, [&attempts]() -> HostedScopeObject::Instance
+    {
+        ++attempts;
+        throw ResourceException("cannot load");
+    });
+
+    EXPECT_THROW(hosted.child_scopes(), ResourceException);
+    EXPECT_FALSE(hosted.loaded());
+
+    // A failed load is retried by the next call.
+    EXPECT_THROW(hosted.child_scopes(), ResourceException);
+    EXPECT_EQ(2, attempts);
+    EXPECT_TRUE(hosted.unload());
+}
+
+TEST_F(HostedScopeObjectTest, unload_when_idle)
+{
+    auto hosted = make_hosted();
+
+    // Unloading a scope that is not loaded does nothing.
+    EXPECT_TRUE(hosted->unload());
+    EXPECT_EQ(0, stops);
+
+    EXPECT_THROW(hosted->child_scopes(), LogicException);
+    EXPECT_TRUE(hosted->unload());
+    EXPECT_FALSE(hosted->loaded());
+    EXPECT_EQ(1, stops);
+
+    // The next call loads the scope again.
+    EXPECT_THROW(hosted->child_scopes(), LogicException);
+    EXPECT_TRUE(hosted->loaded());
+    EXPECT_EQ(2, loads);
+
+    // Destroying the object stops a loaded scope.
+    hosted.reset();
+    EXPECT_EQ(2, stops);
+}
+
+TEST_F(HostedScopeObjectTest, no_unload_while_busy)
+{
+    auto hosted = make_hosted();
+
+    promise<void> entered;
+    promise<void> proceed;
+    shared_future<void> proceed_future(proceed.get_future());
+    scope.on_call = [&entered, proceed_future]
+    {
+        entered.set_value();
+        proceed_future.wait();
+    };
+
+    auto call_done = async(launch::async, [hosted] { hosted->child_scopes(); });
+    entered.get_future().wait();
+
+    // The call is still in progress, so the scope stays loaded.
+    EXPECT_FALSE(hosted->unload());
+    EXPECT_TRUE(hosted->loaded());
+    EXPECT_EQ(0, stops);
+
+    proceed.set_value();
+    EXPECT_THROW(call_done.get(), LogicException);
+
+    EXPECT_TRUE(hosted->unload());
+    EXPECT_FALSE(hosted->loaded());
+    EXPECT_EQ(1, stops);
+}
+
+TEST_F(HostedScopeObjectTest, forced_unload)
+{
+    auto hosted = make_hosted();
+
+    promise<void> entered;
+    promise<void> proceed;
+    shared_future<void> proceed_future(proceed.get_future());
+    scope.on_call = [&entered, proceed_future]
+    {
+        entered.set_value();
+        proceed_future.wait();
+    };
+
+    auto call_done = async(launch::async, [hosted] { hosted->child_scopes(); });
+    entered.get_future().wait();
+
+    EXPECT_TRUE(hosted->unload(true));
+    EXPECT_FALSE(hosted->loaded());
+    EXPECT_EQ(1, stops);
+
+    proceed.set_value();
+    EXPECT_THROW(call_done.get(), LogicException);
+    EXPECT_EQ(1, stops);
+}
+
+} // namespace
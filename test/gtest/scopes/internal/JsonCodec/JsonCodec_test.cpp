@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/JsonCodec.h>
+
+#include <unity/scopes/internal/JsonCppNode.h>
+#include <unity/UnityExceptions.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+namespace
+{
+
+// Roughly what a result looks like on the wire.
+Variant make_result(int i)
+{
+    VariantMap attrs;
+    attrs["uri"] = Variant("http://www.example.com/item/" + to_string(i));
+    attrs["title"] = Variant("Item \"" + to_string(i) + "\"\twith some escapes\n");
+    attrs["art"] = Variant("file:///usr/share/icons/item" + to_string(i) + ".png");
+    attrs["dnd_uri"] = Variant("http://www.example.com/dnd/" + to_string(i));
+    attrs["rating"] = Variant(i * 0.5);
+    attrs["count"] = Variant(i);
+    attrs["timestamp"] = Variant(int64_t(1450000000000) + i);
+    attrs["explicit"] = Variant(i % 2 == 0);
+    attrs["tags"] = Variant(VariantArray{ Variant("a"), Variant("b"), Variant("ünïcödé") });
+
+    VariantMap result;
+    result["attrs"] = Variant(attrs);
+    result["internal"] = Variant(VariantMap{ { "origin", Variant("scope-A") } });
+    return Variant(result);
+}
+
+Variant make_cache(int num_results)
+{
+    VariantArray results;
+    for (int i = 0; i < num_results; ++i)
+    {
+        results.push_back(make_result(i));
+    }
+    return Variant(results);
+}
+
+template<typename F>
+double time_it(int iterations, F f)
+{
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        f();
+    }
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+}
+
+void benchmark(string const& name, Variant const& v, int iterations)
+{
+    string const json = v.serialize_json();
+
+    double glib_write = time_it(iterations, [&]{ JsonCppNode(v).to_json_string(); });
+    double codec_write = time_it(iterations, [&]{ variant_to_json(v); });
+    double glib_read = time_it(iterations, [&]{ JsonCppNode(json).to_variant(); });
+    double codec_read = time_it(iterations, [&]{ json_to_variant(json); });
+
+    cout << name << " (" << json.size() << " bytes):" << endl
+         << "  write: json-glib " << glib_write << " us, codec " << codec_write << " us" << endl
+         << "  read:  json-glib " << glib_read << " us, codec " << codec_read << " us" << endl;
+}
+
+} // namespace
+
+TEST(JsonCodec, write)
+{
+    EXPECT_EQ("null\n", variant_to_json(Variant()));
+    EXPECT_EQ("true\n", variant_to_json(Variant(true)));
+    EXPECT_EQ("-42\n", variant_to_json(Variant(-42)));
+    EXPECT_EQ("9223372036854775807\n", variant_to_json(Variant(INT64_MAX)));
+    EXPECT_EQ("10.5\n", variant_to_json(Variant(10.5)));
+    EXPECT_EQ("3.0\n", variant_to_json(Variant(3.0)));
+    EXPECT_EQ("0.10000000000000001\n", variant_to_json(Variant(0.1)));  // Same as json-glib
+    EXPECT_EQ("\"a\\\"b\\\\c\\n\\u0001\xc3\xa4\"\n", variant_to_json(Variant("a\"b\\c\n\x01\xc3\xa4")));
+    EXPECT_EQ("[]\n", variant_to_json(Variant(VariantArray())));
+    EXPECT_EQ("{}\n", variant_to_json(Variant(VariantMap())));
+    EXPECT_EQ("{\"a\":[1,\"x\"],\"b\":{\"c\":null}}\n",
+              variant_to_json(Variant(VariantMap{ { "b", Variant(VariantMap{ { "c", Variant() } }) },
+                                                  { "a", Variant(VariantArray{ Variant(1), Variant("x") }) } })));
+
+    string out = "prefix";
+    write_json(Variant(1), out);
+    EXPECT_EQ("prefix1", out);
+}
+
+TEST(JsonCodec, read)
+{
+    EXPECT_EQ(Variant(), json_to_variant(" null "));
+    EXPECT_EQ(Variant(false), json_to_variant("false"));
+    EXPECT_EQ(Variant::Type::Int, json_to_variant("2147483647").which());
+    EXPECT_EQ(Variant::Type::Int64, json_to_variant("2147483648").which());
+    EXPECT_EQ(Variant(int64_t(-2147483649)), json_to_variant("-2147483649"));
+    EXPECT_EQ(Variant(1.5e3), json_to_variant("1.5E3"));
+    EXPECT_EQ(Variant::Type::Double, json_to_variant("3.0").which());
+    EXPECT_EQ(Variant("a\"b/\n\xc3\xa4\xf0\x9f\x98\x80"), json_to_variant(R"("a\"b\/\n\u00e4\ud83d\ude00")"));
+    EXPECT_EQ(Variant("\xc3\xa4"), json_to_variant("\"\xc3\xa4\""));
+
+    auto v = json_to_variant(R"( // comment
+        { "a" : [ 1, "x", {} ], /* another */ "b": {"c": null}, "a": true } )");
+    EXPECT_EQ(Variant(true), v.get_dict()["a"]);  // Last one wins.
+    EXPECT_EQ(Variant(VariantMap{ { "c", Variant() } }), v.get_dict()["b"]);
+
+    for (auto const& bad : { "", " \n\t", "nul", "[1,", "[1 2]", "{\"a\" 1}", "{1:2}", "\"abc", "\"\\x\"",
+                             "\"\\ud83d\"", "01x", "-", "1.", "1e", "[] []", "/* abc", "\"a\nb\"" })
+    {
+        EXPECT_THROW(json_to_variant(bad), unity::ResourceException) << bad;
+    }
+    EXPECT_THROW(json_to_variant(string(1000, '[') + string(1000, ']')), unity::ResourceException);
+
+    try
+    {
+        json_to_variant("  ");
+        FAIL();
+    }
+    catch (unity::ResourceException const& e)
+    {
+        EXPECT_NE(string::npos, string(e.what()).find("empty string is not a valid JSON"));
+    }
+}
+
+TEST(JsonCodec, compatibility)
+{
+    // Whatever one implementation writes, the other must read back identically.
+    auto const v = make_cache(5);
+
+    string const codec_json = variant_to_json(v);
+    EXPECT_EQ(v, JsonCppNode(codec_json).to_variant());
+    EXPECT_EQ(v, json_to_variant(codec_json));
+
+    string const glib_json = JsonCppNode(v).to_json_string();
+    EXPECT_EQ(v, json_to_variant(glib_json));
+}
+
+TEST(JsonCodec, benchmark)
+{
+    benchmark("result", make_result(1), 2000);
+    benchmark("cache", make_cache(200), 20);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/PreviewCache.h>
+
+#include <unity/scopes/internal/ResultImpl.h>
+#include <unity/UnityExceptions.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+namespace
+{
+
+Result make_result(string const& uri)
+{
+    VariantMap attrs;
+    attrs["uri"] = uri;
+    VariantMap vm;
+    vm["internal"] = Variant(VariantMap());
+    vm["attrs"] = Variant(attrs);
+    return ResultImpl::create_result(vm);
+}
+
+vector<VariantMap> make_replies(string const& value)
+{
+    VariantMap data;
+    data["preview-data"] = Variant(VariantMap{ { "k", Variant(value) } });
+    return vector<VariantMap>{ data };
+}
+
+} // namespace
+
+TEST(PreviewCache, key)
+{
+    ActionMetadata hints("en", "phone");
+    auto const k = PreviewCache::key(make_result("a"), hints);
+    EXPECT_EQ(k, PreviewCache::key(make_result("a"), hints));
+    EXPECT_NE(k, PreviewCache::key(make_result("b"), hints));
+    EXPECT_NE(k, PreviewCache::key(make_result("a"), ActionMetadata("de", "phone")));
+}
+
+TEST(PreviewCache, lookup)
+{
+    EXPECT_THROW(PreviewCache(0), unity::InvalidArgumentException);
+
+    PreviewCache cache(64 * 1024);
+    EXPECT_EQ(nullptr, cache.lookup("scope-A", "k"));
+
+    auto gen = cache.generation("scope-A");
+    cache.store("scope-A", gen, "k", make_replies("v"), chrono::milliseconds(100));
+    EXPECT_TRUE(cache.contains("scope-A", "k"));
+    EXPECT_FALSE(cache.contains("scope-B", "k"));
+
+    auto e = cache.lookup("scope-A", "k");
+    ASSERT_NE(nullptr, e);
+    ASSERT_EQ(1u, e->replies.size());
+    EXPECT_EQ("v", e->replies[0].at("preview-data").get_dict().at("k").get_string());
+
+    EXPECT_EQ(1, cache.hits());
+    EXPECT_EQ(1, cache.misses());
+    EXPECT_EQ(1, cache.prefetched());
+    EXPECT_EQ(chrono::milliseconds(100), cache.saved_latency());
+}
+
+TEST(PreviewCache, invalidate)
+{
+    PreviewCache cache(64 * 1024);
+
+    auto gen_a = cache.generation("scope-A");
+    cache.store("scope-A", gen_a, "k", make_replies("a"), chrono::milliseconds(1));
+    cache.store("scope-B", cache.generation("scope-B"), "k", make_replies("b"), chrono::milliseconds(1));
+
+    // Only the entries for scope-A go away.
+    cache.invalidate("scope-A");
+    EXPECT_FALSE(cache.contains("scope-A", "k"));
+    EXPECT_TRUE(cache.contains("scope-B", "k"));
+
+    // A prefetch that started before the invalidation is not stored.
+    cache.store("scope-A", gen_a, "k", make_replies("a"), chrono::milliseconds(1));
+    EXPECT_FALSE(cache.contains("scope-A", "k"));
+    cache.store("scope-A", cache.generation("scope-A"), "k", make_replies("a"), chrono::milliseconds(1));
+    EXPECT_TRUE(cache.contains("scope-A", "k"));
+}
+
+TEST(PreviewCache, eviction)
+{
+    string const big(400, 'x');
+    PreviewCache cache(1000);
+    auto gen = cache.generation("s");
+
+    cache.store("s", gen, "k1", make_replies(big), chrono::milliseconds(1));
+    cache.store("s", gen, "k2", make_replies(big), chrono::milliseconds(1));
+    EXPECT_NE(nullptr, cache.lookup("s", "k1"));  // k1 is now more recently used than k2
+
+    cache.store("s", gen, "k3", make_replies(big), chrono::milliseconds(1));
+    EXPECT_TRUE(cache.contains("s", "k1"));
+    EXPECT_FALSE(cache.contains("s", "k2"));
+    EXPECT_TRUE(cache.contains("s", "k3"));
+
+    // An entry that is larger than the cache is not stored.
+    cache.store("s", gen, "k4", make_replies(string(2000, 'x')), chrono::milliseconds(1));
+    EXPECT_FALSE(cache.contains("s", "k4"));
+    EXPECT_TRUE(cache.contains("s", "k1"));
+}
@@ -38,6 +38,7 @@ TEST(RegistryConfig, basic)
     EXPECT_EQ("Zmq", c.mw_kind());
     EXPECT_EQ("Zmq.ini", c.mw_configfile());
     EXPECT_EQ(3000, c.process_timeout());
+    EXPECT_EQ((vector<string>{ "scope-A", "scope-B" }), c.shared_host_scopes());
 }
 
 TEST(RegistryConfig, RegistryIDEmpty)
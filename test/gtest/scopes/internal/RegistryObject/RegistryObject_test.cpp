@@ -41,11 +41,8 @@ namespace
 class MockExecutor: public virtual Executor
 {
 public:
-    MOCK_METHOD5(exec, core::posix::ChildProcess(const std::string&,
-                    const std::vector<std::string>&,
-                    const std::map<std::string, std::string>&,
-                    const core::posix::StandardStream&,
-                    const std::string&));
+    MOCK_METHOD2(spawn, core::posix::ChildProcess(const Executor::Command&,
+                    const core::posix::StandardStream&));
 };
 
 class MockObject: public virtual Object
@@ -113,11 +110,13 @@ public:
 class TestRegistryObject: public Test
 {
 public:
-    core::posix::ChildProcess mock_exec(const string&, const vector<string>&,
-            const map<string, string>&, const core::posix::StandardStream&,
-            const string&)
+    core::posix::ChildProcess mock_exec(const Executor::Command&, const core::posix::StandardStream&)
     {
-        t_start.reset(new thread(pretend_started, registry->state_receiver()));
+        if (t_start)
+        {
+            t_start->join();
+        }
+        t_start.reset(new thread(pretend_started, registry->state_receiver(), started_id));
         return dummy_process;
     }
 
@@ -130,9 +129,9 @@ protected:
         dummy_process.send_signal_or_throw(core::posix::Signal::sig_term);
     }
 
-    static void pretend_started(StateReceiverObject::SPtr receiver)
+    static void pretend_started(StateReceiverObject::SPtr receiver, string const& scope_id)
     {
-        receiver->push_state("scope-id", StateReceiverObject::State::ScopeReady);
+        receiver->push_state(scope_id, StateReceiverObject::State::ScopeReady);
     }
 
     ScopeMetadata make_meta(const string& scope_id)
@@ -186,6 +185,34 @@ protected:
         EXPECT_TRUE(registry->is_scope_running("scope-id"));
     }
 
+    // Adds a scope that shares its process with the other hosted scopes.
+    void add_hosted_scope(string const& scope_id, string const& scope_config)
+    {
+        RegistryObject::ScopeExecData exec_data;
+        exec_data.scope_id = scope_id;
+        exec_data.scoperunner_path = "/path/scoperunner";
+        exec_data.runtime_config = "/path/runtime.ini";
+        exec_data.scope_config = scope_config;
+        exec_data.timeout_ms = 500;
+        exec_data.debug_mode = false;
+        exec_data.host_id = "shared-host";
+
+        if (!registry)
+        {
+            registry.reset(new RegistryObject(*death_observer(), executor, nullptr));
+        }
+        registry->add_local_scope(scope_id, make_meta(scope_id), exec_data);
+    }
+
+    void expect_host_spawn(vector<string> const& args)
+    {
+        EXPECT_CALL(*executor,
+                spawn(AllOf(Property(&Executor::Command::program, "/path/scoperunner"),
+                            Property(&Executor::Command::args, args)),
+                      StandardStream::stdin)).WillOnce(
+                Invoke(this, &TestRegistryObject::mock_exec));
+    }
+
     static std::shared_ptr<ChildProcess::DeathObserver> death_observer_;
 
     shared_ptr<MockExecutor> executor = make_shared<StrictMock<MockExecutor>>();
@@ -194,6 +221,7 @@ protected:
         { "30" }, map<string, string>(), StandardStream::empty);
 
     unique_ptr<thread> t_start;
+    string started_id = "scope-id";     // The scope ID the pretend process reports as ready
 
     unique_ptr<RegistryObject> registry;
 };
@@ -203,10 +231,11 @@ std::shared_ptr<ChildProcess::DeathObserver> TestRegistryObject::death_observer_
 TEST_F(TestRegistryObject, basic)
 {
     EXPECT_CALL(*executor,
-            exec("/path/scoperunner", vector<string>
-                    {   "/path/runtime.ini", "scope.ini"}, _,
-                    StandardStream::stdin,
-                    string())).WillOnce(
+            spawn(AllOf(Property(&Executor::Command::program, "/path/scoperunner"),
+                        Property(&Executor::Command::args, vector<string>
+                                {   "/path/runtime.ini", "scope.ini"}),
+                        Property(&Executor::Command::confinement_profile, string())),
+                  StandardStream::stdin)).WillOnce(
             Invoke(this, &TestRegistryObject::mock_exec));
 
     run_registry(string());
@@ -215,13 +244,78 @@ TEST_F(TestRegistryObject, basic)
 TEST_F(TestRegistryObject, confined)
 {
     EXPECT_CALL(*executor,
-            exec("/path/scoperunner", vector<string>
-                    {   "/path/runtime.ini", "scope.ini"}, _,
-                    StandardStream::stdin,
-                    "confinement profile")).WillOnce(
+            spawn(AllOf(Property(&Executor::Command::program, "/path/scoperunner"),
+                        Property(&Executor::Command::args, vector<string>
+                                {   "/path/runtime.ini", "scope.ini"}),
+                        Property(&Executor::Command::confinement_profile, string("confinement profile"))),
+                  StandardStream::stdin)).WillOnce(
             Invoke(this, &TestRegistryObject::mock_exec));
 
     run_registry("confinement profile");
 }
 
+TEST_F(TestRegistryObject, shared_host)
+{
+    // Both scopes run in a single process, which is started by locating either of them.
+    expect_host_spawn({ "/path/runtime.ini", "scope.ini", "other-scope.ini" });
+
+    add_hosted_scope("scope-A", "scope.ini");
+    add_hosted_scope("scope-B", "other-scope.ini");
+    EXPECT_FALSE(registry->is_scope_running("scope-A"));
+    EXPECT_FALSE(registry->is_scope_running("scope-B"));
+
+    started_id = "scope-B";
+    registry->locate("scope-A");
+    EXPECT_TRUE(registry->is_scope_running("scope-A"));
+    EXPECT_TRUE(registry->is_scope_running("scope-B"));
+
+    // The host is running already, so it is not spawned again.
+    registry->locate("scope-B");
+    EXPECT_TRUE(registry->is_scope_running("scope-B"));
+}
+
+TEST_F(TestRegistryObject, shared_host_add_scope)
+{
+    InSequence s;
+    expect_host_spawn({ "/path/runtime.ini", "scope.ini" });
+    expect_host_spawn({ "/path/runtime.ini", "scope.ini", "other-scope.ini" });
+
+    add_hosted_scope("scope-A", "scope.ini");
+    started_id = "scope-A";
+    registry->locate("scope-A");
+    EXPECT_TRUE(registry->is_scope_running("scope-A"));
+
+    // The running host doesn't know about scope-B, so adding scope-B stops the host.
+    add_hosted_scope("scope-B", "other-scope.ini");
+    EXPECT_FALSE(registry->is_scope_running("scope-A"));
+    EXPECT_FALSE(registry->is_scope_running("scope-B"));
+
+    // Locating scope-B starts a new host with both scopes.
+    registry->locate("scope-B");
+    EXPECT_TRUE(registry->is_scope_running("scope-A"));
+    EXPECT_TRUE(registry->is_scope_running("scope-B"));
+}
+
+TEST_F(TestRegistryObject, shared_host_remove_scope)
+{
+    InSequence s;
+    expect_host_spawn({ "/path/runtime.ini", "scope.ini", "other-scope.ini" });
+    expect_host_spawn({ "/path/runtime.ini", "other-scope.ini" });
+
+    add_hosted_scope("scope-A", "scope.ini");
+    add_hosted_scope("scope-B", "other-scope.ini");
+    started_id = "scope-B";
+    registry->locate("scope-B");
+    EXPECT_TRUE(registry->is_scope_running("scope-A"));
+
+    // Removing scope-A stops the host, which still runs scope-A.
+    EXPECT_TRUE(registry->remove_local_scope("scope-A"));
+    EXPECT_THROW(registry->locate("scope-A"), NotFoundException);
+    EXPECT_FALSE(registry->is_scope_running("scope-B"));
+
+    // Locating scope-B starts a new host without scope-A.
+    registry->locate("scope-B");
+    EXPECT_TRUE(registry->is_scope_running("scope-B"));
+}
+
 }
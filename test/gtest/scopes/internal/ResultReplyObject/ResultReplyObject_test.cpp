@@ -17,12 +17,14 @@
  */
 
 #include <unity/scopes/internal/ResultReplyObject.h>
+#include <unity/scopes/internal/CategoryRendererImpl.h>
 #include <unity/scopes/internal/DepartmentImpl.h>
 #include <unity/scopes/internal/RuntimeImpl.h>
 #include <unity/UnityExceptions.h>
 #include <unity/scopes/SearchListenerBase.h>
 #include <unity/scopes/Department.h>
 #include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/ScopeExceptions.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
@@ -99,3 +101,54 @@ TEST(ResultReplyObject, departments_push)
         }
     }
 }
+
+class CategoryReceiver : public SearchListenerBase
+{
+public:
+    void push(CategorisedResult) override {}
+
+    void push(Category::SCPtr const& category) override
+    {
+        categories.push_back(category);
+    }
+
+    void finished(CompletionDetails const& /*details*/) override {}
+
+    std::vector<Category::SCPtr> categories;
+};
+
+TEST(ResultReplyObject, evicted_renderer)
+{
+    std::string const json = R"({"template":{"category-layout":"vertical-journal"}})";
+    CategoryRenderer rdr(json);
+    auto const hash = CategoryRendererImpl::hash(rdr);
+    CategoryRendererImpl::note_received("ipc:///tmp/scope-foo#scope-foo!c=Scope", rdr);
+    auto const templates = CategoryRendererImpl::received_templates("ipc:///tmp/scope-foo#scope-foo!c=Scope");
+    ASSERT_EQ(1u, templates.count(hash));
+
+    // The cache evicts the template after we have told the scope about its hash.
+    for (int i = 0; i < 2000; ++i)
+    {
+        CategoryRenderer r(R"({"template":{"card-size":)" + std::to_string(i) + "}}");
+    }
+    EXPECT_THROW(CategoryRendererImpl::from_hash(hash), unity::scopes::NotFoundException);
+
+    auto df = []() -> void {};
+    auto runtime = internal::RuntimeImpl::create("", "Runtime.ini");
+    auto receiver = std::make_shared<CategoryReceiver>();
+    internal::ResultReplyObject reply(receiver, runtime.get(), "ipc:///tmp/scope-foo#scope-foo!c=Scope", 0);
+    reply.set_disconnect_function(df);
+    reply.set_known_renderers(templates);
+
+    // The scope sends just the hash, and we still get the full template.
+    VariantMap cat;
+    cat["id"] = "cat1";
+    cat["renderer_hash"] = hash;
+    VariantMap data;
+    data["category"] = cat;
+    reply.process_data(data);
+
+    ASSERT_EQ(1u, receiver->categories.size());
+    EXPECT_EQ("cat1", receiver->categories[0]->id());
+    EXPECT_EQ(json, receiver->categories[0]->renderer_template().data());
+}
@@ -157,7 +157,7 @@ TEST_F(RuntimeConfigTest, exceptions)
     catch (ConfigException const& e)
     {
         EXPECT_STREQ("unity::scopes::ConfigException: \"" TEST_DIR "/BadMW.ini\": Illegal value for Default.Middleware: "
-                     "\"Foo\": legal values are \"Zmq\" and \"REST\"",
+                     "\"Foo\": legal values are \"Zmq\", \"REST\", and \"Inproc\"",
                      e.what());
     }
 
@@ -17,6 +17,8 @@
  */
 
 #include <unity/scopes/internal/RuntimeImpl.h>
+#include <unity/scopes/internal/ScopeImpl.h>
+#include <unity/scopes/internal/StateReceiverObject.h>
 #include <unity/scopes/ScopeExceptions.h>
 #include <unity/UnityExceptions.h>
 #include <unity/util/ResourcePtr.h>
@@ -25,12 +27,14 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <valgrind/valgrind.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
 #include <gtest/gtest.h>
 #pragma GCC diagnostic pop
 
+#include <chrono>
 #include <fstream>
 
 #include <fcntl.h>
@@ -251,6 +255,161 @@ TEST(RuntimeImpl, directories)
     }
 }
 
+// Once the middleware has shut down, the scope must still tell the registry
+// that it is stopping, and it must do so quickly.
+
+TEST(RuntimeImpl, shutdown_latency)
+{
+    string const rt_ini_file = TEST_DIR "/Runtime.ini";
+    string const scope_ini_file = TEST_DIR "/TestScope.ini";
+
+    // Stand-in for the registry, so we can see the state updates from the scope.
+    auto reg_rt = RuntimeImpl::create("Registry", rt_ini_file);
+    auto reg_mw = reg_rt->factory()->find("Registry", "Zmq");
+    auto receiver = make_shared<StateReceiverObject>();
+
+    mutex m;
+    condition_variable cond;
+    vector<StateReceiverObject::State> states;
+    receiver->state_received().connect([&](string const& id, StateReceiverObject::State const& state)
+    {
+        if (id == "TestScope")
+        {
+            lock_guard<mutex> lock(m);
+            states.push_back(state);
+            cond.notify_all();
+        }
+    });
+    reg_mw->add_state_receiver_object("StateReceiver", receiver);
+
+    std::promise<void> promise;
+    auto initialized = promise.get_future();
+
+    auto rt = move(RuntimeImpl::create("TestScope", rt_ini_file));
+    TestScope testscope;
+    auto thread_func = [&rt, &testscope, &scope_ini_file, &promise]
+    {
+        rt->run_scope(&testscope, scope_ini_file, move(promise));
+    };
+    auto thread_done = std::async(launch::async, thread_func);
+
+    initialized.wait();
+    {
+        unique_lock<mutex> lock(m);
+        ASSERT_TRUE(cond.wait_for(lock, chrono::seconds(5), [&states] { return states.size() == 1; }));
+        EXPECT_EQ(StateReceiverObject::ScopeReady, states[0]);
+    }
+
+    auto start_time = chrono::steady_clock::now();
+    rt->destroy();
+    thread_done.get();
+    auto scope_done = chrono::steady_clock::now();
+    {
+        unique_lock<mutex> lock(m);
+        ASSERT_TRUE(cond.wait_for(lock, chrono::seconds(5), [&states] { return states.size() == 2; }));
+        EXPECT_EQ(StateReceiverObject::ScopeStopping, states[1]);
+    }
+    auto notified = chrono::steady_clock::now();
+
+    auto shutdown_ms = chrono::duration_cast<chrono::milliseconds>(scope_done - start_time).count();
+    auto notify_ms = chrono::duration_cast<chrono::milliseconds>(notified - start_time).count();
+    cout << "scope shutdown: " << shutdown_ms << " ms, registry notified after " << notify_ms << " ms" << endl;
+    EXPECT_LT(notify_ms, RUNNING_ON_VALGRIND ? 2000 : 300);
+
+    reg_rt->destroy();
+}
+
+// Scopes that share a process are loaded when the first request for them arrives,
+// and the process shuts down once all of its scopes are idle.
+
+TEST(RuntimeImpl, hosted_scopes)
+{
+    string const rt_ini_file = TEST_DIR "/Runtime.ini";
+
+    {
+        auto rt = RuntimeImpl::create("TestHost", rt_ini_file);
+        auto load = [](string const&, string const&) { return ScopeLoader::SPtr(); };
+        EXPECT_THROW(rt->run_hosted_scopes({}, load), InvalidArgumentException);
+        EXPECT_THROW(rt->run_hosted_scopes({ TEST_DIR "/HostedA.ini" }, nullptr), InvalidArgumentException);
+    }
+
+    mutex m;
+    condition_variable cond;
+    map<string, vector<StateReceiverObject::State>> states;
+    vector<pair<string, string>> loaded;
+
+    // Stand-in for the registry, so we can see the state updates from the hosted scopes.
+    auto reg_rt = RuntimeImpl::create("Registry", rt_ini_file);
+    auto reg_mw = reg_rt->factory()->find("Registry", "Zmq");
+    auto receiver = make_shared<StateReceiverObject>();
+    receiver->state_received().connect([&](string const& id, StateReceiverObject::State const& state)
+    {
+        lock_guard<mutex> lock(m);
+        states[id].push_back(state);
+        cond.notify_all();
+    });
+    reg_mw->add_state_receiver_object("StateReceiver", receiver);
+
+    // We don't have a scope library, so loading fails. We only remember which scope was loaded.
+    auto load = [&m, &loaded](string const& scope_id, string const& scope_ini_file) -> ScopeLoader::SPtr
+    {
+        lock_guard<mutex> lock(m);
+        loaded.push_back(make_pair(scope_id, scope_ini_file));
+        throw ResourceException("no scope library");
+    };
+
+    std::promise<void> promise;
+    auto initialized = promise.get_future();
+
+    auto start_time = chrono::steady_clock::now();
+    auto rt = RuntimeImpl::create("TestHost", rt_ini_file);
+    auto thread_func = [&rt, &load, &promise]
+    {
+        rt->run_hosted_scopes({ TEST_DIR "/HostedA.ini", TEST_DIR "/HostedB.ini" }, load, move(promise));
+    };
+    auto thread_done = std::async(launch::async, thread_func);
+
+    initialized.wait();
+    {
+        unique_lock<mutex> lock(m);
+        ASSERT_TRUE(cond.wait_for(lock, chrono::seconds(5), [&states]
+                                  { return states["HostedA"].size() == 1 && states["HostedB"].size() == 1; }));
+        EXPECT_EQ(StateReceiverObject::ScopeReady, states["HostedA"][0]);
+        EXPECT_EQ(StateReceiverObject::ScopeReady, states["HostedB"][0]);
+        EXPECT_TRUE(loaded.empty());
+    }
+
+    // A request for HostedA loads HostedA only.
+    {
+        auto client_rt = RuntimeImpl::create("", rt_ini_file);
+        auto mw = client_rt->factory()->create("client_middleware", "Zmq", TEST_DIR "/Zmq.ini");
+        mw->start();
+        auto scope = ScopeImpl::create(mw->create_scope_proxy("HostedA"), "HostedA");
+        EXPECT_THROW(scope->child_scopes(), MiddlewareException);
+    }
+    {
+        lock_guard<mutex> lock(m);
+        ASSERT_EQ(1u, loaded.size());
+        EXPECT_EQ("HostedA", loaded[0].first);
+        EXPECT_EQ(TEST_DIR "/HostedA.ini", loaded[0].second);
+    }
+
+    // No scope is loaded, so the host shuts down once the scopes have been idle for their idle timeout.
+    ASSERT_EQ(future_status::ready, thread_done.wait_for(chrono::seconds(10)));
+    thread_done.get();
+    EXPECT_GT(chrono::steady_clock::now() - start_time, chrono::seconds(2));
+    {
+        unique_lock<mutex> lock(m);
+        ASSERT_TRUE(cond.wait_for(lock, chrono::seconds(5), [&states]
+                                  { return states["HostedA"].size() == 2 && states["HostedB"].size() == 2; }));
+        EXPECT_EQ(StateReceiverObject::ScopeStopping, states["HostedA"][1]);
+        EXPECT_EQ(StateReceiverObject::ScopeStopping, states["HostedB"][1]);
+        EXPECT_EQ(1u, loaded.size());
+    }
+
+    reg_rt->destroy();
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/SearchReplyImpl.h>
+
+#include <unity/scopes/CategoryRenderer.h>
+#include <unity/scopes/internal/CategoryRendererImpl.h>
+#include <unity/scopes/internal/MWReply.h>
+#include <unity/scopes/internal/QueryObjectBase.h>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+namespace
+{
+
+// Stands in for the middleware and captures what the scope sends to the client.
+
+class CapturingReply : public MWReply
+{
+public:
+    CapturingReply()
+        : MWObjectProxy(nullptr)
+        , MWReply(nullptr)
+    {
+    }
+
+    MiddlewareBase* mw_base() const noexcept override
+    {
+        return nullptr;
+    }
+
+    string identity() const override
+    {
+        return "reply";
+    }
+
+    string target_category() const override
+    {
+        return "";
+    }
+
+    string endpoint() const override
+    {
+        return "";
+    }
+
+    int64_t timeout() const noexcept override
+    {
+        return -1;
+    }
+
+    string to_string() const override
+    {
+        return "reply";
+    }
+
+    void ping() override
+    {
+    }
+
+    void push(VariantMap const& result) override
+    {
+        pushed.push_back(result);
+    }
+
+    void finished(CompletionDetails const&) override
+    {
+    }
+
+    void info(OperationInfo const&) override
+    {
+    }
+
+    vector<VariantMap> pushed;
+};
+
+class TestQueryObject : public QueryObjectBase
+{
+public:
+    void run(MWReplyProxy const&, InvokeInfo const&) noexcept override
+    {
+    }
+
+    void cancel(InvokeInfo const&) override
+    {
+    }
+
+    bool pushable(InvokeInfo const&) const noexcept override
+    {
+        return true;
+    }
+
+    int cardinality(InvokeInfo const&) const noexcept override
+    {
+        return 0;
+    }
+
+    void set_self(SPtr const&) noexcept override
+    {
+    }
+};
+
+} // namespace
+
+TEST(SearchReplyImpl, category_renderer_hash)
+{
+    CategoryRenderer known(R"({"template":{"category-layout":"grid"}})");
+    CategoryRenderer unknown(R"({"template":{"category-layout":"carousel"}})");
+    auto const known_hash = CategoryRendererImpl::hash(known);
+
+    auto mw_reply = make_shared<CapturingReply>();
+    auto qo = make_shared<TestQueryObject>();
+    {
+        // A non-empty query string, so finishing the reply doesn't write a surfacing cache file.
+        SearchReplyImpl reply(mw_reply, qo, 0, "query", "", { known_hash });
+        reply.register_category("cat1", "Cat 1", "", known);
+        reply.register_category("cat2", "Cat 2", "", unknown);
+    }
+
+    ASSERT_EQ(2u, mw_reply->pushed.size());
+
+    // The client has the first template already, so only its hash goes over the wire.
+    auto cat = mw_reply->pushed[0]["category"].get_dict();
+    EXPECT_EQ("cat1", cat["id"].get_string());
+    EXPECT_EQ(known_hash, cat["renderer_hash"].get_string());
+    EXPECT_EQ(cat.end(), cat.find("renderer_template"));
+
+    // The client doesn't have the second template, so it is sent in full.
+    cat = mw_reply->pushed[1]["category"].get_dict();
+    EXPECT_EQ("cat2", cat["id"].get_string());
+    EXPECT_EQ(unknown.data(), cat["renderer_template"].get_string());
+    EXPECT_EQ(cat.end(), cat.find("renderer_hash"));
+}
+
+TEST(SearchReplyImpl, no_known_renderers)
+{
+    CategoryRenderer rdr(R"({"template":{"category-layout":"grid"}})");
+
+    auto mw_reply = make_shared<CapturingReply>();
+    auto qo = make_shared<TestQueryObject>();
+    {
+        SearchReplyImpl reply(mw_reply, qo, 0, "query", "");
+        reply.register_category("cat1", "Cat 1", "", rdr);
+    }
+
+    ASSERT_EQ(1u, mw_reply->pushed.size());
+    auto cat = mw_reply->pushed[0]["category"].get_dict();
+    EXPECT_EQ(rdr.data(), cat["renderer_template"].get_string());
+    EXPECT_EQ(cat.end(), cat.find("renderer_hash"));
+}
+
+TEST(SearchReplyImpl, cache_directory)
+{
+    // Scopes that share a process each cache their surfacing results in their own directory.
+    string const dir_a = TEST_DIR "/cache-a";
+    string const dir_b = TEST_DIR "/cache-b";
+    boost::filesystem::remove_all(dir_a);
+    boost::filesystem::remove_all(dir_b);
+    boost::filesystem::create_directories(dir_a);
+    boost::filesystem::create_directories(dir_b);
+
+    CategoryRenderer rdr;
+    auto qo = make_shared<TestQueryObject>();
+    {
+        auto mw_reply = make_shared<CapturingReply>();
+        SearchReplyImpl reply(mw_reply, qo, 0, "", "");
+        reply.set_cache_directory(dir_a);
+        reply.register_category("cat1", "Cat 1", "", rdr);
+        reply.finished();
+    }
+    EXPECT_TRUE(boost::filesystem::exists(dir_a + "/.surfacing_cache"));
+    EXPECT_FALSE(boost::filesystem::exists(dir_b + "/.surfacing_cache"));
+
+    // Nothing was cached for the second scope, so it doesn't get the first scope's results.
+    {
+        auto mw_reply = make_shared<CapturingReply>();
+        SearchReplyImpl reply(mw_reply, qo, 0, "", "");
+        reply.set_cache_directory(dir_b);
+        reply.push_surfacing_results_from_cache();
+        EXPECT_TRUE(mw_reply->pushed.empty());
+    }
+
+    // But the first scope does.
+    {
+        auto mw_reply = make_shared<CapturingReply>();
+        SearchReplyImpl reply(mw_reply, qo, 0, "", "");
+        reply.set_cache_directory(dir_a);
+        reply.push_surfacing_results_from_cache();
+        ASSERT_FALSE(mw_reply->pushed.empty());
+        EXPECT_EQ("cat1", mw_reply->pushed[0]["category"].get_dict()["id"].get_string());
+    }
+}
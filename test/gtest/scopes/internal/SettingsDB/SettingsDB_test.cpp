@@ -39,6 +39,12 @@ using namespace std;
 
 string const db_name = TEST_BIN_DIR "/foo.ini";
 
+// SettingsDB picks up changes in the background, wait until it has done so.
+void wait_for_watcher(SettingsDB& db)
+{
+    EXPECT_TRUE(db.wait_for_refresh(std::chrono::seconds(5))) << "settings did not pick up the change to " << db_name;
+}
+
 void write_db(const string& src)
 {
     // make sure the next write doesn't happen too fast or otherwise modification time of settings db
@@ -103,6 +109,7 @@ TEST(SettingsDB, basic)
 
         // Create the DB now, but without any recognizable records.
         write_db("db_empty.ini");
+        wait_for_watcher(*db);
 
         // Default values must still be there.
         EXPECT_EQ(4u, db->settings().size());
@@ -113,6 +120,7 @@ TEST(SettingsDB, basic)
 
         // Add a record that looks like a settings document, but for which there is no schema.
         write_db("db_unknown_setting.ini");
+        wait_for_watcher(*db);
 
         // Default values must still be there.
         EXPECT_EQ(4u, db->settings().size());
@@ -123,6 +131,7 @@ TEST(SettingsDB, basic)
 
         // Change the location.
         write_db("db_location.ini");
+        wait_for_watcher(*db);
         EXPECT_EQ(4u, db->settings().size());
         EXPECT_EQ("New York", db->settings()["locationSetting"].get_string());
         EXPECT_EQ(1, db->settings()["unitTempSetting"].get_int());
@@ -131,6 +140,7 @@ TEST(SettingsDB, basic)
 
         // Change the unit.
         write_db("db_loctemp.ini");
+        wait_for_watcher(*db);
         EXPECT_EQ(4u, db->settings().size());
         EXPECT_EQ("New York", db->settings()["locationSetting"].get_string());
         EXPECT_EQ(0, db->settings()["unitTempSetting"].get_int());
@@ -139,6 +149,7 @@ TEST(SettingsDB, basic)
 
         // Change the age.
         write_db("db_loctempage.ini");
+        wait_for_watcher(*db);
         EXPECT_EQ(4u, db->settings().size());
         EXPECT_EQ("New York", db->settings()["locationSetting"].get_string());
         EXPECT_EQ(0, db->settings()["unitTempSetting"].get_int());
@@ -156,6 +167,7 @@ TEST(SettingsDB, basic)
 
         // Change enabled boolean.
         write_db("db_loctempageenabled.ini");
+        wait_for_watcher(*db);
         EXPECT_EQ(4u, db->settings().size());
         EXPECT_EQ("New York", db->settings()["locationSetting"].get_string());
         EXPECT_EQ(0, db->settings()["unitTempSetting"].get_int());
@@ -177,6 +189,7 @@ TEST(SettingsDB, basic)
 
         // Add records to supply the values.
         write_db("db_loctemp.ini");
+        wait_for_watcher(*db);
 
         // Check that they are correct
         EXPECT_EQ(4u, db->settings().size());
@@ -195,6 +208,7 @@ TEST(SettingsDB, basic)
 
         // Add records to supply the values.
         write_db("db_loctemp.ini");
+        wait_for_watcher(*db);
 
         // Check that they are correct.
         EXPECT_EQ(4u, db->settings().size());
@@ -205,6 +219,7 @@ TEST(SettingsDB, basic)
 
         // Update a value with a nonsense setting, to make sure that nonsense settings are ignored.
         write_db("db_loctemp_bad_age.ini");
+        wait_for_watcher(*db);
 
         // Check that nothing has changed.
         EXPECT_EQ(4u, db->settings().size());
@@ -229,6 +244,7 @@ TEST(SettingsDB, chinese_characters)
 
         // Change the location.
         write_db("db_chinese_location.ini");
+        wait_for_watcher(*db);
         EXPECT_EQ(1u, db->settings().size());
         EXPECT_EQ("丈", db->settings()["locationSetting"].get_string());
     }
@@ -251,6 +267,7 @@ TEST(SettingsDB, delete_db)
 
         // Create the DB now, with a bunch of settings.
         write_db("db_loctempageenabled.ini");
+        wait_for_watcher(*db);
 
         // Settings should be updated.
         EXPECT_EQ(4u, db->settings().size());
@@ -261,6 +278,7 @@ TEST(SettingsDB, delete_db)
 
         // Now remove the database.
         unlink(db_name.c_str());
+        wait_for_watcher(*db);
 
         // Default values should come back.
         EXPECT_EQ(4u, db->settings().size());
@@ -271,6 +289,34 @@ TEST(SettingsDB, delete_db)
     }
 }
 
+TEST(SettingsDB, replace_db)
+{
+    auto schema = TEST_SRC_DIR "/schema.ini";
+
+    unlink(db_name.c_str());
+    auto db = SettingsDB::create_from_ini_file(db_name, schema);
+    EXPECT_EQ("London", db->settings()["locationSetting"].get_string());
+
+    // Editors and settings UIs commonly write a new file and rename it over the old one.
+    string const tmp_name = db_name + ".tmp";
+    if (system((string("cp ") + TEST_SRC_DIR "/db_location_munich.ini " + tmp_name).c_str()) != 0)
+    {
+        FAIL();
+    }
+    ASSERT_EQ(0, rename(tmp_name.c_str(), db_name.c_str()));
+    wait_for_watcher(*db);
+    EXPECT_EQ("Munich", db->settings()["locationSetting"].get_string());
+
+    // Changes to other files in the same directory don't affect the settings.
+    if (system((string("cp ") + TEST_SRC_DIR "/db_location.ini " + tmp_name).c_str()) != 0)
+    {
+        FAIL();
+    }
+    wait_for_watcher(*db);
+    EXPECT_EQ("Munich", db->settings()["locationSetting"].get_string());
+    unlink(tmp_name.c_str());
+}
+
 TEST(SettingsDB, from_json_string)
 {
     char const* ok_schema = R"delimiter(
@@ -299,6 +345,7 @@ TEST(SettingsDB, from_json_string)
 
         // Change the location.
         write_db("db_location_json.ini");
+        wait_for_watcher(*db);
         EXPECT_EQ(1u, db->settings().size());
         EXPECT_EQ("New York", db->settings()["location"].get_string());
     }
@@ -340,12 +387,14 @@ TEST(SettingsDB, exceptions)
 
         // Add a record, which creates the DB
         write_db("db_location.ini");
+        wait_for_watcher(*db);
 
         // Remove read permission.
         if (system(string("chmod -r " + db_name).c_str()) < 0)
         {
             FAIL();
         }
+        wait_for_watcher(*db);
 
         // Call settings(), which will try to open the DB and fail.
         db->settings();
@@ -378,6 +427,7 @@ TEST(SettingsDB, exceptions)
         {
             FAIL();
         }
+        wait_for_watcher(*db);
 
         // Call settings(), which will fail.
         db->settings();
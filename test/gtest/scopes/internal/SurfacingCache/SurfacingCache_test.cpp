@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/SurfacingCache.h>
+
+#include <unity/scopes/CategoryRenderer.h>
+#include <unity/scopes/Location.h>
+#include <unity/UnityExceptions.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <thread>
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+TEST(SurfacingCache, key)
+{
+    SearchMetadata md("en", "phone");
+    CannedQuery q("scope-A", "", "");
+    auto const k = SurfacingCache::key(q, md);
+    EXPECT_FALSE(k.empty());
+
+    // Search queries are not cached.
+    EXPECT_TRUE(SurfacingCache::key(CannedQuery("scope-A", "foo", ""), md).empty());
+
+    // Department, metadata, and location are part of the key.
+    EXPECT_NE(k, SurfacingCache::key(CannedQuery("scope-A", "", "dept"), md));
+    EXPECT_NE(k, SurfacingCache::key(q, SearchMetadata("de", "phone")));
+    md.set_location(Location(1.0, 2.0));
+    auto const k1 = SurfacingCache::key(q, md);
+    EXPECT_NE(k, k1);
+    EXPECT_EQ(k1, SurfacingCache::key(q, md));
+    md.set_location(Location(3.0, 4.0));
+    EXPECT_NE(k1, SurfacingCache::key(q, md));
+}
+
+TEST(SurfacingCache, lookup)
+{
+    EXPECT_EQ(chrono::seconds(60), SurfacingCache::ttl(ScopeMetadata::ResultsTtlType::Small));
+    EXPECT_EQ(chrono::seconds(3600), SurfacingCache::ttl(ScopeMetadata::ResultsTtlType::Large));
+    EXPECT_THROW(SurfacingCache(ScopeMetadata::ResultsTtlType::None), unity::InvalidArgumentException);
+    EXPECT_THROW(SurfacingCache(chrono::seconds(1), 0), unity::InvalidArgumentException);
+
+    SurfacingCache cache(chrono::milliseconds(200));
+    bool stale = false;
+    EXPECT_EQ(nullptr, cache.lookup("k", stale));
+
+    auto entry = make_shared<SurfacingCache::Entry>();
+    cache.store("k", entry);
+    EXPECT_EQ(entry, cache.lookup("k", stale));
+    EXPECT_FALSE(stale);
+
+    this_thread::sleep_for(chrono::milliseconds(300));
+    EXPECT_EQ(entry, cache.lookup("k", stale));
+    EXPECT_TRUE(stale);
+
+    EXPECT_EQ(1, cache.hits());
+    EXPECT_EQ(1, cache.stale_hits());
+    EXPECT_EQ(1, cache.misses());
+
+    EXPECT_TRUE(cache.begin_refresh("k"));
+    EXPECT_FALSE(cache.begin_refresh("k"));
+    cache.end_refresh("k");
+    EXPECT_TRUE(cache.begin_refresh("k"));
+}
+
+TEST(SurfacingCache, eviction)
+{
+    SurfacingCache cache(chrono::seconds(10), 2);
+    cache.store("a", make_shared<SurfacingCache::Entry>());
+    this_thread::sleep_for(chrono::milliseconds(10));
+    cache.store("b", make_shared<SurfacingCache::Entry>());
+    cache.store("c", make_shared<SurfacingCache::Entry>());
+
+    bool stale;
+    EXPECT_EQ(nullptr, cache.lookup("a", stale));
+    EXPECT_NE(nullptr, cache.lookup("b", stale));
+    EXPECT_NE(nullptr, cache.lookup("c", stale));
+}
+
+TEST(SurfacingCache, refresh_reply)
+{
+    auto cache = make_shared<SurfacingCache>(chrono::seconds(10));
+    ASSERT_TRUE(cache->begin_refresh("k"));
+    {
+        auto reply = make_shared<SurfacingRefreshReply>(cache, "k", 2);
+        auto cat = reply->register_category("cat1", "title", "icon", CategoryRenderer());
+        for (int i = 0; i < 3; ++i)
+        {
+            CategorisedResult r(cat);
+            r.set_uri("uri" + to_string(i));
+            EXPECT_EQ(i == 0, reply->push(r));  // Cardinality limit is 2.
+        }
+    }
+
+    bool stale;
+    auto entry = cache->lookup("k", stale);
+    ASSERT_NE(nullptr, entry);
+    EXPECT_FALSE(stale);
+    ASSERT_EQ(1u, entry->categories.size());
+    EXPECT_EQ("cat1", entry->categories[0]->id());
+    ASSERT_EQ(2u, entry->results.size());
+    EXPECT_EQ("uri1", entry->results[1].uri());
+    EXPECT_TRUE(cache->begin_refresh("k"));  // Refresh has ended.
+
+    // A failed refresh leaves the entry alone.
+    {
+        auto reply = make_shared<SurfacingRefreshReply>(cache, "k", 0);
+        reply->error(make_exception_ptr(unity::ResourceException("no network")));
+    }
+    EXPECT_EQ(entry, cache->lookup("k", stale));
+}
@@ -23,6 +23,9 @@
 #include <gtest/gtest.h>
 #pragma GCC diagnostic pop
 
+#include <set>
+#include <thread>
+
 using namespace std;
 using namespace unity::scopes::internal;
 
@@ -62,3 +65,38 @@ TEST(UniqueID, seed)
     string id2 = v.gen();
     EXPECT_EQ(id, id2);
 }
+
+TEST(UniqueID, threads)
+{
+    UniqueID u;
+
+    const int num_threads = 8;
+    const int num_ids = 10000;
+    vector<vector<string>> ids(num_threads);
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(thread([&u, &ids, t]
+        {
+            for (int i = 0; i < num_ids; ++i)
+            {
+                ids[t].push_back(u.gen());
+            }
+        }));
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    set<string> all;
+    for (auto const& v : ids)
+    {
+        for (auto const& id : v)
+        {
+            EXPECT_EQ(16u, id.size());
+            all.insert(id);
+        }
+    }
+    EXPECT_EQ(size_t(num_threads * num_ids), all.size());
+}
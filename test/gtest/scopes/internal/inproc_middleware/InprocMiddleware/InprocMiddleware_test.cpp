@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/ActionMetadata.h>
+#include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/internal/RuntimeImpl.h>
+#include <unity/scopes/PreviewQueryBase.h>
+#include <unity/scopes/PreviewReply.h>
+#include <unity/scopes/QueryCtrl.h>
+#include <unity/scopes/Scope.h>
+#include <unity/scopes/ScopeBase.h>
+#include <unity/scopes/ScopeExceptions.h>
+#include <unity/scopes/SearchQueryBase.h>
+#include <unity/scopes/SearchReply.h>
+#include <unity/UnityExceptions.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <condition_variable>
+#include <future>
+#include <thread>
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+
+namespace
+{
+
+// Pushes three results, unless the query string is "slow", in which case
+// the query runs until it is cancelled.
+
+class TestQuery : public SearchQueryBase
+{
+public:
+    TestQuery(CannedQuery const& query, SearchMetadata const& metadata)
+        : SearchQueryBase(query, metadata)
+        , cancelled_(false)
+    {
+    }
+
+    virtual void cancelled() override
+    {
+        lock_guard<mutex> lock(mutex_);
+        cancelled_ = true;
+        cond_.notify_all();
+    }
+
+    virtual void run(SearchReplyProxy const& reply) override
+    {
+        if (query().query_string() == "slow")
+        {
+            unique_lock<mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return cancelled_; });
+            return;
+        }
+
+        auto cat = reply->register_category("cat1", "Category 1", "");
+        for (int i = 0; i < 3; ++i)
+        {
+            CategorisedResult res(cat);
+            res.set_uri("uri" + to_string(i));
+            res.set_title("title");
+            res.set_dnd_uri("dnd_uri");
+            reply->push(res);
+        }
+    }
+
+private:
+    bool cancelled_;
+    mutex mutex_;
+    condition_variable cond_;
+};
+
+class TestPreview : public PreviewQueryBase
+{
+public:
+    TestPreview(Result const& result, ActionMetadata const& metadata)
+        : PreviewQueryBase(result, metadata)
+    {
+    }
+
+    virtual void cancelled() override
+    {
+    }
+
+    virtual void run(PreviewReplyProxy const& reply) override
+    {
+        PreviewWidgetList widgets;
+        widgets.emplace_back(PreviewWidget(R"({"id": "header", "type": "header", "title": "title"})"));
+        reply->push(widgets);
+        reply->push("uri", Variant(result().uri()));
+    }
+};
+
+class TestScope : public ScopeBase
+{
+public:
+    virtual SearchQueryBase::UPtr search(CannedQuery const& query, SearchMetadata const& metadata) override
+    {
+        return SearchQueryBase::UPtr(new TestQuery(query, metadata));
+    }
+
+    virtual PreviewQueryBase::UPtr preview(Result const& result, ActionMetadata const& metadata) override
+    {
+        return PreviewQueryBase::UPtr(new TestPreview(result, metadata));
+    }
+};
+
+class WaitUntilFinished
+{
+public:
+    WaitUntilFinished()
+        : query_complete_(false)
+        , status_(CompletionDetails::Error)
+    {
+    }
+
+    CompletionDetails::CompletionStatus wait_until_finished()
+    {
+        unique_lock<mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return query_complete_; });
+        return status_;
+    }
+
+protected:
+    void notify(CompletionDetails const& details)
+    {
+        lock_guard<mutex> lock(mutex_);
+        query_complete_ = true;
+        status_ = details.status();
+        cond_.notify_all();
+    }
+
+    mutex mutex_;
+
+private:
+    bool query_complete_;
+    CompletionDetails::CompletionStatus status_;
+    condition_variable cond_;
+};
+
+class Receiver : public SearchListenerBase, public WaitUntilFinished
+{
+public:
+    virtual void push(CategorisedResult result) override
+    {
+        lock_guard<mutex> lock(mutex_);
+        uris_.push_back(result.uri());
+        last_result_ = make_shared<Result>(result);
+    }
+
+    virtual void finished(CompletionDetails const& details) override
+    {
+        notify(details);
+    }
+
+    vector<string> uris()
+    {
+        lock_guard<mutex> lock(mutex_);
+        return uris_;
+    }
+
+    shared_ptr<Result> last_result()
+    {
+        lock_guard<mutex> lock(mutex_);
+        return last_result_;
+    }
+
+private:
+    vector<string> uris_;
+    shared_ptr<Result> last_result_;
+};
+
+class PreviewReceiver : public PreviewListenerBase, public WaitUntilFinished
+{
+public:
+    PreviewReceiver()
+        : widgets_(0)
+    {
+    }
+
+    virtual void push(PreviewWidgetList const& widgets) override
+    {
+        lock_guard<mutex> lock(mutex_);
+        widgets_ += widgets.size();
+    }
+
+    virtual void push(string const& key, Variant const& value) override
+    {
+        lock_guard<mutex> lock(mutex_);
+        data_[key] = value;
+    }
+
+    virtual void push(ColumnLayoutList const&) override
+    {
+    }
+
+    virtual void finished(CompletionDetails const& details) override
+    {
+        notify(details);
+    }
+
+    size_t widgets()
+    {
+        lock_guard<mutex> lock(mutex_);
+        return widgets_;
+    }
+
+    VariantMap data()
+    {
+        lock_guard<mutex> lock(mutex_);
+        return data_;
+    }
+
+private:
+    size_t widgets_;
+    VariantMap data_;
+};
+
+ScopeProxy test_scope(RuntimeImpl::UPtr const& rt)
+{
+    return dynamic_pointer_cast<Scope>(rt->string_to_proxy("inproc://TestScope#TestScope"));
+}
+
+} // namespace
+
+TEST(InprocMiddleware, search)
+{
+    auto rt = RuntimeImpl::create("", "Runtime.ini");
+    auto scope = test_scope(rt);
+    ASSERT_TRUE(scope != nullptr);
+
+    auto receiver = make_shared<Receiver>();
+    scope->search("test", SearchMetadata("en", "phone"), receiver);
+    EXPECT_EQ(CompletionDetails::OK, receiver->wait_until_finished());
+    EXPECT_EQ((vector<string>{ "uri0", "uri1", "uri2" }), receiver->uris());
+}
+
+TEST(InprocMiddleware, preview)
+{
+    auto rt = RuntimeImpl::create("", "Runtime.ini");
+    auto scope = test_scope(rt);
+
+    auto receiver = make_shared<Receiver>();
+    scope->search("test", SearchMetadata("en", "phone"), receiver);
+    ASSERT_EQ(CompletionDetails::OK, receiver->wait_until_finished());
+    auto result = receiver->last_result();
+    ASSERT_TRUE(result != nullptr);
+
+    auto previewer = make_shared<PreviewReceiver>();
+    scope->preview(*result, ActionMetadata("en", "phone"), previewer);
+    EXPECT_EQ(CompletionDetails::OK, previewer->wait_until_finished());
+    EXPECT_EQ(1u, previewer->widgets());
+    EXPECT_EQ("uri2", previewer->data()["uri"].get_string());
+}
+
+TEST(InprocMiddleware, cancel)
+{
+    auto rt = RuntimeImpl::create("", "Runtime.ini");
+    auto scope = test_scope(rt);
+
+    auto receiver = make_shared<Receiver>();
+    auto ctrl = scope->search("slow", SearchMetadata("en", "phone"), receiver);
+    ctrl->cancel();
+    EXPECT_EQ(CompletionDetails::Cancelled, receiver->wait_until_finished());
+    EXPECT_TRUE(receiver->uris().empty());
+}
+
+TEST(InprocMiddleware, no_such_scope)
+{
+    auto rt = RuntimeImpl::create("", "Runtime.ini");
+    auto scope = dynamic_pointer_cast<Scope>(rt->string_to_proxy("inproc://NoSuchScope#NoSuchScope"));
+    ASSERT_TRUE(scope != nullptr);
+
+    auto receiver = make_shared<Receiver>();
+    EXPECT_THROW(scope->search("test", SearchMetadata("en", "phone"), receiver), ObjectNotExistException);
+}
+
+TEST(InprocMiddleware, proxy_strings)
+{
+    auto rt = RuntimeImpl::create("", "Runtime.ini");
+
+    auto proxy = rt->string_to_proxy("inproc://TestScope#TestScope!t=200");
+    EXPECT_EQ("inproc://TestScope#TestScope!c=Scope!t=200", rt->proxy_to_string(proxy));
+    proxy = rt->string_to_proxy(rt->proxy_to_string(proxy));
+    EXPECT_EQ("inproc://TestScope#TestScope!c=Scope!t=200", rt->proxy_to_string(proxy));
+
+    EXPECT_THROW(rt->string_to_proxy("inproc://TestScope"), unity::ResourceException);
+    EXPECT_THROW(rt->string_to_proxy("inproc://#TestScope"), unity::ResourceException);
+    EXPECT_THROW(rt->string_to_proxy("inproc://TestScope#"), unity::ResourceException);
+    EXPECT_THROW(rt->string_to_proxy("inproc://TestScope#TestScope!t=-2"), unity::ResourceException);
+    EXPECT_THROW(rt->string_to_proxy("inproc://TestScope#TestScope!x=1"), unity::ResourceException);
+    EXPECT_THROW(rt->string_to_proxy("inproc://TestScope#TestScope!c=Registry"), unity::ResourceException);
+}
+
+TEST(InprocMiddleware, no_registry)
+{
+    auto rt = RuntimeImpl::create("", "Runtime.ini");
+    EXPECT_EQ("", rt->registry_identity());
+    EXPECT_THROW(rt->registry(), ConfigException);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    auto srt = RuntimeImpl::create("TestScope", "Runtime.ini");
+    TestScope scope;
+    promise<void> ready;
+    auto ready_future = ready.get_future();
+    thread scope_t([&srt, &scope, &ready] { srt->run_scope(&scope, "", move(ready)); });
+    ready_future.wait();
+
+    int rc = RUN_ALL_TESTS();
+
+    srt->destroy();
+    scope_t.join();
+
+    return rc;
+}
@@ -339,6 +339,52 @@ TEST(ObjectAdapter, add_remove_find)
     EXPECT_EQ(nullptr, a.find("fred").get());
 }
 
+TEST(ObjectAdapter, concurrent_add_remove)
+{
+    auto rt = RuntimeImpl::create("testscope", runtime_ini);
+    ZmqMiddleware mw("testscope", rt.get(), zmq_ini);
+
+    wait();
+    ObjectAdapter a(mw, "testscope", "ipc://testscope", RequestMode::Twoway, 5);
+
+    // Each thread adds, finds, and removes its own servants, as for the servants of concurrent queries.
+    const int num_threads = 8;
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(thread([&a, t]
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                string const id = to_string(t) + "-" + to_string(i);
+                shared_ptr<MyServant> o(new MyServant);
+                a.add(id, o);
+                EXPECT_EQ(o, a.find(id));
+                a.remove(id);
+                EXPECT_EQ(nullptr, a.find(id).get());
+            }
+        }));
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    a.shutdown();
+    a.wait_for_shutdown();
+    try
+    {
+        a.find("fred");
+        FAIL();
+    }
+    catch (MiddlewareException const& e)
+    {
+        EXPECT_STREQ("unity::scopes::MiddlewareException: find(): Object adapter in Destroyed "
+                     "state (adapter: testscope)",
+                     e.what());
+    }
+}
+
 TEST(ObjectAdapter, dispatch_oneway_to_twoway)
 {
     ZmqMiddleware mw("testscope", nullptr, zmq_ini);
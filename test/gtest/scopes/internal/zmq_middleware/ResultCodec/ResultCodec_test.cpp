@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/zmq_middleware/ResultCodec.h>
+
+#include <unity/scopes/internal/zmq_middleware/VariantConverter.h>
+#include <unity/scopes/internal/ResultImpl.h>
+#include <unity/scopes/ScopeExceptions.h>
+#include <unity/UnityExceptions.h>
+
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace unity::scopes;
+using namespace unity::scopes::internal;
+using namespace unity::scopes::internal::zmq_middleware;
+
+namespace
+{
+
+// What SearchReplyImpl pushes for a typical result.
+VariantMap make_push(int i)
+{
+    VariantMap attrs;
+    attrs["uri"] = Variant("http://www.example.com/item/" + to_string(i));
+    attrs["title"] = Variant("Item " + to_string(i));
+    attrs["art"] = Variant("file:///usr/share/icons/item" + to_string(i) + ".png");
+    attrs["dnd_uri"] = Variant("http://www.example.com/dnd/" + to_string(i));
+    attrs["subtitle"] = Variant("Subtitle");
+    attrs["rating"] = Variant(i * 0.5);
+    attrs["price"] = Variant(i);
+
+    VariantMap internal;
+    internal["cat_id"] = Variant("cat1");
+    internal["origin"] = Variant("scope-A");
+    if (i % 2)
+    {
+        internal["flags"] = Variant(1);
+    }
+
+    VariantMap result;
+    result["attrs"] = Variant(attrs);
+    result["internal"] = Variant(internal);
+
+    VariantMap push;
+    push["result"] = Variant(result);
+    return push;
+}
+
+size_t encode(ResultEncoder& encoder, VariantMap const& push, capnp::MallocMessageBuilder& message)
+{
+    auto b = message.initRoot<capnproto::Reply::Result>();
+    encoder.encode(push, b);
+    return capnp::computeSerializedSizeInWords(message) * sizeof(capnp::word);
+}
+
+VariantMap decode(ResultDecoder& decoder, capnp::MallocMessageBuilder& message)
+{
+    return decoder.decode(message.getRoot<capnproto::Reply::Result>().asReader());
+}
+
+} // namespace
+
+TEST(ResultCodec, encodable)
+{
+    EXPECT_TRUE(ResultEncoder::encodable(make_push(1)));
+
+    EXPECT_FALSE(ResultEncoder::encodable(VariantMap()));
+    EXPECT_FALSE(ResultEncoder::encodable(VariantMap{ { "category", Variant(VariantMap()) } }));
+    EXPECT_FALSE(ResultEncoder::encodable(VariantMap{ { "result", Variant(1) } }));
+    EXPECT_FALSE(ResultEncoder::encodable(VariantMap{ { "result", Variant(VariantMap{ { "attrs", Variant(VariantMap()) } }) } }));
+
+    auto push = make_push(1);
+    push["annotation"] = Variant(VariantMap());
+    EXPECT_FALSE(ResultEncoder::encodable(push));
+}
+
+TEST(ResultCodec, round_trip)
+{
+    ResultEncoder encoder;
+    ResultDecoder decoder;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        capnp::MallocMessageBuilder message;
+        auto const push = make_push(i);
+        encode(encoder, push, message);
+        EXPECT_EQ(push, decode(decoder, message));
+    }
+
+    // Values that don't fit the fixed fields, and a stored result.
+    auto push = make_push(0);
+    auto result = push["result"].get_dict();
+    auto attrs = result["attrs"].get_dict();
+    attrs["title"] = Variant("");
+    attrs["art"] = Variant(42);
+    attrs["new_attr"] = Variant(VariantArray{ Variant(1), Variant("x") });
+    auto internal = result["internal"].get_dict();
+    internal["flags"] = Variant(0);
+    internal["result"] = Variant(make_push(5)["result"].get_dict());
+    result["attrs"] = Variant(attrs);
+    result["internal"] = Variant(internal);
+    push["result"] = Variant(result);
+
+    capnp::MallocMessageBuilder message;
+    encode(encoder, push, message);
+    EXPECT_EQ(push, decode(decoder, message));
+}
+
+TEST(ResultCodec, from_result)
+{
+    ResultEncoder encoder;
+    ResultDecoder decoder;
+
+    // Encoding a result gives the same as encoding what it serializes to,
+    // and the two share the dictionary.
+    for (int i = 0; i < 3; ++i)
+    {
+        ResultImpl const result(make_push(i)["result"].get_dict());
+        VariantMap const push{ { "result", Variant(result.serialize()) } };
+
+        capnp::MallocMessageBuilder m1;
+        auto b = m1.initRoot<capnproto::Reply::Result>();
+        encoder.encode(result, b);
+        EXPECT_EQ(push, decode(decoder, m1));
+
+        capnp::MallocMessageBuilder m2;
+        encode(encoder, push, m2);
+        EXPECT_EQ(0u, m2.getRoot<capnproto::Reply::Result>().asReader().getNewKeys().size());
+        EXPECT_EQ(push, decode(decoder, m2));
+    }
+
+    // A result that can't be serialized can't be encoded either.
+    capnp::MallocMessageBuilder message;
+    auto b = message.initRoot<capnproto::Reply::Result>();
+    EXPECT_THROW(encoder.encode(ResultImpl(), b), unity::InvalidArgumentException);
+}
+
+TEST(ResultCodec, dictionary)
+{
+    ResultEncoder encoder;
+    ResultDecoder decoder;
+
+    // Custom attribute names are sent with the first result only.
+    capnp::MallocMessageBuilder m1;
+    encode(encoder, make_push(1), m1);
+    auto r1 = m1.getRoot<capnproto::Reply::Result>().asReader();
+    EXPECT_EQ(0u, r1.getFirstNewKey());
+    EXPECT_EQ(3u, r1.getNewKeys().size());
+
+    capnp::MallocMessageBuilder m2;
+    encode(encoder, make_push(2), m2);
+    auto r2 = m2.getRoot<capnproto::Reply::Result>().asReader();
+    EXPECT_EQ(3u, r2.getFirstNewKey());
+    EXPECT_EQ(0u, r2.getNewKeys().size());
+    EXPECT_EQ(3u, r2.getAttrKeys().size());
+
+    // The decoder can't make sense of m2 without having seen m1.
+    EXPECT_THROW(decode(decoder, m2), MiddlewareException);
+    EXPECT_EQ(make_push(1), decode(decoder, m1));
+    EXPECT_EQ(make_push(2), decode(decoder, m2));
+
+    // After a reset, the encoder starts over, and the decoder follows.
+    encoder.reset();
+    capnp::MallocMessageBuilder m3;
+    encode(encoder, make_push(3), m3);
+    EXPECT_EQ(0u, m3.getRoot<capnproto::Reply::Result>().asReader().getFirstNewKey());
+    EXPECT_EQ(make_push(3), decode(decoder, m3));
+}
+
+TEST(ResultCodec, benchmark)
+{
+    int const iterations = 2000;
+    auto const push = make_push(7);
+
+    size_t dict_bytes = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        capnp::MallocMessageBuilder message;
+        auto b = message.initRoot<capnproto::ValueDict>();
+        to_value_dict(push, b);
+        dict_bytes = capnp::computeSerializedSizeInWords(message) * sizeof(capnp::word);
+        to_variant_map(message.getRoot<capnproto::ValueDict>().asReader());
+    }
+    double dict_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+
+    ResultEncoder encoder;
+    ResultDecoder decoder;
+    size_t compact_bytes = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        capnp::MallocMessageBuilder message;
+        compact_bytes = encode(encoder, push, message);
+        decode(decoder, message);
+    }
+    double compact_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+
+    cout << "result: ValueDict " << dict_bytes << " bytes, " << dict_us << " us; "
+         << "compact " << compact_bytes << " bytes, " << compact_us << " us" << endl;
+    EXPECT_LT(compact_bytes, dict_bytes);
+}
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/internal/zmq_middleware/ShmChannel.h>
+#include <unity/scopes/ScopeExceptions.h>
+
+#include <scopes/internal/zmq_middleware/capnproto/Message.capnp.h>
+
+#include <capnp/serialize.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace unity::scopes::internal::zmq_middleware;
+
+namespace
+{
+
+string const socket_path = TEST_DIR "/ShmChannel_test.shm";
+
+// A request with the given id and some padding, so we can vary the message size.
+void make_request(capnp::MallocMessageBuilder& b, int id, size_t padding = 0)
+{
+    auto req = b.initRoot<capnproto::Request>();
+    req.setMode(capnproto::RequestMode::ONEWAY);
+    req.setId(to_string(id));
+    req.setCat("Reply");
+    req.setOpName("push");
+    req.getInParams().setAs<capnp::Text>(string(padding, 'x'));
+}
+
+int request_id(capnp::MessageReader& message)
+{
+    return stoi(message.getRoot<capnproto::Request>().getId().cStr());
+}
+
+int request_id(kj::ArrayPtr<capnp::word const> words)
+{
+    capnp::FlatArrayMessageReader message(words);
+    return request_id(message);
+}
+
+ShmRing::UPtr attach_to(ShmRing const& ring)
+{
+    return ShmRing::attach(dup(ring.mem_fd()), dup(ring.data_fd()), dup(ring.space_fd()));
+}
+
+bool wait_readable(int fd, int timeout)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, timeout) == 1;
+}
+
+} // namespace
+
+TEST(ShmRing, basic)
+{
+    auto consumer = ShmRing::create(4096);
+    EXPECT_LE(4096u, consumer->capacity());
+    auto producer = attach_to(*consumer);
+    EXPECT_EQ(consumer->capacity(), producer->capacity());
+
+    EXPECT_EQ(0u, consumer->read([](kj::ArrayPtr<capnp::word const>) { FAIL(); }));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        capnp::MallocMessageBuilder b;
+        make_request(b, i);
+        EXPECT_TRUE(producer->write(b.getSegmentsForOutput(), 0));
+    }
+    EXPECT_TRUE(wait_readable(consumer->data_fd(), 0));  // The consumer went to sleep in the first read().
+
+    vector<int> ids;
+    EXPECT_EQ(3u, consumer->read([&ids](kj::ArrayPtr<capnp::word const> words) { ids.push_back(request_id(words)); }));
+    EXPECT_EQ(vector<int>({ 0, 1, 2 }), ids);
+    EXPECT_EQ(0u, consumer->read([](kj::ArrayPtr<capnp::word const>) { FAIL(); }));
+}
+
+TEST(ShmRing, wrap_around)
+{
+    auto consumer = ShmRing::create(4096);
+    auto producer = attach_to(*consumer);
+
+    // Messages of varying size, so they end at different places in the ring.
+    int next_expected = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        capnp::MallocMessageBuilder b;
+        make_request(b, i, i % 700);
+        auto segments = b.getSegmentsForOutput();
+        if (!producer->write(segments, 0))
+        {
+            consumer->read([&next_expected](kj::ArrayPtr<capnp::word const> words)
+            {
+                EXPECT_EQ(next_expected++, request_id(words));
+            });
+            ASSERT_TRUE(producer->write(segments, 0));
+        }
+    }
+    consumer->read([&next_expected](kj::ArrayPtr<capnp::word const> words)
+    {
+        EXPECT_EQ(next_expected++, request_id(words));
+    });
+    EXPECT_EQ(1000, next_expected);
+}
+
+TEST(ShmRing, too_large)
+{
+    auto consumer = ShmRing::create(4096);
+    auto producer = attach_to(*consumer);
+
+    capnp::MallocMessageBuilder b;
+    make_request(b, 1, consumer->capacity() / 2);
+    EXPECT_GT(ShmRing::message_size(b.getSegmentsForOutput()), producer->max_message_size());
+    EXPECT_FALSE(producer->write(b.getSegmentsForOutput(), 0));
+    EXPECT_EQ(0u, consumer->read([](kj::ArrayPtr<capnp::word const>) {}));
+}
+
+TEST(ShmRing, wait_for_space)
+{
+    auto consumer = ShmRing::create(4096);
+    auto producer = attach_to(*consumer);
+
+    capnp::MallocMessageBuilder b;
+    make_request(b, 1, 1000);
+    int written = 0;
+    while (producer->write(b.getSegmentsForOutput(), 0))
+    {
+        ++written;
+    }
+    ASSERT_GT(written, 0);
+    EXPECT_FALSE(producer->wait_until_empty(10));
+
+    // The producer is woken up as soon as the consumer makes room.
+    thread t([&consumer]
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        consumer->read([](kj::ArrayPtr<capnp::word const>) {});
+    });
+    auto start = chrono::steady_clock::now();
+    EXPECT_TRUE(producer->write(b.getSegmentsForOutput(), 5000));
+    EXPECT_LT(chrono::steady_clock::now() - start, chrono::seconds(4));
+    t.join();
+}
+
+TEST(ShmRing, close)
+{
+    auto consumer = ShmRing::create(4096);
+    auto producer = attach_to(*consumer);
+
+    capnp::MallocMessageBuilder b;
+    make_request(b, 1, 1000);
+    while (producer->write(b.getSegmentsForOutput(), 0))
+    {
+    }
+
+    // Closing the ring wakes up a waiting producer.
+    thread t([&consumer]
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        consumer->close();
+    });
+    auto start = chrono::steady_clock::now();
+    EXPECT_FALSE(producer->write(b.getSegmentsForOutput(), 5000));
+    EXPECT_LT(chrono::steady_clock::now() - start, chrono::seconds(4));
+    EXPECT_TRUE(producer->closed());
+    t.join();
+}
+
+TEST(ShmRing, corrupt_header)
+{
+    auto consumer = ShmRing::create(4096);
+
+    // A producer that claims to have written more than fits into the ring.
+    void* p = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, consumer->mem_fd(), 0);
+    ASSERT_NE(MAP_FAILED, p);
+    *static_cast<uint64_t*>(p) = consumer->capacity() + 8;
+    munmap(p, 4096);
+
+    EXPECT_EQ(0u, consumer->read([](kj::ArrayPtr<capnp::word const>) { FAIL(); }));
+    EXPECT_TRUE(consumer->closed());
+}
+
+TEST(ShmRing, unsealed_segment)
+{
+    auto consumer = ShmRing::create(4096);
+    char tmpl[] = "/tmp/ShmChannel_test.XXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT_NE(-1, fd);
+    unlink(tmpl);
+    ASSERT_EQ(0, ftruncate(fd, 8192));
+    EXPECT_THROW(ShmRing::attach(fd, dup(consumer->data_fd()), dup(consumer->space_fd())), std::exception);
+}
+
+TEST(ShmRing, processes)
+{
+    auto consumer = ShmRing::create(64 * 1024);
+    int const num_messages = 100000;
+
+    pid_t pid = fork();
+    ASSERT_NE(-1, pid);
+    if (pid == 0)
+    {
+        auto producer = attach_to(*consumer);
+        for (int i = 0; i < num_messages; ++i)
+        {
+            capnp::MallocMessageBuilder b;
+            make_request(b, i, i % 500);
+            if (!producer->write(b.getSegmentsForOutput(), 5000))
+            {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+
+    int next_expected = 0;
+    while (next_expected < num_messages)
+    {
+        consumer->read([&next_expected](kj::ArrayPtr<capnp::word const> words)
+        {
+            EXPECT_EQ(next_expected++, request_id(words));
+        });
+        if (next_expected < num_messages)
+        {
+            ASSERT_TRUE(wait_readable(consumer->data_fd(), 5000));
+        }
+    }
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST(ShmChannel, path)
+{
+    EXPECT_EQ("/run/user/1000/zmq/fred-r.shm", shm_channel_path("ipc:///run/user/1000/zmq/fred-r"));
+    EXPECT_EQ("", shm_channel_path("inproc://fred-q"));
+}
+
+namespace
+{
+
+class Receiver
+{
+public:
+    void dispatch(capnp::MessageReader& message)
+    {
+        unique_lock<mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !held_; });
+        ids_.push_back(request_id(message));
+        cond_.notify_all();
+    }
+
+    // While held, dispatch() blocks, so the ring fills up.
+    void hold(bool held)
+    {
+        lock_guard<mutex> lock(mutex_);
+        held_ = held;
+        cond_.notify_all();
+    }
+
+    vector<int> wait_for(size_t count)
+    {
+        unique_lock<mutex> lock(mutex_);
+        cond_.wait_for(lock, chrono::seconds(5), [this, count] { return ids_.size() >= count; });
+        return ids_;
+    }
+
+private:
+    mutex mutex_;
+    condition_variable cond_;
+    vector<int> ids_;
+    bool held_ = false;
+};
+
+} // namespace
+
+TEST(ShmChannel, send)
+{
+    Receiver r;
+    ShmListener listener(socket_path, 4096, [&r](capnp::MessageReader& m) { r.dispatch(m); });
+    ShmSender sender(1000);
+
+    vector<int> expected;
+    for (int i = 0; i < 100; ++i)
+    {
+        capnp::MallocMessageBuilder b;
+        make_request(b, i, i * 10);
+        EXPECT_TRUE(sender.send(socket_path, b.getSegmentsForOutput()));
+        expected.push_back(i);
+    }
+    EXPECT_EQ(expected, r.wait_for(100));
+
+    // A message that does not fit is only refused once everything else has been dispatched,
+    // and everything after it is refused as well.
+    capnp::MallocMessageBuilder b;
+    make_request(b, 100, 4096);
+    EXPECT_FALSE(sender.send(socket_path, b.getSegmentsForOutput()));
+    capnp::MallocMessageBuilder b2;
+    make_request(b2, 101);
+    EXPECT_FALSE(sender.send(socket_path, b2.getSegmentsForOutput()));
+    EXPECT_EQ(100u, r.wait_for(100).size());
+}
+
+TEST(ShmChannel, no_listener)
+{
+    ShmSender sender(1000);
+    capnp::MallocMessageBuilder b;
+    make_request(b, 1);
+    EXPECT_FALSE(sender.send(TEST_DIR "/no_such_listener.shm", b.getSegmentsForOutput()));
+}
+
+TEST(ShmChannel, listener_stops)
+{
+    Receiver r;
+    ShmListener listener(socket_path, 4096, [&r](capnp::MessageReader& m) { r.dispatch(m); });
+    ShmSender sender(1000);
+
+    capnp::MallocMessageBuilder b;
+    make_request(b, 1);
+    EXPECT_TRUE(sender.send(socket_path, b.getSegmentsForOutput()));
+    EXPECT_EQ(1u, r.wait_for(1).size());
+
+    listener.stop();
+    EXPECT_FALSE(sender.send(socket_path, b.getSegmentsForOutput()));
+    EXPECT_NE(0, access(socket_path.c_str(), F_OK));  // The socket is gone.
+}
+
+TEST(ShmChannel, slow_receiver)
+{
+    Receiver r;
+    ShmListener listener(socket_path, 4096, [&r](capnp::MessageReader& m) { r.dispatch(m); });
+    ShmSender sender(500);
+
+    // The receiver gets going again after the sender's timeout, but before the ring
+    // could have drained a second time. The request that did not fit is refused only
+    // once the receiver has caught up, so it can go the other way without overtaking anything.
+    r.hold(true);
+    thread releaser([&r] { this_thread::sleep_for(chrono::milliseconds(700)); r.hold(false); });
+
+    vector<int> expected;
+    bool refused = false;
+    for (int i = 0; i < 100 && !refused; ++i)
+    {
+        capnp::MallocMessageBuilder b;
+        make_request(b, i, 500);
+        if (sender.send(socket_path, b.getSegmentsForOutput()))
+        {
+            expected.push_back(i);
+        }
+        else
+        {
+            refused = true;
+            EXPECT_EQ(expected, r.wait_for(0));  // Everything sent earlier has been dispatched.
+        }
+    }
+    releaser.join();
+    EXPECT_TRUE(refused);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, r.wait_for(expected.size()));
+
+    capnp::MallocMessageBuilder b;
+    make_request(b, 100);
+    EXPECT_FALSE(sender.send(socket_path, b.getSegmentsForOutput()));
+}
+
+TEST(ShmChannel, hung_receiver)
+{
+    Receiver r;
+    ShmListener listener(socket_path, 4096, [&r](capnp::MessageReader& m) { r.dispatch(m); });
+    ShmSender sender(100);
+
+    // A receiver that stops reading does not get the request that did not fit,
+    // and the sender does not send it some other way either.
+    r.hold(true);
+    bool timed_out = false;
+    for (int i = 0; i < 100 && !timed_out; ++i)
+    {
+        capnp::MallocMessageBuilder b;
+        make_request(b, i, 500);
+        try
+        {
+            EXPECT_TRUE(sender.send(socket_path, b.getSegmentsForOutput()));
+        }
+        catch (unity::scopes::TimeoutException const&)
+        {
+            timed_out = true;
+        }
+    }
+    EXPECT_TRUE(timed_out);
+
+    capnp::MallocMessageBuilder b;
+    make_request(b, 100);
+    EXPECT_FALSE(sender.send(socket_path, b.getSegmentsForOutput()));
+    r.hold(false);
+}
@@ -20,14 +20,24 @@
 
 #include <unity/scopes/internal/RuntimeImpl.h>
 #include <unity/scopes/internal/MWObjectProxy.h>
+#include <unity/scopes/internal/MWScope.h>
+#include <unity/scopes/internal/RegistryObjectBase.h>
+#include <unity/scopes/internal/ReplyObjectBase.h>
 #include <unity/scopes/internal/zmq_middleware/ZmqObjectProxy.h>
+#include <unity/scopes/internal/zmq_middleware/ZmqQueryCtrl.h>
+#include <unity/scopes/internal/zmq_middleware/ZmqReply.h>
 #include <unity/scopes/ScopeExceptions.h>
+#include <unity/scopes/SearchMetadata.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
 #include <gtest/gtest.h>
 #pragma GCC diagnostic pop
 
+#include <condition_variable>
+#include <future>
+#include <iostream>
+
 using namespace std;
 using namespace unity::scopes;
 using namespace unity::scopes::internal;
@@ -35,6 +45,9 @@ using namespace unity::scopes::internal::zmq_middleware;
 
 string const runtime_ini = TEST_DIR "/Runtime.ini";
 string const zmq_ini = TEST_DIR "/Zmq.ini";
+string const shm_zmq_ini = TEST_DIR "/ShmZmq.ini";  // Same, but replies are received via shared memory
+string const limited_zmq_ini = TEST_DIR "/LimitedZmq.ini";  // Allows only a few twoway requests on the wire at a time
+string const no_registry_runtime_ini = TEST_DIR "/NoRegistryRuntime.ini";
 
 // Basic test.
 
@@ -525,3 +538,433 @@ TEST(ZmqMiddleware, shutdown_after_start_with_adapter)
     }
     mw.wait_for_shutdown();
 }
+
+// Many threads can wait for twoway replies at the same time, even though only a few
+// requests are allowed on the wire at once.
+
+TEST(ZmqMiddleware, concurrent_twoway)
+{
+    auto rt = RuntimeImpl::create("testscope", no_registry_runtime_ini);
+    ZmqMiddleware mw("testscope", rt.get(), limited_zmq_ini);
+
+    auto fred = mw.add_scope_object("fred", make_shared<MyScopeObject>());
+    auto joe = mw.add_scope_object("joe", make_shared<MyScopeObject>());
+    mw.start();
+
+    int const num_threads = 32;
+    int const num_pings = 20;
+    atomic_int num_failed(0);
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; ++i)
+    {
+        auto proxy = i % 2 == 0 ? fred : joe;
+        threads.emplace_back([proxy, &num_failed]
+        {
+            for (int j = 0; j < num_pings; ++j)
+            {
+                try
+                {
+                    proxy->ping();
+                }
+                catch (std::exception const& e)
+                {
+                    cerr << e.what() << endl;
+                    ++num_failed;
+                }
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    EXPECT_EQ(0, num_failed);
+
+    mw.stop();
+    mw.wait_for_shutdown();
+}
+
+// Requests that are held back because too many requests to the same endpoint are
+// outstanding time out as well, and the time they spend waiting counts towards the timeout.
+
+TEST(ZmqMiddleware, twoway_timeout)
+{
+    auto rt = RuntimeImpl::create("testscope", no_registry_runtime_ini);
+    ZmqMiddleware mw("testscope", rt.get(), limited_zmq_ini);
+    mw.start();
+
+    auto proxy = mw.create_scope_proxy("nobody", "ipc:///tmp/no_such_endpoint");
+    auto timeout = proxy->timeout();
+
+    int const num_threads = 4;
+    atomic_int num_timeouts(0);
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; ++i)
+    {
+        threads.emplace_back([proxy, &num_timeouts]
+        {
+            try
+            {
+                proxy->ping();
+            }
+            catch (TimeoutException const&)
+            {
+                ++num_timeouts;
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(num_threads, num_timeouts);
+    EXPECT_GE(elapsed, timeout);
+    EXPECT_LT(elapsed, 2 * timeout);
+
+    mw.stop();
+    mw.wait_for_shutdown();
+}
+
+// Two scopes sharing a middleware each get their own idle notification,
+// and the middleware keeps running until someone stops it.
+
+TEST(ZmqMiddleware, idle_callback)
+{
+    ZmqMiddleware mw("host", nullptr, zmq_ini);
+
+    atomic_int fred_idle(0);
+    atomic_int joe_idle(0);
+    mw.add_scope_object("fred", make_shared<MyScopeObject>(), 100, [&fred_idle] { ++fred_idle; });
+    mw.add_scope_object("joe", make_shared<MyScopeObject>(), 200, [&joe_idle] { ++joe_idle; });
+    mw.start();
+
+    this_thread::sleep_for(chrono::milliseconds(500));
+    EXPECT_LE(2, fred_idle);
+    EXPECT_LE(1, joe_idle);
+    EXPECT_GT(fred_idle, joe_idle);
+
+    mw.stop();
+    mw.wait_for_shutdown();
+}
+
+// Counts the results it receives and checks that they arrive in order.
+
+class CountingReply : public ReplyObjectBase
+{
+public:
+    CountingReply()
+        : count_(0)
+        , in_order_(true)
+        , finished_(false)
+    {
+    }
+
+    virtual void push(VariantMap const& result) noexcept override
+    {
+        lock_guard<mutex> lock(mutex_);
+        in_order_ = in_order_ && !finished_ && result.at("i").get_int() == count_;
+        ++count_;
+        cond_.notify_all();
+    }
+
+    virtual void finished(CompletionDetails const&) noexcept override
+    {
+        lock_guard<mutex> lock(mutex_);
+        finished_ = true;
+        cond_.notify_all();
+    }
+
+    virtual void info(OperationInfo const&) noexcept override
+    {
+    }
+
+    void wait_for_results(int count)
+    {
+        unique_lock<mutex> lock(mutex_);
+        cond_.wait_for(lock, chrono::seconds(10), [this, count] { return count_ >= count; });
+    }
+
+    void wait_until_finished()
+    {
+        unique_lock<mutex> lock(mutex_);
+        cond_.wait_for(lock, chrono::seconds(10), [this] { return finished_; });
+    }
+
+    int count()
+    {
+        lock_guard<mutex> lock(mutex_);
+        return count_;
+    }
+
+    bool in_order()
+    {
+        lock_guard<mutex> lock(mutex_);
+        return in_order_;
+    }
+
+private:
+    mutex mutex_;
+    condition_variable cond_;
+    int count_;
+    bool in_order_;
+    bool finished_;
+};
+
+VariantMap make_result(int i, size_t payload_size)
+{
+    VariantMap result;
+    result["i"] = Variant(i);
+    result["payload"] = Variant(string(payload_size, 'x'));
+    return result;
+}
+
+// Replies via shared memory arrive in order, including results that are too large for the ring
+// and therefore go via zmq, and the results that follow those.
+
+TEST(ZmqMiddleware, shm_replies)
+{
+    ZmqMiddleware mw("testclient", nullptr, shm_zmq_ini);
+    mw.start();
+
+    auto reply = make_shared<CountingReply>();
+    auto proxy = mw.add_reply_object(reply);
+    EXPECT_EQ(ZmqReply::shm_channel_version, dynamic_pointer_cast<ZmqReply>(proxy)->version());
+
+    int const num_results = 1000;
+    for (int i = 0; i < num_results; ++i)
+    {
+        proxy->push(make_result(i, i == num_results / 2 ? 100000 : 100));
+    }
+    proxy->finished(CompletionDetails(CompletionDetails::OK));
+    reply->wait_until_finished();
+    EXPECT_EQ(num_results, reply->count());
+    EXPECT_TRUE(reply->in_order());
+
+    mw.stop();
+    mw.wait_for_shutdown();
+}
+
+// Compares throughput and latency of replies via ipc and via shared memory.
+
+TEST(ZmqMiddleware, shm_replies_benchmark)
+{
+    int const num_results = 20000;
+    int const batch_size = 500;
+    int const num_round_trips = 2000;
+
+    for (auto const& config : { zmq_ini, shm_zmq_ini })
+    {
+        for (size_t payload_size : { 100, 2000 })
+        {
+            ZmqMiddleware mw("testclient", nullptr, config);
+            mw.start();
+
+            auto reply = make_shared<CountingReply>();
+            auto proxy = mw.add_reply_object(reply);
+
+            // zmq drops oneway messages once too many are in flight, so we send in batches.
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < num_results; ++i)
+            {
+                proxy->push(make_result(i, payload_size));
+                if ((i + 1) % batch_size == 0)
+                {
+                    reply->wait_for_results(i + 1);
+                }
+            }
+            reply->wait_for_results(num_results);
+            auto throughput_time = chrono::steady_clock::now() - start;
+            ASSERT_EQ(num_results, reply->count());
+
+            start = chrono::steady_clock::now();
+            for (int i = num_results; i < num_results + num_round_trips; ++i)
+            {
+                proxy->push(make_result(i, payload_size));
+                reply->wait_for_results(i + 1);
+            }
+            auto latency_time = chrono::steady_clock::now() - start;
+            ASSERT_EQ(num_results + num_round_trips, reply->count());
+            EXPECT_TRUE(reply->in_order());
+
+            auto us = [](chrono::steady_clock::duration d) { return chrono::duration_cast<chrono::microseconds>(d).count(); };
+            cout << (config == zmq_ini ? "ipc:" : "shm:") << " payload " << payload_size << " bytes: "
+                 << num_results * 1000000.0 / us(throughput_time) << " results/s, "
+                 << double(us(latency_time)) / num_round_trips << " us latency" << endl;
+
+            mw.stop();
+            mw.wait_for_shutdown();
+        }
+    }
+}
+
+// Takes a while to create each query, as a scope that is busy would.
+
+class SlowScopeObject : public MyScopeObject
+{
+public:
+    virtual MWQueryCtrlProxy search(CannedQuery const&,
+                                    SearchMetadata const&,
+                                    VariantMap const&,
+                                    MWReplyProxy const&,
+                                    InvokeInfo const& info) override
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        return make_shared<ZmqQueryCtrl>(dynamic_cast<ZmqMiddleware*>(info.mw), "ipc:///tmp/ctrl", "ctrl", "");
+    }
+};
+
+// search_async() returns without waiting for the scope, so a single thread can have
+// many queries in flight, and each query's ctrl proxy arrives via the callback.
+
+TEST(ZmqMiddleware, search_async)
+{
+    auto rt = RuntimeImpl::create("testscope", no_registry_runtime_ini);
+    ZmqMiddleware mw("testscope", rt.get(), zmq_ini);
+
+    auto fred = mw.add_scope_object("fred", make_shared<SlowScopeObject>());
+    mw.start();
+
+    int const num_queries = 20;
+    mutex m;
+    condition_variable cond;
+    int num_ctrls = 0;
+    int num_errors = 0;
+    auto on_done = [&](QueryCtrlProxy const& ctrl, exception_ptr const& error)
+    {
+        lock_guard<mutex> lock(m);
+        if (error || !ctrl)
+        {
+            ++num_errors;
+        }
+        else
+        {
+            ++num_ctrls;
+        }
+        cond.notify_all();
+    };
+
+    CannedQuery query("fred", "query", "");
+    auto hints = SearchMetadata("en", "phone").serialize();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; ++i)
+    {
+        fred->search_async(query, hints, VariantMap(), mw.add_reply_object(make_shared<CountingReply>()), on_done);
+    }
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    EXPECT_LT(elapsed, num_queries * 50 / 2);  // Well under the time it takes to process the queries one by one
+
+    {
+        unique_lock<mutex> lock(m);
+        EXPECT_TRUE(cond.wait_for(lock, chrono::seconds(10), [&] { return num_ctrls + num_errors == num_queries; }));
+        EXPECT_EQ(num_queries, num_ctrls);
+        EXPECT_EQ(0, num_errors);
+    }
+
+    mw.stop();
+    mw.wait_for_shutdown();
+}
+
+// A query to a scope that does not respond times out via the callback.
+
+TEST(ZmqMiddleware, search_async_timeout)
+{
+    auto rt = RuntimeImpl::create("testscope", no_registry_runtime_ini);
+    ZmqMiddleware mw("testscope", rt.get(), zmq_ini);
+    mw.start();
+
+    auto proxy = mw.create_scope_proxy("nobody", "ipc:///tmp/no_such_endpoint");
+
+    promise<exception_ptr> error;
+    CannedQuery query("nobody", "query", "");
+    proxy->search_async(query, SearchMetadata("en", "phone").serialize(), VariantMap(),
+                        mw.add_reply_object(make_shared<CountingReply>()),
+                        [&error](QueryCtrlProxy const&, exception_ptr const& e) { error.set_value(e); });
+
+    auto f = error.get_future();
+    ASSERT_EQ(future_status::ready, f.wait_for(chrono::seconds(10)));
+    auto e = f.get();
+    ASSERT_TRUE(bool(e));
+    EXPECT_THROW(rethrow_exception(e), TimeoutException);
+
+    mw.stop();
+    mw.wait_for_shutdown();
+}
+
+// A registry that takes a long time to locate a scope, as it does when the scope is slow to start.
+
+class SlowRegistryObject : public RegistryObjectBase
+{
+public:
+    virtual ScopeMetadata get_metadata(std::string const& scope_id) const override
+    {
+        throw NotFoundException("no such scope", scope_id);
+    }
+
+    virtual MetadataMap list() const override
+    {
+        return MetadataMap();
+    }
+
+    virtual ObjectProxy locate(std::string const& identity) override
+    {
+        this_thread::sleep_for(chrono::seconds(3));
+        throw NotFoundException("no such scope", identity);
+    }
+
+    virtual bool is_scope_running(std::string const&) override
+    {
+        return false;
+    }
+};
+
+// Destroying the run time while an asynchronous request is still waiting for locate() does not hang,
+// even though the request's callback calls back into the middleware when the request is abandoned.
+
+TEST(ZmqMiddleware, destroy_with_async_request_in_flight)
+{
+    auto reg_rt = RuntimeImpl::create("Registry", runtime_ini);
+    ZmqMiddleware reg_mw("Registry", reg_rt.get(), zmq_ini);
+    reg_mw.add_registry_object("Registry", make_shared<SlowRegistryObject>());
+    reg_mw.start();
+
+    auto rt = RuntimeImpl::create("testclient", runtime_ini);
+    auto mw = rt->factory()->find("testclient", "Zmq");
+    ASSERT_TRUE(bool(mw));
+
+    auto proxy = mw->create_scope_proxy("slow");
+    auto reply = mw->add_reply_object(make_shared<CountingReply>());
+
+    promise<exception_ptr> error;
+    CannedQuery query("slow", "query", "");
+    proxy->search_async(query, SearchMetadata("en", "phone").serialize(), VariantMap(), reply,
+                        [&error, reply](QueryCtrlProxy const&, exception_ptr const& e)
+                        {
+                            // As ScopeImpl does, tell the reply object that the query failed.
+                            try
+                            {
+                                reply->finished(CompletionDetails(CompletionDetails::Error, "failed"));
+                            }
+                            catch (...)
+                            {
+                            }
+                            error.set_value(e);
+                        });
+
+    this_thread::sleep_for(chrono::milliseconds(200));  // Let the locate() request go out.
+
+    auto start = chrono::steady_clock::now();
+    rt->destroy();
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    EXPECT_LT(elapsed, 2000);  // Well before the registry replies
+
+    auto f = error.get_future();
+    ASSERT_EQ(future_status::ready, f.wait_for(chrono::seconds(0)));
+    auto e = f.get();
+    ASSERT_TRUE(bool(e));
+    EXPECT_THROW(rethrow_exception(e), MiddlewareException);
+
+    reg_mw.stop();
+    reg_mw.wait_for_shutdown();
+}
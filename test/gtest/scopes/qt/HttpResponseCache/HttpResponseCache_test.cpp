@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity/scopes/qt/JsonAsyncReader.h>
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QTemporaryDir>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <core/posix/exec.h>
+
+namespace posix = core::posix;
+
+using namespace std;
+using namespace unity::scopes::qt;
+
+class HttpResponseCacheTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        ASSERT_TRUE(cache_dir_.isValid());
+
+        fake_server_ = posix::exec(FAKE_SERVER, {}, {}, posix::StandardStream::stdout);
+
+        ASSERT_GT(fake_server_.pid(), 0);
+        string port;
+        fake_server_.cout() >> port;
+
+        fake_server_host = "http://127.0.0.1:" + port;
+    }
+
+    string cache_dir() const
+    {
+        return cache_dir_.path().toStdString();
+    }
+
+    static JsonAsyncReader::JsonParameters params(string const& cache_control, string const& delay = "0")
+    {
+        return JsonAsyncReader::JsonParameters{
+            {"method", "json_chart_gettoptracks"}, {"cache_control", cache_control}, {"delay", delay}};
+    }
+
+    QTemporaryDir cache_dir_;
+    posix::ChildProcess fake_server_ = posix::ChildProcess::invalid();
+    std::string fake_server_host;
+};
+
+struct Track
+{
+    std::string title;
+
+    Track()
+    {
+    }
+
+    Track(QJsonObject& json)
+    {
+        if (json.contains("name"))
+        {
+            title = json["name"].toString().toStdString();
+        }
+    }
+};
+
+void expect_stats(JsonAsyncReader const& reader, int64_t hits, int64_t revalidated, int64_t misses, int64_t coalesced)
+{
+    auto stats = reader.cache_stats();
+    EXPECT_EQ(hits, stats.hits);
+    EXPECT_EQ(revalidated, stats.revalidated);
+    EXPECT_EQ(misses, stats.misses);
+    EXPECT_EQ(coalesced, stats.coalesced);
+}
+
+TEST_F(HttpResponseCacheTest, no_cache)
+{
+    JsonAsyncReader reader;
+    for (int i = 0; i < 2; ++i)
+    {
+        auto f = reader.async_get<Track>(fake_server_host, params("max-age=60"), "track");
+        EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f).size());
+    }
+    expect_stats(reader, 0, 0, 0, 0);
+}
+
+TEST_F(HttpResponseCacheTest, fresh)
+{
+    JsonAsyncReader reader;
+    reader.set_cache(cache_dir());
+    for (int i = 0; i < 3; ++i)
+    {
+        auto f = reader.async_get<Track>(fake_server_host, params("max-age=60"), "track");
+        auto tracks = HttpAsyncReader::get_or_throw(f);
+        ASSERT_EQ(5u, tracks.size());
+        EXPECT_EQ("Take Me to Church", tracks[0]->title);
+    }
+    expect_stats(reader, 2, 0, 1, 0);
+}
+
+TEST_F(HttpResponseCacheTest, revalidate)
+{
+    JsonAsyncReader reader;
+    reader.set_cache(cache_dir());
+    for (int i = 0; i < 3; ++i)
+    {
+        auto f = reader.async_get<Track>(fake_server_host, params("no-cache"), "track");
+        EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f).size());
+    }
+    expect_stats(reader, 0, 2, 1, 0);
+}
+
+TEST_F(HttpResponseCacheTest, no_store)
+{
+    JsonAsyncReader reader;
+    reader.set_cache(cache_dir());
+    for (int i = 0; i < 2; ++i)
+    {
+        auto f = reader.async_get<Track>(fake_server_host, params("no-store"), "track");
+        EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f).size());
+    }
+    expect_stats(reader, 0, 0, 2, 0);
+}
+
+TEST_F(HttpResponseCacheTest, coalesce)
+{
+    JsonAsyncReader reader;
+    reader.set_cache(cache_dir());
+
+    // The server delays its response, so the second request is made while the first is in progress.
+    auto f1 = reader.async_get<Track>(fake_server_host, params("max-age=60", "0.5"), "track");
+    auto f2 = reader.async_get<Track>(fake_server_host, params("max-age=60", "0.5"), "track");
+    EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f1).size());
+    EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f2).size());
+    expect_stats(reader, 0, 0, 1, 1);
+}
+
+TEST_F(HttpResponseCacheTest, too_large)
+{
+    JsonAsyncReader reader;
+    reader.set_cache(cache_dir(), 100);  // Smaller than the response
+    for (int i = 0; i < 2; ++i)
+    {
+        auto f = reader.async_get<Track>(fake_server_host, params("max-age=60"), "track");
+        EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f).size());
+    }
+    expect_stats(reader, 0, 0, 2, 0);
+}
+
+TEST_F(HttpResponseCacheTest, persistent)
+{
+    {
+        JsonAsyncReader reader;
+        reader.set_cache(cache_dir());
+        auto f = reader.async_get<Track>(fake_server_host, params("max-age=60"), "track");
+        EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f).size());
+        expect_stats(reader, 0, 0, 1, 0);
+    }
+
+    // A new reader finds the response that was stored by the first one.
+    JsonAsyncReader reader;
+    reader.set_cache(cache_dir());
+    auto f = reader.async_get<Track>(fake_server_host, params("max-age=60"), "track");
+    EXPECT_EQ(5u, HttpAsyncReader::get_or_throw(f).size());
+    expect_stats(reader, 1, 0, 0, 0);
+}
+
+TEST_F(HttpResponseCacheTest, stream)
+{
+    JsonAsyncReader reader;
+    reader.set_cache(cache_dir());
+    for (int i = 0; i < 2; ++i)
+    {
+        std::vector<std::string> titles;
+        auto f = reader.async_get_stream<Track>(fake_server_host, params("max-age=60"), "track",
+                                                [&titles](std::shared_ptr<Track> const& t)
+                                                {
+                                                    titles.push_back(t->title);
+                                                    return true;
+                                                });
+        HttpAsyncReader::get_or_throw(f);
+        ASSERT_EQ(5u, titles.size());
+        EXPECT_EQ("Take Me to Church", titles[0]);
+    }
+    expect_stats(reader, 1, 0, 1, 0);
+}
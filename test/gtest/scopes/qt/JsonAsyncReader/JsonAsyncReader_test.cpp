@@ -193,3 +193,53 @@ TEST_F(ExceptionsTest, check_xml_bad_formed)
         FAIL() << e.what();
     }
 }
+
+TEST_F(ExceptionsTest, stream_results)
+{
+    JsonAsyncReader reader;
+    JsonAsyncReader::JsonParameters parameters{
+        {"method", "json_chart_gettoptracks"}, {"api_key", "1cf69754d419139d08d42f307d060fff"}, {"format", "json"}};
+
+    std::vector<std::string> titles;
+    auto stream_future = reader.async_get_stream<Client::Result>(fake_server_host, parameters, "track",
+                                                                 [&titles](std::shared_ptr<Client::Result> const& r)
+                                                                 {
+                                                                     titles.push_back(r->title);
+                                                                     return true;
+                                                                 });
+    HttpAsyncReader::get_or_throw(stream_future);
+
+    // check that we've got 5 valid results
+    ASSERT_EQ(5u, titles.size());
+    EXPECT_EQ("Take Me to Church", titles[0]);
+}
+
+TEST_F(ExceptionsTest, stream_stop)
+{
+    JsonAsyncReader reader;
+    JsonAsyncReader::JsonParameters parameters{
+        {"method", "json_chart_gettoptracks"}, {"api_key", "1cf69754d419139d08d42f307d060fff"}, {"format", "json"}};
+
+    int count = 0;
+    auto stream_future = reader.async_get_stream<Client::Result>(fake_server_host, parameters, "track",
+                                                                 [&count](std::shared_ptr<Client::Result> const&)
+                                                                 {
+                                                                     return ++count < 2;
+                                                                 });
+    HttpAsyncReader::get_or_throw(stream_future);
+    EXPECT_EQ(2, count);
+}
+
+TEST_F(ExceptionsTest, stream_bad_formed)
+{
+    JsonAsyncReader reader;
+    JsonAsyncReader::JsonParameters parameters{{"method", "xml_bad_formed_chart_gettoptracks"},
+                                               {"api_key", "1cf69754d419139d08d42f307d060fff"}};
+
+    auto stream_future = reader.async_get_stream<Client::Result>(fake_server_host, parameters, "track",
+                                                                 [](std::shared_ptr<Client::Result> const&)
+                                                                 {
+                                                                     return true;
+                                                                 });
+    EXPECT_THROW(HttpAsyncReader::get_or_throw(stream_future), unity::LogicException);
+}
@@ -212,3 +212,48 @@ TEST_F(ExceptionsTest, check_xml_bad_formed_exception)
                      "and ending tag mismatch. at line: 10");
     }
 }
+
+TEST_F(ExceptionsTest, stream_results)
+{
+    XmlAsyncReader reader;
+
+    XmlAsyncReader::QXmlStreamReaderParams parameters{{"method", "xml_chart_gettoptracks"},
+                                                      {"api_key", "1cf69754d419139d08d42f307d060fff"}};
+
+    std::vector<std::string> titles;
+    auto stream_future = reader.async_get_stream<Client::Result>(fake_server_host, parameters, "track",
+                                                                 [&titles](std::shared_ptr<Client::Result> const& r)
+                                                                 {
+                                                                     titles.push_back(r->title);
+                                                                     return true;
+                                                                 });
+    HttpAsyncReader::get_or_throw(stream_future);
+
+    // check that we've got 5 valid results
+    ASSERT_EQ(5u, titles.size());
+    EXPECT_EQ("Take Me to Church", titles[0]);
+}
+
+TEST_F(ExceptionsTest, stream_bad_formed)
+{
+    XmlAsyncReader reader;
+
+    XmlAsyncReader::QXmlStreamReaderParams parameters{{"method", "xml_bad_formed_chart_gettoptracks"},
+                                                      {"api_key", "1cf69754d419139d08d42f307d060fff"}};
+
+    auto stream_future = reader.async_get_stream<Client::Result>(fake_server_host, parameters, "track",
+                                                                 [](std::shared_ptr<Client::Result> const&)
+                                                                 {
+                                                                     return true;
+                                                                 });
+    try
+    {
+        HttpAsyncReader::get_or_throw(stream_future);
+        FAIL();
+    }
+    catch (unity::LogicException const& e)
+    {
+        std::string error_msg = e.what();
+        EXPECT_NE(std::string::npos, error_msg.find("Opening and ending tag mismatch."));
+    }
+}
@@ -20,6 +20,7 @@
 import base64
 import json
 import os
+import tornado.gen
 import tornado.httpserver
 import tornado.ioloop
 import tornado.netutil
@@ -44,8 +45,15 @@ class ErrorHandler(tornado.web.RequestHandler):
         self.write(json.dumps({'error': '%s: %d' % (kwargs["exc_info"][1], status_code)}))
 
 class Query(ErrorHandler):
+    @tornado.gen.coroutine
     def get(self):
 #         validate_argument(self, 'part', 'snippet,statistics')
+        delay = float(self.get_argument('delay', '0'))
+        if delay > 0:
+            yield tornado.gen.sleep(delay)
+        cache_control = self.get_argument('cache_control', None)
+        if cache_control is not None:
+            self.set_header('Cache-Control', cache_control)
         file = 'queries/%s.txt' % self.get_argument('method', None );
         if "not_found" in file:
             file = 'queries/not_found.txt'
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <unity/scopes/utility/FanOutSearch.h>
+#include <unity/scopes/utility/ResultMerger.h>
+#include <unity/scopes/CategoryRenderer.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockQueryCtrl.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/ScopeMetadataBuilder.h>
+#include <unity/UnityExceptions.h>
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace unity::scopes;
+using namespace unity::scopes::utility;
+using namespace ::testing;
+
+namespace
+{
+
+MATCHER_P2(ResultProp, prop, value, "")
+{
+    return arg.contains(prop) && arg[prop] == unity::scopes::Variant(value);
+}
+
+ChildScope make_child(std::string const& id, bool enabled = true)
+{
+    unity::scopes::testing::ScopeMetadataBuilder builder;
+    builder.scope_id(id).proxy(ScopeProxy()).display_name(id).description(id).author(id);
+    return ChildScope{id, builder(), enabled};
+}
+
+void push_results(std::string const& child, int count, SearchListenerBase::SPtr const& listener)
+{
+    auto cat = std::make_shared<unity::scopes::testing::Category>(child + "cat", child, "", CategoryRenderer());
+    for (int i = 0; i < count; ++i)
+    {
+        CategorisedResult res(cat);
+        res.set_uri(child + std::to_string(i));
+        res.set_title(child);
+        listener->push(res);
+    }
+}
+
+// Search function that remembers the listener of each child, so the test can deliver results later.
+struct Children
+{
+    FanOutSearch::SearchFunc func()
+    {
+        return [this](ChildScope const& child, SearchListenerBase::SPtr const& listener)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            listeners[child.id] = listener;
+            return QueryCtrlProxy();
+        };
+    }
+
+    SearchListenerBase::SPtr get(std::string const& id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return listeners[id];
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return listeners.size();
+    }
+
+    size_t count(std::string const& id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return listeners.count(id);
+    }
+
+    std::mutex mutex;
+    std::map<std::string, SearchListenerBase::SPtr> listeners;
+};
+
+} // namespace
+
+TEST(FanOutSearch, child_order)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    {
+        InSequence s;
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "A")))).Times(2);
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "B")))).Times(3);
+    }
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "C")))).Times(0);
+
+    FanOutSearch fan_out(upstream, { make_child("A"), make_child("C", false), make_child("B") });
+
+    std::vector<FanOutSearch::ChildStats> stats;
+    Children children;
+    std::thread t([&]{ stats = fan_out.run(children.func()); });
+
+    // Wait for run() to issue the searches.
+    while (children.size() != 2)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(0u, children.count("C"));
+
+    // B arrives first, but must be held back until A is ready.
+    push_results("B", 3, children.get("B"));
+    children.get("B")->finished(CompletionDetails(CompletionDetails::OK));
+    push_results("A", 2, children.get("A"));
+    children.get("A")->finished(CompletionDetails(CompletionDetails::OK));
+
+    t.join();
+
+    ASSERT_EQ(2u, stats.size());
+    EXPECT_EQ("A", stats[0].scope_id);
+    EXPECT_EQ(2, stats[0].results);
+    EXPECT_FALSE(stats[0].timed_out);
+    EXPECT_EQ(CompletionDetails::OK, stats[0].status);
+    EXPECT_EQ("B", stats[1].scope_id);
+    EXPECT_EQ(3, stats[1].results);
+    EXPECT_LE(0, stats[1].first_result_ms);
+    EXPECT_LE(stats[1].first_result_ms, stats[1].latency_ms);
+}
+
+TEST(FanOutSearch, child_timeout)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    // A never finishes. B must still be forwarded once A's deadline expires.
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "A")))).Times(0);
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "B")))).Times(2);
+
+    FanOutSearch fan_out(upstream, { make_child("A"), make_child("B") });
+    fan_out.set_child_timeout(200);
+
+    Children children;
+    auto search = children.func();
+    auto stats = fan_out.run([&](ChildScope const& child, SearchListenerBase::SPtr const& listener)
+    {
+        search(child, listener);
+        if (child.id == "B")
+        {
+            push_results("B", 2, listener);
+            listener->finished(CompletionDetails(CompletionDetails::OK));
+        }
+        return QueryCtrlProxy();
+    });
+
+    ASSERT_EQ(2u, stats.size());
+    EXPECT_TRUE(stats[0].timed_out);
+    EXPECT_EQ(CompletionDetails::Cancelled, stats[0].status);
+    EXPECT_EQ(0, stats[0].results);
+    EXPECT_EQ(-1, stats[0].first_result_ms);
+    EXPECT_LE(200, stats[0].latency_ms);
+    EXPECT_FALSE(stats[1].timed_out);
+    EXPECT_EQ(2, stats[1].results);
+
+    // Late results from the timed-out child are dropped.
+    push_results("A", 1, children.get("A"));
+    children.get("A")->finished(CompletionDetails(CompletionDetails::OK));
+}
+
+TEST(FanOutSearch, cardinality)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "A")))).Times(3);
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "B")))).Times(2);
+
+    FanOutSearch fan_out(upstream, { make_child("A"), make_child("B") });
+    fan_out.set_cardinality(5);
+
+    auto stats = fan_out.run([&](ChildScope const& child, SearchListenerBase::SPtr const& listener)
+    {
+        // Neither child calls finished(); run() must return once the limit is reached.
+        push_results(child.id, child.id == "A" ? 3 : 10, listener);
+        return QueryCtrlProxy();
+    });
+
+    ASSERT_EQ(2u, stats.size());
+    EXPECT_EQ(3, stats[0].results);
+    EXPECT_EQ(2, stats[1].results);
+    EXPECT_EQ(CompletionDetails::Cancelled, stats[1].status);
+    EXPECT_FALSE(stats[1].timed_out);
+}
+
+// Duplicates that the merger drops do not count towards the cardinality.
+
+TEST(FanOutSearch, merger_cardinality)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "A")))).Times(3);
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(AllOf(ResultProp("title", "B"),
+                                                                     ResultProp("uri", "u3"))))).Times(1);
+
+    auto merger = std::make_shared<ResultMerger>(upstream);
+    FanOutSearch fan_out(upstream, { make_child("A"), make_child("B") });
+    fan_out.set_merger(merger);
+    fan_out.set_cardinality(4);
+
+    auto stats = fan_out.run([&](ChildScope const& child, SearchListenerBase::SPtr const& listener)
+    {
+        // B returns the same three results as A, plus two more.
+        auto cat = std::make_shared<unity::scopes::testing::Category>("cat", "cat", "", CategoryRenderer());
+        for (int i = 0; i < (child.id == "A" ? 3 : 5); ++i)
+        {
+            CategorisedResult res(cat);
+            res.set_uri("u" + std::to_string(i));
+            res.set_title(child.id);
+            listener->push(res);
+        }
+        return QueryCtrlProxy();
+    });
+
+    ASSERT_EQ(2u, stats.size());
+    EXPECT_EQ(3, stats[0].results);
+    EXPECT_EQ(1, stats[1].results);
+    EXPECT_EQ(3, merger->duplicates());
+}
+
+// Results that the merger holds back for a child that finished normally are forwarded,
+// even if they leave the merger only after run() has returned.
+
+TEST(FanOutSearch, merger_held_results)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "A")))).Times(1);
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "B")))).Times(2);
+
+    auto merger = std::make_shared<ResultMerger>(upstream, "uri", ResultMerger::Policy::PreferChildOrder);
+    FanOutSearch fan_out(upstream, { make_child("A"), make_child("B") });
+    fan_out.set_merger(merger);
+
+    std::vector<FanOutSearch::ChildStats> stats;
+    Children children;
+    std::thread t([&]{ stats = fan_out.run(children.func()); });
+    while (children.size() != 2)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    push_results("B", 2, children.get("B"));
+    children.get("B")->finished(CompletionDetails(CompletionDetails::OK));
+    push_results("A", 1, children.get("A"));
+    children.get("A")->finished(CompletionDetails(CompletionDetails::OK));
+    t.join();
+
+    ASSERT_EQ(2u, stats.size());
+    EXPECT_EQ(2, stats[1].results);
+}
+
+// Once the search is cancelled, the merger no longer forwards results that it held back.
+
+TEST(FanOutSearch, merger_cancel)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_))).Times(0);
+
+    auto merger = std::make_shared<ResultMerger>(upstream, "uri", ResultMerger::Policy::PreferChildOrder);
+    FanOutSearch fan_out(upstream, { make_child("A"), make_child("B") });
+    fan_out.set_merger(merger);
+
+    std::vector<FanOutSearch::ChildStats> stats;
+    Children children;
+    std::thread t([&]{ stats = fan_out.run(children.func()); });
+    while (children.size() != 2)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // B's results wait for A, which is abandoned by cancel().
+    push_results("B", 2, children.get("B"));
+    children.get("B")->finished(CompletionDetails(CompletionDetails::OK));
+    fan_out.cancel();
+    t.join();
+
+    ASSERT_EQ(2u, stats.size());
+    EXPECT_EQ(CompletionDetails::Cancelled, stats[0].status);
+    EXPECT_EQ(0, stats[1].results);
+}
+
+TEST(FanOutSearch, cancel)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    FanOutSearch fan_out(upstream, { make_child("A") });
+
+    std::thread t([&]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        fan_out.cancel();
+    });
+    Children children;
+    auto stats = fan_out.run(children.func());
+    t.join();
+
+    ASSERT_EQ(1u, stats.size());
+    EXPECT_EQ(CompletionDetails::Cancelled, stats[0].status);
+    EXPECT_FALSE(stats[0].timed_out);
+}
+
+// A child whose search returns after cancel() was called is still cancelled.
+
+TEST(FanOutSearch, cancel_during_search)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    auto ctrl = std::make_shared<unity::scopes::testing::MockQueryCtrl>();
+    EXPECT_CALL(*ctrl, cancel()).Times(1);
+
+    FanOutSearch fan_out(upstream, { make_child("A") });
+    auto stats = fan_out.run([&](ChildScope const&, SearchListenerBase::SPtr const&) -> QueryCtrlProxy
+    {
+        fan_out.cancel();
+        return ctrl;
+    });
+
+    ASSERT_EQ(1u, stats.size());
+    EXPECT_EQ(CompletionDetails::Cancelled, stats[0].status);
+}
+
+TEST(FanOutSearch, search_error)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    FanOutSearch fan_out(upstream, { make_child("A") });
+    auto stats = fan_out.run([](ChildScope const&, SearchListenerBase::SPtr const&) -> QueryCtrlProxy
+    {
+        throw unity::ResourceException("no such scope");
+    });
+    ASSERT_EQ(1u, stats.size());
+    EXPECT_EQ(CompletionDetails::Error, stats[0].status);
+}
+
+TEST(FanOutSearch, exceptions)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_THROW(FanOutSearch(nullptr, {}), unity::InvalidArgumentException);
+
+    FanOutSearch fan_out(upstream, {});
+    EXPECT_THROW(fan_out.set_child_timeout(-2), unity::InvalidArgumentException);
+    EXPECT_THROW(fan_out.set_cardinality(-1), unity::InvalidArgumentException);
+    EXPECT_THROW(fan_out.run(FanOutSearch::SearchFunc()), unity::InvalidArgumentException);
+
+    Children children;
+    EXPECT_TRUE(fan_out.run(children.func()).empty());
+    EXPECT_THROW(fan_out.run(children.func()), unity::LogicException);
+}
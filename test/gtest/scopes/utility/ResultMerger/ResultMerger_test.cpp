@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wctor-dtor-privacy"
+#include <gtest/gtest.h>
+#pragma GCC diagnostic pop
+
+#include <unity/scopes/utility/ResultMerger.h>
+#include <unity/scopes/CategoryRenderer.h>
+#include <unity/scopes/SearchReply.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/UnityExceptions.h>
+
+using namespace unity::scopes;
+using namespace unity::scopes::utility;
+using namespace ::testing;
+
+namespace
+{
+
+MATCHER_P2(ResultProp, prop, value, "")
+{
+    return arg.contains(prop) && arg[prop] == unity::scopes::Variant(value);
+}
+
+MATCHER_P(HasAttr, prop, "")
+{
+    return arg.contains(prop);
+}
+
+Category::SCPtr cat()
+{
+    static auto c = std::make_shared<unity::scopes::testing::Category>("cat", "Cat", "", CategoryRenderer());
+    return c;
+}
+
+CategorisedResult make_result(std::string const& uri, std::string const& title)
+{
+    CategorisedResult res(cat());
+    res.set_uri(uri);
+    res.set_title(title);
+    return res;
+}
+
+} // namespace
+
+TEST(ResultMerger, first_wins)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "B")))).Times(2);
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "A")))).Times(1);
+
+    ResultMerger merger(upstream);
+    auto a = merger.child_reply();
+    auto b = merger.child_reply();
+
+    b->push(make_result("uri1", "B"));
+    b->push(make_result("uri2", "B"));
+    a->push(make_result("uri1", "A"));   // Duplicate, dropped
+    a->push(make_result("uri3", "A"));
+    b->push(make_result("uri3", "B"));   // Duplicate, dropped
+
+    EXPECT_EQ(2, merger.duplicates());
+}
+
+TEST(ResultMerger, prefer_child_order)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    ResultMerger merger(upstream, "uri", ResultMerger::Policy::PreferChildOrder);
+    auto a = merger.child_reply();
+    auto b = merger.child_reply();
+
+    {
+        InSequence s;
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("uri", "uri1")))).Times(1);
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "A")))).Times(1);
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "B")))).Times(1);
+    }
+
+    // B's results are held back while A is still running.
+    b->push(make_result("uri2", "B"));
+    b->push(make_result("uri3", "B"));
+    a->push(make_result("uri1", "A"));
+    a->push(make_result("uri3", "A"));   // Replaces B's pending result
+    a->finished();                       // Releases B's remaining result
+
+    EXPECT_EQ(1, merger.duplicates());
+
+    // Once A has finished, B's results are no longer held back.
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("uri", "uri4")))).Times(1);
+    b->push(make_result("uri4", "B"));
+}
+
+TEST(ResultMerger, combine_attributes)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    ResultMerger merger(upstream, "uri", ResultMerger::Policy::CombineAttributes);
+    auto a = merger.child_reply();
+    auto b = merger.child_reply();
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(AllOf(ResultProp("title", "A"),
+                                                                    ResultProp("rating", 5),
+                                                                    ResultProp("art", "a.png"))))).Times(1);
+
+    auto rb = make_result("uri1", "B");
+    rb["rating"] = 5;
+    rb.set_art("b.png");
+    b->push(rb);
+
+    auto ra = make_result("uri1", "A");
+    ra.set_art("a.png");
+    a->push(ra);
+
+    b->finished();
+    a->finished();
+}
+
+TEST(ResultMerger, max_keys)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_))).Times(4);
+
+    ResultMerger merger(upstream, "uri", ResultMerger::Policy::FirstWins, 1);
+    auto a = merger.child_reply();
+
+    a->push(make_result("uri1", "A"));
+    a->push(make_result("uri1", "A"));   // Dropped
+    a->push(make_result("uri2", "A"));   // Not tracked
+    a->push(make_result("uri2", "A"));   // Not tracked
+    a->push(make_result("uri3", "A"));   // Not tracked
+    EXPECT_EQ(1, merger.duplicates());
+}
+
+TEST(ResultMerger, flush)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    ResultMerger merger(upstream, "dnd_uri", ResultMerger::Policy::PreferChildOrder);
+    auto a = merger.child_reply();
+    auto b = merger.child_reply();
+
+    auto r = make_result("uri1", "B");
+    r.set_dnd_uri("dnd1");
+    b->push(r);
+    b->push(make_result("uri2", "B"));   // No dnd_uri, not held back
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("uri", "uri1")))).Times(1);
+    merger.flush();
+}
+
+TEST(ResultMerger, exceptions)
+{
+    NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*) {});
+
+    EXPECT_THROW(ResultMerger(nullptr), unity::InvalidArgumentException);
+    EXPECT_THROW(ResultMerger(upstream, ""), unity::InvalidArgumentException);
+    EXPECT_THROW(ResultMerger(upstream, "uri", ResultMerger::Policy::FirstWins, 0), unity::InvalidArgumentException);
+}